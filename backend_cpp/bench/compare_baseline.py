@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Compare a bench run against a stored baseline.
+
+Understands both outputs of the bench suite:
+  * micro_bench --benchmark_out=micro.json --benchmark_out_format=json (Google Benchmark)
+  * load_gen --json load.json
+
+    bench/compare_baseline.py micro.json bench/baselines/micro.json [--tolerance 0.10]
+    bench/compare_baseline.py load.json bench/baselines/load.json --update
+
+A benchmark is a regression when its time (p99 for load_gen scenarios) grows, or its
+throughput drops, by more than the tolerance. --update stores the run as the baseline.
+Exit code: 0 clean, 1 usage or input error, 2 regression.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+
+def load_metrics(doc):
+    """name -> {"time": lower is better, "rate": higher is better (optional)}"""
+    metrics = {}
+    if "benchmarks" in doc:  # Google Benchmark
+        for b in doc["benchmarks"]:
+            # With repetitions, compare the median aggregate; otherwise the single run
+            if b.get("run_type") == "aggregate" and b.get("aggregate_name") != "median":
+                continue
+            name = b.get("run_name", b["name"])
+            if b.get("run_type") != "aggregate" and name in metrics:
+                continue
+            entry = {"time": float(b["real_time"]), "unit": b.get("time_unit", "ns")}
+            if "items_per_second" in b:
+                entry["rate"] = float(b["items_per_second"])
+            metrics[name] = entry
+    elif "scenarios" in doc:  # load_gen
+        for name, s in doc["scenarios"].items():
+            metrics[name] = {"time": float(s["p99_ms"]), "unit": "ms p99", "rate": float(s["throughput"])}
+    else:
+        raise ValueError("neither Google Benchmark nor load_gen output")
+    return metrics
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("current")
+    parser.add_argument("baseline")
+    parser.add_argument("--tolerance", type=float, default=0.10)
+    parser.add_argument("--update", action="store_true", help="write current as the new baseline")
+    args = parser.parse_args()
+
+    try:
+        with open(args.current) as f:
+            current_doc = json.load(f)
+        current = load_metrics(current_doc)
+    except (OSError, ValueError, KeyError) as e:
+        print(f"cannot read {args.current}: {e}", file=sys.stderr)
+        return 1
+
+    if args.update:
+        os.makedirs(os.path.dirname(args.baseline) or ".", exist_ok=True)
+        with open(args.baseline, "w") as f:
+            json.dump(current_doc, f, indent=2)
+        print(f"baseline written to {args.baseline} ({len(current)} entries)")
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print(f"no baseline at {args.baseline}; record one with --update", file=sys.stderr)
+        return 0
+    try:
+        with open(args.baseline) as f:
+            baseline = load_metrics(json.load(f))
+    except (OSError, ValueError, KeyError) as e:
+        print(f"cannot read {args.baseline}: {e}", file=sys.stderr)
+        return 1
+
+    regressions = 0
+    width = max([len("benchmark")] + [len(n) for n in current])
+    print(f"{'benchmark':<{width}}  {'time':>12} {'base':>12} {'delta':>8}  {'rate delta':>10}")
+    for name, cur in sorted(current.items()):
+        base = baseline.get(name)
+        if base is None:
+            print(f"{name:<{width}}  {cur['time']:>12.2f} {'(new)':>12}")
+            continue
+        time_delta = cur["time"] / base["time"] - 1.0 if base["time"] > 0 else 0.0
+        rate_delta = None
+        if "rate" in cur and base.get("rate", 0) > 0:
+            rate_delta = cur["rate"] / base["rate"] - 1.0
+        bad = time_delta > args.tolerance or (rate_delta is not None and rate_delta < -args.tolerance)
+        regressions += bad
+        rate = f"{rate_delta:+.1%}" if rate_delta is not None else ""
+        print(f"{name:<{width}}  {cur['time']:>12.2f} {base['time']:>12.2f} {time_delta:>+8.1%}  {rate:>10}"
+              f"{'  REGRESSION' if bad else ''}")
+    for name in sorted(set(baseline) - set(current)):
+        print(f"{name:<{width}}  {'(missing)':>12} {baseline[name]['time']:>12.2f}")
+
+    if regressions:
+        print(f"\n{regressions} regression(s) beyond {args.tolerance:.0%}")
+        return 2
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
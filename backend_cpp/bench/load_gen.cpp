@@ -0,0 +1,332 @@
+// 🚚 LOAD GENERATOR
+// Drives code_assistance_server (REST: /complete, /sync/file) and agent_service (gRPC:
+// ExecuteTask) concurrently for a fixed time and reports throughput and latency
+// percentiles per scenario, optionally checked against a stored baseline. Run the servers
+// against bench/mock_gemini so the numbers are this backend's, not the network's:
+//
+//   mock_gemini --latency-ms 40 --rate-429 0.02 &
+//   code_assistance_server --llm-base-url http://127.0.0.1:8089/v1beta/models/ &
+//   agent_service --llm-base-url http://127.0.0.1:8089/v1beta/models/ &
+//   load_gen [--duration 30] [--warmup 3] [--rest http://127.0.0.1:5002] [--agent 127.0.0.1:50051]
+//            [--complete-workers 16] [--sync-workers 2] [--agent-workers 4] [--sync-files 200]
+//            [--project load_gen] [--json out.json]
+//            [--baseline bench/baselines/load.json] [--tolerance 0.15] [--write-baseline]
+//
+// A scenario with 0 workers (or its endpoint set to "") is skipped. With --baseline, a
+// throughput below (1 - tolerance) x baseline or a p99 above (1 + tolerance) x baseline
+// is a regression and the exit code is 2. --write-baseline stores this run there instead.
+
+#include "agent.grpc.pb.h"
+#include <cpr/cpr.h>
+#include <grpcpp/grpcpp.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Args {
+    int duration_s = 30;
+    int warmup_s = 3;
+    std::string rest = "http://127.0.0.1:5002";
+    std::string agent = "127.0.0.1:50051";
+    int complete_workers = 16;
+    int sync_workers = 2;
+    int agent_workers = 4;
+    int sync_files = 200;
+    std::string project = "load_gen";
+    std::string json_out;
+    std::string baseline;
+    double tolerance = 0.15;
+    bool write_baseline = false;
+};
+
+bool parse_args(int argc, char** argv, Args& a) {
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--write-baseline") {
+            a.write_baseline = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        std::string val = argv[++i];
+        if (flag == "--duration") a.duration_s = std::stoi(val);
+        else if (flag == "--warmup") a.warmup_s = std::stoi(val);
+        else if (flag == "--rest") a.rest = val;
+        else if (flag == "--agent") a.agent = val;
+        else if (flag == "--complete-workers") a.complete_workers = std::stoi(val);
+        else if (flag == "--sync-workers") a.sync_workers = std::stoi(val);
+        else if (flag == "--agent-workers") a.agent_workers = std::stoi(val);
+        else if (flag == "--sync-files") a.sync_files = std::max(1, std::stoi(val));
+        else if (flag == "--project") a.project = val;
+        else if (flag == "--json") a.json_out = val;
+        else if (flag == "--baseline") a.baseline = val;
+        else if (flag == "--tolerance") a.tolerance = std::stod(val);
+        else return false;
+    }
+    return a.duration_s > 0 && (!a.write_baseline || !a.baseline.empty());
+}
+
+double ms_since(Clock::time_point t) { return std::chrono::duration<double, std::milli>(Clock::now() - t).count(); }
+
+// Per-worker samples; merged once the run is over
+struct WorkerStats {
+    std::vector<double> latency_ms;
+    std::vector<double> first_event_ms; // Streaming scenarios: time to the first message
+    uint64_t errors = 0;
+};
+
+struct ScenarioReport {
+    std::string name;
+    uint64_t ok = 0, errors = 0;
+    double throughput = 0.0;
+    double p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+    double first_event_p99 = -1.0;
+
+    json to_json() const {
+        json j = {{"requests", ok}, {"errors", errors}, {"throughput", throughput},
+                  {"p50_ms", p50}, {"p95_ms", p95}, {"p99_ms", p99}, {"max_ms", max}};
+        if (first_event_p99 >= 0.0) j["first_event_p99_ms"] = first_event_p99;
+        return j;
+    }
+};
+
+double percentile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(q * static_cast<double>(sorted.size()));
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+// Runs `workers` threads of `call` (true = success) until the deadline; samples taken
+// during the warmup are dropped
+class Scenario {
+public:
+    using Call = std::function<bool(int worker, uint64_t n, WorkerStats& stats)>;
+
+    Scenario(std::string name, int workers, Call call) : name_(std::move(name)), call_(std::move(call)), stats_(workers) {}
+
+    void start(Clock::time_point measure_from, Clock::time_point until) {
+        measure_from_ = measure_from;
+        for (size_t w = 0; w < stats_.size(); ++w) {
+            threads_.emplace_back([this, w, measure_from, until] {
+                WorkerStats& s = stats_[w];
+                for (uint64_t n = 0; Clock::now() < until; ++n) {
+                    bool measured = Clock::now() >= measure_from;
+                    size_t before = s.first_event_ms.size();
+                    auto t0 = Clock::now();
+                    bool ok = call_(static_cast<int>(w), n, s);
+                    double ms = ms_since(t0);
+                    if (!measured) {
+                        s.first_event_ms.resize(before);
+                        continue;
+                    }
+                    if (ok) s.latency_ms.push_back(ms);
+                    else s.errors++;
+                }
+            });
+        }
+    }
+
+    ScenarioReport finish() {
+        for (auto& t : threads_) t.join();
+        auto measured_s = std::chrono::duration<double>(Clock::now() - measure_from_).count();
+        ScenarioReport r;
+        r.name = name_;
+        std::vector<double> all, first;
+        for (const auto& s : stats_) {
+            all.insert(all.end(), s.latency_ms.begin(), s.latency_ms.end());
+            first.insert(first.end(), s.first_event_ms.begin(), s.first_event_ms.end());
+            r.errors += s.errors;
+        }
+        std::sort(all.begin(), all.end());
+        std::sort(first.begin(), first.end());
+        r.ok = all.size();
+        r.throughput = measured_s > 0 ? static_cast<double>(all.size()) / measured_s : 0.0;
+        r.p50 = percentile(all, 0.50);
+        r.p95 = percentile(all, 0.95);
+        r.p99 = percentile(all, 0.99);
+        r.max = all.empty() ? 0.0 : all.back();
+        if (!first.empty()) r.first_event_p99 = percentile(first, 0.99);
+        return r;
+    }
+
+private:
+    std::string name_;
+    Call call_;
+    std::vector<WorkerStats> stats_;
+    std::vector<std::thread> threads_;
+    Clock::time_point measure_from_;
+};
+
+// ---- Scenarios ----
+
+// Ghost text: every prefix is new, so the completion cache cannot answer it
+Scenario::Call complete_call(const std::string& rest) {
+    return [url = rest + "/complete"](int worker, uint64_t n, WorkerStats&) {
+        thread_local cpr::Session session;
+        thread_local bool ready = false;
+        if (!ready) {
+            session.SetUrl(cpr::Url{url});
+            session.SetHeader(cpr::Header{{"Content-Type", "application/json"}});
+            session.SetTimeout(cpr::Timeout{30000});
+            ready = true;
+        }
+        std::string id = std::to_string(worker) + "_" + std::to_string(n);
+        session.SetBody(cpr::Body{json{{"prefix", "def handle_" + id + "(request):\n    value = request.get('" + id + "')\n    "},
+                                       {"session_id", "load-" + id}}.dump()});
+        auto r = session.Post();
+        return r.status_code == 200;
+    };
+}
+
+// A synthetic project the sync scenario rewrites one file of per request
+fs::path make_sync_project(const Args& a) {
+    fs::path root = fs::temp_directory_path() / "synapse_load_gen" / a.project;
+    fs::create_directories(root / "src");
+    for (int i = 0; i < a.sync_files; ++i) {
+        std::ofstream(root / "src" / ("module_" + std::to_string(i) + ".py"))
+            << "def module_" << i << "(x):\n    return x + " << i << "\n";
+    }
+    return root;
+}
+
+Scenario::Call sync_call(const Args& a, const fs::path& root) {
+    return [url = a.rest + "/sync/file/" + a.project, root, files = a.sync_files](int worker, uint64_t n, WorkerStats&) {
+        int file = static_cast<int>((n * 7919 + static_cast<uint64_t>(worker) * 104729) % static_cast<uint64_t>(files));
+        std::string rel = "src/module_" + std::to_string(file) + ".py";
+        {
+            std::ofstream out(root / rel, std::ios::trunc);
+            out << "def module_" << file << "(x):\n    # revision " << worker << "." << n << "\n    return x * " << n << "\n";
+        }
+        auto r = cpr::Post(cpr::Url{url}, cpr::Header{{"Content-Type", "application/json"}},
+                           cpr::Body{json{{"file_path", rel}, {"local_path", root.string()}}.dump()}, cpr::Timeout{30000});
+        return r.status_code == 200;
+    };
+}
+
+// One mission per call; each message of the stream counts, the first one is timed separately
+Scenario::Call agent_call(const Args& a, const fs::path& project_root) {
+    auto channel = grpc::CreateChannel(a.agent, grpc::InsecureChannelCredentials());
+    return [stub = std::shared_ptr<code_assistance::AgentService::Stub>(code_assistance::AgentService::NewStub(channel)),
+            project_root](int worker, uint64_t n, WorkerStats& stats) {
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(120));
+        code_assistance::UserQuery query;
+        query.set_project_id(project_root.string());
+        query.set_prompt("What does src/module_" + std::to_string(n % 50) + ".py return? (load " +
+                         std::to_string(worker) + "." + std::to_string(n) + ")");
+        query.set_session_id("load-" + std::to_string(worker));
+
+        auto t0 = Clock::now();
+        auto reader = stub->ExecuteTask(&context, query);
+        code_assistance::AgentResponse response;
+        bool first = true;
+        while (reader->Read(&response)) {
+            if (first) {
+                stats.first_event_ms.push_back(ms_since(t0));
+                first = false;
+            }
+        }
+        return reader->Finish().ok();
+    };
+}
+
+// ---- Baseline ----
+
+bool compare_with_baseline(const std::vector<ScenarioReport>& reports, const std::string& path, double tolerance) {
+    std::ifstream in(path);
+    if (!in) {
+        spdlog::warn("⚠️ No baseline at {}; run with --write-baseline to create it", path);
+        return true;
+    }
+    json base = json::parse(in, nullptr, false);
+    if (base.is_discarded() || !base.contains("scenarios")) {
+        spdlog::error("❌ {} is not a load_gen baseline", path);
+        return false;
+    }
+    bool ok = true;
+    std::printf("\n%-10s %14s %14s %12s %12s\n", "baseline", "throughput", "(base)", "p99 ms", "(base)");
+    for (const auto& r : reports) {
+        if (!base["scenarios"].contains(r.name)) continue;
+        const auto& b = base["scenarios"][r.name];
+        double base_tp = b.value("throughput", 0.0), base_p99 = b.value("p99_ms", 0.0);
+        bool slower = base_tp > 0 && r.throughput < base_tp * (1.0 - tolerance);
+        bool later = base_p99 > 0 && r.p99 > base_p99 * (1.0 + tolerance);
+        std::printf("%-10s %14.1f %14.1f %12.2f %12.2f %s\n", r.name.c_str(), r.throughput, base_tp, r.p99, base_p99,
+                    slower || later ? "REGRESSION" : "ok");
+        ok = ok && !slower && !later;
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    spdlog::set_pattern("[%H:%M:%S] [%^%l%$] %v");
+    Args args;
+    if (!parse_args(argc, argv, args)) {
+        spdlog::error("usage: load_gen [--duration S] [--warmup S] [--rest URL] [--agent HOST:PORT] "
+                      "[--complete-workers N] [--sync-workers N] [--agent-workers N] [--sync-files N] [--project ID] "
+                      "[--json FILE] [--baseline FILE] [--tolerance F] [--write-baseline]");
+        return 1;
+    }
+
+    fs::path root = make_sync_project(args);
+    std::vector<std::unique_ptr<Scenario>> scenarios;
+    if (!args.rest.empty() && args.complete_workers > 0) {
+        scenarios.push_back(std::make_unique<Scenario>("complete", args.complete_workers, complete_call(args.rest)));
+    }
+    if (!args.rest.empty() && args.sync_workers > 0) {
+        scenarios.push_back(std::make_unique<Scenario>("sync", args.sync_workers, sync_call(args, root)));
+    }
+    if (!args.agent.empty() && args.agent_workers > 0) {
+        scenarios.push_back(std::make_unique<Scenario>("agent", args.agent_workers, agent_call(args, root)));
+    }
+    if (scenarios.empty()) {
+        spdlog::error("❌ Nothing to run: every scenario has 0 workers or no endpoint");
+        return 1;
+    }
+
+    spdlog::info("🚚 {} scenario(s), {}s warmup + {}s measured", scenarios.size(), args.warmup_s, args.duration_s);
+    auto measure_from = Clock::now() + std::chrono::seconds(args.warmup_s);
+    auto until = measure_from + std::chrono::seconds(args.duration_s);
+    for (auto& s : scenarios) s->start(measure_from, until);
+
+    std::vector<ScenarioReport> reports;
+    for (auto& s : scenarios) reports.push_back(s->finish());
+
+    std::printf("\n%-10s %10s %8s %12s %10s %10s %10s %10s %12s\n", "scenario", "requests", "errors", "req/s",
+                "p50 ms", "p95 ms", "p99 ms", "max ms", "first p99");
+    json out = {{"duration_s", args.duration_s}, {"scenarios", json::object()}};
+    for (const auto& r : reports) {
+        std::printf("%-10s %10llu %8llu %12.1f %10.2f %10.2f %10.2f %10.2f", r.name.c_str(),
+                    static_cast<unsigned long long>(r.ok), static_cast<unsigned long long>(r.errors), r.throughput,
+                    r.p50, r.p95, r.p99, r.max);
+        if (r.first_event_p99 >= 0.0) std::printf(" %12.2f", r.first_event_p99);
+        std::printf("\n");
+        out["scenarios"][r.name] = r.to_json();
+    }
+
+    if (!args.json_out.empty()) std::ofstream(args.json_out) << out.dump(2);
+    if (args.write_baseline) {
+        if (fs::path(args.baseline).has_parent_path()) fs::create_directories(fs::path(args.baseline).parent_path());
+        std::ofstream(args.baseline) << out.dump(2);
+        spdlog::info("📌 Baseline written to {}", args.baseline);
+        return 0;
+    }
+    if (!args.baseline.empty() && !compare_with_baseline(reports, args.baseline, args.tolerance)) return 2;
+    return 0;
+}
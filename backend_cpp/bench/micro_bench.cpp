@@ -0,0 +1,303 @@
+// 📏 MICRO BENCH
+// Google Benchmark suite over the hot paths: ignore rules, caches, both parsers, the
+// vector search, graph expansion and context assembly. Everything runs on synthetic data
+// generated in-process, so numbers are comparable between runs and commits.
+//
+//   micro_bench [--benchmark_filter=Retrieve] [--benchmark_repetitions=10]
+//               [--benchmark_out=micro.json --benchmark_out_format=json]
+//   bench/compare_baseline.py micro.json bench/baselines/micro.json
+//
+// With repetitions, each benchmark also reports a p99 aggregate over them.
+// BENCH_NODES overrides the synthetic store size (default 10000 nodes of 768 dims).
+
+#include "cache_manager.hpp"
+#include "code_graph.hpp"
+#include "faiss_vector_store.hpp"
+#include "parser_elite.hpp"
+#include "PathMatcher.hpp"
+#include "retrieval_engine.hpp"
+#include "StageMetrics.hpp"
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace code_assistance;
+
+namespace {
+
+constexpr int DIM = 768;
+constexpr size_t QUERIES = 256;
+
+double p99(const std::vector<double>& v) {
+    if (v.empty()) return 0.0;
+    std::vector<double> sorted(v);
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(0.99 * static_cast<double>(sorted.size())))];
+}
+
+// ---- Synthetic inputs ----
+
+// A C++ file of `functions` small functions, each calling the previous two
+std::shared_ptr<const std::string> synthetic_source(int functions) {
+    auto src = std::make_shared<std::string>("#include <vector>\n#include <string>\n\nnamespace bench {\n\n");
+    for (int i = 0; i < functions; ++i) {
+        *src += "// Computes step " + std::to_string(i) + "\n";
+        *src += "int step_" + std::to_string(i) + "(const std::vector<int>& v, int seed) {\n";
+        *src += "    int acc = seed;\n    for (int x : v) {\n        if (x % 3 == 0) acc += x;\n        else acc ^= x;\n    }\n";
+        if (i > 1) {
+            *src += "    acc += step_" + std::to_string(i - 1) + "(v, acc) - step_" + std::to_string(i - 2) + "(v, 1);\n";
+        }
+        *src += "    return acc;\n}\n\n";
+    }
+    *src += "} // namespace bench\n";
+    return src;
+}
+
+std::vector<float> clustered_vector(std::mt19937& rng, const std::vector<std::vector<float>>& centroids) {
+    std::normal_distribution<float> noise(0.0f, 0.35f);
+    const auto& c = centroids[rng() % centroids.size()];
+    std::vector<float> v(DIM);
+    for (int d = 0; d < DIM; ++d) v[d] = c[d] + noise(rng);
+    return v;
+}
+
+// One store for every retrieval benchmark: clustered vectors, four dependencies per node
+struct StoreFixture {
+    std::shared_ptr<FaissVectorStore> store;
+    std::unique_ptr<RetrievalEngine> engine;
+    std::vector<float> queries; // QUERIES x DIM
+
+    static StoreFixture& get() {
+        static StoreFixture fixture;
+        return fixture;
+    }
+
+private:
+    StoreFixture() {
+        size_t n = 10000;
+        if (const char* env = std::getenv("BENCH_NODES")) n = std::max<size_t>(100, std::strtoull(env, nullptr, 10));
+        std::mt19937 rng(42);
+        std::normal_distribution<float> unit(0.0f, 1.0f);
+        std::vector<std::vector<float>> centroids(64, std::vector<float>(DIM));
+        for (auto& c : centroids) {
+            for (float& x : c) x = unit(rng);
+        }
+
+        store = std::make_shared<FaissVectorStore>(DIM);
+        std::vector<std::shared_ptr<CodeNode>> batch;
+        for (size_t i = 0; i < n; ++i) {
+            auto node = std::make_shared<CodeNode>();
+            node->id = "bench/file_" + std::to_string(i / 20) + ".cpp::fn_" + std::to_string(i);
+            node->name = "fn_" + std::to_string(i);
+            node->type = "function";
+            node->file_path = "bench/file_" + std::to_string(i / 20) + ".cpp";
+            node->content = "int fn_" + std::to_string(i) + "() { return helper(" + std::to_string(i) + "); }\n" +
+                            std::string(200 + i % 400, 'x');
+            for (int d = 0; d < 4; ++d) {
+                size_t dep = rng() % n;
+                if (dep != i) node->dependencies.insert("bench/file_" + std::to_string(dep / 20) + ".cpp::fn_" + std::to_string(dep));
+            }
+            node->embedding = clustered_vector(rng, centroids);
+            batch.push_back(std::move(node));
+            if (batch.size() == 1000) {
+                store->upsert_nodes(batch);
+                batch.clear();
+            }
+        }
+        if (!batch.empty()) store->upsert_nodes(batch);
+        store->compact(); // One sealed graph, as a saved and reloaded store would have
+
+        RetrievalCacheOptions no_cache;
+        no_cache.enabled = false; // Every iteration does the full pipeline
+        engine = std::make_unique<RetrievalEngine>(store, no_cache);
+
+        for (size_t q = 0; q < QUERIES; ++q) {
+            auto v = clustered_vector(rng, centroids);
+            queries.insert(queries.end(), v.begin(), v.end());
+        }
+    }
+};
+
+std::vector<float> query(size_t i) {
+    const auto& f = StoreFixture::get();
+    const float* q = f.queries.data() + (i % QUERIES) * DIM;
+    return std::vector<float>(q, q + DIM);
+}
+
+// p99 of one stage over the samples recorded since `before`
+double stage_p99_since(Stage stage, const ConcurrentHistogram::Snapshot& before) {
+    auto after = StageMetrics::histogram(stage).snapshot();
+    for (size_t b = 0; b < after.counts.size(); ++b) after.counts[b] -= before.counts[b];
+    after.count -= before.count;
+    after.sum_us -= before.sum_us;
+    return after.percentile_ms(0.99);
+}
+
+// ---- Ignore rules (PathMatcher's literal trie + globs) ----
+
+void BM_PathMatcherCheck(benchmark::State& state) {
+    PathMatcher matcher({"node_modules", "build/", "*.o", "*.pyc", "dist", ".git", "third_party/**/test",
+                         "docs/generated", "*.min.js", "out/"},
+                        {"third_party/keep/**"}, false);
+    std::vector<std::string> paths;
+    std::mt19937 rng(7);
+    const char* dirs[] = {"src", "include", "node_modules", "third_party", "build", "docs", "test", "tools"};
+    const char* files[] = {"main.cpp", "util.o", "index.min.js", "a.py", "b.pyc", "README.md", "CMakeLists.txt"};
+    for (int i = 0; i < 1024; ++i) {
+        std::string p;
+        int depth = 1 + rng() % 5;
+        for (int d = 0; d < depth; ++d) p += std::string(dirs[rng() % 8]) + "/";
+        paths.push_back(p + files[rng() % 7]);
+    }
+    size_t i = 0, matched = 0;
+    for (auto _ : state) {
+        matched += matcher.check(paths[i++ & 1023], false) != PathFlag::NONE;
+    }
+    benchmark::DoNotOptimize(matched);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PathMatcherCheck)->ComputeStatistics("p99", p99);
+
+// ---- Caches ----
+
+void BM_LRUCacheGet(benchmark::State& state) {
+    static LRUCache<std::string, std::string> cache(8192, std::chrono::seconds(3600));
+    static std::vector<std::string> keys = [] {
+        std::vector<std::string> k;
+        for (int i = 0; i < 4096; ++i) {
+            k.push_back("key/" + std::to_string(i));
+            cache.set(k.back(), std::string(64, 'v'));
+        }
+        return k;
+    }();
+    size_t i = state.thread_index() * 131;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.get(keys[i++ & 4095]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LRUCacheGet)->ThreadRange(1, 8)->ComputeStatistics("p99", p99);
+
+void BM_LRUCacheSet(benchmark::State& state) {
+    LRUCache<std::string, std::string> cache(1024, std::chrono::seconds(3600)); // Evicts from the 1025th set on
+    std::string value(64, 'v');
+    size_t i = 0;
+    for (auto _ : state) {
+        cache.set("key/" + std::to_string(i++), value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LRUCacheSet)->ComputeStatistics("p99", p99);
+
+// Arg: 0 = LRU, 1 = Clock
+void BM_ShardedCacheGet(benchmark::State& state) {
+    static ShardedLRUCache<std::string, std::string> lru(8 << 20, std::chrono::seconds(3600), EvictionPolicy::LRU);
+    static ShardedLRUCache<std::string, std::string> clock(8 << 20, std::chrono::seconds(3600), EvictionPolicy::Clock);
+    static std::vector<std::string> keys = [] {
+        std::vector<std::string> k;
+        for (int i = 0; i < 4096; ++i) {
+            k.push_back("key/" + std::to_string(i));
+            lru.set(k.back(), std::string(64, 'v'));
+            clock.set(k.back(), std::string(64, 'v'));
+        }
+        return k;
+    }();
+    auto& cache = state.range(0) ? clock : lru;
+    size_t i = state.thread_index() * 131;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.get(keys[i++ & 4095]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShardedCacheGet)->ArgName("clock")->Arg(0)->Arg(1)->ThreadRange(1, 8)->ComputeStatistics("p99", p99);
+
+// ---- Parsers ----
+
+void BM_BracketParser(benchmark::State& state) {
+    auto src = synthetic_source(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CodeParser::extract_nodes_fallback("bench/fallback.txt", src));
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(src->size()));
+}
+BENCHMARK(BM_BracketParser)->Arg(100)->Arg(1000)->ComputeStatistics("p99", p99);
+
+// Cold: the tree is parsed from scratch. Warm: the AST cache holds the file's tree.
+void BM_ASTBoosterExtract(benchmark::State& state) {
+    auto src = synthetic_source(static_cast<int>(state.range(0)));
+    const bool warm = state.range(1) != 0;
+    const std::string path = "bench/ast_" + std::to_string(state.range(0)) + ".cpp";
+    elite::ASTBooster booster;
+    for (auto _ : state) {
+        if (!warm) elite::ASTCache::instance().invalidate(path);
+        benchmark::DoNotOptimize(booster.extract_symbols(path, src));
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(src->size()));
+}
+BENCHMARK(BM_ASTBoosterExtract)->ArgNames({"fns", "warm"})->ArgsProduct({{100, 1000}, {0, 1}})
+    ->ComputeStatistics("p99", p99);
+
+// ---- Vector store ----
+
+// Args: k, queries per call
+void BM_FaissSearch(benchmark::State& state) {
+    auto& f = StoreFixture::get();
+    const int k = static_cast<int>(state.range(0));
+    const size_t nq = static_cast<size_t>(state.range(1));
+    FaissBatchResult out;
+    size_t i = 0;
+    for (auto _ : state) {
+        f.store->search_batch_into(f.queries.data() + ((i++ * nq) % (QUERIES - nq + 1)) * DIM, nq, k, {}, out);
+        benchmark::DoNotOptimize(out.labels.data());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(nq));
+}
+BENCHMARK(BM_FaissSearch)->ArgNames({"k", "nq"})->ArgsProduct({{10, 50, 200}, {1, 8}})->ComputeStatistics("p99", p99);
+
+// ---- Retrieval pipeline ----
+
+// Search + exponential_graph_expansion + scoring + MMR. The expansion itself is file-local
+// to retrieval_engine.cpp, so its share is reported from the stage histogram.
+void BM_Retrieve(benchmark::State& state) {
+    auto& f = StoreFixture::get();
+    const bool use_graph = state.range(0) != 0;
+    auto before = StageMetrics::histogram(Stage::RetrievalExpand).snapshot();
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(f.engine->retrieve("", query(i++), 80, use_graph));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["expand_p99_ms"] = stage_p99_since(Stage::RetrievalExpand, before);
+}
+BENCHMARK(BM_Retrieve)->ArgName("graph")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond)->ComputeStatistics("p99", p99);
+
+// Arg: max_chars
+void BM_BuildHierarchicalContext(benchmark::State& state) {
+    auto& f = StoreFixture::get();
+    auto candidates = f.engine->retrieve("", query(0), 80, true);
+    std::string out;
+    size_t chars = 0;
+    for (auto _ : state) {
+        chars = f.engine->build_hierarchical_context_into(candidates, out, static_cast<size_t>(state.range(0)));
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(chars));
+    state.counters["candidates"] = static_cast<double>(candidates.size());
+}
+BENCHMARK(BM_BuildHierarchicalContext)->Arg(30000)->Arg(120000)->ComputeStatistics("p99", p99);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::warn); // The pipeline logs every retrieval at info
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,254 @@
+// 🎭 MOCK GEMINI
+// A local stand-in for the Gemini REST API, so load tests measure this backend and not
+// the network or a quota. Serves generateContent, streamGenerateContent (SSE),
+// embedContent and batchEmbedContents at /v1beta/models/<model>:<action> with a
+// configurable latency and a share of 429s carrying a RetryInfo delay.
+//
+//   mock_gemini [--port 8089] [--latency-ms 40] [--jitter-ms 20] [--embed-latency-ms 15]
+//               [--stream-chunks 6] [--chunk-delay-ms 10] [--rate-429 0.02]
+//               [--retry-after-s 1] [--dim 768] [--agent-steps 2] [--seed 1]
+//
+// Point the servers at it with --llm-base-url http://127.0.0.1:8089/v1beta/models/.
+// Agent replies call read_file on a made-up path until the mission has agent-steps
+// steps, then give FINAL_ANSWER. GET /stats returns the request counters.
+
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace {
+
+struct Options {
+    int port = 8089;
+    int latency_ms = 40;
+    int jitter_ms = 20;
+    int embed_latency_ms = 15;
+    int stream_chunks = 6;
+    int chunk_delay_ms = 10;
+    double rate_429 = 0.02;
+    int retry_after_s = 1;
+    int dim = 768;
+    int agent_steps = 2;
+    uint32_t seed = 1;
+};
+
+struct Counters {
+    std::atomic<uint64_t> generate{0}, stream{0}, embed{0}, embed_texts{0}, throttled{0}, bad{0};
+};
+
+bool parse_args(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string val = argv[++i];
+        if (flag == "--port") o.port = std::stoi(val);
+        else if (flag == "--latency-ms") o.latency_ms = std::stoi(val);
+        else if (flag == "--jitter-ms") o.jitter_ms = std::stoi(val);
+        else if (flag == "--embed-latency-ms") o.embed_latency_ms = std::stoi(val);
+        else if (flag == "--stream-chunks") o.stream_chunks = std::max(1, std::stoi(val));
+        else if (flag == "--chunk-delay-ms") o.chunk_delay_ms = std::stoi(val);
+        else if (flag == "--rate-429") o.rate_429 = std::stod(val);
+        else if (flag == "--retry-after-s") o.retry_after_s = std::stoi(val);
+        else if (flag == "--dim") o.dim = std::stoi(val);
+        else if (flag == "--agent-steps") o.agent_steps = std::max(1, std::stoi(val));
+        else if (flag == "--seed") o.seed = static_cast<uint32_t>(std::stoul(val));
+        else return false;
+    }
+    return true;
+}
+
+class Mock {
+public:
+    explicit Mock(const Options& o) : o_(o) {}
+
+    void handle(const httplib::Request& req, httplib::Response& res) {
+        const std::string model = req.matches[1];
+        const std::string action = req.matches[2];
+        const bool embedding = action == "embedContent" || action == "batchEmbedContents";
+
+        sleep_ms(embedding ? o_.embed_latency_ms : o_.latency_ms, embedding ? 0 : o_.jitter_ms);
+        if (roll() < o_.rate_429) {
+            counters_.throttled++;
+            res.status = 429;
+            res.set_header("Retry-After", std::to_string(o_.retry_after_s));
+            res.set_content(json{{"error", {{"code", 429}, {"status", "RESOURCE_EXHAUSTED"},
+                                            {"message", "Mock quota exceeded for " + model},
+                                            {"details", {{{"@type", "type.googleapis.com/google.rpc.RetryInfo"},
+                                                          {"retryDelay", std::to_string(o_.retry_after_s) + "s"}}}}}}}
+                                .dump(),
+                            "application/json");
+            return;
+        }
+
+        json body = json::parse(req.body, nullptr, false);
+        if (body.is_discarded()) {
+            counters_.bad++;
+            res.status = 400;
+            return;
+        }
+
+        if (action == "batchEmbedContents") {
+            counters_.embed++;
+            json out = json::array();
+            for (const auto& r : body.value("requests", json::array())) {
+                out.push_back({{"values", embed(first_text(r.value("content", json::object())))}});
+            }
+            counters_.embed_texts += out.size();
+            res.set_content(json{{"embeddings", std::move(out)}}.dump(), "application/json");
+        } else if (action == "embedContent") {
+            counters_.embed++;
+            counters_.embed_texts++;
+            res.set_content(json{{"embedding", {{"values", embed(first_text(body.value("content", json::object())))}}}}.dump(),
+                            "application/json");
+        } else if (action == "generateContent") {
+            counters_.generate++;
+            std::string text = reply_for(req.body);
+            res.set_content(json{{"candidates", {{{"content", {{"role", "model"}, {"parts", {{{"text", text}}}}}},
+                                                  {"finishReason", "STOP"}}}},
+                                 {"usageMetadata", usage(req.body, text)}}
+                                .dump(),
+                            "application/json");
+        } else if (action == "streamGenerateContent") {
+            counters_.stream++;
+            stream(req.body, res);
+        } else {
+            counters_.bad++;
+            res.status = 404;
+        }
+    }
+
+    json stats() const {
+        return {{"generate", counters_.generate.load()}, {"stream", counters_.stream.load()},
+                {"embed_requests", counters_.embed.load()}, {"embed_texts", counters_.embed_texts.load()},
+                {"throttled", counters_.throttled.load()}, {"bad_requests", counters_.bad.load()}};
+    }
+
+private:
+    // Mission steps so far: each finished step adds one "[RESULT:" block to the history
+    std::string reply_for(const std::string& request) const {
+        if (request.find("### ROLE: Synapse Autonomous Pilot") == std::string::npos) {
+            return "    return value + 1;\n"; // Ghost text / plain generation
+        }
+        size_t steps = 0;
+        for (size_t at = request.find("[RESULT:"); at != std::string::npos; at = request.find("[RESULT:", at + 1)) steps++;
+        if (static_cast<int>(steps) + 1 < o_.agent_steps) {
+            return "Looking at the code first.\n{\"tool\": \"read_file\", \"parameters\": {\"path\": \"mock/step_" +
+                   std::to_string(steps) + ".txt\"}}";
+        }
+        return "{\"tool\": \"FINAL_ANSWER\", \"parameters\": {\"answer\": \"Mock answer after " + std::to_string(steps) +
+               " step(s).\"}}";
+    }
+
+    void stream(const std::string& request, httplib::Response& res) {
+        std::string text = reply_for(request);
+        json meta = usage(request, text);
+        const int chunks = o_.stream_chunks;
+        const int delay = o_.chunk_delay_ms;
+        res.set_chunked_content_provider("text/event-stream",
+            [text = std::move(text), meta = std::move(meta), chunks, delay, sent = 0](size_t, httplib::DataSink& sink) mutable {
+                if (sent >= chunks) {
+                    sink.done();
+                    return true;
+                }
+                size_t begin = text.size() * sent / chunks, end = text.size() * (sent + 1) / chunks;
+                json event = {{"candidates", {{{"content", {{"role", "model"}, {"parts", {{{"text", text.substr(begin, end - begin)}}}}}}}}}};
+                if (++sent == chunks) {
+                    event["candidates"][0]["finishReason"] = "STOP";
+                    event["usageMetadata"] = meta;
+                }
+                if (delay > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+                std::string frame = "data: " + event.dump() + "\r\n\r\n";
+                return sink.write(frame.data(), frame.size());
+            });
+    }
+
+    static json usage(const std::string& request, const std::string& reply) {
+        int prompt = static_cast<int>(request.size() / 4), completion = static_cast<int>(reply.size() / 4);
+        return {{"promptTokenCount", prompt}, {"candidatesTokenCount", completion},
+                {"totalTokenCount", prompt + completion}, {"cachedContentTokenCount", 0}};
+    }
+
+    static std::string first_text(const json& content) {
+        for (const auto& part : content.value("parts", json::array())) {
+            if (part.contains("text")) return part["text"].get<std::string>();
+        }
+        return {};
+    }
+
+    // Deterministic per text, so cache hits and dedup behave as with the real model
+    std::vector<float> embed(std::string_view text) const {
+        uint64_t h = 1469598103934665603ULL ^ o_.seed;
+        for (unsigned char c : text) h = (h ^ c) * 1099511628211ULL;
+        std::mt19937_64 rng(h);
+        std::normal_distribution<float> unit(0.0f, 1.0f);
+        std::vector<float> v(o_.dim);
+        double norm = 0.0;
+        for (float& x : v) {
+            x = unit(rng);
+            norm += static_cast<double>(x) * x;
+        }
+        float scale = static_cast<float>(1.0 / std::sqrt(norm));
+        for (float& x : v) x *= scale;
+        return v;
+    }
+
+    double roll() {
+        std::lock_guard<std::mutex> lock(rng_mutex_);
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+    }
+
+    void sleep_ms(int base, int jitter) {
+        int ms = base;
+        if (jitter > 0) {
+            std::lock_guard<std::mutex> lock(rng_mutex_);
+            ms += std::uniform_int_distribution<int>(-jitter, jitter)(rng_);
+        }
+        if (ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+
+    Options o_;
+    Counters counters_;
+    std::mutex rng_mutex_;
+    std::mt19937 rng_{o_.seed};
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    spdlog::set_pattern("[%H:%M:%S] [%^%l%$] %v");
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        spdlog::error("usage: mock_gemini [--port N] [--latency-ms N] [--jitter-ms N] [--embed-latency-ms N] "
+                      "[--stream-chunks N] [--chunk-delay-ms N] [--rate-429 F] [--retry-after-s N] [--dim N] "
+                      "[--agent-steps N] [--seed N]");
+        return 1;
+    }
+
+    Mock mock(options);
+    httplib::Server server;
+    server.new_task_queue = [] { return new httplib::ThreadPool(64); }; // Latency is simulated by sleeping
+    server.Post(R"(/v1beta/models/([^/:]+):(\w+))",
+                [&](const httplib::Request& req, httplib::Response& res) { mock.handle(req, res); });
+    server.Get("/stats", [&](const httplib::Request&, httplib::Response& res) {
+        res.set_content(mock.stats().dump(2), "application/json");
+    });
+
+    spdlog::info("🎭 Mock Gemini on 127.0.0.1:{} (latency {}±{} ms, embed {} ms, 429 rate {:.1f}%)", options.port,
+                 options.latency_ms, options.jitter_ms, options.embed_latency_ms, options.rate_429 * 100.0);
+    if (!server.listen("127.0.0.1", options.port)) {
+        spdlog::error("❌ Cannot bind 127.0.0.1:{}", options.port);
+        return 1;
+    }
+    return 0;
+}
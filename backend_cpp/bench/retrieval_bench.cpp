@@ -0,0 +1,220 @@
+// 📏 RETRIEVAL BENCH
+// Replays a query file against a saved vector_store and reports latency
+// percentiles plus recall@k against brute force, for a sweep of ef/k values.
+// For IVF backends the --ef values are used as nprobe.
+//
+//   retrieval_bench --store <dir> --queries <file> [--ef 16,32,64,128,256]
+//                   [--k 10,50,200] [--project <root>] [--warmup 20] [--json out.json]
+//
+// Query files: .fvecs (int32 dim + floats per vector), or JSON / JSONL where each
+// entry is a float array or an object with an "embedding" array.
+
+#include "faiss_vector_store.hpp"
+#include "node_store.hpp"
+#include <faiss/utils/distances.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using namespace code_assistance;
+
+namespace {
+
+struct Args {
+    std::string store_dir;
+    std::string query_file;
+    std::string project_root;
+    std::string json_out;
+    std::vector<int> ef_values = {16, 32, 64, 128, 256};
+    std::vector<int> k_values = {10, 50, 200};
+    int warmup = 20;
+};
+
+std::vector<int> parse_list(const std::string& s) {
+    std::vector<int> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(std::stoi(item));
+    }
+    return out;
+}
+
+bool parse_args(int argc, char** argv, Args& a) {
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string val = argv[++i];
+        if (flag == "--store") a.store_dir = val;
+        else if (flag == "--queries") a.query_file = val;
+        else if (flag == "--project") a.project_root = val;
+        else if (flag == "--json") a.json_out = val;
+        else if (flag == "--ef") a.ef_values = parse_list(val);
+        else if (flag == "--k") a.k_values = parse_list(val);
+        else if (flag == "--warmup") a.warmup = std::stoi(val);
+        else return false;
+    }
+    return !a.store_dir.empty() && !a.query_file.empty();
+}
+
+// Flattened nq x dim; entries with the wrong dimension are skipped
+std::vector<float> load_queries(const std::string& path, int dim) {
+    std::vector<float> flat;
+
+    if (fs::path(path).extension() == ".fvecs") {
+        std::ifstream in(path, std::ios::binary);
+        int32_t d = 0;
+        while (in.read(reinterpret_cast<char*>(&d), sizeof(d))) {
+            std::vector<float> v(d);
+            if (!in.read(reinterpret_cast<char*>(v.data()), d * sizeof(float))) break;
+            if (d == dim) flat.insert(flat.end(), v.begin(), v.end());
+        }
+        return flat;
+    }
+
+    auto push = [&](const json& j) {
+        const json& arr = j.is_object() ? j.value("embedding", json::array()) : j;
+        if (!arr.is_array() || (int)arr.size() != dim) return;
+        for (const auto& x : arr) flat.push_back(x.get<float>());
+    };
+
+    std::ifstream in(path);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    try {
+        json doc = json::parse(text);
+        if (doc.is_array() && !doc.empty() && (doc[0].is_array() || doc[0].is_object())) {
+            for (const auto& q : doc) push(q);
+        } else {
+            push(doc);
+        }
+    } catch (const json::parse_error&) {
+        std::stringstream ss(text); // JSONL
+        std::string line;
+        while (std::getline(ss, line)) {
+            if (!line.empty()) push(json::parse(line));
+        }
+    }
+    return flat;
+}
+
+// Exact top-k by cosine over the embedding column of nodes.bin
+std::vector<std::vector<int64_t>> brute_force(const NodeStore& nodes, const std::vector<float>& queries,
+                                              size_t nq, int dim, int k) {
+    const size_t n = nodes.size();
+    std::vector<float> inv_norm(n, 0.0f);
+    std::vector<float> scratch(dim);
+    for (size_t row = 0; row < n; ++row) {
+        float sq = faiss::fvec_norm_L2sqr(nodes.embedding(row, scratch.data()), dim);
+        inv_norm[row] = sq > 0.0f ? 1.0f / std::sqrt(sq) : 0.0f;
+    }
+
+    std::vector<std::vector<int64_t>> truth(nq);
+    #pragma omp parallel for schedule(dynamic)
+    for (long q = 0; q < (long)nq; ++q) {
+        const float* qv = queries.data() + q * dim;
+        std::vector<std::pair<float, int64_t>> scored(n);
+        std::vector<float> row_buf(dim);
+        for (size_t row = 0; row < n; ++row) {
+            float s = faiss::fvec_inner_product(qv, nodes.embedding(row, row_buf.data()), dim) * inv_norm[row];
+            scored[row] = {s, FaissVectorStore::stable_id(nodes.id(row))};
+        }
+        size_t kk = std::min<size_t>(k, n);
+        std::partial_sort(scored.begin(), scored.begin() + kk, scored.end(),
+                          [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (size_t i = 0; i < kk; ++i) truth[q].push_back(scored[i].second);
+    }
+    return truth;
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(std::ceil(p * v.size())) - 1);
+    return v[idx];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args args;
+    if (!parse_args(argc, argv, args)) {
+        std::fprintf(stderr, "usage: retrieval_bench --store <dir> --queries <file> [--ef 16,32,64] [--k 10,50,200] "
+                             "[--project <root>] [--warmup N] [--json out.json]\n");
+        return 2;
+    }
+    spdlog::set_level(spdlog::level::warn);
+
+    NodeStore nodes;
+    if (!nodes.open((fs::path(args.store_dir) / "nodes.bin").string()) || !nodes.has_embeddings()) {
+        std::fprintf(stderr, "❌ %s/nodes.bin is missing or has no embedding column\n", args.store_dir.c_str());
+        return 1;
+    }
+    const int dim = nodes.dimension();
+
+    IndexConfig config = args.project_root.empty() ? IndexConfig{} : IndexConfig::load_for_project(args.project_root);
+    FaissVectorStore store(dim, config);
+    store.load(args.store_dir);
+
+    std::vector<float> queries = load_queries(args.query_file, dim);
+    const size_t nq = queries.size() / dim;
+    if (nq == 0) {
+        std::fprintf(stderr, "❌ No %d-dim queries in %s\n", dim, args.query_file.c_str());
+        return 1;
+    }
+
+    const int max_k = *std::max_element(args.k_values.begin(), args.k_values.end());
+    std::printf("📦 %zu nodes | %zu queries | dim %d | computing ground truth@%d...\n", nodes.size(), nq, dim, max_k);
+    auto truth = brute_force(nodes, queries, nq, dim, max_k);
+
+    json report = json::array();
+    std::printf("\n%6s %6s %10s %10s %10s %10s\n", "ef", "k", "p50(ms)", "p95(ms)", "p99(ms)", "recall@k");
+
+    for (int k : args.k_values) {
+        for (int ef : args.ef_values) {
+            SearchOptions opts;
+            opts.ef_search = ef;
+            opts.nprobe = ef; // Same sweep drives IVF backends
+
+            for (int i = 0; i < args.warmup; ++i) {
+                store.search_batch(queries.data() + (i % nq) * dim, 1, k, opts);
+            }
+
+            std::vector<double> latencies;
+            latencies.reserve(nq);
+            double recall_sum = 0.0;
+            for (size_t q = 0; q < nq; ++q) {
+                auto start = std::chrono::steady_clock::now();
+                auto batch = store.search_batch(queries.data() + q * dim, 1, k, opts);
+                latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+                size_t kk = std::min<size_t>(k, truth[q].size());
+                std::unordered_set<int64_t> expected(truth[q].begin(), truth[q].begin() + kk);
+                size_t hits = 0;
+                for (int64_t label : batch.labels) hits += expected.count(label);
+                recall_sum += kk ? static_cast<double>(hits) / kk : 1.0;
+            }
+
+            double p50 = percentile(latencies, 0.50), p95 = percentile(latencies, 0.95), p99 = percentile(latencies, 0.99);
+            double recall = recall_sum / nq;
+            std::printf("%6d %6d %10.3f %10.3f %10.3f %10.4f\n", ef, k, p50, p95, p99, recall);
+            report.push_back({{"ef_search", ef}, {"k", k}, {"p50_ms", p50}, {"p95_ms", p95}, {"p99_ms", p99}, {"recall", recall}});
+        }
+    }
+
+    if (!args.json_out.empty()) {
+        std::ofstream(args.json_out) << report.dump(2);
+        std::printf("\n💾 Report written to %s\n", args.json_out.c_str());
+    }
+    return 0;
+}
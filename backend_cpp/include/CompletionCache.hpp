@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace code_assistance {
+
+// 👻 Per-session speculative reuse for ghost text.
+// Remembers the last (prefix, completion) per session. If the next prefix extends
+// that prefix and the typed characters match the start of the completion, the rest
+// of the completion is still valid and is served without calling the model.
+class CompletionCache {
+public:
+    explicit CompletionCache(size_t max_sessions = 256,
+                             std::chrono::seconds ttl = std::chrono::seconds(30))
+        : max_sessions_(max_sessions), ttl_(ttl) {}
+
+    std::optional<std::string> lookup(const std::string& session, std::string_view prefix) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(session);
+        if (it == sessions_.end() || !matches(it->second, prefix)) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        const Entry& e = it->second;
+        return e.completion.substr(prefix.size() - e.prefix.size());
+    }
+
+    void store(const std::string& session, std::string prefix, std::string completion) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        if (sessions_.size() >= max_sessions_ && !sessions_.count(session)) evict_oldest();
+        sessions_[session] = {std::move(prefix), std::move(completion), now};
+    }
+
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        std::string prefix;
+        std::string completion;
+        std::chrono::steady_clock::time_point stored_at;
+    };
+
+    bool matches(const Entry& e, std::string_view prefix) const {
+        if (std::chrono::steady_clock::now() - e.stored_at > ttl_) return false;
+        if (prefix.size() < e.prefix.size() || prefix.substr(0, e.prefix.size()) != e.prefix) return false;
+        std::string_view typed = prefix.substr(e.prefix.size());
+        // Something must remain to suggest, and the user must have typed along with it
+        return typed.size() < e.completion.size() && std::string_view(e.completion).substr(0, typed.size()) == typed;
+    }
+
+    void evict_oldest() {
+        auto oldest = sessions_.begin();
+        for (auto it = sessions_.begin(); it != sessions_.end(); ++it) {
+            if (it->second.stored_at < oldest->second.stored_at) oldest = it;
+        }
+        if (oldest != sessions_.end()) sessions_.erase(oldest);
+    }
+
+    size_t max_sessions_;
+    std::chrono::seconds ttl_;
+    std::unordered_map<std::string, Entry> sessions_;
+    std::mutex mutex_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
+
+} // namespace code_assistance
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace code_assistance {
+
+// 🕸️ Immutable dependency graph in compressed sparse row form.
+// Nodes are dense ids [0, size()); neighbors(u) is a contiguous slice of targets.
+// Snapshots are built by FaissVectorStore and shared read-only across queries.
+struct CsrGraph {
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    std::vector<int64_t> labels;    // dense id -> FAISS label
+    std::vector<uint32_t> offsets;  // size() + 1 entries
+    std::vector<uint32_t> targets;  // Concatenated adjacency lists
+    std::vector<float> structural;  // dense id -> CodeNode::structural_weight
+    std::unordered_map<int64_t, uint32_t> dense_of; // FAISS label -> dense id
+
+    size_t size() const { return labels.size(); }
+    size_t edge_count() const { return targets.size(); }
+
+    std::span<const uint32_t> neighbors(uint32_t u) const {
+        return {targets.data() + offsets[u], targets.data() + offsets[u + 1]};
+    }
+
+    uint32_t find(int64_t label) const {
+        auto it = dense_of.find(label);
+        return it == dense_of.end() ? NONE : it->second;
+    }
+};
+
+} // namespace code_assistance
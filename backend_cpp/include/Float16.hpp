@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace code_assistance {
+
+// 🪶 IEEE 754 binary16 <-> binary32, portable (no F16C requirement).
+// Round-to-nearest-even on the way down; subnormals, Inf and NaN preserved.
+inline uint16_t float_to_half(float value) {
+    uint32_t f;
+    std::memcpy(&f, &value, 4);
+    const uint32_t sign = (f >> 16) & 0x8000u;
+    const uint32_t abs = f & 0x7FFFFFFFu;
+
+    if (abs >= 0x7F800000u) {                        // Inf / NaN
+        return static_cast<uint16_t>(sign | 0x7C00u | (abs > 0x7F800000u ? 0x200u : 0u));
+    }
+    if (abs >= 0x477FF000u) return static_cast<uint16_t>(sign | 0x7C00u); // Overflow -> Inf
+
+    if (abs < 0x38800000u) {                         // Result is subnormal (or zero)
+        if (abs < 0x33000000u) return static_cast<uint16_t>(sign);
+        const uint32_t mant = (abs & 0x007FFFFFu) | 0x00800000u;
+        const int shift = 126 - static_cast<int>(abs >> 23);   // 14..24
+        uint32_t half = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1);
+        const uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1u))) ++half;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = ((abs - 0x38000000u) >> 13);     // Rebias exponent 127 -> 15
+    const uint32_t rem = abs & 0x1FFFu;
+    if (rem > 0x1000u || (rem == 0x1000u && (half & 1u))) ++half;
+    return static_cast<uint16_t>(sign | half);
+}
+
+inline float half_to_float(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+    uint32_t exp = (h >> 10) & 0x1Fu;
+    uint32_t mant = h & 0x3FFu;
+    uint32_t f;
+
+    if (exp == 0x1Fu) {
+        f = sign | 0x7F800000u | (mant << 13);
+    } else if (exp != 0) {
+        f = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        f = sign;
+    } else {                                          // Subnormal: normalize
+        exp = 113;
+        while ((mant & 0x400u) == 0) { mant <<= 1; --exp; }
+        f = sign | (exp << 23) | ((mant & 0x3FFu) << 13);
+    }
+
+    float out;
+    std::memcpy(&out, &f, 4);
+    return out;
+}
+
+} // namespace code_assistance
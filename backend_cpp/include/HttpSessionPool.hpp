@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cpr/cpr.h>
+#include <curl/curl.h>
+
+namespace code_assistance {
+
+// 🔌 Process-wide pool of keep-alive cpr::Sessions, bucketed by scheme://host[:port].
+// A session owns one curl easy handle and therefore its live connection: leasing a
+// warm one skips TCP + TLS setup entirely. Sessions negotiate HTTP/2 over ALPN and
+// share one curl DNS + TLS-session cache, so even a freshly created session resumes
+// TLS instead of doing a full handshake.
+class HttpSessionPool {
+public:
+    static HttpSessionPool& instance() {
+        static HttpSessionPool instance;
+        return instance;
+    }
+
+    HttpSessionPool(const HttpSessionPool&) = delete;
+    HttpSessionPool& operator=(const HttpSessionPool&) = delete;
+
+    // `keep_going` is polled during the transfer; returning false aborts it (hedge losers)
+    cpr::Response post(const std::string& url, const std::string& body, const cpr::Header& header,
+                       std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+                       std::function<bool()> keep_going = {}) {
+        std::string host = host_of(url);
+        std::unique_ptr<cpr::Session> session = acquire(host);
+        prepare(*session, url, body, header, timeout, std::move(keep_going));
+        session->SetWriteCallback(cpr::WriteCallback{}); // Buffer into Response::text again after a stream
+
+        cpr::Response r = session->Post();
+        // A transport error may leave the connection half-dead; let it go
+        if (!r.error) release(host, std::move(session));
+        return r;
+    }
+
+    // 🌊 Like post(), but the body goes to `on_data` as it arrives instead of into
+    // Response::text (server-sent events). `on_data` returning false ends the transfer.
+    cpr::Response post_stream(const std::string& url, const std::string& body, const cpr::Header& header,
+                              std::function<bool(std::string_view)> on_data,
+                              std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+                              std::function<bool()> keep_going = {}) {
+        std::string host = host_of(url);
+        std::unique_ptr<cpr::Session> session = acquire(host);
+        prepare(*session, url, body, header, timeout, std::move(keep_going));
+        session->SetWriteCallback(cpr::WriteCallback(
+            [on_data = std::move(on_data)](std::string_view data, intptr_t) -> bool { return on_data(data); }));
+
+        cpr::Response r = session->Post();
+        if (!r.error) release(host, std::move(session)); // An early stop is a write error: never reused
+        return r;
+    }
+
+    uint64_t sessions_created() const { return created_.load(std::memory_order_relaxed); }
+    uint64_t sessions_reused() const { return reused_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t MAX_IDLE_PER_HOST = 16;
+
+    HttpSessionPool() {
+        share_ = curl_share_init();
+        if (share_) {
+            curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &HttpSessionPool::lock_cb);
+            curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &HttpSessionPool::unlock_cb);
+            curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+            curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        }
+    }
+
+    ~HttpSessionPool() {
+        idle_.clear(); // Easy handles must go before the share handle they point at
+        if (share_) curl_share_cleanup(share_);
+    }
+
+    static std::string host_of(const std::string& url) {
+        size_t scheme = url.find("://");
+        size_t start = scheme == std::string::npos ? 0 : scheme + 3;
+        size_t end = url.find_first_of("/?", start);
+        return url.substr(0, end);
+    }
+
+    // Every option is set on every request: nothing leaks from the session's previous use
+    static void prepare(cpr::Session& session, const std::string& url, const std::string& body,
+                        const cpr::Header& header, std::chrono::milliseconds timeout,
+                        std::function<bool()> keep_going) {
+        session.SetUrl(cpr::Url{url});
+        session.SetBody(cpr::Body{body});
+        session.SetHeader(header);
+        session.SetTimeout(cpr::Timeout{timeout});
+        session.SetProgressCallback(cpr::ProgressCallback(
+            [keep_going = std::move(keep_going)](auto&&...) { return !keep_going || keep_going(); }));
+    }
+
+    std::unique_ptr<cpr::Session> acquire(const std::string& host) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& idle = idle_[host];
+            if (!idle.empty()) {
+                auto s = std::move(idle.back());
+                idle.pop_back();
+                reused_.fetch_add(1, std::memory_order_relaxed);
+                return s;
+            }
+        }
+
+        auto s = std::make_unique<cpr::Session>();
+        s->SetHttpVersion(cpr::HttpVersion{cpr::HttpVersionCode::VERSION_2_0_TLS}); // Falls back to 1.1
+        if (share_) curl_easy_setopt(s->GetCurlHolder()->handle, CURLOPT_SHARE, share_);
+        created_.fetch_add(1, std::memory_order_relaxed);
+        return s;
+    }
+
+    void release(const std::string& host, std::unique_ptr<cpr::Session> session) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& idle = idle_[host];
+        if (idle.size() < MAX_IDLE_PER_HOST) idle.push_back(std::move(session));
+    }
+
+    static void lock_cb(CURL*, curl_lock_data data, curl_lock_access, void* self) {
+        static_cast<HttpSessionPool*>(self)->share_locks_[data % LOCK_SLOTS].lock();
+    }
+    static void unlock_cb(CURL*, curl_lock_data data, void* self) {
+        static_cast<HttpSessionPool*>(self)->share_locks_[data % LOCK_SLOTS].unlock();
+    }
+
+    static constexpr size_t LOCK_SLOTS = 8;
+
+    CURLSH* share_ = nullptr;
+    std::mutex share_locks_[LOCK_SLOTS];
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::vector<std::unique_ptr<cpr::Session>>> idle_;
+    std::atomic<uint64_t> created_{0};
+    std::atomic<uint64_t> reused_{0};
+};
+
+} // namespace code_assistance
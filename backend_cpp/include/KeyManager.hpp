@@ -5,16 +5,51 @@
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
 #include <spdlog/spdlog.h>
 
 namespace code_assistance {
 
+// 🪣 Per-(key, model) request budget, learned AIMD-style: every success nudges the refill
+// rate up, a 429 halves it and empties the bucket until the server's retry delay passes.
+struct KeyBudgetOptions {
+    double capacity = 10.0;            // Burst size (requests)
+    double initial_rate = 1.0;         // Requests / second before anything is learned
+    double min_rate = 0.05;
+    double max_rate = 50.0;
+    double additive_increase = 0.05;   // Per success
+    double latency_weight = 0.25;      // Score penalty per second of EWMA latency
+    std::chrono::seconds base_bench{30};   // First bench after repeated 429s; doubles each time
+    std::chrono::seconds max_bench{300};
+};
+
+struct KeyLease {
+    std::string key;
+    size_t key_index = 0;
+    std::chrono::milliseconds wait{0}; // > 0: no key had budget; sleep this long before sending
+};
+
 class KeyManager {
 private:
+    using Clock = std::chrono::steady_clock;
+
     struct ApiKey {
         std::string key;
-        bool is_active = true;
+        bool is_active = true;          // False while benched; recovers at benched_until
         int fail_count = 0;
+        Clock::time_point benched_until{};
+    };
+
+    struct Budget {
+        double tokens = 0.0;
+        double rate = 0.0;
+        double latency_ms = 0.0;        // EWMA
+        Clock::time_point refilled_at{};
+        Clock::time_point cooldown_until{};
     };
 
     std::vector<ApiKey> key_pool;
@@ -24,6 +59,58 @@ private:
     std::atomic<size_t> current_model_index{0}; // 🚀 NEW: Track current model
     std::string serper_key;
 
+    KeyBudgetOptions budget_options_;
+    std::mutex budget_mutex_;
+    std::unordered_map<std::string, std::vector<Budget>> budgets_; // model -> per-key budget
+
+    size_t get_active_unlocked() const {
+        size_t count = 0;
+        for (const auto& k : key_pool) {
+            if (k.is_active) count++;
+        }
+        return count;
+    }
+
+    // Benched keys come back once their time is served (caller holds pool_mutex exclusively)
+    void recover_benched_unlocked(Clock::time_point now) {
+        for (size_t i = 0; i < key_pool.size(); ++i) {
+            auto& k = key_pool[i];
+            if (!k.is_active && now >= k.benched_until) {
+                k.is_active = true;
+                spdlog::info("♻️ Key #{} back in rotation", i);
+            }
+        }
+    }
+
+    // Repeated 429s bench a key for base_bench * 2^n (capped) instead of forever
+    void bench_unlocked(size_t idx) {
+        auto& k = key_pool[idx];
+        k.fail_count++;
+        if (k.fail_count > 2) {
+            int doublings = std::min(k.fail_count - 3, 8);
+            auto bench = std::min<std::chrono::seconds>(budget_options_.max_bench,
+                                                        budget_options_.base_bench * (1 << doublings));
+            k.is_active = false;
+            k.benched_until = Clock::now() + bench;
+            spdlog::warn("⚠️ Key #{} benched for {}s due to Rate Limits", idx, bench.count());
+        }
+    }
+
+    // Caller holds budget_mutex_
+    std::vector<Budget>& budgets_for(const std::string& model, Clock::time_point now) {
+        auto& b = budgets_[model];
+        if (b.size() != key_pool.size()) {
+            b.assign(key_pool.size(), Budget{budget_options_.capacity, budget_options_.initial_rate, 0.0, now, {}});
+        }
+        return b;
+    }
+
+    void refill(Budget& b, Clock::time_point now) const {
+        double dt = std::chrono::duration<double>(now - b.refilled_at).count();
+        if (dt > 0) b.tokens = std::min(budget_options_.capacity, b.tokens + dt * b.rate);
+        b.refilled_at = now;
+    }
+
 public:
     KeyManager() {
         refresh_key_pool();
@@ -49,13 +136,13 @@ public:
 
         try {
             auto j = nlohmann::json::parse(f);
-            
+
             // Load keys
             key_pool.clear();
             for (auto& k : j["keys"]) {
                 key_pool.push_back({k.get<std::string>(), true, 0});
             }
-            
+
             // 🚀 Load all models (prioritized order)
             model_pool.clear();
             if (j.contains("models") && j["models"].is_array()) {
@@ -67,7 +154,7 @@ public:
                 if (j.contains("primary")) model_pool.push_back(j["primary"]);
                 if (j.contains("secondary")) model_pool.push_back(j["secondary"]);
             }
-            
+
             // Default models if none specified
             if (model_pool.empty()) {
                 model_pool = {
@@ -75,14 +162,19 @@ public:
                     "gemini-2.5-flash-lite"
                 };
             }
-            
+
             serper_key = j.value("serper", "");
             current_key_index = 0;
             current_model_index = 0;
-            
-            spdlog::info("🛰️ Unified Vault: {} keys, {} models loaded.", 
+
+            {
+                std::lock_guard<std::mutex> budget_lock(budget_mutex_);
+                budgets_.clear(); // Key indices changed
+            }
+
+            spdlog::info("🛰️ Unified Vault: {} keys, {} models loaded.",
                         key_pool.size(), model_pool.size());
-            
+
         } catch (const std::exception& e) {
             spdlog::error("💥 Failed to parse keys.json: {}", e.what());
         }
@@ -99,10 +191,10 @@ public:
     KeyModelPair get_current_pair() const {
         std::shared_lock lock(pool_mutex);
         if (key_pool.empty() || model_pool.empty()) return {"", "", 0, 0};
-        
+
         size_t key_idx = current_key_index.load() % key_pool.size();
         size_t model_idx = current_model_index.load() % model_pool.size();
-        
+
         return {
             key_pool[key_idx].key,
             model_pool[model_idx],
@@ -111,12 +203,40 @@ public:
         };
     }
 
-    std::string get_current_key() const { 
+    // Pair `key_offset` keys / `model_offset` models after the current one, without rotating
+    // (hedged requests probe the next key while the current one is still in flight)
+    KeyModelPair get_pair(size_t key_offset, size_t model_offset) const {
+        std::shared_lock lock(pool_mutex);
+        if (key_pool.empty() || model_pool.empty()) return {"", "", 0, 0};
+
+        size_t key_idx = (current_key_index.load() + key_offset) % key_pool.size();
+        size_t model_idx = (current_model_index.load() + model_offset) % model_pool.size();
+        return {key_pool[key_idx].key, model_pool[model_idx], key_idx, model_idx};
+    }
+
+    std::string get_current_key() const {
         std::shared_lock lock(pool_mutex);
         if (key_pool.empty()) return "";
         return key_pool[current_key_index.load() % key_pool.size()].key;
     }
 
+    // 🛰️ Spreads concurrent callers across the pool: slot 0 is the current key,
+    // slot n the n-th active key after it. Falls back to the current key.
+    std::string get_key_for_slot(size_t slot) const {
+        std::shared_lock lock(pool_mutex);
+        if (key_pool.empty()) return "";
+        size_t base = current_key_index.load();
+        size_t active = get_active_unlocked();
+        if (active == 0) return key_pool[base % key_pool.size()].key;
+
+        size_t target = slot % active;
+        for (size_t i = 0; i < key_pool.size(); ++i) {
+            const auto& k = key_pool[(base + i) % key_pool.size()];
+            if (k.is_active && target-- == 0) return k.key;
+        }
+        return key_pool[base % key_pool.size()].key;
+    }
+
     std::string get_current_model() const {
         std::shared_lock lock(pool_mutex);
         if (model_pool.empty()) return "gemini-1.5-flash";
@@ -139,23 +259,102 @@ public:
     void report_rate_limit() {
         std::unique_lock lock(pool_mutex);
         if (key_pool.empty()) return;
-        
-        size_t idx = current_key_index.load() % key_pool.size();
-        key_pool[idx].fail_count++;
-        
-        if (key_pool[idx].fail_count > 2) {
-            key_pool[idx].is_active = false;
-            spdlog::warn("⚠️ Key #{} Decommissioned due to Rate Limits", idx);
+        bench_unlocked(current_key_index.load() % key_pool.size());
+    }
+
+    void set_budget_options(const KeyBudgetOptions& options) {
+        std::unique_lock lock(pool_mutex);
+        std::lock_guard<std::mutex> budget_lock(budget_mutex_);
+        budget_options_ = options;
+        budgets_.clear();
+    }
+
+    // 🎯 Picks the active key with the most remaining budget for `model`, penalized by its
+    // recent latency, and spends one token. `hint` rotates the scan start so equally good
+    // keys spread across concurrent callers. When every bucket is dry the key that refills
+    // first is reserved and `wait` says how long to hold off.
+    KeyLease acquire_key(const std::string& model, size_t hint = 0) {
+        auto now = Clock::now();
+        std::unique_lock lock(pool_mutex);
+        if (key_pool.empty()) return {};
+        recover_benched_unlocked(now);
+
+        std::lock_guard<std::mutex> budget_lock(budget_mutex_);
+        auto& budgets = budgets_for(model, now);
+
+        const size_t n = key_pool.size();
+        const size_t start = current_key_index.load() + hint;
+        long best = -1;
+        double best_score = -1e300;
+        long soonest = -1;
+        double soonest_wait = 1e300;
+
+        for (size_t j = 0; j < n; ++j) {
+            size_t i = (start + j) % n;
+            if (!key_pool[i].is_active) continue;
+            Budget& b = budgets[i];
+            refill(b, now);
+
+            double cooldown = std::chrono::duration<double>(b.cooldown_until - now).count();
+            double wait = std::max(cooldown, b.tokens >= 1.0 ? 0.0 : (1.0 - b.tokens) / b.rate);
+            if (wait > 0) {
+                if (wait < soonest_wait) { soonest_wait = wait; soonest = static_cast<long>(i); }
+                continue;
+            }
+
+            double score = b.tokens / budget_options_.capacity
+                         - budget_options_.latency_weight * b.latency_ms / 1000.0;
+            if (score > best_score) { best_score = score; best = static_cast<long>(i); }
+        }
+
+        if (best >= 0) {
+            budgets[best].tokens -= 1.0;
+            return {key_pool[best].key, static_cast<size_t>(best), std::chrono::milliseconds(0)};
+        }
+        if (soonest >= 0) {
+            budgets[soonest].tokens -= 1.0;
+            auto wait = std::chrono::milliseconds(static_cast<long>(std::ceil(soonest_wait * 1000.0)));
+            return {key_pool[soonest].key, static_cast<size_t>(soonest), wait};
         }
+
+        // Everything benched: fall back to the current key rather than stalling
+        size_t idx = current_key_index.load() % n;
+        return {key_pool[idx].key, idx, std::chrono::milliseconds(0)};
+    }
+
+    // 📈 Feeds the budget: a 429 halves the key's rate and cools it down for `retry_after`
+    // (from Retry-After / RetryInfo, else one refill interval); a success grows the rate,
+    // updates the latency EWMA and clears the key's strikes.
+    void report_result(size_t key_index, const std::string& model, long status, double latency_ms,
+                       std::chrono::milliseconds retry_after = std::chrono::milliseconds(0)) {
+        auto now = Clock::now();
+        std::unique_lock lock(pool_mutex);
+        if (key_index >= key_pool.size()) return;
+
+        {
+            std::lock_guard<std::mutex> budget_lock(budget_mutex_);
+            Budget& b = budgets_for(model, now)[key_index];
+            refill(b, now);
+            if (status == 429) {
+                b.rate = std::max(budget_options_.min_rate, b.rate * 0.5);
+                b.tokens = 0.0;
+                auto delay = retry_after.count() > 0
+                    ? retry_after
+                    : std::chrono::milliseconds(static_cast<long>(1000.0 / b.rate));
+                b.cooldown_until = now + delay;
+            } else if (status == 200) {
+                b.rate = std::min(budget_options_.max_rate, b.rate + budget_options_.additive_increase);
+                b.latency_ms = b.latency_ms == 0.0 ? latency_ms : 0.8 * b.latency_ms + 0.2 * latency_ms;
+            }
+        }
+
+        if (status == 429) bench_unlocked(key_index);
+        else if (status == 200) key_pool[key_index].fail_count = 0;
     }
 
     size_t get_active_key_count() const {
         std::shared_lock lock(pool_mutex);
-        size_t count = 0;
-        for (const auto& k : key_pool) {
-            if (k.is_active) count++;
-        }
-        return count;
+        return get_active_unlocked();
     }
 
     size_t get_total_keys() const {
@@ -167,7 +366,7 @@ public:
         std::shared_lock lock(pool_mutex);
         return model_pool.size();
     }
-    
+
 };
 
-} // namespace code_assistance
\ No newline at end of file
+} // namespace code_assistance
@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+namespace code_assistance {
+
+// ⏱️ Log-bucketed latency histogram (4 buckets per power of two, 1 ms .. ~65 s).
+// Counts are halved once `window` samples accumulate, so quantiles track recent
+// behaviour instead of the whole process lifetime.
+class LatencyHistogram {
+public:
+    static constexpr size_t BUCKETS = 64;
+
+    explicit LatencyHistogram(uint64_t window = 2000) : window_(window) {}
+
+    void record(double ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        counts_[bucket_of(ms)]++;
+        if (++total_ >= window_) {
+            total_ = 0;
+            for (auto& c : counts_) { c /= 2; total_ += c; }
+        }
+    }
+
+    // Upper edge of the bucket holding quantile q; `fallback` until anything is recorded
+    double quantile(double q, double fallback = 0.0) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (total_ == 0) return fallback;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total_)));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            seen += counts_[b];
+            if (seen >= rank && counts_[b] > 0) return upper_edge(b);
+        }
+        return upper_edge(BUCKETS - 1);
+    }
+
+    uint64_t count() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return total_;
+    }
+
+private:
+    static size_t bucket_of(double ms) {
+        if (!(ms > 1.0)) return 0;
+        size_t b = static_cast<size_t>(std::log2(ms) * 4.0);
+        return b < BUCKETS ? b : BUCKETS - 1;
+    }
+
+    static double upper_edge(size_t b) { return std::exp2(static_cast<double>(b + 1) / 4.0); }
+
+    uint64_t window_;
+    uint64_t total_ = 0;
+    std::array<uint64_t, BUCKETS> counts_{};
+    mutable std::mutex mutex_;
+};
+
+} // namespace code_assistance
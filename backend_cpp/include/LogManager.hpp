@@ -1,9 +1,14 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <string>
 #include <nlohmann/json.hpp>
+#include "Utf8.hpp"
 
 using json = nlohmann::json;
 
@@ -31,41 +36,77 @@ struct InteractionLog {
     int total_tokens = 0;
 };
 
+// 🗂️ Interaction logs live in a fixed ring of slots, each holding an immutable entry.
+// Writers claim a sequence number with one fetch_add and publish their entry into its
+// slot; no lock is shared between writers or with the telemetry poll. Prompts and
+// responses are clipped to fixed caps when added (head and tail kept), so the ring
+// holds at most LOG_SLOTS * (caps) bytes however large the agent monologue gets.
+// Each entry renders its JSON once, on the first poll that wants it.
 class LogManager {
 public:
+    static constexpr size_t LOG_SLOTS = 128; // Power of two
+    static constexpr size_t PROMPT_CAP = 64 * 1024;
+    static constexpr size_t RESPONSE_CAP = 32 * 1024;
+    static constexpr size_t QUERY_CAP = 4 * 1024;
+
     // Singleton access
     static LogManager& instance() {
         static LogManager instance;
         return instance;
     }
 
-    void add_log(const InteractionLog& log) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        logs_.push_back(log);
-        if (logs_.size() > 100) { // Keep last 50 only
-            logs_.pop_front();
+    void add_log(InteractionLog log) {
+        clip(log.full_prompt, PROMPT_CAP);
+        clip(log.ai_response, RESPONSE_CAP);
+        clip(log.user_query, QUERY_CAP);
+
+        auto entry = std::make_shared<LogEntry>();
+        const uint64_t seq = head_.fetch_add(1, std::memory_order_relaxed) + 1;
+        entry->seq = seq;
+        entry->log = std::move(log);
+        std::shared_ptr<const LogEntry> published = std::move(entry);
+
+        // A writer lapped by LOG_SLOTS newer ones must not overwrite them
+        auto& slot = slots_[seq & (LOG_SLOTS - 1)];
+        std::shared_ptr<const LogEntry> current = slot.load(std::memory_order_acquire);
+        while (!current || current->seq < seq) {
+            if (slot.compare_exchange_weak(current, published, std::memory_order_acq_rel)) break;
         }
     }
 
-    json get_logs_json() {
-        std::lock_guard<std::mutex> lock(mtx_);
-        json j_list = json::array();
-        for (auto it = logs_.rbegin(); it != logs_.rend(); ++it) {
-            j_list.push_back({
-                {"timestamp", it->timestamp},
-                {"project_id", it->project_id},
-                {"type", it->request_type},
-                {"user_query", it->user_query},
-                {"full_prompt", it->full_prompt},
-                {"ai_response", it->ai_response},
-                {"vector_snapshot", it->vector_snapshot},
-                {"duration_ms", it->duration_ms},
-                {"total_tokens", it->total_tokens},
-                {"prompt_tokens", it->prompt_tokens},
-                {"completion_tokens", it->completion_tokens}
-            });
+    // Highest sequence number handed out so far
+    uint64_t log_cursor() const { return head_.load(std::memory_order_acquire); }
+
+    // JSON array of the entries after `since`, newest first. `cursor` receives the
+    // sequence to pass as the next `since`: it stops short of any entry still being
+    // published, so a poll never skips one. A `since` from before a restart starts over.
+    std::string logs_json_since(uint64_t since, uint64_t& cursor) const {
+        const uint64_t head = log_cursor();
+        if (since > head) since = 0;
+        uint64_t first = head > LOG_SLOTS ? head - LOG_SLOTS + 1 : 1;
+        first = std::max(first, since + 1);
+
+        std::vector<std::shared_ptr<const LogEntry>> entries;
+        entries.reserve(head >= first ? head - first + 1 : 0);
+        cursor = std::max(since, first - 1);
+        for (uint64_t seq = first; seq <= head; ++seq) {
+            auto entry = slots_[seq & (LOG_SLOTS - 1)].load(std::memory_order_acquire);
+            if (!entry || entry->seq < seq) break; // Claimed but not yet published
+            cursor = seq;
+            if (entry->seq == seq) entries.push_back(std::move(entry));
         }
-        return j_list;
+
+        size_t bytes = 2;
+        for (const auto& e : entries) bytes += e->render().size() + 1;
+        std::string out;
+        out.reserve(bytes);
+        out += '[';
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+            if (out.size() > 1) out += ',';
+            out += (*it)->render();
+        }
+        out += ']';
+        return out;
     }
 
     void add_trace(const AgentTrace& trace) {
@@ -89,10 +130,50 @@ public:
     }
 
 private:
+    struct LogEntry {
+        uint64_t seq = 0;
+        InteractionLog log;
+
+        const std::string& render() const {
+            std::call_once(rendered_, [this] {
+                rendered_json_ = nlohmann::json{
+                    {"seq", seq},
+                    {"timestamp", log.timestamp},
+                    {"project_id", log.project_id},
+                    {"type", log.request_type},
+                    {"user_query", log.user_query},
+                    {"full_prompt", log.full_prompt},
+                    {"ai_response", log.ai_response},
+                    {"vector_snapshot", log.vector_snapshot},
+                    {"duration_ms", log.duration_ms},
+                    {"total_tokens", log.total_tokens},
+                    {"prompt_tokens", log.prompt_tokens},
+                    {"completion_tokens", log.completion_tokens}
+                }.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+            });
+            return rendered_json_;
+        }
+
+    private:
+        mutable std::once_flag rendered_;
+        mutable std::string rendered_json_;
+    };
+
+    // Keeps the first 3/4 and last 1/4 of the cap, cut on code point boundaries
+    static void clip(std::string& s, size_t cap) {
+        if (s.size() <= cap) return;
+        size_t head = Utf8::floor_boundary(s, cap * 3 / 4);
+        size_t tail_from = s.size() - cap / 4;
+        while (tail_from < s.size() && (static_cast<unsigned char>(s[tail_from]) & 0xC0) == 0x80) tail_from++;
+        std::string marker = "\n... [" + std::to_string(tail_from - head) + " bytes elided] ...\n";
+        s.replace(head, tail_from - head, marker);
+    }
+
     LogManager() {} // Private constructor
-    std::deque<InteractionLog> logs_;
+    std::atomic<uint64_t> head_{0};
+    std::array<std::atomic<std::shared_ptr<const LogEntry>>, LOG_SLOTS> slots_;
     std::deque<AgentTrace> agent_traces_;
-    std::mutex mtx_;
+    std::mutex mtx_; // Traces only
 };
 
 }
\ No newline at end of file
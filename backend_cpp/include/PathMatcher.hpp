@@ -0,0 +1,364 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace code_assistance {
+
+enum PathFlag : uint8_t {
+    NONE = 0,
+    IGNORE = 1 << 0,  // 0x01
+    INCLUDE = 1 << 1, // 0x02 (Overrides IGNORE at the same depth)
+    BRIDGE = 1 << 2   // 0x04 Directory on the way to an included path: must be entered
+};
+
+// 🧭 Ignore / include rules compiled once per project config.
+// Patterns follow gitignore: a pattern without an inner '/' ("node_modules", "*.log")
+// matches a segment at any depth, one with a '/' (or a leading '/') is anchored at the
+// root, a trailing '/' restricts it to directories, and '*', '?', '[...]' and '**' glob.
+// A leading '!' turns an ignore pattern into an include.
+//
+// The most specific rule wins: the one matching the deepest prefix of the path, with
+// INCLUDE beating IGNORE at equal depth. Literal anchored rules live in a flat trie
+// (nodes in one vector, labels in one char arena) that also marks every ancestor of an
+// anchored include as a BRIDGE, so scanners can descend into ignored directories only
+// where an exception lies beneath. check() never allocates.
+class PathMatcher {
+public:
+    static constexpr size_t MAX_DEPTH = 128; // Segments beyond this are not examined
+
+    PathMatcher() { nodes_.push_back({}); }
+
+    PathMatcher(const std::vector<std::string>& ignored, const std::vector<std::string>& included,
+                bool case_insensitive = default_case_insensitive())
+        : fold_(case_insensitive) {
+        nodes_.push_back({});
+        for (const auto& p : ignored) add(p, PathFlag::IGNORE);
+        for (const auto& p : included) add(p, PathFlag::INCLUDE);
+        for (const auto& r : literals_) {
+            auto& slot = floating_literals_[view(r.pattern)];
+            (r.dir_only ? slot.dir_rules : slot.rules) |= r.flag;
+        }
+    }
+
+    // Views in floating_literals_ point into arena_, whose buffer survives a move
+    PathMatcher(PathMatcher&&) noexcept = default;
+    PathMatcher& operator=(PathMatcher&&) noexcept = default;
+    PathMatcher(const PathMatcher&) = delete;
+    PathMatcher& operator=(const PathMatcher&) = delete;
+
+    static bool default_case_insensitive() {
+#ifdef _WIN32
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool empty() const { return rule_count_ == 0; }
+
+    // `rel_path` is relative to the project root; '/' and '\\' both separate segments
+    uint8_t check(std::string_view rel_path, bool is_dir) const {
+        std::array<std::string_view, MAX_DEPTH> segs;
+        size_t n = split(rel_path, segs);
+        if (n == 0) return PathFlag::NONE;
+
+        Verdict v;
+        auto seg_is_dir = [&](size_t i) { return i + 1 < n || is_dir; };
+
+        // 1. Anchored literals: one walk down the trie
+        uint32_t node = 0;
+        size_t walked = 0;
+        for (; walked < n; ++walked) {
+            node = find_child(node, segs[walked]);
+            if (node == NIL) break;
+            const Node& nd = nodes_[node];
+            v.consider(walked + 1, nd.rules);
+            if (seg_is_dir(walked)) v.consider(walked + 1, nd.dir_rules);
+        }
+        bool bridge = is_dir && walked == n && nodes_[node].bridge;
+
+        // 2. Floating literals: hash probe per segment
+        if (!floating_literals_.empty()) {
+            for (size_t i = 0; i < n; ++i) {
+                auto it = floating_literals_.find(segs[i]);
+                if (it == floating_literals_.end()) continue;
+                v.consider(i + 1, it->second.rules);
+                if (seg_is_dir(i)) v.consider(i + 1, it->second.dir_rules);
+            }
+        }
+
+        // 3. Globs
+        for (const auto& g : globs_) {
+            if (!g.anchored) {
+                for (size_t i = 0; i < n; ++i) {
+                    if ((!g.dir_only || seg_is_dir(i)) && match_segment(view(g.segments.front()), segs[i])) {
+                        v.consider(i + 1, g.flag);
+                    }
+                }
+                continue;
+            }
+            for (size_t k = 1; k <= n; ++k) {
+                if ((!g.dir_only || seg_is_dir(k - 1)) && match_segments(g, 0, segs.data(), k, false)) {
+                    v.consider(k, g.flag);
+                }
+            }
+            if (is_dir && !bridge && g.flag == PathFlag::INCLUDE) {
+                bridge = match_segments(g, 0, segs.data(), n, true);
+            }
+        }
+
+        return v.flag | (bridge ? PathFlag::BRIDGE : PathFlag::NONE);
+    }
+
+    // Scanner helpers: a directory is entered unless ignored with no exception inside it
+    bool should_enter(std::string_view rel_dir) const {
+        uint8_t f = check(rel_dir, true);
+        return !(f & PathFlag::IGNORE) || (f & PathFlag::BRIDGE);
+    }
+
+    bool should_collect(std::string_view rel_file) const {
+        return !(check(rel_file, false) & PathFlag::IGNORE);
+    }
+
+    // True iff INCLUDE decided the path (explicit exceptions bypass extension filters)
+    bool is_included(std::string_view rel_path, bool is_dir) const {
+        return check(rel_path, is_dir) & PathFlag::INCLUDE;
+    }
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Span { uint32_t offset = 0; uint32_t length = 0; };
+
+    struct Node {
+        Span label;
+        uint32_t first_child = NIL;
+        uint32_t next_sibling = NIL;
+        uint8_t rules = 0;      // Flags applying to the path and everything below it
+        uint8_t dir_rules = 0;  // Same, but only when this segment is a directory ("build/")
+        bool bridge = false;    // An anchored include lies strictly below
+    };
+
+    struct Glob {
+        std::vector<Span> segments; // "**" kept as its own segment
+        uint8_t flag = 0;
+        bool anchored = false;
+        bool dir_only = false;
+    };
+
+    struct Literal { Span pattern; uint8_t flag; bool dir_only; };
+    struct LiteralRules { uint8_t rules = 0; uint8_t dir_rules = 0; };
+
+    struct Verdict {
+        size_t depth = 0;
+        uint8_t flag = PathFlag::NONE;
+        void consider(size_t d, uint8_t f) {
+            f &= (PathFlag::IGNORE | PathFlag::INCLUDE);
+            if (!f) return;
+            if (f & PathFlag::INCLUDE) f = PathFlag::INCLUDE;
+            if (d > depth || (d == depth && f == PathFlag::INCLUDE)) { depth = d; flag = f; }
+        }
+    };
+
+    struct FoldHash {
+        bool fold;
+        size_t operator()(std::string_view s) const {
+            uint64_t h = 1469598103934665603ull; // FNV-1a over folded bytes
+            for (char c : s) { h ^= static_cast<unsigned char>(fold ? lower(c) : c); h *= 1099511628211ull; }
+            return static_cast<size_t>(h);
+        }
+    };
+    struct FoldEq {
+        bool fold;
+        bool operator()(std::string_view a, std::string_view b) const {
+            if (a.size() != b.size()) return false;
+            for (size_t i = 0; i < a.size(); ++i) {
+                if (fold ? lower(a[i]) != lower(b[i]) : a[i] != b[i]) return false;
+            }
+            return true;
+        }
+    };
+
+    bool fold_ = default_case_insensitive();
+    std::vector<char> arena_;
+    std::vector<Node> nodes_;
+    std::vector<Glob> globs_;
+    std::vector<Literal> literals_;
+    std::unordered_map<std::string_view, LiteralRules, FoldHash, FoldEq> floating_literals_{
+        0, FoldHash{fold_}, FoldEq{fold_}};
+    size_t rule_count_ = 0;
+
+    static char lower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+    bool eq(char a, char b) const { return fold_ ? lower(a) == lower(b) : a == b; }
+
+    std::string_view view(Span s) const { return {arena_.data() + s.offset, s.length}; }
+
+    Span intern(std::string_view s) {
+        Span span{static_cast<uint32_t>(arena_.size()), static_cast<uint32_t>(s.size())};
+        arena_.insert(arena_.end(), s.begin(), s.end());
+        return span;
+    }
+
+    static bool is_sep(char c) { return c == '/' || c == '\\'; }
+
+    template<size_t N>
+    static size_t split(std::string_view path, std::array<std::string_view, N>& out) {
+        size_t n = 0, i = 0;
+        while (i < path.size() && n < N) {
+            while (i < path.size() && is_sep(path[i])) ++i;
+            size_t start = i;
+            while (i < path.size() && !is_sep(path[i])) ++i;
+            std::string_view seg = path.substr(start, i - start);
+            if (!seg.empty() && seg != ".") out[n++] = seg;
+        }
+        return n;
+    }
+
+    static bool has_glob(std::string_view s) { return s.find_first_of("*?[") != std::string_view::npos; }
+
+    void add(std::string_view pattern, PathFlag flag) {
+        while (!pattern.empty() && (pattern.back() == ' ' || pattern.back() == '\r')) pattern.remove_suffix(1);
+        if (pattern.empty() || pattern[0] == '#') return;
+        if (pattern[0] == '!') {
+            pattern.remove_prefix(1);
+            flag = flag == PathFlag::IGNORE ? PathFlag::INCLUDE : PathFlag::IGNORE;
+        }
+
+        bool dir_only = false;
+        while (!pattern.empty() && is_sep(pattern.back())) { pattern.remove_suffix(1); dir_only = true; }
+        // "dir/**" covers exactly what "dir" covers under prefix semantics, but its '/'
+        // anchors it: "src/**" is the root's src, not every src
+        bool tail_anchored = false;
+        while (pattern.size() >= 3 && pattern.substr(pattern.size() - 3) == "/**") {
+            pattern.remove_suffix(3);
+            dir_only = false;
+            tail_anchored = true;
+        }
+        if (pattern.size() >= 2 && pattern[0] == '.' && is_sep(pattern[1])) pattern.remove_prefix(2);
+
+        // A leading "**/" before a single segment just means "at any depth"
+        bool any_depth = false;
+        while (pattern.size() >= 3 && pattern.substr(0, 3) == "**/" &&
+               pattern.find_first_of("/\\", 3) == std::string_view::npos) {
+            pattern.remove_prefix(3);
+            any_depth = true;
+        }
+        bool anchored = pattern.find_first_of("/\\") != std::string_view::npos || (tail_anchored && !any_depth);
+
+        std::array<std::string_view, MAX_DEPTH> segs;
+        size_t n = split(pattern, segs);
+        if (n == 0) return;
+        rule_count_++;
+
+        bool literal = true;
+        for (size_t i = 0; i < n; ++i) literal = literal && !has_glob(segs[i]);
+
+        if (!anchored && literal) {
+            literals_.push_back({intern(segs[0]), static_cast<uint8_t>(flag), dir_only});
+            return;
+        }
+        if (!literal || !anchored) {
+            Glob g;
+            for (size_t i = 0; i < n; ++i) g.segments.push_back(intern(segs[i]));
+            g.flag = flag;
+            g.anchored = anchored;
+            g.dir_only = dir_only;
+            globs_.push_back(std::move(g));
+            return;
+        }
+
+        uint32_t node = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (flag == PathFlag::INCLUDE) nodes_[node].bridge = true;
+            uint32_t child = find_child(node, segs[i]);
+            if (child == NIL) {
+                child = static_cast<uint32_t>(nodes_.size());
+                Node fresh;
+                fresh.label = intern(segs[i]);
+                fresh.next_sibling = nodes_[node].first_child;
+                nodes_.push_back(fresh);
+                nodes_[node].first_child = child;
+            }
+            node = child;
+        }
+        (dir_only ? nodes_[node].dir_rules : nodes_[node].rules) |= flag;
+    }
+
+    uint32_t find_child(uint32_t node, std::string_view seg) const {
+        for (uint32_t c = nodes_[node].first_child; c != NIL; c = nodes_[c].next_sibling) {
+            if (FoldEq{fold_}(view(nodes_[c].label), seg)) return c;
+        }
+        return NIL;
+    }
+
+    // Single-segment glob: '*', '?', '[abc]', '[a-z]', '[!x]'. No '\\' escapes: configs
+    // come from Windows, where it separates segments
+    bool match_segment(std::string_view pat, std::string_view s) const {
+        size_t p = 0, i = 0;
+        size_t star_p = std::string_view::npos, star_i = 0;
+        while (i < s.size()) {
+            if (p < pat.size()) {
+                char c = pat[p];
+                if (c == '*') { star_p = p++; star_i = i; continue; }
+                if (c == '?') { ++p; ++i; continue; }
+                if (c == '[') {
+                    size_t end = p + 1;
+                    bool ok = false;
+                    if (match_class(pat, end, s[i], ok)) {
+                        if (ok) { p = end; ++i; continue; }
+                    } else if (eq(c, s[i])) { ++p; ++i; continue; } // Unterminated '[' is literal
+                } else if (eq(c, s[i])) { ++p; ++i; continue; }
+            }
+            if (star_p == std::string_view::npos) return false;
+            p = star_p + 1;
+            i = ++star_i;
+        }
+        while (p < pat.size() && pat[p] == '*') ++p;
+        return p == pat.size();
+    }
+
+    // `pos` points just past '['; on success it is moved past ']' and `ok` holds the result
+    bool match_class(std::string_view pat, size_t& pos, char ch, bool& ok) const {
+        size_t p = pos;
+        bool negate = p < pat.size() && (pat[p] == '!' || pat[p] == '^');
+        if (negate) ++p;
+        bool hit = false;
+        bool first = true;
+        while (p < pat.size() && (pat[p] != ']' || first)) {
+            first = false;
+            char lo = pat[p];
+            char hi = lo;
+            if (p + 2 < pat.size() && pat[p + 1] == '-' && pat[p + 2] != ']') { hi = pat[p + 2]; p += 2; }
+            char c = fold_ ? lower(ch) : ch;
+            char l = fold_ ? lower(lo) : lo;
+            char h = fold_ ? lower(hi) : hi;
+            if (c >= l && c <= h) hit = true;
+            ++p;
+        }
+        if (p >= pat.size()) return false;
+        pos = p + 1;
+        ok = hit != negate;
+        return true;
+    }
+
+    // Anchored glob against the first `n` path segments. `prefix_only`: succeed if the
+    // path is used up while the pattern could still continue (the path is a bridge).
+    bool match_segments(const Glob& g, size_t gi, const std::string_view* segs, size_t n, bool prefix_only) const {
+        if (gi == g.segments.size()) return !prefix_only && n == 0;
+        if (n == 0) return prefix_only;
+        std::string_view pat = view(g.segments[gi]);
+        if (pat == "**") {
+            for (size_t skip = 0; skip <= n; ++skip) {
+                if (match_segments(g, gi + 1, segs + skip, n - skip, prefix_only)) return true;
+            }
+            return false;
+        }
+        return match_segment(pat, segs[0]) && match_segments(g, gi + 1, segs + 1, n - 1, prefix_only);
+    }
+};
+
+} // namespace code_assistance
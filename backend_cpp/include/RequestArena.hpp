@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+namespace code_assistance {
+
+// 🧺 Per-request arena for short-lived temporaries (context pruning tables, dedup sets,
+// prompt pieces). A monotonic buffer starts in inline storage and grows in chunks taken
+// from a thread-local pool, so nothing in it is freed piecemeal and concurrent requests
+// never meet in malloc: the whole arena goes back to the pool in one shot when it is
+// destroyed, and the pool hands the same chunks to the thread's next request.
+//
+// Constructing one makes it the thread's current arena until it is destroyed (arenas
+// nest). Code below a request entry point allocates from RequestArena::resource() and
+// needs no new parameter; with no arena active that is the thread's pool itself.
+// Only locals may live in it: nothing allocated here may escape the request or be
+// handed to another thread.
+class RequestArena {
+public:
+    static constexpr size_t INLINE_BYTES = 16 * 1024;
+
+    RequestArena() : buffer_(inline_, sizeof(inline_), thread_pool()), previous_(current_) { current_ = this; }
+    ~RequestArena() { current_ = previous_; }
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* get() { return &buffer_; }
+
+    // The innermost arena on this thread, else the thread's pool
+    static std::pmr::memory_resource* resource() {
+        return current_ ? current_->get() : thread_pool();
+    }
+
+    // Upstream of every arena on this thread; unsynchronized since only this thread uses it
+    static std::pmr::memory_resource* thread_pool() {
+        thread_local std::pmr::unsynchronized_pool_resource pool;
+        return &pool;
+    }
+
+private:
+    alignas(std::max_align_t) std::byte inline_[INLINE_BYTES];
+    std::pmr::monotonic_buffer_resource buffer_;
+    RequestArena* previous_;
+    inline static thread_local RequestArena* current_ = nullptr;
+};
+
+} // namespace code_assistance
@@ -0,0 +1,66 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "MappedFile.hpp"
+
+namespace code_assistance {
+
+// 📥 One source file opened for ingestion.
+// Large files are mapped and small ones read with a single call, so hashing and copying
+// into the full-context store cost no heap copy. buffer() makes the one copy that parsed nodes
+// and the cached syntax tree share, and only callers that actually parse ask for it:
+// unchanged files never reach the heap. Mapped bytes belong to a file someone may be
+// editing, which is why nothing long-lived keeps a view into the mapping itself.
+class SourceFile {
+public:
+    static constexpr size_t MAP_THRESHOLD = 64 * 1024; // Below this, read() beats mmap + page faults
+
+    SourceFile() = default;
+    SourceFile(SourceFile&&) noexcept = default;
+    SourceFile& operator=(SourceFile&&) noexcept = default;
+
+    bool open(const std::filesystem::path& path) {
+        close();
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec) return false;
+        if (size >= MAP_THRESHOLD) return map_.open(path.string());
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        auto text = std::make_shared<std::string>(static_cast<size_t>(size), '\0');
+        in.read(text->data(), static_cast<std::streamsize>(text->size()));
+        text->resize(static_cast<size_t>(in.gcount()));
+        buffer_ = std::move(text);
+        return true;
+    }
+
+    void close() {
+        map_.close();
+        buffer_.reset();
+    }
+
+    bool is_open() const { return buffer_ || map_.is_open(); }
+    std::string_view view() const { return buffer_ ? std::string_view(*buffer_) : map_.view(); }
+    size_t size() const { return view().size(); }
+
+    // Heap copy shared by everything parsed from this file; mapped files are copied once
+    const std::shared_ptr<const std::string>& buffer() {
+        if (!buffer_) buffer_ = std::make_shared<const std::string>(map_.view());
+        return buffer_;
+    }
+
+    // Drops the mapping once the shared copy exists (the copy outlives this object)
+    void release_mapping() {
+        if (buffer_) map_.close();
+    }
+
+private:
+    MappedFile map_;
+    std::shared_ptr<const std::string> buffer_;
+};
+
+} // namespace code_assistance
@@ -0,0 +1,192 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace code_assistance {
+
+// 📊 HDR-style latency histogram: 8 linear sub-buckets per power of two of microseconds
+// (<= 12.5% error, 1 us .. ~19 h), so no value needs a range set up front.
+// Recording is one relaxed fetch_add on the calling thread's shard; shards sit on their
+// own cache lines and are summed only when read.
+class ConcurrentHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 3;
+    static constexpr uint64_t SUB = 1u << SUB_BITS;
+    static constexpr unsigned MAX_EXP = 36;
+    static constexpr size_t BUCKETS = (MAX_EXP - SUB_BITS + 1) * SUB;
+    static constexpr size_t SHARDS = 8;
+
+    struct Snapshot {
+        std::array<uint64_t, BUCKETS> counts{};
+        uint64_t count = 0;
+        uint64_t sum_us = 0;
+        uint64_t max_us = 0;
+
+        // Upper edge of the bucket holding quantile q, never above the largest sample
+        double percentile_ms(double q) const {
+            if (count == 0) return 0.0;
+            uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(count) + 0.5));
+            uint64_t seen = 0;
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                seen += counts[b];
+                if (seen >= rank) return std::min(upper_edge_us(b), max_us) / 1000.0;
+            }
+            return max_us / 1000.0;
+        }
+        double mean_ms() const { return count ? sum_us / 1000.0 / count : 0.0; }
+        // Samples in buckets that end at or below `us` (Prometheus "le" buckets)
+        uint64_t count_at_most(uint64_t us) const {
+            uint64_t n = 0;
+            for (size_t b = 0; b < BUCKETS && upper_edge_us(b) <= us; ++b) n += counts[b];
+            return n;
+        }
+    };
+
+    void record_us(uint64_t us) {
+        Shard& s = shards_[shard_index()];
+        s.counts[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+        s.sum_us.fetch_add(us, std::memory_order_relaxed);
+        uint64_t seen = s.max_us.load(std::memory_order_relaxed);
+        while (us > seen && !s.max_us.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {}
+    }
+    void record_ms(double ms) { record_us(ms > 0.0 ? static_cast<uint64_t>(ms * 1000.0) : 0); }
+
+    Snapshot snapshot() const {
+        Snapshot out;
+        for (const Shard& s : shards_) {
+            for (size_t b = 0; b < BUCKETS; ++b) out.counts[b] += s.counts[b].load(std::memory_order_relaxed);
+            out.sum_us += s.sum_us.load(std::memory_order_relaxed);
+            out.max_us = std::max(out.max_us, s.max_us.load(std::memory_order_relaxed));
+        }
+        for (uint64_t c : out.counts) out.count += c;
+        return out;
+    }
+
+    static size_t bucket_of(uint64_t us) {
+        if (us < SUB) return static_cast<size_t>(us);
+        unsigned exp = std::min<unsigned>(std::bit_width(us) - 1, MAX_EXP);
+        if (exp == MAX_EXP) return BUCKETS - 1;
+        unsigned shift = exp - SUB_BITS;
+        return (exp - SUB_BITS + 1) * SUB + static_cast<size_t>((us >> shift) - SUB);
+    }
+    static uint64_t upper_edge_us(size_t b) {
+        if (b < SUB) return b;
+        uint64_t octave = b / SUB - 1, sub = b % SUB;
+        return ((SUB + sub + 1) << octave) - 1;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+        std::atomic<uint64_t> sum_us{0};
+        std::atomic<uint64_t> max_us{0};
+    };
+
+    static size_t shard_index() {
+        static std::atomic<size_t> next{0};
+        thread_local size_t mine = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return mine;
+    }
+
+    std::array<Shard, SHARDS> shards_;
+};
+
+// ⏱️ Request stages with a latency histogram each
+enum class Stage : uint8_t {
+    Retrieval,       // One uncached retrieval, end to end
+    RetrievalSearch, // ANN seeds
+    RetrievalExpand, // Lexical fusion + graph expansion
+    RetrievalScore,  // Scoring, exact re-rank and MMR
+    ContextBuild,    // Hierarchical context rendering of the results
+    Embedding,       // One embedding batch (remote or local)
+    Llm,             // One generateContent / stream call
+    Autocomplete,    // Ghost completion, end to end
+    Tool,            // One agent tool execution
+    Count
+};
+
+class StageMetrics {
+public:
+    static constexpr size_t STAGES = static_cast<size_t>(Stage::Count);
+
+    static const char* name(Stage s) {
+        static constexpr const char* NAMES[STAGES] = {"retrieval", "retrieval_search", "retrieval_expand",
+                                                      "retrieval_score", "context_build", "embedding",
+                                                      "llm", "autocomplete", "tool"};
+        return NAMES[static_cast<size_t>(s)];
+    }
+
+    static ConcurrentHistogram& histogram(Stage s) {
+        static std::array<ConcurrentHistogram, STAGES> histograms;
+        return histograms[static_cast<size_t>(s)];
+    }
+
+    static void record(Stage s, double ms) { histogram(s).record_ms(ms); }
+
+    // Prometheus text exposition (version 0.0.4) of every stage, in seconds
+    static std::string prometheus() {
+        static constexpr double LE_SECONDS[] = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1,
+                                                0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0};
+        std::string out;
+        out.reserve(STAGES * 1500);
+        out += "# HELP code_assistance_stage_duration_seconds Latency of each request stage.\n"
+               "# TYPE code_assistance_stage_duration_seconds histogram\n";
+        char line[160];
+        for (size_t i = 0; i < STAGES; ++i) {
+            const char* stage = name(static_cast<Stage>(i));
+            auto snap = histogram(static_cast<Stage>(i)).snapshot();
+            for (double le : LE_SECONDS) {
+                std::snprintf(line, sizeof(line), "code_assistance_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                              stage, le, static_cast<unsigned long long>(snap.count_at_most(static_cast<uint64_t>(le * 1e6))));
+                out += line;
+            }
+            std::snprintf(line, sizeof(line), "code_assistance_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+                          stage, static_cast<unsigned long long>(snap.count));
+            out += line;
+            std::snprintf(line, sizeof(line), "code_assistance_stage_duration_seconds_sum{stage=\"%s\"} %.6f\n",
+                          stage, snap.sum_us / 1e6);
+            out += line;
+            std::snprintf(line, sizeof(line), "code_assistance_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+                          stage, static_cast<unsigned long long>(snap.count));
+            out += line;
+        }
+        return out;
+    }
+};
+
+// RAII span: records the time from construction to destruction (or to stop()) under `stage`
+class StageSpan {
+public:
+    explicit StageSpan(Stage stage) : stage_(stage), start_(std::chrono::steady_clock::now()) {}
+    ~StageSpan() { stop(); }
+    StageSpan(const StageSpan&) = delete;
+    StageSpan& operator=(const StageSpan&) = delete;
+
+    double elapsed_ms() const {
+        if (!running_) return elapsed_ms_;
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    // Records once and returns the span's duration in ms
+    double stop() {
+        if (!running_) return elapsed_ms_;
+        running_ = false;
+        elapsed_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+        StageMetrics::record(stage_, elapsed_ms_);
+        return elapsed_ms_;
+    }
+
+private:
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+    bool running_ = true;
+    double elapsed_ms_ = 0.0;
+};
+
+} // namespace code_assistance
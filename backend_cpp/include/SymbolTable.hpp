@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace code_assistance {
+
+// 🔤 Append-only string interner: each distinct string is stored once and named by a
+// dense uint32 id. File paths, node types and dependency names repeat across thousands
+// of nodes; records hold 4-byte ids instead. Bytes live in fixed chunks that never move,
+// so str() views stay valid for the table's lifetime. Id 0 is always "".
+class SymbolTable {
+public:
+    static constexpr uint32_t EMPTY = 0;
+
+    SymbolTable() { insert(std::string_view()); }
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    // Shared by every store in the process, so equal paths share one id everywhere
+    static SymbolTable& global() {
+        static SymbolTable table;
+        return table;
+    }
+
+    uint32_t intern(std::string_view s) {
+        if (s.empty()) return EMPTY;
+        {
+            std::shared_lock lock(mutex_);
+            auto it = ids_.find(s);
+            if (it != ids_.end()) return it->second;
+        }
+        std::unique_lock lock(mutex_);
+        auto it = ids_.find(s);
+        if (it != ids_.end()) return it->second;
+        return insert(s);
+    }
+
+    std::string_view str(uint32_t id) const {
+        std::shared_lock lock(mutex_);
+        return id < strings_.size() ? strings_[id] : std::string_view();
+    }
+
+    size_t size() const {
+        std::shared_lock lock(mutex_);
+        return strings_.size();
+    }
+
+    // Chunk bytes plus index overhead
+    size_t memory_bytes() const {
+        std::shared_lock lock(mutex_);
+        return chunks_.size() * CHUNK_SIZE + oversized_bytes_ +
+               strings_.capacity() * sizeof(std::string_view) + ids_.size() * (sizeof(std::string_view) + 16);
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    // Caller holds the unique lock (or is the constructor)
+    uint32_t insert(std::string_view s) {
+        const char* stored = "";
+        if (!s.empty()) {
+            char* dst;
+            if (s.size() > CHUNK_SIZE / 4) {
+                // Large strings get their own allocation instead of wasting a chunk tail
+                oversized_.push_back(std::make_unique<char[]>(s.size()));
+                oversized_bytes_ += s.size();
+                dst = oversized_.back().get();
+            } else {
+                if (chunks_.empty() || chunk_used_ + s.size() > CHUNK_SIZE) {
+                    chunks_.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+                    chunk_used_ = 0;
+                }
+                dst = chunks_.back().get() + chunk_used_;
+                chunk_used_ += s.size();
+            }
+            std::memcpy(dst, s.data(), s.size());
+            stored = dst;
+        }
+        std::string_view view(stored, s.size());
+        uint32_t id = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(view);
+        ids_.emplace(view, id);
+        return id;
+    }
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string_view, uint32_t> ids_; // Keys view into the chunks
+    std::vector<std::string_view> strings_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    std::vector<std::unique_ptr<char[]>> oversized_;
+    size_t chunk_used_ = 0;
+    size_t oversized_bytes_ = 0;
+};
+
+} // namespace code_assistance
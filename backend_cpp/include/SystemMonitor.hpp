@@ -1,12 +1,17 @@
 #pragma once
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <chrono>
 #include <vector>
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <charconv>
+#include "StageMetrics.hpp"
+#include "ThreadPool.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -16,155 +21,407 @@
 #else
 #include <sys/types.h>
 #include <sys/sysinfo.h>
+#include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <cstdlib>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define CODE_ASSISTANCE_HAS_MALLINFO2 1
+#endif
 #endif
 
 namespace code_assistance {
 
+struct SystemMonitorOptions {
+    std::chrono::milliseconds interval{1000};
+    // No snapshot read for this long: the sampler sleeps until the next read
+    std::chrono::seconds idle_after{60};
+    bool per_thread = true;
+    // PSS (smaps_rollup walks every mapping) and allocator stats are taken every Nth sample
+    unsigned slow_every = 10;
+    size_t max_threads_reported = 32;
+};
+
+struct ThreadUsage {
+    int tid = 0;
+    std::string name;
+    double cpu_percent = 0.0; // Of one core, over the last window
+};
+
 struct TelemetryData {
     // System
-    double cpu_usage = 0.0;
-    size_t ram_usage_mb = 0;
+    double cpu_usage = 0.0;   // Whole machine
+    size_t ram_usage_mb = 0;  // This process (RSS)
     size_t ram_total_mb = 0;
-    
-    // Application Latency
+
+    // Process
+    double process_cpu = 0.0; // Share of all cores, like cpu_usage
+    uint64_t rss_bytes = 0;
+    uint64_t pss_bytes = 0;   // Proportional set size; 0 where unavailable
+    uint64_t heap_in_use_bytes = 0;
+    uint64_t heap_free_bytes = 0;   // Held by the allocator, not in use
+    uint64_t heap_mapped_bytes = 0; // Large blocks served by mmap
+    size_t thread_count = 0;
+    std::vector<ThreadUsage> threads; // Busiest first
+
+    // Worker pool
+    size_t pool_pending = 0;
+    size_t pool_active = 0;
+    size_t pool_size = 0;
+
+    // Application Latency (medians; StageMetrics has the full distributions)
     double vector_latency_ms = 0.0;
     double embedding_latency_ms = 0.0;
-    double llm_generation_ms = 0.0; 
-    
-    // AI Throughput
-    int output_token_count = 0;     
-    double tokens_per_second = 0.0; 
-    int graph_nodes_scanned = 0; 
+    double llm_generation_ms = 0.0;
+
+    // AI Throughput: output tokens over LLM time of the calls finished in the last poll window
+    uint64_t output_token_count = 0;
+    double tokens_per_second = 0.0;
+    int graph_nodes_scanned = 0;
+
+    double sample_cost_us = 0.0; // What the last sample cost the sampler thread
 };
 
+// 🩺 Process and machine telemetry, sampled on a background thread.
+// The sampler starts with the first snapshot read and parks once nobody has read one for
+// idle_after, so an unwatched server pays nothing. On Linux the /proc files stay open and
+// are re-read with pread, and per-thread CPU comes from /proc/self/task.
 class SystemMonitor {
 public:
-    // Global Atomic Metrics
-    inline static std::atomic<double> global_vector_latency_ms{0.0};
-    inline static std::atomic<double> global_embedding_latency_ms{0.0};
-    inline static std::atomic<double> global_llm_generation_ms{0.0}; 
-    inline static std::atomic<int> global_output_tokens{0};          
+    // Running totals, so throughput is computed from one consistent pair of counters
+    inline static std::atomic<uint64_t> global_output_tokens{0};
+    inline static std::atomic<uint64_t> global_llm_us{0};
     inline static std::atomic<int> global_graph_nodes_scanned{0};
 
-    SystemMonitor() : stop_thread_(false) {
-#ifdef _WIN32
-        PdhOpenQuery(NULL, NULL, &cpuQuery);
-        PdhAddCounter(cpuQuery, TEXT("\\Processor(_Total)\\% Processor Time"), NULL, &cpuCounter);
-        PdhCollectQueryData(cpuQuery);
-#endif
-        monitor_thread_ = std::thread(&SystemMonitor::poll_routine, this);
+    // One finished LLM call (its latency is a Stage::Llm span of the caller)
+    static void record_generation(uint64_t output_tokens, double ms) {
+        global_output_tokens.fetch_add(output_tokens, std::memory_order_relaxed);
+        global_llm_us.fetch_add(static_cast<uint64_t>(std::max(ms, 0.0) * 1000.0), std::memory_order_relaxed);
+    }
+
+    explicit SystemMonitor(SystemMonitorOptions options = {}) : options_(options) {
+        options_.slow_every = std::max(1u, options_.slow_every);
+        if (options_.interval.count() <= 0) options_.interval = std::chrono::milliseconds(1000);
     }
 
     ~SystemMonitor() {
-        stop_thread_ = true;
+        {
+            std::lock_guard<std::mutex> lock(data_mutex_);
+            stop_thread_ = true;
+        }
+        wake_.notify_all();
         if (monitor_thread_.joinable()) monitor_thread_.join();
 #ifdef _WIN32
-        PdhCloseQuery(cpuQuery);
+        if (started_) PdhCloseQuery(cpuQuery);
+#else
+        for (int fd : {stat_fd_, self_stat_fd_, statm_fd_, rollup_fd_}) {
+            if (fd >= 0) ::close(fd);
+        }
+        for (auto& [tid, t] : tasks_) ::close(t.fd);
 #endif
     }
 
+    // Reported as queue depth / active workers. Call before the first snapshot.
+    void watch_pool(const ThreadPool* pool) { pool_ = pool; }
+
     TelemetryData get_latest_snapshot() {
-        std::lock_guard<std::mutex> lock(data_mutex_);
+        std::unique_lock<std::mutex> lock(data_mutex_);
+        last_read_ = std::chrono::steady_clock::now();
+        if (!started_) {
+            started_ = true;
+            lock.unlock();
+            start();
+            lock.lock();
+        } else if (parked_) {
+            parked_ = false;
+            wake_.notify_one();
+        }
         return current_data_;
     }
 
 private:
+    SystemMonitorOptions options_;
+    const ThreadPool* pool_ = nullptr;
+
 #ifdef _WIN32
     PDH_HQUERY cpuQuery;
     PDH_HCOUNTER cpuCounter;
 #else
+    struct TaskSlot {
+        int fd = -1;
+        unsigned long long ticks = 0;
+        std::string name;
+        bool seen = false;
+    };
+
     // Linux CPU Calculation State
-    unsigned long long prev_total_user = 0;
-    unsigned long long prev_total_user_low = 0;
-    unsigned long long prev_total_sys = 0;
-    unsigned long long prev_total_idle = 0;
+    int stat_fd_ = -1, self_stat_fd_ = -1, statm_fd_ = -1, rollup_fd_ = -1;
+    unsigned long long prev_total_ = 0;
+    unsigned long long prev_idle_ = 0;
+    unsigned long long prev_process_ticks_ = 0;
+    std::unordered_map<int, TaskSlot> tasks_;
+    long page_size_ = 4096;
+    long clock_ticks_ = 100;
+    uint64_t pss_bytes_ = 0;
+    uint64_t heap_in_use_ = 0, heap_free_ = 0, heap_mapped_ = 0;
 #endif
+    uint64_t prev_output_tokens_ = 0;
+    uint64_t prev_llm_us_ = 0;
+    std::chrono::steady_clock::time_point prev_sample_{};
+    unsigned samples_ = 0;
 
     TelemetryData current_data_;
     std::mutex data_mutex_;
+    std::condition_variable wake_;
+    std::chrono::steady_clock::time_point last_read_{};
+    bool started_ = false;
+    bool parked_ = false;
+    bool stop_thread_ = false;
     std::thread monitor_thread_;
-    std::atomic<bool> stop_thread_;
+
+    // First sample inline, so the very first read already has memory figures
+    void start() {
+#ifdef _WIN32
+        PdhOpenQuery(NULL, NULL, &cpuQuery);
+        PdhAddCounter(cpuQuery, TEXT("\\Processor(_Total)\\% Processor Time"), NULL, &cpuCounter);
+        PdhCollectQueryData(cpuQuery);
+#else
+        page_size_ = ::sysconf(_SC_PAGESIZE);
+        clock_ticks_ = ::sysconf(_SC_CLK_TCK);
+        stat_fd_ = ::open("/proc/stat", O_RDONLY | O_CLOEXEC);
+        self_stat_fd_ = ::open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+        statm_fd_ = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+        rollup_fd_ = ::open("/proc/self/smaps_rollup", O_RDONLY | O_CLOEXEC); // Linux 4.14+
+#endif
+        TelemetryData first = sample();
+        {
+            std::lock_guard<std::mutex> lock(data_mutex_);
+            current_data_ = std::move(first);
+        }
+        monitor_thread_ = std::thread(&SystemMonitor::poll_routine, this);
+    }
 
     void poll_routine() {
+        std::unique_lock<std::mutex> lock(data_mutex_);
         while (!stop_thread_) {
-            TelemetryData snapshot;
+            wake_.wait_for(lock, options_.interval, [this] { return stop_thread_; });
+            if (stop_thread_) break;
+            if (std::chrono::steady_clock::now() - last_read_ > options_.idle_after) {
+                // 💤 Unwatched: park until a reader wakes us, then restart the CPU windows
+                parked_ = true;
+                wake_.wait(lock, [this] { return stop_thread_ || !parked_; });
+                if (stop_thread_) break;
+                lock.unlock();
+                sample();
+                lock.lock();
+                continue;
+            }
+
+            lock.unlock();
+            TelemetryData snapshot = sample();
+            lock.lock();
+            current_data_ = std::move(snapshot);
+        }
+    }
+
+    // Only ever runs on one thread at a time: start() before the sampler exists, then the sampler
+    TelemetryData sample() {
+        auto began = std::chrono::steady_clock::now();
+        TelemetryData snapshot;
+        bool slow = samples_++ % options_.slow_every == 0;
 
 #ifdef _WIN32
-            // --- WINDOWS IMPLEMENTATION ---
-            PDH_FMT_COUNTERVALUE counterVal;
-            PdhCollectQueryData(cpuQuery);
-            PdhGetFormattedCounterValue(cpuCounter, PDH_FMT_DOUBLE, NULL, &counterVal);
-            snapshot.cpu_usage = counterVal.doubleValue;
-
-            PROCESS_MEMORY_COUNTERS_EX pmc;
-            if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc))) {
-                snapshot.ram_usage_mb = pmc.PrivateUsage / 1024 / 1024;
-            }
-            
-            MEMORYSTATUSEX memInfo;
-            memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-            GlobalMemoryStatusEx(&memInfo);
-            snapshot.ram_total_mb = memInfo.ullTotalPhys / 1024 / 1024;
+        // --- WINDOWS IMPLEMENTATION ---
+        PDH_FMT_COUNTERVALUE counterVal;
+        PdhCollectQueryData(cpuQuery);
+        PdhGetFormattedCounterValue(cpuCounter, PDH_FMT_DOUBLE, NULL, &counterVal);
+        snapshot.cpu_usage = counterVal.doubleValue;
+
+        PROCESS_MEMORY_COUNTERS_EX pmc;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc))) {
+            snapshot.rss_bytes = pmc.WorkingSetSize;
+            snapshot.ram_usage_mb = pmc.PrivateUsage / 1024 / 1024;
+        }
+
+        MEMORYSTATUSEX memInfo;
+        memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+        GlobalMemoryStatusEx(&memInfo);
+        snapshot.ram_total_mb = memInfo.ullTotalPhys / 1024 / 1024;
+        (void)slow;
 #else
-            // --- LINUX IMPLEMENTATION ---
-            // 1. RAM Usage
-            struct sysinfo memInfo;
-            sysinfo(&memInfo);
-            // Convert to MB
-            snapshot.ram_total_mb = (memInfo.totalram * memInfo.mem_unit) / 1024 / 1024;
-            long long physProc = (memInfo.totalram - memInfo.freeram) * memInfo.mem_unit;
-            snapshot.ram_usage_mb = physProc / 1024 / 1024;
-
-            // 2. CPU Usage (Parse /proc/stat)
-            std::ifstream fileStat("/proc/stat");
-            std::string line;
-            if (std::getline(fileStat, line)) {
-                std::istringstream iss(line);
-                std::string cpuLabel;
-                unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
-                if (iss >> cpuLabel >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal) {
-                     unsigned long long total_idle = idle + iowait;
-                     unsigned long long total_non_idle = user + nice + system + irq + softirq + steal;
-                     unsigned long long total = total_idle + total_non_idle;
-                     
-                     unsigned long long prev_total = prev_total_idle + (prev_total_user + prev_total_user_low + prev_total_sys);
-                     
-                     unsigned long long total_diff = total - prev_total;
-                     unsigned long long idle_diff = total_idle - prev_total_idle;
-
-                     if (total_diff > 0) {
-                        snapshot.cpu_usage = (double)(total_diff - idle_diff) / total_diff * 100.0;
-                     }
-
-                     // Update State
-                     prev_total_idle = total_idle;
-                     prev_total_user = user;
-                     prev_total_user_low = nice;
-                     prev_total_sys = system + irq + softirq + steal;
-                }
+        // --- LINUX IMPLEMENTATION ---
+        struct sysinfo memInfo;
+        if (::sysinfo(&memInfo) == 0) {
+            snapshot.ram_total_mb = (static_cast<uint64_t>(memInfo.totalram) * memInfo.mem_unit) >> 20;
+        }
+
+        // 1. Memory of this process: resident pages from statm, PSS from smaps_rollup
+        char buf[4096];
+        std::string_view text = read_proc(statm_fd_, buf, sizeof(buf));
+        if (!text.empty()) {
+            next_number(text); // size
+            snapshot.rss_bytes = next_number(text) * static_cast<uint64_t>(page_size_);
+            snapshot.ram_usage_mb = snapshot.rss_bytes >> 20;
+        }
+        if (slow) {
+            text = read_proc(rollup_fd_, buf, sizeof(buf));
+            size_t at = text.find("\nPss:");
+            if (at != std::string_view::npos) {
+                text.remove_prefix(at + 5);
+                pss_bytes_ = next_number(text) << 10; // kB
             }
+#if defined(CODE_ASSISTANCE_HAS_MALLINFO2)
+            struct mallinfo2 mi = ::mallinfo2();
+            heap_in_use_ = mi.uordblks + mi.hblkhd;
+            heap_free_ = mi.fordblks;
+            heap_mapped_ = mi.hblkhd;
 #endif
+        }
+        snapshot.pss_bytes = pss_bytes_;
+        snapshot.heap_in_use_bytes = heap_in_use_;
+        snapshot.heap_free_bytes = heap_free_;
+        snapshot.heap_mapped_bytes = heap_mapped_;
 
-            // 3. Common Telemetry
-            snapshot.vector_latency_ms = global_vector_latency_ms.load();
-            snapshot.embedding_latency_ms = global_embedding_latency_ms.load();
-            snapshot.llm_generation_ms = global_llm_generation_ms.load();
-            snapshot.output_token_count = global_output_tokens.load();
-            snapshot.graph_nodes_scanned = global_graph_nodes_scanned.load();
+        // 2. CPU: machine-wide from /proc/stat, this process from /proc/self/stat (same tick unit)
+        text = read_proc(stat_fd_, buf, sizeof(buf));
+        if (text.substr(0, 4) == "cpu ") {
+            text.remove_prefix(4);
+            unsigned long long fields[8] = {};
+            for (auto& f : fields) f = next_number(text);
+            unsigned long long idle = fields[3] + fields[4];                     // idle + iowait
+            unsigned long long total = 0;
+            for (auto f : fields) total += f;
+            text = read_proc(self_stat_fd_, buf, sizeof(buf));
+            unsigned long long process = process_ticks(text);
 
-            if (snapshot.llm_generation_ms > 0) {
-                snapshot.tokens_per_second = (snapshot.output_token_count / snapshot.llm_generation_ms) * 1000.0;
-            } else {
-                snapshot.tokens_per_second = 0.0;
+            if (prev_total_ && total > prev_total_) {
+                double total_diff = static_cast<double>(total - prev_total_);
+                snapshot.cpu_usage = (total_diff - static_cast<double>(idle - prev_idle_)) / total_diff * 100.0;
+                snapshot.process_cpu = static_cast<double>(process - prev_process_ticks_) / total_diff * 100.0;
             }
+            prev_total_ = total;
+            prev_idle_ = idle;
+            prev_process_ticks_ = process;
+        }
+
+        // 3. Per-thread CPU: one cached stat fd per live thread
+        if (options_.per_thread) sample_threads(snapshot, began);
+#endif
+
+        // 4. Common Telemetry
+        if (pool_) {
+            snapshot.pool_pending = pool_->pending();
+            snapshot.pool_active = pool_->active();
+            snapshot.pool_size = pool_->size();
+        }
+        snapshot.vector_latency_ms = StageMetrics::histogram(Stage::Retrieval).snapshot().percentile_ms(0.5);
+        snapshot.embedding_latency_ms = StageMetrics::histogram(Stage::Embedding).snapshot().percentile_ms(0.5);
+        snapshot.llm_generation_ms = StageMetrics::histogram(Stage::Llm).snapshot().percentile_ms(0.5);
+        snapshot.graph_nodes_scanned = global_graph_nodes_scanned.load();
+
+        uint64_t tokens = global_output_tokens.load(std::memory_order_relaxed);
+        uint64_t llm_us = global_llm_us.load(std::memory_order_relaxed);
+        snapshot.output_token_count = tokens - prev_output_tokens_;
+        if (llm_us > prev_llm_us_) {
+            snapshot.tokens_per_second = snapshot.output_token_count * 1e6 / static_cast<double>(llm_us - prev_llm_us_);
+        } else {
+            // Nothing finished this window: keep showing the last rate
+            std::lock_guard<std::mutex> lock(data_mutex_);
+            snapshot.tokens_per_second = current_data_.tokens_per_second;
+        }
+        prev_output_tokens_ = tokens;
+        prev_llm_us_ = llm_us;
+
+        prev_sample_ = began;
+        snapshot.sample_cost_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - began).count();
+        return snapshot;
+    }
+
+#ifndef _WIN32
+    static std::string_view read_proc(int fd, char* buf, size_t cap) {
+        if (fd < 0) return {};
+        ssize_t n = ::pread(fd, buf, cap - 1, 0);
+        return n > 0 ? std::string_view(buf, static_cast<size_t>(n)) : std::string_view{};
+    }
 
-            {
-                std::lock_guard<std::mutex> lock(data_mutex_);
-                current_data_ = snapshot;
+    // Next unsigned decimal in `text`, consuming it and whatever precedes it
+    static unsigned long long next_number(std::string_view& text) {
+        size_t at = text.find_first_of("0123456789");
+        if (at == std::string_view::npos) {
+            text = {};
+            return 0;
+        }
+        unsigned long long v = 0;
+        auto [end, ec] = std::from_chars(text.data() + at, text.data() + text.size(), v);
+        text.remove_prefix(static_cast<size_t>(end - text.data()));
+        return ec == std::errc() ? v : 0;
+    }
+
+    // utime + stime of a /proc/<pid>/stat line; fills `name` with the comm field
+    static unsigned long long process_ticks(std::string_view text, std::string* name = nullptr) {
+        // comm may itself contain spaces and parentheses: fields resume after the last ')'
+        size_t open = text.find('('), close = text.rfind(')');
+        if (open == std::string_view::npos || close == std::string_view::npos || close < open) return 0;
+        if (name) name->assign(text.substr(open + 1, close - open - 1));
+        text.remove_prefix(close + 2);
+        // Fields 3 (state) .. 13 precede utime (14) and stime (15)
+        for (int skip = 0; skip < 11; ++skip) {
+            size_t sp = text.find(' ');
+            if (sp == std::string_view::npos) return 0;
+            text.remove_prefix(sp + 1);
+        }
+        unsigned long long utime = next_number(text);
+        unsigned long long stime = next_number(text);
+        return utime + stime;
+    }
+
+    void sample_threads(TelemetryData& snapshot, std::chrono::steady_clock::time_point now) {
+        DIR* dir = ::opendir("/proc/self/task");
+        if (!dir) return;
+        double window_s = prev_sample_.time_since_epoch().count()
+            ? std::chrono::duration<double>(now - prev_sample_).count() : 0.0;
+        for (auto& [tid, t] : tasks_) t.seen = false;
+
+        char buf[512];
+        while (dirent* entry = ::readdir(dir)) {
+            int tid = std::atoi(entry->d_name);
+            if (tid <= 0) continue;
+            auto [it, fresh] = tasks_.try_emplace(tid);
+            TaskSlot& slot = it->second;
+            if (fresh) {
+                std::string path = "/proc/self/task/" + std::to_string(tid) + "/stat";
+                slot.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (slot.fd < 0) {
+                    tasks_.erase(it);
+                    continue;
+                }
+            }
+            slot.seen = true;
+            std::string_view text = read_proc(slot.fd, buf, sizeof(buf));
+            unsigned long long ticks = process_ticks(text, &slot.name);
+            if (!fresh && window_s > 0.0 && ticks >= slot.ticks) {
+                double cpu = static_cast<double>(ticks - slot.ticks) / clock_ticks_ / window_s * 100.0;
+                snapshot.threads.push_back({tid, slot.name, cpu});
+            } else {
+                snapshot.threads.push_back({tid, slot.name, 0.0});
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            slot.ticks = ticks;
         }
+        ::closedir(dir);
+
+        for (auto it = tasks_.begin(); it != tasks_.end();) {
+            if (it->second.seen) { ++it; continue; }
+            ::close(it->second.fd); // Thread exited
+            it = tasks_.erase(it);
+        }
+
+        snapshot.thread_count = snapshot.threads.size();
+        size_t keep = std::min(options_.max_threads_reported, snapshot.threads.size());
+        std::partial_sort(snapshot.threads.begin(), snapshot.threads.begin() + keep, snapshot.threads.end(),
+                          [](const ThreadUsage& a, const ThreadUsage& b) { return a.cpu_percent > b.cpu_percent; });
+        snapshot.threads.resize(keep);
     }
+#endif
 };
-}
\ No newline at end of file
+}
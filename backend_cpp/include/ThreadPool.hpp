@@ -1,58 +1,167 @@
 #pragma once
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include <future>
 #include <functional>
 #include <stdexcept>
-#include <type_traits> 
+#include <type_traits>
+#include <new>
+#include <cstddef>
 
+// 🚦 Two lanes: Interactive work (ghost text, chat) is always taken before Background
+// work (sync, parsing) anywhere in the pool.
+enum class TaskPriority { Interactive = 0, Background = 1 };
+
+// 📦 Move-only type-erased callable with inline storage, so typical lambdas
+// (a few captured pointers / a packaged_task) never hit the heap.
+class InlineTask {
+public:
+    static constexpr size_t CAPACITY = 64;
+
+    InlineTask() = default;
+
+    template<class F, class D = std::decay_t<F>, class = std::enable_if_t<!std::is_same_v<D, InlineTask>>>
+    InlineTask(F&& f) {
+        if constexpr (sizeof(D) <= CAPACITY && alignof(D) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<D>) {
+            new (storage_) D(std::forward<F>(f));
+            ops_ = &inline_ops<D>;
+        } else {
+            *reinterpret_cast<D**>(storage_) = new D(std::forward<F>(f));
+            ops_ = &heap_ops<D>;
+        }
+    }
+
+    InlineTask(InlineTask&& other) noexcept { take(other); }
+    InlineTask& operator=(InlineTask&& other) noexcept {
+        if (this != &other) { reset(); take(other); }
+        return *this;
+    }
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+    ~InlineTask() { reset(); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    void operator()() { ops_->invoke(storage_); }
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* src, void* dst) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template<class D>
+    static constexpr Ops inline_ops = {
+        [](void* p) { (*static_cast<D*>(p))(); },
+        [](void* src, void* dst) noexcept { new (dst) D(std::move(*static_cast<D*>(src))); static_cast<D*>(src)->~D(); },
+        [](void* p) noexcept { static_cast<D*>(p)->~D(); }
+    };
+
+    template<class D>
+    static constexpr Ops heap_ops = {
+        [](void* p) { (**static_cast<D**>(p))(); },
+        [](void* src, void* dst) noexcept { *static_cast<D**>(dst) = *static_cast<D**>(src); },
+        [](void* p) noexcept { delete *static_cast<D**>(p); }
+    };
+
+    void take(InlineTask& other) noexcept {
+        ops_ = other.ops_;
+        if (ops_) ops_->move(other.storage_, storage_);
+        other.ops_ = nullptr;
+    }
+
+    void reset() noexcept {
+        if (ops_) ops_->destroy(storage_);
+        ops_ = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[CAPACITY];
+    const Ops* ops_ = nullptr;
+};
+
+// 🧵 Work-stealing pool: every worker owns one deque per priority lane.
+// A worker drains its own Interactive deque, then steals Interactive work from its
+// siblings, and only then touches Background work (own first, then stolen).
+// Submissions from a worker stay on that worker's deque (cache-warm fan-out);
+// external submissions are spread round-robin.
 class ThreadPool {
 public:
-    ThreadPool(size_t threads) : stop(false) {
-        for(size_t i = 0; i < threads; ++i)
-            workers.emplace_back([this] {
-                for(;;) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock, [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-                    task();
-                }
-            });
+    ThreadPool(size_t threads) : queues_(threads ? threads : 1) {
+        for(size_t i = 0; i < queues_.size(); ++i)
+            workers.emplace_back([this, i] { worker_loop(i); });
     }
-    
+
+    // Background lane, like every pre-priority caller
     template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) 
+    auto enqueue(F&& f, Args&&... args)
         -> std::future<std::invoke_result_t<F, Args...>> { // 🚀 FIXED: use invoke_result_t
+        return enqueue(TaskPriority::Background, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template<class F, class... Args>
+    auto enqueue(TaskPriority priority, F&& f, Args&&... args)
+        -> std::future<std::invoke_result_t<F, Args...>> {
         using return_type = std::invoke_result_t<F, Args...>;
 
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
+        std::packaged_task<return_type()> task(
             std::bind(std::forward<F>(f), std::forward<Args>(args)...)
         );
-        
-        std::future<return_type> res = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            if(stop)
-                throw std::runtime_error("enqueue on stopped ThreadPool");
-            tasks.emplace([task](){ (*task)(); });
+        std::future<return_type> res = task.get_future();
+        push(priority, InlineTask([t = std::move(task)]() mutable { t(); }));
+        return res;
+    }
+
+    // Fire-and-forget: no future, no shared state
+    template<class F>
+    void post(TaskPriority priority, F&& f) {
+        push(priority, InlineTask(std::forward<F>(f)));
+    }
+
+    // 🪭 Parallel-for fan-out: fn(i) for i in [0, count), claimed in chunks of `grain`
+    // by up to size() tasks. The future completes after the last index; the first
+    // exception thrown by fn is propagated through it.
+    template<class F>
+    std::future<void> enqueue_bulk(size_t count, F&& fn,
+                                   TaskPriority priority = TaskPriority::Background, size_t grain = 0) {
+        auto state = make_bulk(count, std::forward<F>(fn), grain);
+        std::future<void> res = state->done.get_future();
+        if (count == 0) {
+            state->done.set_value();
+            return res;
         }
-        condition.notify_one();
+        size_t tasks = std::min(queues_.size(), (count + state->grain - 1) / state->grain);
+        for (size_t t = 0; t < tasks; ++t) push(priority, InlineTask([state] { state->run(); }));
         return res;
     }
 
+    // Blocking variant: the calling thread claims chunks too, so it is safe to call
+    // from inside a pool task (it finishes the work itself if every worker is busy).
+    template<class F>
+    void parallel_for(size_t count, F&& fn, TaskPriority priority = TaskPriority::Background, size_t grain = 0) {
+        if (count == 0) return;
+        auto state = make_bulk(count, std::forward<F>(fn), grain);
+        std::future<void> res = state->done.get_future();
+        size_t tasks = std::min(queues_.size(), (count + state->grain - 1) / state->grain);
+        for (size_t t = 1; t < tasks; ++t) push(priority, InlineTask([state] { state->run(); }));
+        state->run();
+        res.get();
+    }
+
+    size_t size() const { return queues_.size(); }
+    // Queue depth: tasks submitted but not yet taken by a worker
+    size_t pending() const { return pending_.load(std::memory_order_relaxed); }
+    // Workers currently running a task
+    size_t active() const { return active_.load(std::memory_order_relaxed); }
+
     ~ThreadPool() {
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
             stop = true;
         }
         condition.notify_all();
@@ -61,9 +170,111 @@ public:
     }
 
 private:
+    static constexpr size_t LANES = 2;
+
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<InlineTask> lanes[LANES];
+    };
+
+    struct BulkState {
+        std::function<void(size_t)> fn;
+        size_t count = 0;
+        size_t grain = 1;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> remaining{0};
+        std::atomic<bool> failed{false};
+        std::promise<void> done;
+
+        void run() {
+            for (;;) {
+                size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= count) return;
+                size_t end = std::min(count, begin + grain);
+                if (!failed.load(std::memory_order_relaxed)) {
+                    try {
+                        for (size_t i = begin; i < end; ++i) fn(i);
+                    } catch (...) {
+                        if (!failed.exchange(true)) done.set_exception(std::current_exception());
+                    }
+                }
+                if (remaining.fetch_sub(end - begin, std::memory_order_acq_rel) == end - begin && !failed.load()) {
+                    done.set_value();
+                }
+            }
+        }
+    };
+
+    template<class F>
+    std::shared_ptr<BulkState> make_bulk(size_t count, F&& fn, size_t grain) {
+        auto state = std::make_shared<BulkState>();
+        state->fn = std::forward<F>(fn);
+        state->count = count;
+        // Default: ~4 chunks per worker, enough slack to absorb uneven items
+        state->grain = grain ? grain : std::max<size_t>(1, count / (queues_.size() * 4));
+        state->remaining.store(count, std::memory_order_relaxed);
+        return state;
+    }
+
+    void push(TaskPriority priority, InlineTask task) {
+        size_t target = tl_pool_ == this
+            ? tl_index_
+            : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        {
+            std::lock_guard<std::mutex> lock(queues_[target].mutex);
+            if (stop.load(std::memory_order_relaxed))
+                throw std::runtime_error("enqueue on stopped ThreadPool");
+            queues_[target].lanes[static_cast<size_t>(priority)].push_back(std::move(task));
+        }
+        pending_.fetch_add(1, std::memory_order_release);
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); } // Pairs with the wait predicate
+        condition.notify_one();
+    }
+
+    bool try_pop(size_t self, InlineTask& out) {
+        const size_t n = queues_.size();
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            for (size_t k = 0; k < n; ++k) {
+                WorkerQueue& q = queues_[(self + k) % n];
+                std::lock_guard<std::mutex> lock(q.mutex);
+                auto& dq = q.lanes[lane];
+                if (dq.empty()) continue;
+                out = std::move(dq.front());
+                dq.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(size_t self) {
+        tl_pool_ = this;
+        tl_index_ = self;
+        for(;;) {
+            InlineTask task;
+            if (try_pop(self, task)) {
+                pending_.fetch_sub(1, std::memory_order_acq_rel);
+                active_.fetch_add(1, std::memory_order_relaxed);
+                task();
+                active_.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            this->condition.wait(lock, [this]{ return this->stop || pending_.load(std::memory_order_acquire) > 0; });
+            if(this->stop && pending_.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+
+    inline static thread_local const ThreadPool* tl_pool_ = nullptr;
+    inline static thread_local size_t tl_index_ = 0;
+
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
-    std::mutex queue_mutex;
+    std::vector<WorkerQueue> queues_;
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> active_{0};
+    std::mutex sleep_mutex_;
     std::condition_variable condition;
-    bool stop;
-};
\ No newline at end of file
+    std::atomic<bool> stop{false};
+};
@@ -0,0 +1,153 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CODE_ASSISTANCE_UTF8_NEON 1
+#endif
+
+namespace code_assistance {
+
+// 🔤 UTF-8 validation, repair and code-point-safe truncation.
+// Source text is overwhelmingly ASCII, so ASCII runs are skipped 32 (AVX2) or 16
+// (SSE2 / NEON) bytes at a time and only multi-byte sequences are decoded, by the
+// Unicode well-formedness table (no overlongs, surrogates or code points past U+10FFFF).
+// Valid input is returned as one copy, never rebuilt byte by byte.
+class Utf8 {
+public:
+    // Length of the longest well-formed prefix; text.size() when all of it is valid
+    static size_t valid_prefix(std::string_view text) {
+        const auto* s = reinterpret_cast<const unsigned char*>(text.data());
+        const size_t n = text.size();
+        size_t i = 0;
+        while (i < n) {
+            i = skip_ascii(s, i, n);
+            if (i == n) break;
+            size_t len = sequence_length(s + i, n - i);
+            if (len == 0) return i;
+            i += len;
+        }
+        return n;
+    }
+
+    static bool valid(std::string_view text) { return valid_prefix(text) == text.size(); }
+
+    // Copy of `text` with each ill-formed subsequence replaced by U+FFFD
+    static std::string repair(std::string_view text) {
+        size_t good = valid_prefix(text);
+        if (good == text.size()) return std::string(text);
+
+        std::string out;
+        out.reserve(text.size() + 8);
+        while (good < text.size()) {
+            out.append(text.data(), good);
+            out.append(REPLACEMENT);
+            text.remove_prefix(good + invalid_length(text.substr(good)));
+            good = valid_prefix(text);
+        }
+        out.append(text.data(), good);
+        return out;
+    }
+
+    // Largest cut <= max_bytes that doesn't split a code point
+    static size_t floor_boundary(std::string_view text, size_t max_bytes) {
+        if (max_bytes >= text.size()) return text.size();
+        size_t cut = max_bytes;
+        // At most three continuation bytes precede any boundary in well-formed text
+        for (size_t back = 0; back < 3 && cut > 0 && is_continuation(static_cast<unsigned char>(text[cut])); ++back) cut--;
+        return is_continuation(static_cast<unsigned char>(text[cut])) ? max_bytes : cut;
+    }
+
+    // At most max_bytes of `text`, cut on a code point boundary and repaired
+    static std::string truncate(std::string_view text, size_t max_bytes) {
+        return repair(text.substr(0, floor_boundary(text, max_bytes)));
+    }
+
+private:
+    static constexpr std::string_view REPLACEMENT = "\xEF\xBF\xBD";
+
+    static bool is_continuation(unsigned char c) { return (c & 0xC0) == 0x80; }
+
+    static size_t skip_ascii(const unsigned char* s, size_t i, size_t n) {
+#if defined(__AVX2__)
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            uint32_t high = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+            if (high) return i + __builtin_ctz(high);
+        }
+#elif defined(__SSE2__)
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            uint32_t high = static_cast<uint32_t>(_mm_movemask_epi8(v));
+            if (high) return i + __builtin_ctz(high);
+        }
+#elif defined(CODE_ASSISTANCE_UTF8_NEON)
+        for (; i + 16 <= n; i += 16) {
+            if (vmaxvq_u8(vld1q_u8(s + i)) >= 0x80) break;
+        }
+#else
+        for (; i + 8 <= n; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, s + i, 8);
+            if (word & 0x8080808080808080ULL) break;
+        }
+#endif
+        while (i < n && s[i] < 0x80) ++i;
+        return i;
+    }
+
+    // Length a lead byte announces (2-4) and the range its second byte must fall in,
+    // which rules out overlongs, surrogates and code points past U+10FFFF; 0 if no lead
+    static size_t lead_length(unsigned char c, unsigned char& lo, unsigned char& hi) {
+        lo = 0x80;
+        hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) return 2;
+        if (c >= 0xE0 && c <= 0xEF) {
+            if (c == 0xE0) lo = 0xA0;
+            else if (c == 0xED) hi = 0x9F;
+            return 3;
+        }
+        if (c >= 0xF0 && c <= 0xF4) {
+            if (c == 0xF0) lo = 0x90;
+            else if (c == 0xF4) hi = 0x8F;
+            return 4;
+        }
+        return 0;
+    }
+
+    // Bytes of the well-formed sequence at s (1-4), or 0 if it is ill-formed
+    static size_t sequence_length(const unsigned char* s, size_t avail) {
+        if (s[0] < 0x80) return 1;
+        unsigned char lo, hi;
+        size_t len = lead_length(s[0], lo, hi);
+        if (len == 0 || avail < len || s[1] < lo || s[1] > hi) return 0;
+        for (size_t k = 2; k < len; ++k) {
+            if (!is_continuation(s[k])) return 0;
+        }
+        return len;
+    }
+
+    // Maximal ill-formed subsequence at the front of `text` (Unicode's "best practice"
+    // for U+FFFD substitution): the longest prefix of a valid sequence, or one byte
+    static size_t invalid_length(std::string_view text) {
+        const auto* s = reinterpret_cast<const unsigned char*>(text.data());
+        unsigned char lo, hi;
+        size_t len = lead_length(s[0], lo, hi);
+        size_t k = 1;
+        if (len && k < text.size() && s[k] >= lo && s[k] <= hi) {
+            for (++k; k < len && k < text.size() && is_continuation(s[k]); ++k) {}
+        }
+        return k;
+    }
+};
+
+} // namespace code_assistance
@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include "Float16.hpp"
+
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CODE_ASSISTANCE_VECTOR_NEON 1
+#endif
+
+namespace code_assistance {
+
+// 🗜️ Stored precision of an embedding row
+//   F32:  dim floats
+//   F16:  dim IEEE binary16 values (2x smaller)
+//   Int8: float scale, then dim int8 codes, v[i] = code[i] * scale (~4x smaller).
+//         Rows are padded to 4 bytes so the scale of every row stays aligned.
+// Decoding uses F16C / AVX2 or NEON when the build enables them, else a scalar loop.
+enum class VectorPrecision : uint32_t { F32 = 0, F16 = 1, Int8 = 2 };
+
+inline size_t vector_row_bytes(VectorPrecision p, size_t dim) {
+    switch (p) {
+    case VectorPrecision::F16: return (dim * 2 + 3) & ~size_t(3);
+    case VectorPrecision::Int8: return (sizeof(float) + dim + 3) & ~size_t(3);
+    default: return dim * sizeof(float);
+    }
+}
+
+inline const char* precision_name(VectorPrecision p) {
+    switch (p) {
+    case VectorPrecision::F16: return "f16";
+    case VectorPrecision::Int8: return "int8";
+    default: return "f32";
+    }
+}
+
+inline bool parse_precision(std::string_view name, VectorPrecision& out) {
+    if (name == "f32" || name == "float32") out = VectorPrecision::F32;
+    else if (name == "f16" || name == "float16") out = VectorPrecision::F16;
+    else if (name == "int8" || name == "sq8") out = VectorPrecision::Int8;
+    else return false;
+    return true;
+}
+
+// Writes vector_row_bytes(p, dim) bytes; padding is zeroed
+inline void encode_vector(VectorPrecision p, const float* v, size_t dim, uint8_t* out) {
+    std::memset(out, 0, vector_row_bytes(p, dim));
+    if (p == VectorPrecision::F32) {
+        std::memcpy(out, v, dim * sizeof(float));
+    } else if (p == VectorPrecision::F16) {
+        for (size_t i = 0; i < dim; ++i) {
+            uint16_t h = float_to_half(v[i]);
+            std::memcpy(out + i * 2, &h, 2);
+        }
+    } else {
+        float max_abs = 0.0f;
+        for (size_t i = 0; i < dim; ++i) max_abs = std::max(max_abs, std::fabs(v[i]));
+        float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        std::memcpy(out, &scale, sizeof(float));
+        auto* codes = reinterpret_cast<int8_t*>(out + sizeof(float));
+        const float inv = 1.0f / scale;
+        for (size_t i = 0; i < dim; ++i) {
+            codes[i] = static_cast<int8_t>(std::clamp(std::lround(v[i] * inv), -127L, 127L));
+        }
+    }
+}
+
+inline void decode_vector(VectorPrecision p, const uint8_t* row, size_t dim, float* out) {
+    size_t i = 0;
+    if (p == VectorPrecision::F32) {
+        std::memcpy(out, row, dim * sizeof(float));
+    } else if (p == VectorPrecision::F16) {
+#if defined(__F16C__)
+        for (; i + 8 <= dim; i += 8) {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i * 2));
+            _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+        }
+#elif defined(CODE_ASSISTANCE_VECTOR_NEON)
+        for (; i + 4 <= dim; i += 4) {
+            vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(row + i * 2)))));
+        }
+#endif
+        for (; i < dim; ++i) {
+            uint16_t h;
+            std::memcpy(&h, row + i * 2, 2);
+            out[i] = half_to_float(h);
+        }
+    } else {
+        float scale;
+        std::memcpy(&scale, row, sizeof(float));
+        const auto* codes = reinterpret_cast<const int8_t*>(row + sizeof(float));
+#if defined(__AVX2__)
+        const __m256 s = _mm256_set1_ps(scale);
+        for (; i + 8 <= dim; i += 8) {
+            __m128i c = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + i));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(c)), s));
+        }
+#elif defined(CODE_ASSISTANCE_VECTOR_NEON)
+        for (; i + 8 <= dim; i += 8) {
+            int16x8_t c = vmovl_s8(vld1_s8(codes + i));
+            vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(c))), scale));
+            vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(c))), scale));
+        }
+#endif
+        for (; i < dim; ++i) out[i] = codes[i] * scale;
+    }
+}
+
+} // namespace code_assistance
@@ -0,0 +1,89 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace code_assistance {
+
+// ⚡ Dense float kernels for the retrieval post-processing stages.
+// AVX-512, AVX2+FMA or NEON when the build enables them, else a scalar loop the
+// compiler can still vectorize. Several independent accumulators hide FMA latency.
+inline float dot_product(const float* a, const float* b, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__AVX512F__)
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16) acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(__AVX2__) && defined(__FMA__)
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    sum = _mm_cvtss_f32(half);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#else
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (; i + 4 <= n; i += 4) {
+        for (size_t j = 0; j < 4; ++j) acc[j] += a[i + j] * b[i + j];
+    }
+    sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+// Scales each of the `rows` rows to unit length; zero rows stay zero
+inline void normalize_rows(float* x, size_t rows, size_t dim) {
+    for (size_t r = 0; r < rows; ++r) {
+        float* v = x + r * dim;
+        float sq = dot_product(v, v, dim);
+        if (sq <= 0.0f) continue;
+        float inv = 1.0f / std::sqrt(sq);
+        for (size_t d = 0; d < dim; ++d) v[d] *= inv;
+    }
+}
+
+// G = X * X^T for n row-major rows of x (n x n, row-major). Tiled so both row blocks of a
+// tile stay in cache while it is filled; only the upper triangle is computed.
+inline void gram_matrix(const float* x, size_t n, size_t dim, float* g) {
+    constexpr size_t TILE = 16; // 16 rows x 768 floats = 48 KB a block
+    for (size_t bi = 0; bi < n; bi += TILE) {
+        const size_t ei = std::min(n, bi + TILE);
+        for (size_t bj = bi; bj < n; bj += TILE) {
+            const size_t ej = std::min(n, bj + TILE);
+            for (size_t i = bi; i < ei; ++i) {
+                for (size_t j = std::max(bj, i); j < ej; ++j) {
+                    float v = dot_product(x + i * dim, x + j * dim, dim);
+                    g[i * n + j] = v;
+                    g[j * n + i] = v;
+                }
+            }
+        }
+    }
+}
+
+} // namespace code_assistance
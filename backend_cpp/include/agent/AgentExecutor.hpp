@@ -7,7 +7,7 @@
 #include "agent.grpc.pb.h"
 #include "agent/AgentTypes.hpp"
 #include "embedding_service.hpp"
-#include "retrieval_engine.hpp"
+#include "project_retrieval.hpp"
 #include "agent/SubAgent.hpp"
 #include "tools/ToolRegistry.hpp"
 #include "agent/ContextManager.hpp"
@@ -17,7 +17,7 @@ namespace code_assistance {
 class AgentExecutor {
 public:
     AgentExecutor(
-        std::shared_ptr<RetrievalEngine> engine,
+        std::shared_ptr<ProjectRetrieval> retrieval, // Over the hub's stores; null: no seeded context
         std::shared_ptr<EmbeddingService> ai,
         std::shared_ptr<SubAgent> sub_agent,
         std::shared_ptr<ToolRegistry> tool_registry
@@ -25,19 +25,25 @@ public:
 
     static std::string find_project_root();
 
+    // Runs one mission to completion or cancellation; safe to call concurrently
+    std::string run_mission(const ::code_assistance::UserQuery& req, MissionContext& mission);
     std::string run_autonomous_loop(const ::code_assistance::UserQuery& req, ::grpc::ServerWriter<::code_assistance::AgentResponse>* writer);
     std::string run_autonomous_loop_internal(const nlohmann::json& body);
+    // 🧭 Seeds ctx.architectural_map with the code most relevant to `query` (project_id is the root)
     void determineContextStrategy(const std::string& query, ContextSnapshot& ctx, const std::string& project_id);
 
 private:
-    std::shared_ptr<RetrievalEngine> engine_;
+    static constexpr size_t HISTORY_TOKEN_BUDGET = 24000; // Step history sent per request, prefix excluded
+    static constexpr int SEED_NODES = 40; // Rendered into the cached prefix, so paid for once
+
+    std::shared_ptr<ProjectRetrieval> retrieval_;
     std::shared_ptr<EmbeddingService> ai_service_;
     std::shared_ptr<SubAgent> sub_agent_;
     std::shared_ptr<ToolRegistry> tool_registry_;
     std::unique_ptr<ContextManager> context_mgr_;
 
     // 🚀 FIXED: Ensure duration_ms is the 4th argument
-    void notify(::grpc::ServerWriter<::code_assistance::AgentResponse>* w, const std::string& phase, const std::string& msg, double duration_ms = 0.0);
+    void notify(MissionContext& mission, const std::string& phase, const std::string& msg, double duration_ms = 0.0);
     bool check_reflection(const std::string& query, const std::string& topo, std::string& reason);
 };
 
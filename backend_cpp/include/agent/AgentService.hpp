@@ -0,0 +1,25 @@
+#pragma once
+#include <memory>
+#include <grpcpp/grpcpp.h>
+#include "agent.pb.h"
+#include "agent.grpc.pb.h"
+#include "agent/AgentExecutor.hpp"
+#include "agent/MissionScheduler.hpp"
+
+namespace code_assistance {
+
+// 🚀 gRPC AgentService on the callback API. Missions run on the scheduler, never on a
+// gRPC thread; hosted by agent_service and by code_assistance_server --agent alike.
+class AgentServiceImpl final : public AgentService::CallbackService {
+public:
+    AgentServiceImpl(std::shared_ptr<AgentExecutor> executor, MissionScheduler& scheduler);
+
+    grpc::ServerWriteReactor<AgentResponse>* ExecuteTask(grpc::CallbackServerContext* context,
+                                                         const UserQuery* request) override;
+
+private:
+    std::shared_ptr<AgentExecutor> executor_;
+    MissionScheduler& scheduler_;
+};
+
+} // namespace code_assistance
@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 #include "retrieval_engine.hpp"
@@ -14,4 +16,27 @@ struct ContextSnapshot {
     std::string focal_code; // 🚀 ADDED
 };
 
+// 🎫 Per-mission state. Everything a mission owns lives here or on the executor's stack,
+// so one AgentExecutor runs any number of missions at once.
+struct MissionContext {
+    std::atomic<bool> cancelled{false}; // Set when the client goes away; polled by LLM and tool waits
+    std::function<void(const std::string& phase, const std::string& payload)> emit; // Progress sink, may be empty
+
+    bool is_cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+};
+
+// 🔭 One tool result shown to the model
+struct StepObservation {
+    std::string tool;
+    std::string text;
+    bool digested = false; // Replaced by a digest to stay under the history budget
+};
+
+// 👣 One agent step: the model's reply and what came back
+struct AgentStep {
+    std::string action;                     // Raw model output
+    std::vector<StepObservation> observations;
+    std::string notes;                      // [SYSTEM: ...] lines (loop detected, invalid JSON)
+};
+
 }
\ No newline at end of file
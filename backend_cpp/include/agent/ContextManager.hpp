@@ -2,7 +2,12 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <string_view>
+#include <memory_resource>
 #include "agent/AgentTypes.hpp" // 🚀 Full definition now available
+#include "TokenCounter.hpp"
+#include "RequestArena.hpp"
+#include "Utf8.hpp"
 
 namespace code_assistance {
 
@@ -10,32 +15,208 @@ class ContextManager {
     const size_t TOKEN_LIMIT = 100000;
 
 public:
-    std::string rank_and_prune(const ContextSnapshot& ctx) {
-        std::string payload = "";
+    static size_t estimate_tokens(std::string_view text) { return TokenCounter::count(text); }
 
-        // 1. Focal Code
-        if (!ctx.raw_nodes.empty()) {
-            payload += std::string("### FOCAL POINT\n") + ctx.raw_nodes[0].node->content + "\n";
+    // Keeps the head and tail of an oversized observation (listings and files front-load
+    // the useful part, errors land at the end)
+    static std::string clip(const std::string& text, size_t max_tokens) {
+        if (estimate_tokens(text) <= max_tokens) return text;
+        const size_t head = TokenCounter::fit_prefix(text, max_tokens * 3 / 4);
+        std::string_view rest = std::string_view(text).substr(head);
+        // Tail: walk back whole lines until a quarter of the budget is used
+        size_t tail = rest.size();
+        size_t tail_tokens = 0;
+        while (tail > 0) {
+            size_t nl = rest.rfind('\n', tail - 1);
+            size_t begin = nl == std::string_view::npos ? 0 : nl;
+            size_t t = estimate_tokens(rest.substr(begin, tail - begin));
+            if (tail_tokens + t > max_tokens / 4) break;
+            tail_tokens += t;
+            tail = begin;
         }
+        std::string elided = std::to_string(tail);
+        std::string out;
+        out.reserve(head + elided.size() + rest.size() - tail + 24);
+        out.append(text, 0, head).append("\n... [").append(elided).append(" bytes elided] ...\n").append(rest.substr(tail));
+        return out;
+    }
+
+    // 🎒 Fills `token_budget` with the most useful context per token.
+    // Every section (focal code, each retrieved node, topology, each experience, and the
+    // history cut into turns, newest scored highest) is an item with a score and a token
+    // cost; a 0/1 knapsack over 64-token buckets picks the best set, then the leftover
+    // room goes to a truncated copy of the best item that did not fit whole.
+    // Sections keep their usual order in the output. Every table lives in the request arena.
+    std::string rank_and_prune(const ContextSnapshot& ctx, size_t token_budget = 0) {
+        if (token_budget == 0) token_budget = TOKEN_LIMIT;
+        std::pmr::memory_resource* arena = RequestArena::resource();
+
+        struct Item {
+            int section;         // Output order
+            std::string_view header;
+            std::string_view text;
+            double score;
+            size_t tokens = 0;
+            bool truncatable;    // Useful even as a prefix
+        };
+        std::pmr::vector<Item> items(arena);
+        std::pmr::vector<std::pmr::string> related(arena); // "### RELATED: <id>" headers; reserved, items view into it
+        related.reserve(ctx.raw_nodes.size());
+
+        // 1. Focal Code: the top node is the point of the request; the rest by retrieval score
+        for (size_t i = 0; i < ctx.raw_nodes.size(); ++i) {
+            const auto& r = ctx.raw_nodes[i];
+            if (!r.node) continue;
+            double score = i == 0 ? 10.0 : 2.0 + std::clamp(r.final_score, 0.0, 1.0) * 3.0;
+            std::string_view header = "### FOCAL POINT\n";
+            if (i > 0) {
+                auto& h = related.emplace_back("### RELATED: "); // Takes the vector's arena
+                h.append(r.node->id).append("\n");
+                header = h;
+            }
+            items.push_back({0, header, r.node->text(), score, 0, i == 0});
+        }
+        if (!ctx.focal_code.empty()) items.push_back({1, "### FOCAL CODE\n", ctx.focal_code, 6.0, 0, true});
 
         // 2. Topology
-        if (!ctx.architectural_map.empty()) {
-            payload += std::string("### PROJECT TOPOLOGY\n") + ctx.architectural_map + "\n";
+        if (!ctx.architectural_map.empty()) items.push_back({2, "### PROJECT TOPOLOGY\n", ctx.architectural_map, 4.0, 0, true});
+        if (!ctx.search_results.empty()) items.push_back({3, "### SEARCH RESULTS\n", ctx.search_results, 3.0, 0, true});
+
+        // 3. Experience Vault: earlier entries are the closer matches
+        for (size_t i = 0; i < ctx.experiences.size(); ++i) {
+            items.push_back({4, "### PREVIOUS FIX\n", ctx.experiences[i], 3.0 / (1.0 + 0.5 * static_cast<double>(i)), 0, false});
         }
 
-        // 3. Experience Vault
-        for (const auto& exp : ctx.experiences) {
-            payload += std::string("### PREVIOUS FIX\n") + exp + "\n";
+        // 4. History: split on blank lines, recency-weighted
+        std::pmr::vector<std::string_view> turns(arena);
+        std::string_view history = ctx.history;
+        for (size_t pos = 0; pos < history.size();) {
+            size_t cut = history.find("\n\n", pos);
+            size_t next = cut == std::string_view::npos ? history.size() : cut + 2;
+            turns.push_back(history.substr(pos, next - pos));
+            pos = next;
         }
+        for (size_t i = 0; i < turns.size(); ++i) {
+            double age = static_cast<double>(turns.size() - 1 - i);
+            items.push_back({5 + static_cast<int>(i), i == 0 ? "### CHAT HISTORY\n" : "", turns[i], 5.0 / (1.0 + age), 0, false});
+        }
+
+        for (auto& it : items) it.tokens = estimate_tokens(it.header) + estimate_tokens(it.text) + 1;
+
+        // 0/1 knapsack on bucketed costs (rounded up, so the pick never exceeds the budget)
+        constexpr size_t BUCKET = 64;
+        const size_t capacity = token_budget / BUCKET;
+        std::pmr::vector<size_t> cost(items.size(), arena);
+        for (size_t i = 0; i < items.size(); ++i) cost[i] = (items[i].tokens + BUCKET - 1) / BUCKET;
 
-        // 4. History (Surgical Truncation)
-        size_t history_len = ctx.history.length();
-        size_t start_pos = (history_len > 3000) ? (history_len - 3000) : 0;
-        
-        payload += std::string("### CHAT HISTORY\n") + ctx.history.substr(start_pos);
+        std::pmr::vector<double> best(capacity + 1, 0.0, arena);
+        // One flat items x (capacity + 1) table, one allocation
+        const size_t row = capacity + 1;
+        std::pmr::vector<uint8_t> took(items.size() * row, 0, arena);
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (cost[i] > capacity) continue;
+            for (size_t c = capacity; c >= cost[i]; --c) {
+                double with = best[c - cost[i]] + items[i].score;
+                if (with > best[c]) {
+                    best[c] = with;
+                    took[i * row + c] = 1;
+                }
+            }
+        }
+        std::pmr::vector<uint8_t> chosen(items.size(), 0, arena);
+        size_t used = 0;
+        for (size_t i = items.size(), c = capacity; i-- > 0;) {
+            if (took[i * row + c]) {
+                chosen[i] = true;
+                c -= cost[i];
+                used += items[i].tokens;
+            }
+        }
 
+        // Leftover room: the best-scoring truncatable item that did not fit
+        std::string_view partial; // Prefix of items[partial_of].text
+        long partial_of = -1;
+        size_t left = token_budget > used ? token_budget - used : 0;
+        long fill = -1;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (!chosen[i] && items[i].truncatable && (fill < 0 || items[i].score > items[fill].score)) fill = static_cast<long>(i);
+        }
+        if (fill >= 0 && left > estimate_tokens(items[fill].header) + 64) {
+            const Item& it = items[fill];
+            size_t room = left - estimate_tokens(it.header) - 16;
+            partial = it.text.substr(0, TokenCounter::fit_prefix(it.text, room));
+            partial_of = fill;
+            chosen[fill] = true;
+        }
+        static constexpr std::string_view TRUNCATED = "\n... [truncated]";
+        static constexpr std::string_view HISTORY = "### CHAT HISTORY\n";
+
+        std::pmr::vector<size_t> order(arena);
+        size_t length = 0;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (!chosen[i]) continue;
+            order.push_back(i);
+            length += items[i].header.size() + items[i].text.size() + 1;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return items[a].section < items[b].section; });
+
+        // Sized once: the only allocation that outlives the call
+        std::string payload;
+        payload.reserve(length + HISTORY.size() + TRUNCATED.size());
+        bool history_header = false;
+        for (size_t i : order) {
+            const Item& it = items[i];
+            // Kept turns may skip the first one; the history header goes on whichever comes first
+            if (it.section >= 5 && !history_header) {
+                payload += HISTORY;
+                history_header = true;
+            } else if (it.section < 5) {
+                payload += it.header;
+            }
+            if (static_cast<long>(i) == partial_of) payload.append(partial).append(TRUNCATED);
+            else payload.append(it.text);
+            payload += "\n";
+        }
         return payload;
     }
+
+    // 🪓 Agent history under a token budget: observations of the oldest steps are
+    // replaced by short digests until the history fits in 3/4 of the budget, so pruning
+    // happens in occasional large cuts and the prompt prefix stays byte-identical (and
+    // cacheable by the provider) between cuts. The newest `keep_recent` steps stay whole.
+    // Returns the estimated token count afterwards.
+    size_t rank_and_prune(std::vector<AgentStep>& steps, size_t token_budget, size_t keep_recent = 2) {
+        auto step_tokens = [](const AgentStep& s) {
+            size_t t = estimate_tokens(s.action) + estimate_tokens(s.notes);
+            for (const auto& o : s.observations) t += estimate_tokens(o.text) + estimate_tokens(o.tool) + 4;
+            return t;
+        };
+        size_t total = 0;
+        for (const auto& s : steps) total += step_tokens(s);
+        if (total <= token_budget) return total;
+
+        const size_t target = token_budget * 3 / 4;
+        const size_t prunable = steps.size() > keep_recent ? steps.size() - keep_recent : 0;
+        for (size_t i = 0; i < prunable && total > target; ++i) {
+            for (auto& o : steps[i].observations) {
+                if (o.digested) continue;
+                size_t before = estimate_tokens(o.text);
+                // One right-sized allocation; the observation's buffer is released
+                // Cut on a code point: the digest goes into the next prompt's JSON body
+                std::string_view head = std::string_view(o.text).substr(0, o.text.find('\n'));
+                std::string_view first_line = head.substr(0, Utf8::floor_boundary(head, 160));
+                std::string bytes = std::to_string(o.text.size());
+                std::string digest;
+                digest.reserve(first_line.size() + bytes.size() + o.tool.size() + 48);
+                digest.append(first_line).append(" ... [").append(bytes).append(" bytes pruned; call ")
+                      .append(o.tool).append(" again if needed]");
+                o.text = std::move(digest);
+                o.digested = true;
+                total -= before - std::min(before, estimate_tokens(o.text));
+            }
+        }
+        return total;
+    }
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include "ThreadPool.hpp"
+
+namespace code_assistance {
+
+struct MissionSchedulerOptions {
+    size_t max_concurrent = 32; // Missions running at once (each holds one thread while it waits on the LLM)
+    size_t max_queued = 512;    // Waiting beyond that is refused
+};
+
+// 🎛️ Admission control for agent missions.
+// A fixed set of threads runs missions; the rest wait in the pool's queue and cost no
+// thread until a slot frees, so hundreds of open sessions never become hundreds of
+// threads. submit() refuses work once the queue is full.
+class MissionScheduler {
+public:
+    explicit MissionScheduler(MissionSchedulerOptions options = {})
+        : options_(options), pool_(options.max_concurrent ? options.max_concurrent : 1) {}
+
+    bool submit(std::function<void()> job) {
+        if (queued_.fetch_add(1, std::memory_order_acq_rel) >= options_.max_queued) {
+            queued_.fetch_sub(1, std::memory_order_acq_rel);
+            return false;
+        }
+        pool_.post(TaskPriority::Interactive, [this, job = std::move(job)] {
+            queued_.fetch_sub(1, std::memory_order_acq_rel);
+            Running slot(running_); // Released even when the job throws
+            job();
+        });
+        return true;
+    }
+
+    size_t running() const { return running_.load(std::memory_order_relaxed); }
+    size_t queued() const { return queued_.load(std::memory_order_relaxed); }
+    const MissionSchedulerOptions& options() const { return options_; }
+
+private:
+    struct Running {
+        std::atomic<size_t>& count;
+        explicit Running(std::atomic<size_t>& c) : count(c) { count.fetch_add(1, std::memory_order_relaxed); }
+        ~Running() { count.fetch_sub(1, std::memory_order_relaxed); }
+        Running(const Running&) = delete;
+        Running& operator=(const Running&) = delete;
+    };
+
+    MissionSchedulerOptions options_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> running_{0};
+    ThreadPool pool_; // Last: its workers join before the counters go
+};
+
+} // namespace code_assistance
@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "agent/AgentTypes.hpp"
+#include "agent/ContextManager.hpp"
+#include "embedding_service.hpp"
+
+namespace code_assistance {
+
+// 🧱 Agent prompt as a stable prefix plus per-step deltas.
+// Turn 0 (role, tools, mission, protocol) never changes during a mission, and each step
+// appends a model turn (its reply) and a user turn (observations), so consecutive
+// requests share everything but the newest turns and the provider's prefix cache
+// applies. History is pruned through ContextManager only when it outgrows the budget.
+class PromptBuilder {
+public:
+    static constexpr size_t MAX_OBSERVATION_TOKENS = 4000; // One tool result, before any pruning
+
+    PromptBuilder(std::string prefix, size_t history_budget, ContextManager& context)
+        : prefix_(std::move(prefix.append(NEXT_ACTION))), budget_(history_budget), context_(context) {}
+
+    void add_step(AgentStep step) {
+        for (auto& o : step.observations) o.text = ContextManager::clip(o.text, MAX_OBSERVATION_TOKENS);
+        steps_.push_back(std::move(step));
+    }
+
+    // Digests old observations if the history is over budget; cheap otherwise
+    void prepare() { history_tokens_ = context_.rank_and_prune(steps_, budget_); }
+
+    std::vector<ChatTurn> turns() const {
+        std::vector<ChatTurn> out;
+        out.reserve(1 + steps_.size() * 2);
+        out.push_back({"user", prefix_});
+        for (const auto& s : steps_) {
+            out.push_back({"model", s.action});
+            std::string results;
+            results.reserve(results_size(s) + NEXT_ACTION.size());
+            append_results(s, results);
+            results += NEXT_ACTION;
+            out.push_back({"user", std::move(results)});
+        }
+        return out;
+    }
+
+    // Flat history for logs
+    std::string transcript() const {
+        size_t size = 0;
+        for (const auto& s : steps_) size += results_size(s);
+        std::string out;
+        out.reserve(size);
+        for (const auto& s : steps_) append_results(s, out);
+        return out;
+    }
+
+    size_t steps() const { return steps_.size(); }
+
+    // An observation as the history now holds it (clipped, maybe digested); null if there is none
+    const StepObservation* observation(size_t step, size_t index) const {
+        if (step >= steps_.size() || index >= steps_[step].observations.size()) return nullptr;
+        return &steps_[step].observations[index];
+    }
+    size_t history_tokens() const { return history_tokens_; }
+
+private:
+    static constexpr std::string_view NEXT_ACTION = "\nNEXT ACTION:";
+
+    // Rendered user turns are sized first and written once, with no concatenated temporaries
+    static size_t results_size(const AgentStep& s) {
+        size_t n = s.notes.size();
+        for (const auto& o : s.observations) n += o.tool.size() + o.text.size() + 12;
+        return n;
+    }
+    static void append_results(const AgentStep& s, std::string& out) {
+        out += s.notes;
+        for (const auto& o : s.observations) {
+            out.append("\n[RESULT: ").append(o.tool).append("]\n").append(o.text);
+        }
+    }
+
+    std::string prefix_;
+    size_t budget_;
+    ContextManager& context_;
+    std::vector<AgentStep> steps_;
+    size_t history_tokens_ = 0;
+};
+
+} // namespace code_assistance
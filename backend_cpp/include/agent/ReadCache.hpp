@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+namespace code_assistance {
+
+// 📖 read_file results still intact in a mission's history, by file version and range: a
+// repeat read of an unchanged file points back at them instead of resending the content.
+// The key carries the file's mtime and size, so a read after an edit misses and runs
+// again. That key, not loop detection, decides repeat reads (see loop_checked()).
+class ReadCache {
+public:
+    struct Mark {
+        size_t step;  // History step holding the result
+        size_t index; // Observation within that step
+        size_t bytes; // Of the result as recorded; a pruned or clipped one no longer matches
+    };
+
+    explicit ReadCache(std::string project_root) : root_(std::move(project_root)) {}
+
+    // Exact repeats of any other call are a loop; a file may change between two reads
+    static bool loop_checked(const std::string& tool) { return tool != "read_file"; }
+
+    // The model writes the arguments: a field of the wrong type reads as absent, never throws
+    static std::string path_of(const nlohmann::json& args) { return text(args, "path"); }
+
+    // Empty when the file cannot be stat'ed or an argument has the wrong type ("10" for a
+    // line): such a read is never answered from the cache, and the tool reports the error
+    std::string key(const nlohmann::json& args) const {
+        namespace fs = std::filesystem;
+        if (!args.is_object()) return {};
+        for (const char* field : {"path", "symbol"}) {
+            if (args.contains(field) && !args[field].is_string()) return {};
+        }
+        for (const char* field : {"start_line", "end_line"}) {
+            if (!args.contains(field)) continue;
+            const auto& line = args[field];
+            if (!line.is_number_integer() || (!line.is_number_unsigned() && line.get<int64_t>() < 0)) return {};
+        }
+
+        std::error_code ec;
+        fs::path target = (fs::path(root_) / text(args, "path")).lexically_normal();
+        auto stamp = fs::last_write_time(target, ec);
+        if (ec) return {};
+        auto size = fs::file_size(target, ec);
+        if (ec) return {};
+        return target.string() + '\0' + std::to_string(stamp.time_since_epoch().count()) + '\0' +
+               std::to_string(size) + '\0' + std::to_string(args.value("start_line", size_t(0))) + '-' +
+               std::to_string(args.value("end_line", size_t(0))) + '\0' + text(args, "symbol");
+    }
+
+    const Mark* find(const std::string& key) const {
+        if (key.empty()) return nullptr;
+        auto it = marks_.find(key);
+        return it == marks_.end() ? nullptr : &it->second;
+    }
+
+    void remember(const std::string& key, Mark mark) {
+        if (!key.empty()) marks_[key] = mark;
+    }
+
+    template <typename Pred>
+    void forget_if(Pred pred) {
+        std::erase_if(marks_, [&](const auto& entry) { return pred(entry.second); });
+    }
+
+private:
+    static std::string text(const nlohmann::json& args, const char* field) {
+        if (!args.is_object()) return {};
+        auto it = args.find(field);
+        return it != args.end() && it->is_string() ? it->get<std::string>() : std::string();
+    }
+
+    std::string root_;
+    std::unordered_map<std::string, Mark> marks_;
+};
+
+} // namespace code_assistance
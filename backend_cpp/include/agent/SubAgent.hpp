@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include "code_graph.hpp"
 #include "retrieval_engine.hpp"
@@ -14,12 +15,14 @@ public:
      * Converts raw E-Algorithm nodes into a high-density Topology Map (T-Map).
      * Rejects: Raw code dumps.
      * Accepts: Hierarchical context (Full Code -> Signatures -> Relationship Map).
+     * Entries are sized first and written into one buffer (in parallel for large sets).
      */
     std::string generate_topology(const std::vector<RetrievalResult>& nodes);
 
 private:
-    // Helper to extract just the def/class lines (Surgical Extraction)
-    std::string extract_signatures(const std::string& code);
+    // Helper to extract just the def/class lines (Surgical Extraction) of nodes stored
+    // without parser signatures (CodeNode::signatures)
+    static std::string extract_signatures(std::string_view code);
     
     // Categorizes nodes based on path and type
     std::string get_node_category(const std::shared_ptr<CodeNode>& node);
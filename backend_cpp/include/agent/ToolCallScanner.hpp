@@ -0,0 +1,336 @@
+#pragma once
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "ContentHash.hpp"
+
+namespace code_assistance {
+
+// 🔧 One tool call lifted out of the model's output
+struct ParsedToolCall {
+    std::string tool;
+    nlohmann::json parameters = nlohmann::json::object();
+    uint64_t fingerprint = 0; // Tool name + canonical parameters: equal calls hash equal, whatever the key order
+};
+
+// 🌊 Incremental, string-aware JSON scanner for streamed model output.
+// Prose before the action is skipped; from the first '{' every byte is parsed exactly
+// once, straight into a nlohmann::json, while a canonical hash is folded bottom-up
+// (object members combine order-independently, 1 and 1.0 hash alike). When the outer
+// object closes, feed() returns true and the tool calls are ready: the stream can stop
+// and dispatch starts with no re-scan, re-parse or dump(). Accepts
+// {"tool": ..., "parameters": {...}} and {"tool_calls": [ ... ]}. An object that turns
+// out malformed is dropped and scanning resumes at the next top-level '{'.
+class ToolCallScanner {
+public:
+    // Consumes the next chunk; true once the outer object has closed (later chunks are ignored)
+    bool feed(std::string_view chunk) {
+        for (char c : chunk) {
+            if (done_) break;
+            step(c);
+            offset_++;
+        }
+        return done_;
+    }
+
+    bool closed() const { return done_; }
+    size_t start() const { return start_; } // Offset of the outer '{'
+    size_t end() const { return end_; }     // One past the closing brace
+    const nlohmann::json& value() const { return root_; }
+    const std::vector<ParsedToolCall>& calls() const { return calls_; }
+
+private:
+    enum class Mode : uint8_t { Prose, Structural, String, Escape, Unicode, Number, Literal };
+    enum class Expect : uint8_t { Value, ValueOrEnd, KeyOrEnd, Key, Colon, CommaOrEnd };
+
+    struct Frame {
+        nlohmann::json value;
+        bool is_object = true;
+        std::string key;        // Member being filled (objects)
+        uint64_t hash = 0;      // Folded member / element hashes
+        uint64_t params_hash = 0;
+        bool has_params = false;
+    };
+
+    // Type tags keep "1", 1 and [1] apart
+    enum : uint64_t { TAG_NULL = 1, TAG_BOOL, TAG_NUMBER, TAG_STRING, TAG_ARRAY, TAG_OBJECT };
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+    static uint64_t hash_string(std::string_view s) { return xxh64(s, TAG_STRING); }
+
+    void step(char c) {
+        switch (mode_) {
+        case Mode::Prose:
+            if (c == '{') {
+                start_ = offset_;
+                stack_.clear();
+                push(true);
+                mode_ = Mode::Structural;
+            }
+            return;
+        case Mode::String:
+            if (c == '"') finish_string();
+            else if (c == '\\') mode_ = Mode::Escape;
+            else if (static_cast<unsigned char>(c) < 0x20) fail();
+            else text_ += c;
+            return;
+        case Mode::Escape:
+            mode_ = Mode::String;
+            switch (c) {
+            case '"': text_ += '"'; break;
+            case '\\': text_ += '\\'; break;
+            case '/': text_ += '/'; break;
+            case 'b': text_ += '\b'; break;
+            case 'f': text_ += '\f'; break;
+            case 'n': text_ += '\n'; break;
+            case 'r': text_ += '\r'; break;
+            case 't': text_ += '\t'; break;
+            case 'u': mode_ = Mode::Unicode; unicode_digits_ = 0; unicode_ = 0; break;
+            default: fail(); break;
+            }
+            return;
+        case Mode::Unicode: {
+            int d = c >= '0' && c <= '9' ? c - '0'
+                  : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                  : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            if (d < 0) { fail(); return; }
+            unicode_ = (unicode_ << 4) | static_cast<uint32_t>(d);
+            if (++unicode_digits_ == 4) {
+                finish_unicode();
+                if (mode_ == Mode::Unicode) mode_ = Mode::String;
+            }
+            return;
+        }
+        case Mode::Number:
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+                text_ += c;
+                return;
+            }
+            finish_number();
+            if (mode_ != Mode::Structural) return; // Malformed number
+            break; // The terminator is structural: handle it below
+        case Mode::Literal:
+            if (c != literal_[literal_pos_]) { fail(); return; }
+            if (literal_[++literal_pos_] == '\0') finish_literal();
+            return;
+        case Mode::Structural:
+            break;
+        }
+        structural(c);
+    }
+
+    void structural(char c) {
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t') return;
+        switch (expect_) {
+        case Expect::ValueOrEnd:
+            if (c == ']') { close(); return; }
+            [[fallthrough]];
+        case Expect::Value:
+            if (c == '{') push(true);
+            else if (c == '[') push(false);
+            else if (c == '"') { text_.clear(); reading_key_ = false; mode_ = Mode::String; }
+            else if (c == '-' || (c >= '0' && c <= '9')) { text_.assign(1, c); mode_ = Mode::Number; }
+            else if (c == 't') begin_literal("true");
+            else if (c == 'f') begin_literal("false");
+            else if (c == 'n') begin_literal("null");
+            else fail();
+            return;
+        case Expect::KeyOrEnd:
+            if (c == '}') { close(); return; }
+            [[fallthrough]];
+        case Expect::Key:
+            if (c == '"') { text_.clear(); reading_key_ = true; mode_ = Mode::String; }
+            else fail();
+            return;
+        case Expect::Colon:
+            if (c == ':') expect_ = Expect::Value;
+            else fail();
+            return;
+        case Expect::CommaOrEnd: {
+            bool object = stack_.back().is_object;
+            if (c == ',') expect_ = object ? Expect::Key : Expect::Value;
+            else if (c == (object ? '}' : ']')) close();
+            else fail();
+            return;
+        }
+        }
+    }
+
+    void push(bool is_object) {
+        Frame f;
+        f.is_object = is_object;
+        f.value = is_object ? nlohmann::json::object() : nlohmann::json::array();
+        stack_.push_back(std::move(f));
+        expect_ = is_object ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+    }
+
+    void close() {
+        Frame f = std::move(stack_.back());
+        stack_.pop_back();
+        uint64_t h = mix(f.hash ^ (f.is_object ? TAG_OBJECT : TAG_ARRAY));
+
+        // A call object is the root itself or an element of the root's "tool_calls" array
+        if (f.is_object && f.value.contains("tool") && f.value["tool"].is_string()) {
+            bool root = stack_.empty();
+            bool batched = stack_.size() == 2 && !stack_[1].is_object && stack_[0].key == "tool_calls";
+            if (root || batched) {
+                ParsedToolCall call;
+                call.tool = f.value["tool"].get<std::string>();
+                uint64_t params = f.has_params ? f.params_hash : mix(TAG_OBJECT);
+                if (f.has_params && f.value["parameters"].is_object()) call.parameters = f.value["parameters"];
+                call.fingerprint = mix(hash_string(call.tool) ^ mix(params + TAG_OBJECT));
+                if (root) calls_.assign(1, std::move(call));
+                else batched_.push_back(std::move(call));
+            }
+        }
+
+        if (stack_.empty()) {
+            root_ = std::move(f.value);
+            if (calls_.empty() && root_.contains("tool_calls")) calls_ = std::move(batched_);
+            end_ = offset_ + 1;
+            done_ = true;
+            return;
+        }
+        add(std::move(f.value), h);
+    }
+
+    // Folds a completed value into the enclosing container
+    void add(nlohmann::json v, uint64_t h) {
+        Frame& f = stack_.back();
+        if (f.is_object) {
+            if (f.key == "parameters") { f.params_hash = h; f.has_params = true; }
+            f.hash += mix(hash_string(f.key) ^ h); // Sum: member order does not matter
+            f.value[f.key] = std::move(v);
+        } else {
+            f.hash = mix(f.hash + h); // Chained: element order does
+            f.value.push_back(std::move(v));
+        }
+        expect_ = Expect::CommaOrEnd;
+        mode_ = Mode::Structural;
+    }
+
+    void finish_string() {
+        mode_ = Mode::Structural;
+        if (pending_high_) { fail(); return; }
+        if (reading_key_) {
+            stack_.back().key = std::move(text_);
+            expect_ = Expect::Colon;
+            return;
+        }
+        uint64_t h = hash_string(text_);
+        add(nlohmann::json(std::move(text_)), h);
+    }
+
+    void finish_unicode() {
+        uint32_t cp = unicode_;
+        if (cp >= 0xD800 && cp <= 0xDBFF) { // High surrogate: its pair follows as \uDCxx
+            if (pending_high_) { fail(); return; }
+            pending_high_ = cp;
+            return;
+        }
+        if (cp >= 0xDC00 && cp <= 0xDFFF) {
+            if (!pending_high_) { fail(); return; }
+            cp = 0x10000 + ((pending_high_ - 0xD800) << 10) + (cp - 0xDC00);
+            pending_high_ = 0;
+        } else if (pending_high_) {
+            fail();
+            return;
+        }
+        if (cp < 0x80) {
+            text_ += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            text_ += static_cast<char>(0xC0 | (cp >> 6));
+            text_ += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            text_ += static_cast<char>(0xE0 | (cp >> 12));
+            text_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            text_ += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            text_ += static_cast<char>(0xF0 | (cp >> 18));
+            text_ += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            text_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            text_ += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    void finish_number() {
+        const char* b = text_.data();
+        const char* e = b + text_.size();
+        bool integral = text_.find_first_of(".eE") == std::string::npos;
+        if (integral) {
+            int64_t i = 0;
+            auto [p, ec] = std::from_chars(b, e, i);
+            if (ec == std::errc() && p == e) { add(nlohmann::json(i), number_hash(static_cast<double>(i), i)); return; }
+            uint64_t u = 0;
+            auto [pu, ecu] = std::from_chars(b, e, u);
+            if (ecu == std::errc() && pu == e) { add(nlohmann::json(u), mix(u ^ TAG_NUMBER)); return; }
+        }
+        char* parsed_end = nullptr;
+        double d = std::strtod(b, &parsed_end);
+        if (parsed_end != e || text_.empty() || text_.back() == '.') { fail(); return; }
+        double whole = 0.0;
+        bool exact = std::modf(d, &whole) == 0.0 && std::fabs(d) < 9.2e18;
+        add(nlohmann::json(d), number_hash(d, exact ? static_cast<int64_t>(d) : 0, exact));
+    }
+
+    // Integral values hash by their integer, so 1 and 1.0 are the same argument
+    static uint64_t number_hash(double d, int64_t i, bool integral = true) {
+        if (integral) return mix(static_cast<uint64_t>(i) ^ TAG_NUMBER);
+        uint64_t bits;
+        static_assert(sizeof(bits) == sizeof(d));
+        std::memcpy(&bits, &d, sizeof(bits));
+        return mix(bits ^ (TAG_NUMBER << 32));
+    }
+
+    void begin_literal(const char* word) {
+        literal_ = word;
+        literal_pos_ = 1;
+        mode_ = Mode::Literal;
+    }
+
+    void finish_literal() {
+        mode_ = Mode::Structural;
+        if (literal_[0] == 'n') add(nullptr, mix(TAG_NULL));
+        else add(literal_[0] == 't', mix(TAG_BOOL + (literal_[0] == 't')));
+    }
+
+    // Malformed object: forget it and look for the next one
+    void fail() {
+        stack_.clear();
+        batched_.clear();
+        text_.clear();
+        pending_high_ = 0;
+        mode_ = Mode::Prose;
+    }
+
+    Mode mode_ = Mode::Prose;
+    Expect expect_ = Expect::Value;
+    std::vector<Frame> stack_;
+    std::string text_;          // String or number being read
+    bool reading_key_ = false;
+    uint32_t unicode_ = 0;
+    int unicode_digits_ = 0;
+    uint32_t pending_high_ = 0; // High surrogate waiting for its pair
+    const char* literal_ = "";
+    size_t literal_pos_ = 0;
+
+    size_t offset_ = 0;
+    size_t start_ = 0;
+    size_t end_ = 0;
+    bool done_ = false;
+    nlohmann::json root_ = nlohmann::json::object();
+    std::vector<ParsedToolCall> calls_;
+    std::vector<ParsedToolCall> batched_; // Elements of "tool_calls" closed so far
+};
+
+} // namespace code_assistance
@@ -3,10 +3,15 @@
 #include <unordered_map>
 #include <list>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <functional>
 #include <optional>
 #include <chrono>
 #include <vector>
 #include <string>
+#include <memory>
+#include "embedding_cache.hpp"
 
 namespace code_assistance {
 
@@ -90,19 +95,269 @@ private:
     mutable std::mutex mutex_;
 };
 
+// ⚖️ Approximate heap footprint of a cached value, used for byte budgets
+template<typename T>
+struct CacheWeight {
+    static size_t of(const T&) { return sizeof(T); }
+};
+
+template<>
+struct CacheWeight<std::string> {
+    static size_t of(const std::string& s) { return sizeof(std::string) + s.capacity(); }
+};
+
+template<typename T>
+struct CacheWeight<std::vector<T>> {
+    static size_t of(const std::vector<T>& v) { return sizeof(std::vector<T>) + v.capacity() * sizeof(T); }
+};
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t budget_bytes = 0;
+};
+
+enum class EvictionPolicy {
+    LRU,   // Exact recency; a hit relinks the entry, so get() takes the shard's write lock
+    Clock  // Second chance; a hit only sets a reference bit under the shared lock
+};
+
+// 🧩 Sharded, lock-striped cache with a byte budget.
+// Keys hash to one of N shards; each shard owns its lock, an intrusive recency list
+// and budget / N bytes. Counters are relaxed atomics, aggregated by stats().
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedLRUCache {
+public:
+    explicit ShardedLRUCache(size_t budget_bytes,
+                             std::chrono::seconds ttl = std::chrono::seconds(300),
+                             EvictionPolicy policy = EvictionPolicy::LRU,
+                             size_t shard_count = 16)
+        : ttl_(ttl), policy_(policy), budget_bytes_(budget_bytes) {
+        size_t n = 1;
+        while (n < shard_count) n <<= 1;
+        shards_ = std::vector<Shard>(n);
+        shard_mask_ = n - 1;
+        for (auto& shard : shards_) shard.budget = budget_bytes / n;
+    }
+
+    std::optional<Value> get(const Key& key) {
+        Shard& shard = shard_for(key);
+        auto now = std::chrono::steady_clock::now();
+
+        if (policy_ == EvictionPolicy::Clock) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.map.find(key);
+            if (it == shard.map.end() || now > it->second.expiry_time) {
+                shard.misses.fetch_add(1, std::memory_order_relaxed);
+                return std::nullopt; // Expired entries go at the next eviction sweep
+            }
+            it->second.referenced.store(true, std::memory_order_relaxed);
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return it->second.value;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            shard.misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        if (now > it->second.expiry_time) {
+            shard.erase(it);
+            shard.misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        shard.move_to_front(&it->second);
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second.value;
+    }
+
+    void set(const Key& key, const Value& value) {
+        Shard& shard = shard_for(key);
+        const size_t bytes = ENTRY_OVERHEAD + CacheWeight<Key>::of(key) + CacheWeight<Value>::of(value);
+        const auto expiry = std::chrono::steady_clock::now() + ttl_;
+
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (bytes > shard.budget) {
+            // Could never fit; also drop any stale copy
+            if (it != shard.map.end()) shard.erase(it);
+            return;
+        }
+
+        if (it != shard.map.end()) {
+            Entry& e = it->second;
+            shard.bytes = shard.bytes - e.bytes + bytes;
+            e.value = value;
+            e.bytes = bytes;
+            e.expiry_time = expiry;
+            shard.move_to_front(&e);
+        } else {
+            auto [ins, _] = shard.map.try_emplace(key, value);
+            Entry& e = ins->second;
+            e.key = &ins->first;
+            e.bytes = bytes;
+            e.expiry_time = expiry;
+            shard.link_front(&e);
+            shard.bytes += bytes;
+        }
+        evict(shard);
+    }
+
+    void erase(const Key& key) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it != shard.map.end()) shard.erase(it);
+    }
+
+    void clear() {
+        for (auto& shard : shards_) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.map.clear();
+            shard.head = shard.tail = nullptr;
+            shard.bytes = 0;
+        }
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const auto& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            n += shard.map.size();
+        }
+        return n;
+    }
+
+    CacheStats stats() const {
+        CacheStats s;
+        s.budget_bytes = budget_bytes_;
+        for (const auto& shard : shards_) {
+            s.hits += shard.hits.load(std::memory_order_relaxed);
+            s.misses += shard.misses.load(std::memory_order_relaxed);
+            s.evictions += shard.evictions.load(std::memory_order_relaxed);
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            s.entries += shard.map.size();
+            s.bytes += shard.bytes;
+        }
+        return s;
+    }
+
+private:
+    // Map node + list links + bookkeeping, roughly
+    static constexpr size_t ENTRY_OVERHEAD = 96;
+
+    struct Entry {
+        explicit Entry(const Value& v) : value(v) {}
+        Value value;
+        const Key* key = nullptr;  // Points into the owning map node (node addresses are stable)
+        Entry* prev = nullptr;
+        Entry* next = nullptr;
+        size_t bytes = 0;
+        std::chrono::steady_clock::time_point expiry_time;
+        std::atomic<bool> referenced{false};
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Key, Entry, Hash> map;
+        Entry* head = nullptr; // Most recently inserted / used
+        Entry* tail = nullptr; // Eviction candidate
+        size_t bytes = 0;
+        size_t budget = 0;
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+
+        void link_front(Entry* e) {
+            e->prev = nullptr;
+            e->next = head;
+            if (head) head->prev = e;
+            head = e;
+            if (!tail) tail = e;
+        }
+
+        void unlink(Entry* e) {
+            if (e->prev) e->prev->next = e->next; else head = e->next;
+            if (e->next) e->next->prev = e->prev; else tail = e->prev;
+            e->prev = e->next = nullptr;
+        }
+
+        void move_to_front(Entry* e) {
+            if (head == e) return;
+            unlink(e);
+            link_front(e);
+        }
+
+        void erase(typename std::unordered_map<Key, Entry, Hash>::iterator it) {
+            unlink(&it->second);
+            bytes -= it->second.bytes;
+            map.erase(it);
+        }
+    };
+
+    Shard& shard_for(const Key& key) {
+        size_t h = Hash{}(key);
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL; // Decorrelate from the map's own bucket choice
+        return shards_[(h >> 32) & shard_mask_];
+    }
+
+    // Caller holds shard.mutex exclusively
+    void evict(Shard& shard) {
+        const auto now = std::chrono::steady_clock::now();
+        size_t second_chances = shard.map.size();
+        while (shard.bytes > shard.budget && shard.tail) {
+            Entry* victim = shard.tail;
+            if (policy_ == EvictionPolicy::Clock && second_chances > 0 && now <= victim->expiry_time &&
+                victim->referenced.exchange(false, std::memory_order_relaxed)) {
+                shard.move_to_front(victim); // Was hit since the hand last passed
+                --second_chances;
+                continue;
+            }
+            shard.erase(shard.map.find(*victim->key));
+            shard.evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::chrono::seconds ttl_;
+    EvictionPolicy policy_;
+    size_t budget_bytes_;
+    std::vector<Shard> shards_;
+    size_t shard_mask_ = 0;
+};
+
 class CacheManager {
 public:
     CacheManager() 
-        : embedding_cache_(1000, std::chrono::seconds(3600)),
-          result_cache_(500, std::chrono::seconds(300)) {}
+        : embedding_cache_(8 * 1024 * 1024, std::chrono::seconds(3600), EvictionPolicy::Clock),
+          result_cache_(16 * 1024 * 1024, std::chrono::seconds(300), EvictionPolicy::Clock),
+          vision_cache_(4 * 1024 * 1024, std::chrono::seconds(3600), EvictionPolicy::Clock) {}
+
+    // 🧊 Back embeddings with the on-disk, cross-process store. Until this is called
+    // (or if it fails) embeddings only live in the in-memory LRU below.
+    bool open_embedding_store(const std::string& path,
+                              EmbeddingCache::Precision precision = EmbeddingCache::Precision::F32) {
+        auto store = std::make_shared<EmbeddingCache>();
+        if (!store->open(path, precision)) return false;
+        embedding_store_ = std::move(store);
+        return true;
+    }
 
-    // Cache embeddings
-    std::optional<std::vector<float>> get_embedding(const std::string& text) {
-        return embedding_cache_.get(text);
+    // Cache embeddings (content-addressed by model + text)
+    std::optional<std::vector<float>> get_embedding(const std::string& model, const std::string& text) {
+        if (!embedding_store_) return embedding_cache_.get(model + '\0' + text);
+        std::vector<float> out;
+        if (embedding_store_->get(EmbeddingCache::key_for(model, text), out)) return out;
+        return std::nullopt;
     }
 
-    void set_embedding(const std::string& text, const std::vector<float>& embedding) {
-        embedding_cache_.set(text, embedding);
+    void set_embedding(const std::string& model, const std::string& text, const std::vector<float>& embedding) {
+        if (!embedding_store_) return embedding_cache_.set(model + '\0' + text, embedding);
+        embedding_store_->put(EmbeddingCache::key_for(model, text), embedding);
     }
 
     // Cache retrieval results
@@ -114,14 +369,34 @@ public:
         result_cache_.set(query, result);
     }
 
+    // Vision analyses, keyed by the image's content hash and the prompt
+    std::optional<std::string> get_vision(uint64_t image_hash, const std::string& prompt) {
+        return vision_cache_.get(vision_key(image_hash, prompt));
+    }
+
+    void set_vision(uint64_t image_hash, const std::string& prompt, const std::string& analysis) {
+        vision_cache_.set(vision_key(image_hash, prompt), analysis);
+    }
+
+    CacheStats embedding_stats() const { return embedding_cache_.stats(); }
+    CacheStats result_stats() const { return result_cache_.stats(); }
+
     void clear_all() {
         embedding_cache_.clear();
         result_cache_.clear();
+        vision_cache_.clear();
     }
 
 private:
-    LRUCache<std::string, std::vector<float>> embedding_cache_;
-    LRUCache<std::string, std::string> result_cache_;
+    std::shared_ptr<EmbeddingCache> embedding_store_;
+    ShardedLRUCache<std::string, std::vector<float>> embedding_cache_;
+    ShardedLRUCache<std::string, std::string> result_cache_;
+    ShardedLRUCache<std::string, std::string> vision_cache_;
+
+    static std::string vision_key(uint64_t image_hash, const std::string& prompt) {
+        std::string key(reinterpret_cast<const char*>(&image_hash), sizeof(image_hash));
+        return key.append(prompt);
+    }
 };
 
 } // namespace code_assistance
\ No newline at end of file
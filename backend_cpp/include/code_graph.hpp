@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
@@ -14,6 +15,7 @@ struct CodeNode {
     std::string name;
     std::string content;
     std::string docstring;
+    std::string signatures; // Declaration lines of the node and of definitions inside it, one per line
     std::string file_path;
     std::string type;
     std::unordered_set<std::string> dependencies;
@@ -21,6 +23,23 @@ struct CodeNode {
     std::unordered_map<std::string, double> weights;
     std::string ai_summary;
     double ai_quality_score = 0.5;
+    float structural_weight = 0.5f; // Mirrors weights["structural"] for allocation-free scoring
+
+    // 🧷 Zero-copy content: a byte range of the file buffer shared by every node parsed from
+    // that file (and by its cached syntax tree). `content` is only used when no source is set.
+    std::shared_ptr<const std::string> source;
+    uint32_t source_offset = 0;
+    uint32_t source_length = 0;
+
+    std::string_view text() const {
+        return source ? std::string_view(*source).substr(source_offset, source_length) : std::string_view(content);
+    }
+    void set_source(std::shared_ptr<const std::string> buffer, size_t offset, size_t length) {
+        source = std::move(buffer);
+        source_offset = static_cast<uint32_t>(offset);
+        source_length = static_cast<uint32_t>(length);
+        content.clear();
+    }
 
     nlohmann::json to_json() const;
     static CodeNode from_json(const nlohmann::json& j);
@@ -28,17 +47,27 @@ struct CodeNode {
 
 class CodeParser {
 public:
-    // Simple regex-based parser
+    // Tree-sitter queries for languages with a grammar (defined in parser_elite.cpp),
+    // the bracket scanner for everything else
+    // Node content refers into `source`, which the nodes keep alive.
+    static std::vector<CodeNode> extract_nodes_from_file(const std::string& file_path, std::shared_ptr<const std::string> source);
     static std::vector<CodeNode> extract_nodes_from_file(const std::string& file_path, const std::string& content);
+
+    // Grammar-free scanner: brace-delimited blocks plus ES-style imports
+    static std::vector<CodeNode> extract_nodes_fallback(const std::string& file_path, const std::shared_ptr<const std::string>& source);
 };
 
 class CodeGraph {
 public:
     void add_node(std::shared_ptr<CodeNode> node);
+    // 📈 Blends each node's parser weight with its centrality over the dependency edges
+    // (see compute_centrality) into structural_weight and weights["structural"], and
+    // records the score as weights["centrality"]. Safe to call again after more adds.
     void calculate_static_weights();
 
 private:
     std::vector<std::shared_ptr<CodeNode>> all_nodes_;
+    std::vector<float> priors_; // structural_weight of each node as added
     std::unordered_map<std::string, std::shared_ptr<CodeNode>> name_to_node_map_;
 };
 
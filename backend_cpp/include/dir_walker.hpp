@@ -0,0 +1,59 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include "PathMatcher.hpp"
+
+class ThreadPool;
+
+namespace code_assistance {
+
+namespace fs = std::filesystem;
+
+struct WalkEntry {
+    std::string rel_path; // Relative to the walk root, '/'-separated
+    bool is_dir = false;
+    bool included = false; // An include rule decided this path (bypasses extension filters)
+    int depth = 1;         // 1 = direct child of the start directory
+};
+
+struct DirWalkOptions {
+    std::shared_ptr<const PathMatcher> matcher; // Null: nothing is ignored
+    std::string start;       // Subdirectory of the root to walk ('/'-separated); paths stay root-relative
+    fs::path skip_dir;       // Never entered (e.g. the index storage directory)
+    int max_depth = 0;       // Directories at this depth are reported but not entered; 0 = unlimited
+    bool report_dirs = false;
+    size_t threads = 0;      // Walking threads besides the caller; 0 = hardware_concurrency
+};
+
+struct DirWalkStats {
+    size_t dirs = 0;
+    size_t files = 0;
+    size_t errors = 0;   // Directories that could not be opened
+    bool stopped = false; // The sink asked to stop
+};
+
+// Called concurrently from every walking thread; return false to stop the walk
+using WalkSink = std::function<bool(WalkEntry&&)>;
+
+// 🏃 Parallel directory walker.
+// Workers pull directories from a shared stack, list them with the cheapest native call
+// (getdents64 on Linux, readdir elsewhere on POSIX, FindFirstFileEx with large fetch on
+// Windows) and take file types from the listing itself, so an entry costs a stat only
+// when the filesystem reports no type. Relative paths are built by appending names,
+// ignored directories are pruned before they are opened, and the skip directory is
+// recognised by device + inode taken once up front. Entries stream into the sink as
+// they are found, in no particular order. Symlinked directories are not followed.
+//
+// With a pool, helpers run as Background tasks alongside the calling thread. They return
+// as soon as there is no directory to take (another is posted when the frontier grows),
+// so an idle walk holds no pool slot; the caller always works too, so the walk completes
+// even when every pool worker is busy.
+class DirWalker {
+public:
+    static DirWalkStats walk(const fs::path& root, const DirWalkOptions& options,
+                             const WalkSink& sink, ThreadPool* pool = nullptr);
+};
+
+} // namespace code_assistance
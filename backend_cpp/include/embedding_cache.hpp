@@ -0,0 +1,95 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace code_assistance {
+
+// 🧊 PERSISTENT EMBEDDING CACHE (data/embedding_cache.bin)
+// Content-addressed: key = 128-bit XXH64 pair over model name + normalized text.
+// Append-only record log, mmap'd for reads and shared by every process on the host
+// (code_assistance_server and agent_service). Appends are serialized with an OS file lock;
+// readers pick up other processes' appends on their next miss.
+// Layout: [FileHeader][RecordHeader + payload (8-byte padded)] ...
+namespace embedding_cache_format {
+
+constexpr char MAGIC[8] = {'S', 'Y', 'N', 'E', 'M', 'B', 'C', 'H'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t RECORD_MAGIC = 0x52424D45; // "EMBR"
+
+enum class Precision : uint16_t { F32 = 0, F16 = 1 };
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct RecordHeader {
+    uint32_t magic;
+    uint16_t precision;     // Precision
+    uint16_t reserved;
+    uint32_t dim;
+    uint32_t reserved2;
+    uint64_t key_lo;
+    uint64_t key_hi;
+    uint64_t checksum;      // XXH64 of the payload; a torn tail fails this
+};
+
+static_assert(sizeof(FileHeader) == 16, "FileHeader must stay fixed-width");
+static_assert(sizeof(RecordHeader) == 40, "RecordHeader must stay fixed-width");
+
+} // namespace embedding_cache_format
+
+struct EmbeddingKey {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+};
+
+class EmbeddingCache {
+public:
+    using Precision = embedding_cache_format::Precision;
+
+    EmbeddingCache() = default;
+    ~EmbeddingCache();
+
+    EmbeddingCache(const EmbeddingCache&) = delete;
+    EmbeddingCache& operator=(const EmbeddingCache&) = delete;
+
+    // Creates the file if missing and drops a torn tail left by a crashed writer.
+    // `precision` only affects records this process appends; both are readable.
+    bool open(const std::string& path, Precision precision = Precision::F32);
+    bool is_open() const { return out_ != nullptr; }
+
+    // CRLF -> LF and trailing whitespace trimmed, so re-saves that only touch line
+    // endings keep hitting
+    static EmbeddingKey key_for(std::string_view model, std::string_view text);
+
+    bool get(const EmbeddingKey& key, std::vector<float>& out);
+    void put(const EmbeddingKey& key, const std::vector<float>& embedding);
+
+    size_t size() const;
+
+private:
+    // Caller holds mutex_ exclusively
+    bool remap();
+    void index_tail();
+    bool read_record(uint64_t offset, const EmbeddingKey& key, std::vector<float>& out) const;
+
+    std::string path_;
+    Precision precision_ = Precision::F32;
+    std::FILE* out_ = nullptr;   // Append handle; also carries the cross-process lock
+
+    MappedFile map_;
+    uint64_t indexed_end_ = 0;   // Records before this offset are in index_
+    std::unordered_map<uint64_t, uint64_t> index_; // key_lo -> record offset
+    mutable std::shared_mutex mutex_;
+};
+
+} // namespace code_assistance
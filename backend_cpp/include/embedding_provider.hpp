@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace code_assistance {
+
+// 🔌 Where embeddings come from when not from the Gemini embedContent API.
+// EmbeddingService keeps its cache, coalescing and dimension bookkeeping in front of
+// whichever provider it was built with; the provider only turns texts into vectors.
+class EmbeddingProvider {
+public:
+    virtual ~EmbeddingProvider() = default;
+
+    // Names the embedding space: cache entries are keyed by it, so vectors from two
+    // models never mix
+    virtual const std::string& model() const = 0;
+    virtual int dimension() const = 0;
+
+    // One vector per text, in order. May be called from several threads at once.
+    // Throws if the batch as a whole failed; an empty vector marks a single failed text.
+    virtual std::vector<std::vector<float>> embed(const std::vector<std::string>& texts) = 0;
+
+    // How many embed() calls are worth running side by side
+    virtual size_t concurrency() const { return 1; }
+};
+
+} // namespace code_assistance
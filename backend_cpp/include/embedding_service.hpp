@@ -1,17 +1,31 @@
 #pragma once
+#include <atomic>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
 #include <memory>
 #include "cache_manager.hpp"
+#include "embedding_provider.hpp"
+#include "image_pipeline.hpp"
 #include "KeyManager.hpp" 
+#include "LatencyHistogram.hpp"
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
 
 namespace code_assistance {
 
 struct VisionResult {
     std::string analysis;
-    int fuel_consumed;
-    bool success;
+    int fuel_consumed = 0;
+    bool success = false;
+    bool cached = false; // Same image and prompt answered before
 };
 
 struct GenerationResult {
@@ -19,28 +33,116 @@ struct GenerationResult {
     int prompt_tokens = 0;
     int completion_tokens = 0;
     int total_tokens = 0;
+    int cached_tokens = 0; // Prompt tokens served from the provider's prefix cache
     bool success = false;
 };
 
-// Declaration only
-std::string utf8_safe_substr(const std::string& str, size_t length);
+// One message of a multi-turn request; role is "user" or "model"
+struct ChatTurn {
+    std::string role;
+    std::string text;
+};
+
+// 🏇 Ghost-text hedging: when to fire a parallel request at the next key
+struct HedgeOptions {
+    std::chrono::milliseconds initial_delay{800}; // Until a model has min_samples latencies
+    std::chrono::milliseconds min_delay{150};
+    double quantile = 0.95;
+    uint64_t min_samples = 20;
+    size_t max_in_flight = 2;
+};
+
+struct ModelLatency {
+    std::string model;
+    uint64_t samples = 0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+};
+
+// At most `length` bytes, cut on a code point boundary, ill-formed bytes replaced (see Utf8)
+std::string utf8_safe_substr(std::string_view str, size_t length);
 
 class EmbeddingService {
 public:
-    explicit EmbeddingService(std::shared_ptr<KeyManager> key_manager);
+    // Without a provider, embeddings come from the Gemini API (768 dims)
+    explicit EmbeddingService(std::shared_ptr<KeyManager> key_manager,
+                              std::shared_ptr<EmbeddingProvider> provider = nullptr);
+    ~EmbeddingService(); // Joins hedged attempts still draining
+
+    // What vector stores fed by this service must be sized to
+    int embedding_dimension() const { return provider_ ? provider_->dimension() : REMOTE_EMBEDDING_DIM; }
+    const std::string& embedding_model() const;
     
+    // 🧺 Coalesced: concurrent callers are gathered for a few ms into one batchEmbedContents
+    // call, and callers asking for the same text share a single request
     std::vector<float> generate_embedding(const std::string& text);
-    std::vector<std::vector<float>> generate_embeddings_batch(const std::vector<std::string>& texts);
+    // key_slot >= 0 offsets the KeyManager::acquire_key scan, so concurrent batches
+    // fan out across equally good keys instead of piling onto the same one
+    std::vector<std::vector<float>> generate_embeddings_batch(const std::vector<std::string>& texts, int key_slot = -1);
+    size_t active_key_count() const { return key_manager_ ? key_manager_->get_active_key_count() : 0; }
+    // Batches worth keeping in flight: one per API key, or what the local model can use
+    size_t embedding_concurrency() const;
     std::string generate_text(const std::string& prompt);
     std::string generate_autocomplete(const std::string& prefix);
+    std::shared_ptr<CacheManager> cache_manager() const { return cache_manager_; }
+    void set_hedge_options(const HedgeOptions& options) { hedge_options_ = options; }
+    std::vector<ModelLatency> autocomplete_latency() const;
     GenerationResult generate_text_elite(const std::string& prompt); 
-    VisionResult analyze_vision(const std::string& prompt, const std::string& base64_image);
+    // Turns go out in order, so an unchanged leading run hits the provider's implicit prefix cache
+    // `cancel`, when set, aborts the transfer and the retries as soon as it turns true
+    GenerationResult generate_text_elite(const std::vector<ChatTurn>& turns, const std::atomic<bool>* cancel = nullptr);
+    // Same request, streamed: on_chunk gets each piece of the reply as it arrives and may
+    // return false to end generation early. The result still holds the whole text.
+    GenerationResult stream_text_elite(const std::vector<ChatTurn>& turns,
+                                       const std::function<bool(std::string_view)>& on_chunk,
+                                       const std::atomic<bool>* cancel = nullptr);
+    // The image is downscaled and re-encoded by ImagePipeline first; repeats are served from the cache
+    VisionResult analyze_vision(const std::string& prompt, const VisionInput& image);
+    // Another Gemini-compatible endpoint ("http://127.0.0.1:8089/v1beta/models/", e.g. bench/mock_gemini).
+    // Call before serving.
+    void set_base_url(std::string url) {
+        if (!url.empty() && url.back() != '/') url += '/';
+        base_url_ = std::move(url);
+    }
+    void set_image_options(const ImagePipelineOptions& options) { image_pipeline_ = ImagePipeline(options); }
 
 private:
     std::shared_ptr<KeyManager> key_manager_;
     std::shared_ptr<CacheManager> cache_manager_;
-    const std::string base_url_ = "https://generativelanguage.googleapis.com/v1beta/models/";
-    std::string get_endpoint_url(const std::string& action);
+    std::shared_ptr<EmbeddingProvider> provider_;
+    static constexpr int REMOTE_EMBEDDING_DIM = 768;
+    std::string base_url_ = "https://generativelanguage.googleapis.com/v1beta/models/";
+    std::string get_endpoint_url(const std::string& action, int key_slot = -1);
+    std::string get_endpoint_url(const std::string& model, const std::string& action, const std::string& key) const;
+
+    HedgeOptions hedge_options_;
+    ImagePipeline image_pipeline_;
+    mutable std::mutex latency_mutex_;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> autocomplete_latency_;
+    std::chrono::milliseconds hedge_delay(const std::string& model) const;
+    // Every hedged attempt runs on a thread owned here, reaped as later ones start
+    struct HedgeWorker {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::mutex hedge_workers_mutex_;
+    std::vector<HedgeWorker> hedge_workers_;
+    void spawn_hedge_attempt(std::function<void()> attempt);
+
+    // Micro-batcher behind generate_embedding. The caller that opens a batch waits out the
+    // window (or until it is full), then sends it on behalf of everyone who joined.
+    static constexpr std::chrono::milliseconds COALESCE_WINDOW{3};
+    static constexpr size_t MAX_EMBED_BATCH = 100; // batchEmbedContents request limit
+    struct PendingEmbedding {
+        std::string text;
+        std::promise<std::vector<float>> promise;
+    };
+    std::mutex coalesce_mutex_;
+    std::condition_variable batch_full_;
+    std::vector<PendingEmbedding> pending_;
+    std::unordered_map<std::string, std::shared_future<std::vector<float>>> in_flight_;
+    void flush_embeddings(std::vector<PendingEmbedding>& batch);
+    void record_autocomplete_latency(const std::string& model, double ms);
 };
 
 class HyDEGenerator {
@@ -1,9 +1,21 @@
 #pragma once
 
 #include "code_graph.hpp"
+#include "node_store.hpp"
+#include "node_arena.hpp"
+#include "CsrGraph.hpp"
+#include "graph_centrality.hpp"
+#include "lexical_index.hpp"
 #include <string>
 #include <vector>
 #include <memory> // Required for std::unique_ptr
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <span>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
 #include <faiss/utils/distances.h>
 
 // Forward declare FAISS Index
@@ -16,28 +28,256 @@ struct FaissSearchResult {
     float faiss_score;
 };
 
+// 🚀 One FAISS call for nq queries. Row-major nq x k; label -1 marks an empty slot.
+struct FaissBatchResult {
+    size_t nq = 0;
+    int k = 0;
+    std::vector<int64_t> labels;
+    std::vector<float> scores;
+
+    std::span<const int64_t> labels_of(size_t q) const { return {labels.data() + q * k, static_cast<size_t>(k)}; }
+    std::span<const float> scores_of(size_t q) const { return {scores.data() + q * k, static_cast<size_t>(k)}; }
+};
+
+// 🗜️ INDEX BACKENDS
+// Flat/HNSW keep full float32 codes. HNSW_SQ8 (~4x smaller) and IVF_PQ (~16-48x)
+// quantize them; results are then re-scored against the exact vectors in nodes.bin.
+enum class IndexKind { Flat, HNSW, HNSW_SQ8, IVF_PQ };
+
+struct IndexConfig {
+    IndexKind kind = IndexKind::HNSW;
+
+    // HNSW family
+    int hnsw_m = 32;
+    int ef_construction = 128;
+    int ef_search = 64;
+
+    // IVF-PQ
+    int ivf_nlist = 1024;
+    int pq_m = 64;        // Sub-quantizers; must divide the dimension
+    int pq_nbits = 8;
+    int nprobe = 16;
+
+    // Quantized kinds need training; below this many vectors the store runs on
+    // plain HNSW and switches over on the next rebuild.
+    size_t train_min = 50000;
+
+    // Re-rank pool = k * rerank_factor. 1 disables re-ranking.
+    int rerank_factor = 4;
+
+    // How nodes.bin keeps the exact vectors used for re-ranking and rebuilds:
+    // f16 halves them at no practical recall cost, int8 (per-vector scale) quarters them
+    VectorPrecision embedding_precision = VectorPrecision::F16;
+
+    bool quantized() const { return kind == IndexKind::HNSW_SQ8 || kind == IndexKind::IVF_PQ; }
+
+    // Reads {"vector_index": {"type": "hnsw_sq8", ...}} from a project config
+    static IndexConfig from_json(const nlohmann::json& j);
+    // <root>/.study_assistant/config.json, falling back to <root>/config.json
+    static IndexConfig load_for_project(const std::string& root_path);
+};
+
+// 🎛️ Per-request overrides; 0 keeps the IndexConfig value
+struct SearchOptions {
+    int k = 0;             // Seeds to fetch (callers substitute their default)
+    int ef_search = 0;     // HNSW family
+    int nprobe = 0;        // IVF family
+    int rerank_factor = 0; // Quantized backends
+};
+
+// 📸 CONCURRENCY: searches never take a lock. Readers load the published Snapshot (one
+// atomic shared_ptr) and work on it to the end; it is immutable, so ingest running
+// alongside can neither block nor tear it. Writers serialize on a mutex, copy the
+// metadata maps, and publish a successor.
+//
+// 🪵 SEGMENTS (LSM): each upsert batch becomes a small exact (flat) segment of the
+// memtable, so ingest costs O(batch) whatever the index size. A background merger seals
+// the memtable into a graph segment once it holds MEMTABLE_SEAL_VECTORS, merges the two
+// smallest adjacent sealed segments while there are more than MAX_SEALED_SEGMENTS, and
+// folds everything into one segment when tombstones pile up. Sealed segments never
+// change, so a save writes only the ones it has not written before.
 class FaissVectorStore {
 public:
-    explicit FaissVectorStore(int dimension);
+    explicit FaissVectorStore(int dimension, IndexConfig config = {});
     ~FaissVectorStore(); // Destructor must be defined in .cpp
 
-    void add_nodes(const std::vector<std::shared_ptr<CodeNode>>& nodes);
-    std::vector<FaissSearchResult> search(const std::vector<float>& query_vector, int k);
-    
+    // Inserts or replaces nodes by CodeNode::id. Replaced vectors become tombstones.
+    void upsert_nodes(const std::vector<std::shared_ptr<CodeNode>>& nodes);
+    // Tombstones every node whose file_path matches. Returns the number removed.
+    size_t remove_by_file(const std::string& file_path);
+    // Both of the above in one publish: readers (and cached results) see the files' old
+    // nodes or their new ones, never neither. Returns the number removed.
+    size_t replace_file_nodes(const std::vector<std::string>& file_paths,
+                              const std::vector<std::shared_ptr<CodeNode>>& nodes);
+    void add_nodes(const std::vector<std::shared_ptr<CodeNode>>& nodes) { upsert_nodes(nodes); }
+
+    std::vector<FaissSearchResult> search(const std::vector<float>& query_vector, int k, const SearchOptions& opts = {});
+    // Queries are nq contiguous vectors of dimension(); renormalized together before a single search
+    FaissBatchResult search_batch(const float* queries, size_t nq, int k, const SearchOptions& opts = {}) const;
+    // Same, reusing `out`'s capacity (no allocations once warm)
+    void search_batch_into(const float* queries, size_t nq, int k, const SearchOptions& opts, FaissBatchResult& out) const;
+
+    // segments.json lists the sealed segments (seg-<id>.index, written once each);
+    // delta.index holds the memtable, nodes.bin the live nodes. Throws when a file cannot
+    // be written, before the manifest moves: the previous save stays loadable.
     void save(const std::string& path) const;
     void load(const std::string& path);
+    // Whether `path` holds a saved store (either layout)
+    static bool exists(const std::string& path);
 
-    const std::vector<std::shared_ptr<CodeNode>>& get_all_nodes() const;
+    // 🧹 Folds every segment into one graph of live vectors only. Runs in the background
+    // once tombstones exceed `compaction_threshold` of the index.
+    void compact();
+    void set_compaction_threshold(double ratio) { compaction_threshold_ = ratio; }
+    double tombstone_ratio() const;
+
+    // ⚠️ Materializes every node. Prefer size()/get_node_by_name on hot paths.
+    std::vector<std::shared_ptr<CodeNode>> get_all_nodes() const;
     std::shared_ptr<CodeNode> get_node_by_name(const std::string& name) const;
+    // Resolves a label from FaissBatchResult (materializes lazily-loaded rows)
+    std::shared_ptr<CodeNode> get_node(int64_t label) const;
+    // The stored (exact, not index-quantized) vectors of `labels` as rows of `out`, which
+    // is resized to n * dimension. Rows of labels without one are zero. Returns the hits.
+    size_t exact_vectors(const int64_t* labels, size_t n, std::vector<float>& out) const;
+    size_t size() const;
+    int dimension() const { return dimension_; }
+    // Bumped by every published change; equal versions saw identical contents
+    uint64_t version() const { return current()->version; }
+
+    // 🕸️ Dependency edges resolved to dense ids. Rebuilt lazily after any mutation;
+    // the returned snapshot stays valid (and unchanged) for as long as it is held.
+    std::shared_ptr<const CsrGraph> adjacency() const;
+    // 📈 Scores every live node's PageRank / in-degree / betweenness over adjacency() and
+    // folds them into its structural weight. Persisted by the next save(); run after sync.
+    void refresh_centrality(const CentralityOptions& opts = {});
+    // 🔤 Name/content index over the live nodes: built by load(), then kept current by
+    // upserts, so no query pays for it. Removed nodes are filtered with contains().
+    std::shared_ptr<const LexicalIndex> lexical() const;
+    bool contains(int64_t label) const { return current()->is_live(label); }
+    const IndexConfig& config() const { return config_; }
+
+    // Stable 64-bit FAISS label for a CodeNode::id (FNV-1a, sign bit cleared)
+    static int64_t stable_id(std::string_view node_id) {
+        return static_cast<int64_t>(NodeStore::hash_id(node_id) & LABEL_MASK);
+    }
 
 private:
+    static constexpr uint64_t LABEL_MASK = 0x7FFFFFFFFFFFFFFFULL;
+    static constexpr size_t MAX_DELTA_SEGMENTS = 8;       // Beyond this the memtable batches are merged into one
+    static constexpr size_t MEMTABLE_SEAL_VECTORS = 4096; // Memtable size that gets it sealed into a graph
+    static constexpr size_t MAX_SEALED_SEGMENTS = 6;      // Beyond this the smallest neighbours are merged
+
+    // Overlay node: a record in the arena of the upsert batch that wrote it. Batch arenas
+    // are never modified after publication and live while any snapshot points into them.
+    struct OverlayRef {
+        std::shared_ptr<const NodeArena> arena;
+        NodeArena::Index idx = 0;
+    };
+    using OverlayMap = std::unordered_map<int64_t, OverlayRef>;
+    using LabelSet = std::unordered_set<int64_t>;
+
+    // The mmap'd node segment and its materialized rows, shared by every snapshot since load()
+    struct Rows {
+        std::shared_ptr<NodeStore> store;
+        mutable std::mutex mutex;
+        mutable std::vector<std::shared_ptr<CodeNode>> cache;
+        std::shared_ptr<CodeNode> materialize(size_t row) const;
+    };
+
+    // An immutable IDMap2 index over some vectors; replaced only by a merge
+    struct Segment {
+        uint64_t id = 0;                   // seg-<id>.index; unique within the store's directory
+        std::shared_ptr<const faiss::Index> index;
+        IndexKind kind = IndexKind::HNSW;  // May lag config_ until enough vectors exist to train
+    };
+
+    struct Snapshot {
+        uint64_t version = 0;
+        std::vector<Segment> sealed;                             // Oldest first
+        std::vector<std::shared_ptr<const faiss::Index>> deltas; // Memtable: IDMap2 over flat, one per batch
+        std::shared_ptr<const Rows> rows;                        // Null until a segment is loaded
+        std::shared_ptr<const OverlayMap> overlay;               // Upserts since load()
+        std::shared_ptr<const LabelSet> tombstones;              // Labels that must never be returned
+        std::shared_ptr<const std::unordered_map<int64_t, float>> centrality; // Last refresh; null = as in nodes.bin
+        size_t live_count = 0;
+        size_t live_vectors = 0;  // Live labels with an index entry: each has exactly one current entry
+        size_t stale_vectors = 0; // Index entries not backing a live node: total_vectors() - live_vectors
+
+        int64_t sealed_vectors() const;
+        int64_t delta_vectors() const;
+        int64_t total_vectors() const { return sealed_vectors() + delta_vectors(); }
+        bool quantized() const;
+        const Segment* largest() const;
+        long segment_row(int64_t label) const;
+        bool is_live(int64_t label) const;
+        bool indexed(int64_t label) const; // Some segment or memtable batch holds an entry for it
+        std::shared_ptr<CodeNode> lookup(int64_t label) const;
+        // Centrality score of a live node (`row` is its segment row, or -1); 0 if never computed
+        float centrality_of(int64_t label, long row) const;
+        // Exact (unnormalized) vector for re-ranking, or nullptr if none is kept
+        // `scratch` (dimension floats) receives rows stored as f16 / int8
+        const float* exact_vector(int64_t label, float* scratch) const;
+    };
+
+    std::shared_ptr<const Snapshot> current() const { return snapshot_.load(std::memory_order_acquire); }
+    // Caller holds write_mutex_. Recounts stale vectors: every live node has exactly one
+    // current vector, so whatever else the segments hold is stale.
+    void publish(std::shared_ptr<Snapshot> next);
+
+    // config_.kind when `n_train` vectors suffice to train it, else HNSW
+    IndexKind target_kind(size_t n_train) const;
+    std::unique_ptr<faiss::Index> make_index(size_t n_train, IndexKind& kind_out) const;
+    void apply_search_params(faiss::Index* index) const;
+    std::unique_ptr<faiss::Index> make_delta(size_t n, const float* vectors, const int64_t* labels) const;
+    // The current vector of every live label held by `inputs` (oldest first), normalized
+    void gather(const Snapshot& snap, const std::vector<const faiss::Index*>& inputs,
+                std::vector<int64_t>& labels, std::vector<float>& vectors) const;
+    std::shared_ptr<const faiss::Index> merge_deltas(const Snapshot& snap,
+                                                     const std::vector<std::shared_ptr<const faiss::Index>>& deltas) const;
+    void rerank(const Snapshot& snap, const float* query, int64_t label_count, int64_t* labels, float* scores) const;
+    bool needs_rebuild(const Snapshot& snap) const;
+    void build_file_index(const Snapshot& snap); // Caller holds write_mutex_
+    std::shared_ptr<LexicalIndex> build_lexical(const Snapshot& snap) const;
+    void maybe_schedule_compaction();
+
+    // 🔧 Merger (serialized by fold_mutex_). Each builds off a snapshot with no lock held;
+    // only the swap in replace_segments() waits for writers.
+    bool merge_step(); // One due merge; false when none is
+    void rebuild_index();
+    void seal_memtable(const Snapshot& snap);
+    void merge_smallest(const Snapshot& snap);
+    // Snapshot to merge the memtable of; marks its batches as taken
+    std::shared_ptr<const Snapshot> capture_memtable();
+    void replace_segments(const std::vector<uint64_t>& sealed_ids,
+                          const std::vector<std::shared_ptr<const faiss::Index>>& deltas, Segment merged);
+    Segment build_segment(std::vector<int64_t>& labels, std::vector<float>& vectors);
+    void load_segments(const std::string& path);
+    void load_legacy_json(const std::string& path, std::unique_ptr<faiss::Index> positional);
+
     int dimension_;
-    // CHANGED: From faiss::Index* to std::unique_ptr
-    std::unique_ptr<faiss::Index> index_; 
-    
-    std::vector<std::shared_ptr<CodeNode>> nodes_list_;
-    std::unordered_map<long, std::shared_ptr<CodeNode>> id_to_node_map_;
-    std::unordered_map<std::string, long> name_to_id_map_;
+    IndexConfig config_;
+
+    std::atomic<std::shared_ptr<const Snapshot>> snapshot_;
+
+    mutable std::mutex write_mutex_; // Serializes writers; readers never touch it
+    std::mutex fold_mutex_;          // One graph rebuild at a time
+    mutable std::mutex save_mutex_;  // One save at a time
+    std::unordered_map<std::string, std::vector<int64_t>> file_index_; // Built on first remove_by_file
+    bool file_index_ready_ = false;
+    std::vector<std::shared_ptr<const faiss::Index>> merging_deltas_; // Memtable batches a merge has captured
+    std::atomic<uint64_t> next_segment_id_{0};
+    mutable std::unordered_set<uint64_t> saved_segments_; // Sealed segments already in saved_path_
+    mutable std::string saved_path_;
+
+    std::atomic<std::shared_ptr<LexicalIndex>> lexical_; // Swapped by load(), appended to by upserts, compacted by the merger
+
+    mutable std::mutex graph_mutex_;
+    mutable std::shared_ptr<const CsrGraph> graph_;
+    mutable uint64_t graph_version_ = ~0ULL;
+
+    double compaction_threshold_ = 0.25;
+    std::atomic<bool> compacting_{false};
+    std::thread compaction_thread_;
 };
 
-} // namespace code_assistance
\ No newline at end of file
+} // namespace code_assistance
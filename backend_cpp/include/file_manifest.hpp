@@ -0,0 +1,99 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "node_store.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace code_assistance {
+
+// 🧾 BINARY SYNC MANIFEST (data/<project>/manifest.bin)
+// Replaces manifest.json. Per indexed file: size + mtime (cheap change probe),
+// XXH64 of the content (authoritative), and the ids of the nodes it produced.
+// Layout: [Header][FileEntry x N][StrRef x I (node ids)][uint32 hash slots x H][string heap]
+namespace manifest_format {
+
+constexpr char MAGIC[8] = {'S', 'Y', 'N', 'M', 'A', 'N', 'I', 'F'};
+constexpr uint32_t VERSION = 1;
+
+using node_store_format::StrRef;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t entry_count;
+    uint64_t entries_offset;
+    uint64_t id_count;
+    uint64_t ids_offset;
+    uint64_t hash_capacity;   // Power of two; slot value = entry + 1, 0 = empty
+    uint64_t hash_offset;
+    uint64_t heap_offset;
+    uint64_t heap_size;
+};
+
+struct FileEntry {
+    StrRef path;          // Relative, '/'-separated
+    uint64_t size;
+    int64_t mtime;        // file_time_type ticks
+    uint64_t content_hash; // 0 = unknown (migrated from manifest.json)
+    uint32_t id_begin;
+    uint32_t id_count;
+};
+
+static_assert(sizeof(Header) % 8 == 0, "Header must keep entries 8-byte aligned");
+static_assert(sizeof(FileEntry) == 48, "FileEntry must stay fixed-width");
+
+} // namespace manifest_format
+
+// Read-only view over manifest.bin
+class FileManifest {
+public:
+    bool open(const std::string& path);
+    void close() { header_ = nullptr; file_.close(); } // Before renaming a new manifest over this one
+    bool is_open() const { return header_ != nullptr; }
+
+    size_t size() const { return header_ ? header_->entry_count : 0; }
+
+    // O(1) expected. Returns -1 if the path is not in the manifest.
+    long find(std::string_view rel_path) const;
+
+    std::string_view path(size_t i) const { return str(entries_[i].path); }
+    uint64_t file_size(size_t i) const { return entries_[i].size; }
+    int64_t mtime(size_t i) const { return entries_[i].mtime; }
+    uint64_t content_hash(size_t i) const { return entries_[i].content_hash; }
+    uint32_t node_count(size_t i) const { return entries_[i].id_count; }
+    std::string_view node_id(size_t i, uint32_t j) const;
+
+private:
+    std::string_view str(const node_store_format::StrRef& ref) const;
+
+    MappedFile file_;
+    const manifest_format::Header* header_ = nullptr;
+    const manifest_format::FileEntry* entries_ = nullptr;
+    const node_store_format::StrRef* ids_ = nullptr;
+    const uint32_t* slots_ = nullptr;
+    const char* heap_ = nullptr;
+};
+
+class FileManifestWriter {
+public:
+    void add(std::string_view rel_path, uint64_t size, int64_t mtime, uint64_t content_hash,
+             const std::vector<std::string_view>& node_ids);
+
+    // "<path>.tmp" + rename, like NodeStoreWriter
+    bool write(const std::string& path) const;
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    node_store_format::StrRef intern(std::string_view s);
+
+    std::vector<manifest_format::FileEntry> entries_;
+    std::vector<node_store_format::StrRef> ids_;
+    std::string heap_;
+};
+
+} // namespace code_assistance
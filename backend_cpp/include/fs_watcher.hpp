@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "sync_service.hpp"
+
+namespace code_assistance {
+
+namespace fs = std::filesystem;
+
+struct FileWatcherStats {
+    size_t projects = 0;
+    uint64_t events = 0;    // Raw OS notifications
+    uint64_t changes = 0;   // Paths handed to on_change after filtering
+    uint64_t overflows = 0; // Times the OS dropped events and a rescan was requested
+};
+
+// 👁️ Subscribes to OS change notifications for each watched project root:
+// inotify on Linux (one watch per non-ignored directory, added as directories appear),
+// ReadDirectoryChangesW on Windows and FSEvents on macOS (both recursive natively).
+// Every path goes through the project's compiled ignore rules and extension filter;
+// survivors are reported relative to the root, from the watcher's own thread. When the
+// OS drops events, on_overflow asks the owner to rescan that project instead.
+class FileWatcher {
+public:
+    using ChangeFn = std::function<void(const std::string& project_id, const std::string& rel_path)>;
+    using OverflowFn = std::function<void(const std::string& project_id)>;
+
+    FileWatcher(ChangeFn on_change, OverflowFn on_overflow);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    static bool supported();
+
+    // Replaces any existing watch for the project. `skip_dir` (the index storage) is never reported.
+    bool watch(const std::string& project_id, const fs::path& root, FilterConfig filter, const fs::path& skip_dir);
+    void unwatch(const std::string& project_id);
+    bool is_watching(const std::string& project_id) const;
+
+    FileWatcherStats stats() const;
+
+private:
+    struct Watch; // Per-platform backend, one per project
+
+    ChangeFn on_change_;
+    OverflowFn on_overflow_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<Watch>> watches_;
+
+    std::atomic<uint64_t> events_{0};
+    std::atomic<uint64_t> changes_{0};
+    std::atomic<uint64_t> overflows_{0};
+};
+
+} // namespace code_assistance
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "CsrGraph.hpp"
+
+namespace code_assistance {
+
+struct CentralityOptions {
+    float damping = 0.85f;
+    int max_iterations = 40;
+    double tolerance = 1e-6;           // L1 change of the PageRank vector that ends iteration
+    size_t betweenness_samples = 64;   // Brandes sources; all nodes when the graph is smaller
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+    // Mix of the normalized metrics into one centrality in (0, 1]
+    float pagerank_weight = 0.5f;
+    float in_degree_weight = 0.3f;
+    float betweenness_weight = 0.2f;
+};
+
+// 📈 Per dense id of the graph it was computed on. Edges point from a node to what it
+// depends on, so a hub is a node many others import or call.
+struct Centrality {
+    std::vector<float> pagerank;    // Sums to 1
+    std::vector<uint32_t> in_degree;
+    std::vector<float> betweenness; // Sampled estimate, scaled to the full source set
+    std::vector<float> score;       // Combined, in (0, 1]; 0 is reserved for "not computed"
+};
+
+// Offline graph analytics over the CSR adjacency, parallel over nodes (PageRank) and
+// sources (betweenness) with OpenMP. Meant to run once per sync, not per query.
+Centrality compute_centrality(const CsrGraph& graph, const CentralityOptions& opts = {});
+
+// Structural weight of a node from its parser prior (node kind) and its centrality
+// score; a score of 0 means none was computed and leaves the prior as is
+inline float blend_structural(float prior, float centrality) {
+    return centrality > 0.0f ? 0.5f * prior + 0.5f * centrality : prior;
+}
+
+} // namespace code_assistance
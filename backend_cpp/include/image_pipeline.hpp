@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace code_assistance {
+
+struct ImagePipelineOptions {
+    int max_edge = 1568;                 // Longest side the vision model resolves; larger is downscaled
+    int jpeg_quality = 82;
+    size_t passthrough_bytes = 512 * 1024; // An image within max_edge and this size is sent as is
+    size_t max_input_bytes = 32 * 1024 * 1024;
+};
+
+// Region of the source image, in its pixels
+struct CropRect {
+    int x = 0, y = 0, width = 0, height = 0;
+};
+
+struct VisionInput {
+    std::string_view data;        // Base64 (optionally a data: URL) or, with encoded = false, the file's bytes
+    bool encoded = true;
+    std::optional<CropRect> crop;
+};
+
+struct PreparedImage {
+    std::string mime_type;
+    std::string base64;             // Exactly what goes in the request
+    uint64_t content_hash = 0;      // Of the input as given, so a cache lookup needs no decode
+    int width = 0, height = 0;      // Of the image sent; 0 when passed through without decoding
+    size_t input_bytes = 0;         // Decoded size of the input
+    bool transcoded = false;
+};
+
+// 🖼️ Vision input preparation: the image is decoded once, cropped, downscaled to the
+// model's resolution and re-encoded as JPEG, then base64-encoded once into the buffer the
+// request body is built around. An image already small enough is passed through with no
+// decode or re-encode (its header alone is read for the dimensions). Built without the
+// image codecs (CODE_ASSIST_HAVE_STB), every image is passed through.
+class ImagePipeline {
+public:
+    explicit ImagePipeline(ImagePipelineOptions options = {}) : options_(options) {}
+
+    bool prepare(const VisionInput& input, PreparedImage& out, std::string& error) const;
+
+    // Key of an input for result caches: the payload as given, plus the crop
+    static uint64_t content_hash(const VisionInput& input);
+
+    static bool codecs_available();
+
+    // Whitespace is skipped; false on any other non-alphabet character
+    static bool decode_base64(std::string_view in, std::string& out);
+    static void encode_base64(std::string_view in, std::string& out);
+
+    const ImagePipelineOptions& options() const { return options_; }
+
+private:
+    bool transcode(std::string_view bytes, const std::optional<CropRect>& crop, PreparedImage& out,
+                   std::string& error) const;
+
+    ImagePipelineOptions options_;
+};
+
+} // namespace code_assistance
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace code_assistance {
+
+struct LexicalHit {
+    int64_t label;
+    float score;
+    bool exact; // The query is the node's name or id
+};
+
+// 🔤 IN-MEMORY LEXICAL INDEX
+// BM25 over identifier-aware tokens of each node's name (weighted up), file name and
+// content, plus trigram postings over names for substring lookups and an exact-name
+// table. Answers "where is parse_file" without an embedding round trip.
+//
+// Documents are keyed by FAISS label; re-adding a label supersedes its old postings,
+// which are skipped at query time (the `live` callback filters removed nodes too) and no
+// longer count towards document frequencies. compact() drops them; the store's merger
+// runs it once needs_compaction(). Adds take a writer lock; queries share it and are
+// sub-millisecond on typical repos.
+class LexicalIndex {
+public:
+    using LiveFn = std::function<bool(int64_t)>;
+
+    void add(int64_t label, std::string_view id, std::string_view name, std::string_view file_path, std::string_view content);
+
+    // Best `k` documents for the query, exact name/id matches first
+    std::vector<LexicalHit> search(std::string_view query, size_t k, const LiveFn& live) const;
+
+    // One identifier-ish token ("parse_file", "FaissVectorStore::search", "retrieve()"):
+    // worth answering lexically before paying for an embedding
+    static bool identifier_shaped(std::string_view query);
+
+    // Lowercased words of `text`; compound identifiers yield the whole and its parts
+    // ("getUserName" -> getusername, get, user, name)
+    static void tokenize(std::string_view text, std::vector<std::string>& out);
+
+    size_t size() const;
+    size_t superseded() const; // Documents compact() would drop
+
+    // Superseded documents past COMPACT_FRACTION of the live ones (and COMPACT_MIN)
+    bool needs_compaction() const;
+    // Drops superseded documents and their postings; doc ids are renumbered in order
+    void compact();
+
+private:
+    static constexpr float NAME_WEIGHT = 3.0f;      // A name token counts as this many content tokens
+    static constexpr float EXACT_BONUS = 10.0f;     // Keeps exact matches above any BM25 score
+    static constexpr float SUBSTRING_BONUS = 2.0f;
+    static constexpr float BM25_K1 = 1.2f;
+    static constexpr float BM25_B = 0.75f;
+    static constexpr float COMPACT_FRACTION = 0.25f;
+    static constexpr size_t COMPACT_MIN = 256;
+
+    struct Posting {
+        uint32_t doc;
+        float tf;
+    };
+    struct Term {
+        std::vector<Posting> postings; // Ascending doc ids, superseded ones included
+        uint32_t live_df = 0;          // Postings of current documents: what idf is taken from
+    };
+    struct Doc {
+        int64_t label;
+        float length;              // Weighted token count
+        std::string name;          // Lowercased, for substring verification
+        std::vector<Term*> terms;  // Cleared once superseded; map nodes never move
+    };
+
+    bool current(uint32_t doc) const;
+    static uint32_t trigram(const char* p) {
+        return (uint32_t(uint8_t(p[0])) << 16) | (uint32_t(uint8_t(p[1])) << 8) | uint8_t(p[2]);
+    }
+
+    mutable std::shared_mutex mutex_;
+    std::vector<Doc> docs_;
+    std::unordered_map<int64_t, uint32_t> current_;                   // label -> newest doc
+    std::unordered_map<std::string, Term> postings_;                  // term -> docs
+    std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams_;    // name trigram -> docs, ascending
+    std::unordered_map<std::string, std::vector<uint32_t>> exact_;    // lowercased name / id -> docs
+    double total_length_ = 0;
+    size_t superseded_ = 0;
+};
+
+} // namespace code_assistance
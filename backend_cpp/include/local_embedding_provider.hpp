@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "embedding_provider.hpp"
+
+namespace code_assistance {
+
+struct LocalEmbeddingOptions {
+    std::string model_dir;   // model.onnx + vocab.txt of a BERT-family encoder export
+    int threads = 0;         // Intra-op threads per inference; 0 lets ONNX Runtime pick
+    size_t max_tokens = 512; // Longer texts are truncated
+    size_t batch_size = 32;  // Texts per inference, grouped by length to keep padding low
+    bool lowercase = true;   // Uncased vocabularies (bge, MiniLM, e5)
+};
+
+// 🖥️ LOCAL EMBEDDINGS
+// Runs a small encoder on the CPU through ONNX Runtime, whose kernels pick AVX2, AVX-512
+// or NEON at runtime. Texts are WordPiece-tokenized against vocab.txt, the last hidden
+// state is mean-pooled over the attention mask (models exporting a pooled
+// [batch, dim] output are used as is) and L2-normalized. The dimension is read from the
+// model. Indexing then costs CPU instead of API quota and works offline.
+//
+// Needs a build with CODE_ASSIST_LOCAL_EMBEDDINGS=ON; otherwise the constructor throws.
+class LocalEmbeddingProvider : public EmbeddingProvider {
+public:
+    explicit LocalEmbeddingProvider(LocalEmbeddingOptions options);
+    ~LocalEmbeddingProvider() override;
+
+    const std::string& model() const override { return model_; }
+    int dimension() const override { return dimension_; }
+    std::vector<std::vector<float>> embed(const std::vector<std::string>& texts) override;
+    size_t concurrency() const override;
+
+private:
+    struct Runtime; // ONNX Runtime session and tokenizer, out of the header
+    std::unique_ptr<Runtime> runtime_;
+    LocalEmbeddingOptions options_;
+    std::string model_;
+    int dimension_ = 0;
+};
+
+} // namespace code_assistance
@@ -1,10 +1,13 @@
 // backend_cpp/include/memory/MemoryVault.hpp
 #pragma once
+#include <cmath>
+#include <cstdio>
 #include <string>
+#include <thread>
 #include <vector>
-#include <mutex>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
+#include "BoundedQueue.hpp"
 #include "faiss_vector_store.hpp" // Reuse our wrapper
 
 namespace code_assistance {
@@ -17,56 +20,194 @@ struct Experience {
     std::vector<float> embedding;
 };
 
+// 🧠 Experience Vault: past fixes, recalled by similarity to the current mission.
+// It is a vector store of its own (flat index: experiences are few and dedup wants exact
+// scores) persisted at `storage_path` through the segment layout, so it survives restarts.
+// add_experience() only queues; a writer thread inserts in batches, folds near-duplicates
+// (cosine >= dedup_threshold against the vault or the same batch) into the entry they repeat,
+// and saves incrementally after each batch. Recalls search the store's current snapshot and
+// never wait on a write.
 class MemoryVault {
 public:
-    MemoryVault(const std::string& storage_path) : path_(storage_path) {
-        // Initialize distinct index for experiences
-        store_ = std::make_unique<FaissVectorStore>(768); 
+    static constexpr size_t MAX_BATCH = 64;
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+
+    // `dimension` is the embedding service's (EmbeddingService::embedding_dimension)
+    MemoryVault(const std::string& storage_path, int dimension = 768, float dedup_threshold = 0.95f)
+        : path_(storage_path), dedup_threshold_(dedup_threshold), queue_(QUEUE_CAPACITY) {
+        IndexConfig config;
+        config.kind = IndexKind::Flat;
+        store_ = std::make_unique<FaissVectorStore>(dimension, config);
         load();
+        writer_ = std::thread(&MemoryVault::write_loop, this);
+    }
+
+    ~MemoryVault() {
+        queue_.close(); // The writer drains what is queued, saves and exits
+        if (writer_.joinable()) writer_.join();
     }
 
-    void add_experience(const std::string& prompt, const std::string& solution, 
+    MemoryVault(const MemoryVault&) = delete;
+    MemoryVault& operator=(const MemoryVault&) = delete;
+
+    void add_experience(const std::string& prompt, const std::string& solution,
                         const std::vector<float>& embedding, bool success) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        
-        auto exp = std::make_shared<CodeNode>(); // Reusing CodeNode structure for simplicity
-        exp->id = "EXP_" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
-        exp->content = solution; // Store solution in content
-        exp->docstring = prompt; // Store prompt in docstring
-        exp->embedding = embedding;
-        exp->weights["outcome"] = success ? 1.0 : -1.0;
-
-        store_->add_nodes({exp});
-        spdlog::info("🧠 Experience Vault: Learned new {} pattern.", success ? "positive" : "negative");
+        if ((int)embedding.size() != store_->dimension()) return;
+        Experience exp;
+        exp.id = experience_id(prompt, solution);
+        exp.prompt = prompt;
+        exp.solution = solution;
+        exp.outcome_score = success ? 1.0 : -1.0;
+        exp.embedding = embedding;
+        queue_.push(std::move(exp)); // Blocks only if the writer is QUEUE_CAPACITY behind
     }
 
+    // The store is safe for concurrent use: recalls never wait on a learning write
     std::vector<std::string> recall_relevant(const std::vector<float>& query_vec) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        auto results = store_->search(query_vec, 3); // Top 3 relevant memories
-        
+        if ((int)query_vec.size() != store_->dimension() || store_->size() == 0) return {};
+        thread_local FaissBatchResult batch; // Reused capacity across agent steps
+        store_->search_batch_into(query_vec.data(), 1, 3, {}, batch); // Top 3 relevant memories
+
         std::vector<std::string> insights;
-        for (const auto& res : results) {
-            double outcome = res.node->weights.count("outcome") ? res.node->weights["outcome"] : 0.0;
+        for (int64_t label : batch.labels_of(0)) {
+            auto node = label == -1 ? nullptr : store_->get_node(label);
+            if (!node) continue;
+            auto it = node->weights.find("outcome");
+            double outcome = it != node->weights.end() ? it->second : 0.0;
             std::string type = (outcome > 0) ? "SUCCESSFUL STRATEGY" : "FAILED ATTEMPT";
-            
-            insights.push_back("[" + type + "] Context: " + res.node->docstring + "\nResult: " + res.node->content);
+
+            insights.push_back("[" + type + "] Context: " + node->docstring + "\nResult: " + node->content);
         }
         return insights;
     }
 
+    // Writes are persisted by the writer after every batch; this covers the rest
     void save() {
-        // In a real implementation, we'd serialize to disk here
-        // store_->save(path_);
+        try {
+            store_->save(path_);
+        } catch (const std::exception& e) {
+            spdlog::error("🧠 Experience Vault: save to {} failed: {}", path_, e.what());
+        }
     }
 
+    size_t size() const { return store_->size(); }
+    size_t pending() const { return queue_.size(); }
+
 private:
     void load() {
-        // store_->load(path_);
+        if (!FaissVectorStore::exists(path_)) return;
+        try {
+            store_->load(path_);
+            spdlog::info("🧠 Experience Vault: {} experiences restored from {}", store_->size(), path_);
+        } catch (const std::exception& e) {
+            // Another embedding model's vectors, or a torn directory: start empty, keep the files
+            spdlog::warn("🧠 Experience Vault: cannot load {} ({}); starting empty", path_, e.what());
+        }
+    }
+
+    // Same prompt and solution, same entry: an exact repeat replaces instead of accumulating
+    static std::string experience_id(const std::string& prompt, const std::string& solution) {
+        std::string key;
+        key.reserve(prompt.size() + solution.size() + 1);
+        key.append(prompt).append(1, '\0').append(solution);
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(NodeStore::hash_id(key)));
+        return std::string("EXP_") + hex;
+    }
+
+    void write_loop() {
+        std::vector<Experience> batch;
+        while (auto first = queue_.pop()) {
+            batch.clear();
+            batch.push_back(std::move(*first));
+            while (batch.size() < MAX_BATCH) {
+                auto next = queue_.try_pop();
+                if (!next) break;
+                batch.push_back(std::move(*next));
+            }
+            write_batch(batch);
+            save();
+        }
+    }
+
+    void write_batch(std::vector<Experience>& batch) {
+        const size_t dim = static_cast<size_t>(store_->dimension());
+        std::vector<float> queries(batch.size() * dim);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            normalize_into(batch[i].embedding, queries.data() + i * dim);
+        }
+
+        // Nearest stored experience of each, in one search
+        FaissBatchResult nearest;
+        if (store_->size() > 0) store_->search_batch_into(queries.data(), batch.size(), 1, {}, nearest);
+
+        std::vector<std::shared_ptr<CodeNode>> nodes;
+        nodes.reserve(batch.size());
+        size_t folded = 0;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            Experience& exp = batch[i];
+            std::shared_ptr<const CodeNode> twin;
+            if (nearest.nq > 0 && nearest.labels_of(i)[0] != -1 && nearest.scores_of(i)[0] >= dedup_threshold_) {
+                twin = store_->get_node(nearest.labels_of(i)[0]);
+            }
+
+            // A repeat inside this batch folds into the earlier one
+            const float* v = queries.data() + i * dim;
+            bool folded_in_batch = false;
+            for (size_t j = 0; j < i && !folded_in_batch; ++j) {
+                if (nodes[j] && dot(v, queries.data() + j * dim, dim) >= dedup_threshold_) {
+                    nodes[j]->content = std::move(exp.solution); // Latest outcome wins
+                    nodes[j]->docstring = std::move(exp.prompt);
+                    nodes[j]->weights["outcome"] = exp.outcome_score;
+                    nodes[j]->weights["seen"] += 1.0;
+                    folded_in_batch = true;
+                }
+            }
+            nodes.push_back(nullptr);
+            if (folded_in_batch) {
+                folded++;
+                continue;
+            }
+
+            auto node = std::make_shared<CodeNode>(); // Reusing CodeNode structure for simplicity
+            node->id = twin ? twin->id : exp.id;       // A near-duplicate replaces the entry it repeats
+            node->type = "experience";
+            node->content = std::move(exp.solution);   // Store solution in content
+            node->docstring = std::move(exp.prompt);   // Store prompt in docstring
+            node->embedding = std::move(exp.embedding);
+            node->weights["outcome"] = exp.outcome_score;
+            node->weights["seen"] = 1.0;
+            if (twin) {
+                auto seen = twin->weights.find("seen");
+                node->weights["seen"] += seen != twin->weights.end() ? seen->second : 1.0;
+                folded++;
+            }
+            nodes.back() = std::move(node);
+        }
+        std::erase(nodes, nullptr);
+
+        store_->upsert_nodes(nodes);
+        spdlog::info("🧠 Experience Vault: learned {} experience(s), {} folded into earlier ones", nodes.size(), folded);
+    }
+
+    static void normalize_into(const std::vector<float>& v, float* out) {
+        double norm = 0.0;
+        for (float x : v) norm += static_cast<double>(x) * x;
+        float scale = norm > 0.0 ? static_cast<float>(1.0 / std::sqrt(norm)) : 0.0f;
+        for (size_t i = 0; i < v.size(); ++i) out[i] = v[i] * scale;
+    }
+
+    static float dot(const float* a, const float* b, size_t n) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i) sum += a[i] * b[i];
+        return sum;
     }
 
     std::string path_;
+    float dedup_threshold_;
     std::unique_ptr<FaissVectorStore> store_;
-    std::mutex mtx_;
+    BoundedQueue<Experience> queue_;
+    std::thread writer_;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "code_graph.hpp"
+#include "SymbolTable.hpp"
+
+namespace code_assistance {
+
+// 🧱 Fixed-width node record: 60 bytes plus 4 per dependency, against the kilobytes a
+// CodeNode spends on seven strings, a hash set and a hash map.
+struct CompactNode {
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    uint32_t id = SymbolTable::EMPTY;        // SymbolTable ids
+    uint32_t name = SymbolTable::EMPTY;
+    uint32_t file_path = SymbolTable::EMPTY;
+    uint32_t type = SymbolTable::EMPTY;
+    uint32_t dep_begin = 0;                  // Range in the arena's dependency pool (target node ids)
+    uint32_t dep_count = 0;
+    uint32_t weight_begin = 0;               // Weights other than "structural"
+    uint32_t weight_count = 0;
+    uint32_t buffer = NONE;                  // Shared content buffer slot
+    uint32_t content_offset = 0;
+    uint32_t content_length = 0;
+    uint32_t text = NONE;                    // Docstring / AI summary / signatures slot, when any is set
+    uint32_t embedding = NONE;               // Row of the embedding matrix
+    float structural_weight = 0.5f;
+    float ai_quality_score = 0.5f;
+};
+static_assert(sizeof(CompactNode) == 60, "CompactNode must stay fixed-width");
+
+// 🏗️ Contiguous storage for live nodes: records, dependency ids and embeddings each sit
+// in one vector, repeated strings go through the SymbolTable, and content stays a range
+// of the file buffer it was parsed from (buffers are refcounted per slot). CodeNode is
+// rebuilt on demand as a detached view for API callers.
+// Not synchronized: the owner guards it like any other container.
+class NodeArena {
+public:
+    using Index = uint32_t;
+
+    explicit NodeArena(int dimension, SymbolTable& symbols = SymbolTable::global())
+        : dimension_(dimension), symbols_(symbols) {}
+
+    Index add(const CodeNode& node);
+    void erase(Index idx);
+    void clear();
+
+    size_t size() const { return live_; }
+    bool contains(Index idx) const { return idx < records_.size() && alive_[idx]; }
+    const CompactNode& record(Index idx) const { return records_[idx]; }
+
+    std::string_view id(Index idx) const { return symbols_.str(records_[idx].id); }
+    std::string_view name(Index idx) const { return symbols_.str(records_[idx].name); }
+    std::string_view file_path(Index idx) const { return symbols_.str(records_[idx].file_path); }
+    std::string_view type(Index idx) const { return symbols_.str(records_[idx].type); }
+    std::string_view content(Index idx) const;
+    float structural_weight(Index idx) const { return records_[idx].structural_weight; }
+    const float* embedding(Index idx) const;
+
+    uint32_t dependency_count(Index idx) const { return records_[idx].dep_count; }
+    std::string_view dependency(Index idx, uint32_t i) const { return symbols_.str(deps_[records_[idx].dep_begin + i]); }
+
+    // Owning CodeNode; content still shares the source buffer. Embeddings copied on request.
+    std::shared_ptr<CodeNode> materialize(Index idx, bool with_embedding = false) const;
+
+    size_t memory_bytes() const;
+
+private:
+    struct Text {
+        std::string docstring;
+        std::string ai_summary;
+        std::string signatures;
+    };
+    struct Weight {
+        uint32_t key;
+        double value;
+    };
+    struct Buffer {
+        std::shared_ptr<const std::string> bytes;
+        uint32_t refs = 0;
+    };
+
+    uint32_t acquire_buffer(const std::shared_ptr<const std::string>& bytes);
+    void release_buffer(uint32_t slot);
+    void compact_pools(); // Drops dependency / weight ranges of erased records
+
+    int dimension_;
+    SymbolTable& symbols_;
+
+    std::vector<CompactNode> records_;
+    std::vector<uint8_t> alive_;
+    std::vector<Index> free_records_;
+    size_t live_ = 0;
+
+    std::vector<uint32_t> deps_;
+    std::vector<Weight> weights_;
+    size_t dead_pool_entries_ = 0;
+
+    std::vector<Buffer> buffers_;
+    std::vector<uint32_t> free_buffers_;
+    std::unordered_map<const std::string*, uint32_t> buffer_slot_;
+
+    std::vector<Text> texts_;
+    std::vector<uint32_t> free_texts_;
+
+    std::vector<float> embeddings_; // Row-major, dimension_ floats per row
+    std::vector<uint32_t> free_embeddings_;
+};
+
+} // namespace code_assistance
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "code_graph.hpp"
+#include "MappedFile.hpp"
+#include "VectorCodec.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace code_assistance {
+
+// 💾 BINARY NODE SEGMENT (nodes.bin)
+// Replaces metadata.json. Layout (little-endian, offsets from file start):
+//   [Header][NodeRecord x N][WeightEntry x W][StrRef x D (dependencies)][StrRef x N (signatures)]
+//   [uint32 hash slots x H][string heap][embedding row x N (optional, 64B aligned)]
+// Embedding rows are f32, f16 or int8 + scale (Header::embedding_precision).
+// Opening is an mmap + header check; node content is only touched when a row is read.
+namespace node_store_format {
+
+constexpr char MAGIC[8] = {'S', 'Y', 'N', 'N', 'O', 'D', 'E', 'S'};
+constexpr uint32_t VERSION = 6; // v2: NodeRecord.id_hash, v3: structural_weight, v4: embedding precision, v5: centrality,
+                                // v6: signatures column
+constexpr uint32_t MIN_VERSION = 3; // v3 is v4 with f32 rows and a shorter header; before v5 centrality was written as 0
+
+struct StrRef {
+    uint64_t offset;  // Into the string heap
+    uint32_t length;
+    uint32_t reserved;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t dimension;
+    uint64_t node_count;
+    uint64_t records_offset;
+    uint64_t weights_offset;
+    uint64_t weight_count;
+    uint64_t deps_offset;
+    uint64_t dep_count;
+    uint64_t hash_offset;
+    uint64_t hash_capacity;   // Power of two; slot value = row + 1, 0 = empty
+    uint64_t heap_offset;
+    uint64_t heap_size;
+    uint64_t embeddings_offset; // 0 = no embedding column
+    uint32_t embedding_precision; // VectorPrecision (v4+)
+    uint32_t embedding_row_bytes;
+    uint64_t signatures_offset;   // One StrRef per record (v6+; 0 = no column)
+};
+
+struct NodeRecord {
+    StrRef id;
+    StrRef name;
+    StrRef content;
+    StrRef docstring;
+    StrRef file_path;
+    StrRef type;
+    StrRef ai_summary;
+    uint32_t dep_begin;
+    uint32_t dep_count;
+    uint32_t weight_begin;
+    uint32_t weight_count;
+    double ai_quality_score;
+    uint64_t id_hash;  // NodeStore::hash_id(id), doubles as the FAISS label source
+    float structural_weight; // Parser prior (node kind)
+    float centrality;        // compute_centrality() score from the last sync; 0 = not computed
+};
+
+struct WeightEntry {
+    StrRef key;
+    double value;
+};
+
+static_assert(sizeof(StrRef) == 16, "StrRef must stay fixed-width");
+static_assert(sizeof(Header) % 8 == 0, "Header must keep records 8-byte aligned");
+static_assert(sizeof(NodeRecord) == 152, "NodeRecord must stay fixed-width");
+
+} // namespace node_store_format
+
+// Read-only view over a nodes.bin segment.
+class NodeStore {
+public:
+    NodeStore() = default;
+
+    bool open(const std::string& path);
+    bool is_open() const { return header_ != nullptr; }
+
+    size_t size() const { return header_ ? header_->node_count : 0; }
+    int dimension() const { return header_ ? static_cast<int>(header_->dimension) : 0; }
+    bool has_embeddings() const { return header_ && header_->embeddings_offset != 0; }
+    VectorPrecision embedding_precision() const { return precision_; }
+
+    // Zero-copy field access (views stay valid while the store is open)
+    std::string_view id(size_t row) const;
+    std::string_view name(size_t row) const;
+    std::string_view file_path(size_t row) const;
+    std::string_view type(size_t row) const;
+    std::string_view content(size_t row) const;
+    // CodeNode::signatures; empty for segments written before v6
+    std::string_view signatures(size_t row) const;
+    // f32 rows point into the mapping; f16 / int8 rows are decoded into `scratch`
+    // (dimension() floats) and it is returned. Null without an embedding column.
+    const float* embedding(size_t row, float* scratch) const;
+    // The stored bytes of a row, vector_row_bytes(embedding_precision(), dimension()) long
+    const uint8_t* embedding_row(size_t row) const;
+
+    uint64_t id_hash(size_t row) const { return records_[row].id_hash; }
+    float structural_weight(size_t row) const { return records_[row].structural_weight; }
+    float centrality(size_t row) const { return records_[row].centrality; }
+    uint32_t dependency_count(size_t row) const { return records_[row].dep_count; }
+    std::string_view dependency(size_t row, uint32_t i) const;
+
+    // O(1) expected: open-addressed hash on CodeNode::id. Returns -1 if absent.
+    long find(std::string_view node_id) const;
+    // Same table, matched on the stored hash under `mask` (no string compares)
+    long find_by_hash(uint64_t hash, uint64_t mask = ~0ULL) const;
+
+    // Builds an owning CodeNode for API consumers. Embeddings are copied only on request.
+    std::shared_ptr<CodeNode> materialize(size_t row, bool with_embedding = false) const;
+
+    static uint64_t hash_id(std::string_view s);
+
+private:
+    friend class NodeStoreWriter;
+    std::string_view str(const node_store_format::StrRef& ref) const;
+
+    MappedFile file_;
+    const node_store_format::Header* header_ = nullptr;
+    const node_store_format::NodeRecord* records_ = nullptr;
+    const node_store_format::WeightEntry* weights_ = nullptr;
+    const node_store_format::StrRef* deps_ = nullptr;
+    const node_store_format::StrRef* signatures_ = nullptr;
+    const uint32_t* slots_ = nullptr;
+    const char* heap_ = nullptr;
+    const uint8_t* embeddings_ = nullptr;
+    VectorPrecision precision_ = VectorPrecision::F32;
+    size_t row_bytes_ = 0;
+};
+
+// Accumulates nodes and writes a complete segment in one pass.
+// A file's bytes are stored once: every node cut from the same buffer (a CodeNode::source,
+// or a file row's content when copying from another segment) is an (offset, length) into it.
+class NodeStoreWriter {
+public:
+    NodeStoreWriter(int dimension, bool with_embeddings = true, VectorPrecision precision = VectorPrecision::F32)
+        : dimension_(dimension), with_embeddings_(with_embeddings), precision_(precision),
+          row_bytes_(vector_row_bytes(precision, dimension)) {}
+
+    void add(const CodeNode& node, const float* embedding = nullptr, float centrality = 0.0f);
+    // Copies a row straight out of another segment without materializing a CodeNode
+    void add_row(const NodeStore& source, size_t row);
+    void add_row(const NodeStore& source, size_t row, float centrality);
+
+    // Writes to "<path>.tmp" and renames over <path>, so readers never see a torn file
+    bool write(const std::string& path) const;
+
+    size_t size() const { return records_.size(); }
+
+private:
+    node_store_format::StrRef intern(std::string_view s);
+    // `length` bytes at `offset` of `blob`, which is copied into the heap on first sight
+    node_store_format::StrRef intern_slice(std::string_view blob, size_t offset, size_t length);
+    void push_embedding(const float* embedding);
+
+    int dimension_;
+    bool with_embeddings_;
+    VectorPrecision precision_;
+    size_t row_bytes_;
+    std::vector<node_store_format::NodeRecord> records_;
+    std::vector<node_store_format::WeightEntry> weights_;
+    std::vector<node_store_format::StrRef> deps_;
+    std::vector<node_store_format::StrRef> signatures_; // Parallel to records_
+    std::string heap_;
+    std::vector<uint8_t> embeddings_; // Encoded rows
+    std::unordered_map<const char*, uint64_t> blobs_; // Buffer start -> heap offset; buffers outlive the writer's use
+};
+
+} // namespace code_assistance
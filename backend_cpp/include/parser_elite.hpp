@@ -1,9 +1,12 @@
 #pragma once
 #include <tree_sitter/api.h>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory>
 #include <filesystem>
 #include "code_graph.hpp"
+#include "cache_manager.hpp"
 
 // Forward declare grammars from third_party
 extern "C" {
@@ -13,23 +16,99 @@ extern "C" {
 }
 
 namespace code_assistance {
-    namespace elite {    
+    namespace elite {
+
+const TSLanguage* language_for_extension(const std::string& ext);
+
+// 🧵 One TSParser per (thread, language), created on first use and reused for the
+// thread's lifetime. Parsers are not thread-safe, so they are never shared.
+TSParser* thread_parser(const TSLanguage* lang);
+
+// 🌳 One parsed version of a file. Immutable once published: incremental reparses
+// edit a ts_tree_copy, never the cached tree, so readers on other threads are safe.
+class SyntaxTree {
+public:
+    SyntaxTree(std::shared_ptr<const std::string> source, TSTree* tree, const TSLanguage* lang)
+        : source_(std::move(source)), tree_(tree), lang_(lang) {}
+    ~SyntaxTree() { if (tree_) ts_tree_delete(tree_); }
+    SyntaxTree(const SyntaxTree&) = delete;
+    SyntaxTree& operator=(const SyntaxTree&) = delete;
+
+    const std::string& source() const { return *source_; }
+    // The same bytes parsed nodes refer into
+    const std::shared_ptr<const std::string>& source_buffer() const { return source_; }
+    const TSTree* tree() const { return tree_; }
+    const TSLanguage* language() const { return lang_; }
+    TSNode root() const { return ts_tree_root_node(tree_); }
+    bool has_error() const { return ts_node_has_error(root()); }
+
+private:
+    std::shared_ptr<const std::string> source_;
+    TSTree* tree_;
+    const TSLanguage* lang_;
+};
+
+    }
+
+template<>
+struct CacheWeight<std::shared_ptr<const elite::SyntaxTree>> {
+    // Tree nodes run a few times the source size; the source is the part we can measure
+    static size_t of(const std::shared_ptr<const elite::SyntaxTree>& t) {
+        return sizeof(elite::SyntaxTree) + (t ? t->source().size() * 4 : 0);
+    }
+};
+
+    namespace elite {
+
+struct ASTCacheStats {
+    CacheStats cache;
+    uint64_t full_parses = 0;
+    uint64_t incremental_parses = 0;
+};
+
+// 📚 Process-wide cache of the last parsed version of each file, keyed by path.
+// parse() returns the cached tree when the source is unchanged, otherwise diffs
+// the new source against the cached one, applies the change as a single
+// ts_tree_edit and reparses incrementally, so only the touched subtrees are rebuilt.
+class ASTCache {
+public:
+    static ASTCache& instance();
+
+    explicit ASTCache(size_t budget_bytes = 64 * 1024 * 1024);
+
+    // nullptr for languages without a grammar. The buffer overload keeps `source` instead of copying it.
+    std::shared_ptr<const SyntaxTree> parse(const std::string& path, std::shared_ptr<const std::string> source);
+    std::shared_ptr<const SyntaxTree> parse(const std::string& path, std::string_view source);
+    void invalidate(const std::string& path);
+    ASTCacheStats stats() const;
+
+private:
+    std::shared_ptr<const SyntaxTree> parse(const std::string& path, std::string_view source,
+                                            std::shared_ptr<const std::string> buffer);
+
+    ShardedLRUCache<std::string, std::shared_ptr<const SyntaxTree>> trees_;
+    std::atomic<uint64_t> full_parses_{0};
+    std::atomic<uint64_t> incremental_parses_{0};
+};
 
 class ASTBooster {
 public:
-    ASTBooster();
-    ~ASTBooster();
+    ASTBooster() = default;
 
     // 🛡️ The Eyes of the Journal: Returns true if code is syntactically perfect
     bool validate_syntax(const std::string& content, const std::string& extension);
+    // Same check through the AST cache: a file validated on every edit reparses incrementally
+    bool validate_file_syntax(const std::string& path, const std::string& content);
 
-    // 🛰️ The Map Maker: Breaks file into logical nodes
+    // 🛰️ The Map Maker: Breaks file into logical nodes.
+    // Definitions come from per-language queries over the cached tree; their content is the
+    // node's byte range (template / export / decorator wrappers included). Dependencies are
+    // node ids: calls to definitions in the same file, and every project path an import can
+    // resolve to (ids that match no node are dropped when the graph is built). The file node
+    // comes last. Empty when the language has no grammar or its query failed to compile.
+    std::vector<CodeNode> extract_symbols(const std::string& path, std::shared_ptr<const std::string> source);
     std::vector<CodeNode> extract_symbols(const std::string& path, const std::string& content);
-
-private:
-    TSParser* parser_;
-    const TSLanguage* get_lang(const std::string& ext);
 };
 
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "embedding_service.hpp"
+#include "project_stores.hpp"
+#include "retrieval_engine.hpp"
+
+namespace code_assistance {
+
+struct ProjectQuery {
+    std::string query;
+    int max_nodes = 80;
+    bool use_graph = true;
+    size_t max_chars = 120000; // Context budget; 0 skips building it
+    SearchOptions opts;
+};
+
+struct ProjectAnswer {
+    ProjectStores::Handle store; // Keeps the nodes below resolvable while the answer is held
+    std::vector<RetrievalResult> results;
+    std::string context;
+    bool lexical = false; // Answered by the lexical index: no embedding was requested
+};
+
+// 🧭 Retrieval over the ProjectStores registry, shared by the REST server and the agent.
+// Identifier-shaped queries with an exact name hit are served by retrieve_lexical(); only
+// the rest pay for a query embedding. One RetrievalEngine (and result cache) per resident
+// store: it is re-created when a new store version is published or the old one was
+// evicted. The engine does not own its store, so it never keeps one over the budget.
+class ProjectRetrieval {
+public:
+    ProjectRetrieval(ProjectStores& stores, std::shared_ptr<EmbeddingService> ai, RetrievalCacheOptions cache = {});
+
+    // Loads the project's store if it is not resident
+    ProjectAnswer retrieve(const std::string& project_id, const std::string& local_root, const std::string& storage_path,
+                           const ProjectQuery& query);
+
+private:
+    struct Entry {
+        std::weak_ptr<FaissVectorStore> store;
+        std::shared_ptr<RetrievalEngine> engine;
+    };
+
+    std::shared_ptr<RetrievalEngine> engine_for(const std::string& project_id, const ProjectStores::Handle& store);
+
+    ProjectStores& stores_;
+    std::shared_ptr<EmbeddingService> ai_;
+    RetrievalCacheOptions cache_options_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> engines_; // Guarded by mutex_
+};
+
+} // namespace code_assistance
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "faiss_vector_store.hpp"
+
+namespace code_assistance {
+
+struct ProjectStoresOptions {
+    uint64_t memory_budget_bytes = 4ull << 30; // Resident stores beyond this evict the coldest idle ones
+    int dimension = 768;                       // Of the embeddings the stores are fed
+};
+
+struct ProjectStoresStats {
+    size_t projects = 0; // Ever seen by this process
+    size_t loaded = 0;
+    uint64_t resident_bytes = 0;
+    uint64_t budget_bytes = 0;
+    uint64_t loads = 0;
+    uint64_t evictions = 0;
+    uint64_t swaps = 0; // Versions published over a live one
+};
+
+// 🗂️ PER-PROJECT VECTOR STORE REGISTRY
+// A project's store is load()ed from <storage>/vector_store on first use (nodes.bin is
+// mmap'd, so that is cheap) and shared as a reference-counted handle. Lookups read a
+// published, immutable project map and the project's current store pointer: no registry
+// lock, and a load blocks only callers of that same project. A new store version (a
+// re-sync rebuilt from disk) is published with one atomic swap; readers still holding
+// the old handle finish on it, and it is freed with its last handle. Past the memory
+// budget, the least recently used stores nobody is holding are dropped; their next
+// lookup loads them again.
+class ProjectStores {
+public:
+    using Handle = std::shared_ptr<FaissVectorStore>;
+
+    explicit ProjectStores(ProjectStoresOptions options = {});
+
+    // Loads the project's store if it is not resident
+    Handle acquire(const std::string& project_id, const std::string& local_root, const std::string& storage_path);
+    // Null if the project is not resident
+    Handle find(const std::string& project_id) const;
+
+    // Loads a fresh copy off to the side and swaps it in (RCU); false if nothing is on disk
+    bool reload(const std::string& project_id, const std::string& local_root, const std::string& storage_path);
+    // Swaps in a store the caller built
+    void publish(const std::string& project_id, const std::string& local_root, const std::string& storage_path, Handle store);
+
+    // The store was saved: re-measure its footprint and enforce the budget
+    void saved(const std::string& project_id);
+
+    void set_memory_budget(uint64_t bytes);
+    ProjectStoresStats stats() const;
+
+private:
+    struct Slot {
+        std::atomic<std::shared_ptr<FaissVectorStore>> store;
+        std::atomic<uint64_t> last_used{0};
+        std::atomic<uint64_t> bytes{0};
+        std::mutex load_mutex; // One load per project at a time
+        std::string local_root;
+        std::string storage_path;
+    };
+    using SlotMap = std::unordered_map<std::string, std::shared_ptr<Slot>>;
+
+    std::shared_ptr<Slot> find_slot(const std::string& project_id) const;
+    std::shared_ptr<Slot> slot_for(const std::string& project_id, const std::string& local_root, const std::string& storage_path);
+    Handle open(const std::string& local_root, const std::string& storage_path) const;
+    static uint64_t footprint(const std::string& storage_path);
+    void install(Slot& slot, Handle store);
+    void touch(Slot& slot) const { slot.last_used.store(clock_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed); }
+    void enforce_budget(const Slot* keep);
+
+    std::atomic<std::shared_ptr<const SlotMap>> slots_; // Copy-on-write: replaced when a project first appears
+    std::mutex writer_mutex_;                           // Map updates and eviction
+    std::atomic<uint64_t> budget_;
+    const int dimension_;
+    mutable std::atomic<uint64_t> clock_{1};            // LRU ticks
+    std::atomic<uint64_t> loads_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> swaps_{0};
+};
+
+} // namespace code_assistance
@@ -1,7 +1,14 @@
 #pragma once
 #include "faiss_vector_store.hpp"
+#include "cache_manager.hpp"
+#include <chrono>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <vector>
+#include <functional>
+#include <optional>
+#include <string_view>
 
 namespace code_assistance {
 
@@ -12,33 +19,146 @@ struct RetrievalResult {
     int distance;
 };
 
+struct RetrievalCacheOptions {
+    bool enabled = true;
+    size_t budget_bytes = 4 * 1024 * 1024;
+    std::chrono::seconds ttl{300};
+    // > 0: a miss whose embedding is at least this cosine-close to a recent query's (same
+    // store version and parameters) is served that query's results. 0.98 is a fair start.
+    float near_duplicate_cosine = 0.0f;
+};
+
+// 🧾 A cached retrieval: node labels with their scores, resolved against the store again
+// on a hit. Entries carry the store version they were computed at, so any published change
+// makes them unreachable.
+struct CachedHit {
+    int64_t label;
+    float graph_score;
+    float final_score;
+    int distance;
+};
+
+struct RetrievalKey {
+    uint64_t version;
+    uint64_t query_hash;     // Query text
+    uint64_t embedding_hash; // Embeddings quantized to int8, so float noise still matches
+    int max_nodes;
+    bool use_graph;
+    SearchOptions opts;
+
+    bool operator==(const RetrievalKey& o) const {
+        return version == o.version && query_hash == o.query_hash && embedding_hash == o.embedding_hash &&
+               max_nodes == o.max_nodes && use_graph == o.use_graph && opts.k == o.opts.k &&
+               opts.ef_search == o.opts.ef_search && opts.nprobe == o.opts.nprobe &&
+               opts.rerank_factor == o.opts.rerank_factor;
+    }
+    bool same_parameters(const RetrievalKey& o) const {
+        RetrievalKey a = *this;
+        a.query_hash = o.query_hash;
+        a.embedding_hash = o.embedding_hash;
+        return a == o;
+    }
+};
+
+struct RetrievalKeyHash {
+    size_t operator()(const RetrievalKey& k) const {
+        uint64_t h = k.version * 0x9E3779B97F4A7C15ULL ^ k.query_hash;
+        h = (h ^ (h >> 31)) * 0xBF58476D1CE4E5B9ULL ^ k.embedding_hash;
+        h = (h ^ (h >> 29)) * 0x94D049BB133111EBULL ^ static_cast<uint64_t>(k.max_nodes) << 1 ^ k.use_graph;
+        h ^= static_cast<uint64_t>(k.opts.k) << 48 ^ static_cast<uint64_t>(k.opts.ef_search) << 32 ^
+             static_cast<uint64_t>(k.opts.nprobe) << 16 ^ static_cast<uint64_t>(k.opts.rerank_factor);
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
+
 class RetrievalEngine {
 public:
-    explicit RetrievalEngine(std::shared_ptr<FaissVectorStore> store) : vector_store_(store) {}
+    // One engine per project store, so the cache is per project too
+    explicit RetrievalEngine(std::shared_ptr<FaissVectorStore> store, RetrievalCacheOptions cache = {})
+        : vector_store_(store), cache_options_(cache),
+          cache_(cache.budget_bytes, cache.ttl, EvictionPolicy::Clock, 4) {}
 
+    // 🔀 Hybrid: lexical hits on `query` are fused with the vector seeds (reciprocal rank
+    // fusion). Without a usable embedding the lexical hits alone seed the expansion.
     std::vector<RetrievalResult> retrieve(
         const std::string& query,
         const std::vector<float>& query_embedding,
         int max_nodes = 80,
-        bool use_graph = true
+        bool use_graph = true,
+        const SearchOptions& opts = {}
+    );
+
+    // 🛰️ Multi-query fan-out (raw query + HyDE variants): one batched FAISS call, seeds fused by max score
+    std::vector<RetrievalResult> retrieve_multi(
+        const std::string& query,
+        const std::vector<std::vector<float>>& query_embeddings,
+        int max_nodes = 80,
+        bool use_graph = true,
+        const SearchOptions& opts = {}
     );
     
+    // 🔤 Identifier-shaped queries ("parse_file", "Store::search") with an exact name hit
+    // are answered from the lexical index alone: no embedding, no network. nullopt means
+    // the caller should embed the query and use retrieve().
+    std::optional<std::vector<RetrievalResult>> retrieve_lexical(
+        const std::string& query,
+        int max_nodes = 80,
+        bool use_graph = true,
+        const SearchOptions& opts = {}
+    );
+
     std::string build_hierarchical_context(
         const std::vector<RetrievalResult>& candidates,
         size_t max_chars = 120000
     );
 
+    // Writes into a caller-owned buffer (reuse it across turns). Returns chars written.
+    size_t build_hierarchical_context_into(
+        const std::vector<RetrievalResult>& candidates,
+        std::string& out,
+        size_t max_chars = 120000
+    );
+
+    // 🌊 Streams the same context as string_view chunks (node content is never copied).
+    // Stops at the budget or as soon as the sink returns false. Returns chars emitted.
+    using ContextSink = std::function<bool(std::string_view)>;
+    size_t stream_hierarchical_context(
+        const std::vector<RetrievalResult>& candidates,
+        const ContextSink& sink,
+        size_t max_chars = 120000
+    );
+
+    CacheStats cache_stats() const { return cache_.stats(); }
+
 private:
     std::shared_ptr<FaissVectorStore> vector_store_;
 
-    std::vector<RetrievalResult> exponential_graph_expansion(
-        const std::vector<FaissSearchResult>& seed_nodes,
-        int max_nodes,
-        int max_hops,
-        double alpha
-    );
-    
-    void multi_dimensional_scoring(std::vector<RetrievalResult>& candidates);
+    static constexpr int DEFAULT_SEED_K = 200;
+    static constexpr float RRF_K = 60.0f; // Rank damping of reciprocal rank fusion
+    static constexpr size_t MMR_POOL = 200;  // Candidates re-ranked and diversified
+    static constexpr float MMR_LAMBDA = 0.7f; // Relevance vs novelty; 1 is plain score order
+
+    static constexpr size_t RECENT_QUERIES = 64; // Scanned for near-duplicates
+    static constexpr uint64_t LEXICAL_ONLY = 0x6C65786963616CULL; // embedding_hash of retrieve_lexical() entries
+
+    RetrievalCacheOptions cache_options_;
+    ShardedLRUCache<RetrievalKey, std::vector<CachedHit>, RetrievalKeyHash> cache_;
+    struct RecentQuery {
+        RetrievalKey key;
+        std::vector<float> unit; // Normalized embedding
+    };
+    std::mutex recent_mutex_;
+    std::deque<RecentQuery> recent_;
+
+    RetrievalKey cache_key(std::string_view query, const float* embeddings, size_t nq, int max_nodes, bool use_graph,
+                           const SearchOptions& opts) const;
+    std::optional<std::vector<RetrievalResult>> cached(const RetrievalKey& key, const float* embeddings, size_t nq);
+    void remember(const RetrievalKey& key, const float* embeddings, size_t nq, const std::vector<RetrievalResult>& results);
+    std::vector<RetrievalResult> resolve(const std::vector<CachedHit>& hits) const;
+
+    std::vector<LexicalHit> lexical_hits(std::string_view query, const SearchOptions& opts) const;
+    std::vector<RetrievalResult> retrieve_batched(const float* queries, size_t nq, const std::vector<LexicalHit>& lexical,
+                                                  int max_nodes, const SearchOptions& opts);
 };
 
 } // namespace code_assistance
\ No newline at end of file
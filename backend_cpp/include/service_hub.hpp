@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include "ThreadPool.hpp"
+#include "KeyManager.hpp"
+#include "embedding_service.hpp"
+#include "local_embedding_provider.hpp"
+#include "project_stores.hpp"
+#include "project_retrieval.hpp"
+#include "agent/AgentExecutor.hpp"
+#include "agent/SubAgent.hpp"
+#include "tools/ToolRegistry.hpp"
+
+namespace code_assistance {
+
+struct ServiceHubOptions {
+    size_t worker_threads = 0; // 0: max(4, hardware threads)
+    std::string embedding_cache_path = "data/embedding_cache.bin";
+    // Set: embed with this local model instead of the Gemini API. Stores take its dimension.
+    std::optional<LocalEmbeddingOptions> local_embeddings;
+    ProjectStoresOptions stores;
+    std::string llm_base_url; // Empty: the Gemini API
+};
+
+// 🏛️ The services both servers are built on, constructed once per process.
+// The REST server and the gRPC agent take the same hub in combined mode, so keys.json is
+// read once, one KeyManager budgets every call, embeddings cached by a sync are hits for
+// the agent, and tools, sync batches and telemetry share one pool.
+class ServiceHub {
+public:
+    explicit ServiceHub(ServiceHubOptions options = {});
+
+    // file_surgical for the agent service; the REST server alone only reads. Call before serving.
+    void enable_editing_tools();
+
+    // 🔔 Told about every file the agent's apply_edit commits (project id as the agent got it,
+    // path relative to it), so the file is re-indexed without waiting for a watcher or a save
+    using FileEditListener = std::function<void(const std::string& project_id, const std::string& rel_path)>;
+    void set_file_edit_listener(FileEditListener listener); // Empty clears it
+    void notify_file_edited(const std::string& project_id, const std::string& rel_path);
+
+    ThreadPool& thread_pool() { return thread_pool_; }
+    const std::shared_ptr<KeyManager>& key_manager() const { return key_manager_; }
+    const std::shared_ptr<EmbeddingService>& ai_service() const { return ai_service_; }
+    const std::shared_ptr<ToolRegistry>& tools() const { return tools_; }
+    const std::shared_ptr<AgentExecutor>& executor() const { return executor_; }
+    ProjectStores& stores() { return stores_; }
+    ProjectRetrieval& retrieval() { return *retrieval_; }
+
+private:
+    ThreadPool thread_pool_; // First: outlives everything that posts to it
+    std::shared_ptr<KeyManager> key_manager_;
+    std::shared_ptr<EmbeddingService> ai_service_;
+    std::shared_ptr<SubAgent> sub_agent_;
+    std::shared_ptr<ToolRegistry> tools_;
+    ProjectStores stores_;
+    std::shared_ptr<ProjectRetrieval> retrieval_; // Over stores_
+    std::shared_ptr<AgentExecutor> executor_;     // After retrieval_: destroyed before what it searches
+    std::once_flag editing_;
+    std::mutex edit_mutex_;
+    FileEditListener edit_listener_;
+};
+
+} // namespace code_assistance
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace code_assistance {
+
+namespace fs = std::filesystem;
+
+// 📚 SEGMENTED FULL CONTEXT (<storage>/full_context/)
+// Replaces the monolithic _full_context.txt that every sync rewrote from scratch.
+// File blocks keep the old "--- FILE: <path> ---" framing and are appended to
+// seg-NNNNNN.txt segments; index.bin maps each path to its block and content hash.
+// Unchanged files cost nothing, a changed file appends one block, and a segment whose
+// blocks are mostly superseded is compacted into the active one. Segments are
+// append-only and the index is replaced atomically, so a crashed sync leaves the last
+// committed index valid. Thread-safe: parse workers probe while the collector writes.
+class ContextStore {
+public:
+    static constexpr uint64_t SEGMENT_LIMIT = 64ull * 1024 * 1024; // Roll over to a new segment past this
+
+    struct Stats {
+        size_t files = 0;
+        size_t segments = 0;
+        uint64_t live_bytes = 0;
+        uint64_t dead_bytes = 0;
+        uint64_t written_bytes = 0; // Appended since load()
+    };
+
+    explicit ContextStore(fs::path dir) : dir_(std::move(dir)) {}
+    ~ContextStore();
+
+    // Reads index.bin; a missing index starts an empty store
+    bool load();
+
+    // True if `rel_path` is stored with this content hash (its block can stay as is)
+    bool contains(std::string_view rel_path, uint64_t hash) const;
+    // Appends a new block unless the stored one already has this hash
+    bool put(const std::string& rel_path, uint64_t hash, std::string_view content);
+    void remove(const std::string& rel_path);
+    // Drops every path not in `live` (deleted since the last sync); returns how many
+    size_t retain(const std::unordered_set<std::string>& live);
+
+    std::optional<std::string> read(const std::string& rel_path) const;
+
+    // Compacts mostly-dead segments, then publishes the index and deletes unreferenced segments
+    bool commit();
+
+    Stats stats() const;
+
+private:
+    struct Location {
+        uint32_t segment = 0;
+        uint64_t offset = 0; // Content start inside the segment (after the header line)
+        uint64_t length = 0;
+        uint64_t hash = 0;
+    };
+    struct Segment {
+        uint64_t size = 0; // Bytes in the file, including superseded blocks
+        uint64_t live = 0; // Bytes of blocks the index still points at
+    };
+
+    static uint64_t block_size(std::string_view rel_path, uint64_t length);
+    fs::path segment_path(uint32_t id) const;
+
+    // Caller holds mutex_
+    bool append(const std::string& rel_path, uint64_t hash, std::string_view content);
+    void drop(const Location& loc, std::string_view rel_path);
+    bool ensure_active(uint64_t incoming);
+    void flush_active() const;
+    bool compact(uint32_t id);
+    bool write_index();
+
+    fs::path dir_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Location> index_;
+    std::map<uint32_t, Segment> segments_;
+    uint32_t active_ = 0;
+    mutable std::ofstream out_; // Append handle on the active segment
+    bool dirty_ = false;
+    uint64_t written_ = 0;
+};
+
+// 🌳 TREE RENDERING CACHED PER DIRECTORY (tree.txt)
+// Each directory keeps its rendered listing with prefixes relative to itself; the
+// parent adds its "│   " / "    " column when composing, so a clean subtree's text is
+// reused no matter what happens to its siblings. Adding or removing a file only
+// dirties the directories on its path. Not synchronized.
+class DirectoryTree {
+public:
+    // Replaces the file set with `files` ('/'-separated relative paths)
+    void assign(const std::vector<std::string>& files);
+    // Single-file updates; return false when nothing changed
+    bool add(std::string_view rel_path);
+    bool remove(std::string_view rel_path);
+
+    bool populated() const { return populated_; } // A full walk has been assigned
+    bool dirty() const { return root_.dirty; }
+
+    // Full listing under a "<root_name>/" header line; re-renders only dirty directories
+    std::string render(std::string_view root_name);
+    size_t rendered_dirs() const { return rendered_dirs_; } // Directories re-rendered by the last render()
+
+private:
+    struct Dir;
+    struct Entry {
+        std::string name;
+        std::unique_ptr<Dir> dir; // Null for files
+        uint32_t epoch = 0;
+    };
+    struct Dir {
+        std::vector<Entry> entries; // Sorted by name
+        std::string block;          // Rendered children, one line each, prefixes relative to this dir
+        bool dirty = true;
+    };
+
+    static Entry* find(Dir& dir, std::string_view name);
+    bool insert(std::string_view rel_path, uint32_t epoch);
+    bool sweep(Dir& dir, uint32_t epoch); // Drops entries older than epoch; true if anything went
+    const std::string& render_dir(Dir& dir);
+
+    Dir root_;
+    uint32_t epoch_ = 0;
+    bool populated_ = false;
+    size_t rendered_dirs_ = 0;
+};
+
+} // namespace code_assistance
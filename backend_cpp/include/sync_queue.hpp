@@ -0,0 +1,90 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+#include "sync_service.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace code_assistance {
+
+struct SyncQueueOptions {
+    std::chrono::milliseconds debounce{400};   // Quiet period after the last save of a path
+    std::chrono::milliseconds max_delay{3000}; // A path saved continuously still flushes this often
+    size_t max_batch_files = 64;
+};
+
+struct SyncProject {
+    std::string local_root;
+    std::string storage_path;
+};
+
+struct SyncQueueStats {
+    uint64_t submitted = 0;
+    uint64_t coalesced = 0;   // Saves folded into an already-pending entry
+    uint64_t batches = 0;
+    uint64_t files_synced = 0;
+    size_t pending = 0;
+};
+
+// ⏳ Background queue behind /sync/file, keyed by (project, path).
+// Rapid saves of one path collapse into a single entry whose deadline slides by
+// `debounce` (capped at first save + max_delay). When entries come due, every due
+// path of a project goes through SyncService::sync_files together, on the shared
+// pool's Background lane, with at most one batch per project in flight.
+class SyncQueue {
+public:
+    // Runs on a pool worker after each batch; applies the result to the project's index
+    using ApplyFn = std::function<void(const std::string& project_id, const SyncProject& project, FileSyncBatch& batch)>;
+
+    SyncQueue(std::shared_ptr<SyncService> service, ThreadPool& pool, ApplyFn apply, SyncQueueOptions options = {});
+    ~SyncQueue();
+
+    SyncQueue(const SyncQueue&) = delete;
+    SyncQueue& operator=(const SyncQueue&) = delete;
+
+    // O(1), never touches disk or the network. Returns false if the save was coalesced.
+    bool submit(const std::string& project_id, const SyncProject& project, const std::string& rel_path);
+
+    SyncQueueStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        Clock::time_point due;
+        Clock::time_point first_seen;
+    };
+
+    struct ProjectQueue {
+        SyncProject project;
+        std::unordered_map<std::string, Pending> pending;
+        bool in_flight = false;
+    };
+
+    void dispatch_loop();
+    void run_batch(const std::string& project_id, const SyncProject& project, const std::vector<std::string>& paths);
+
+    std::shared_ptr<SyncService> service_;
+    ThreadPool& pool_;
+    ApplyFn apply_;
+    SyncQueueOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, ProjectQueue> projects_;
+    size_t batches_in_flight_ = 0;
+    bool stop_ = false;
+
+    SyncQueueStats stats_;
+    std::thread dispatcher_;
+};
+
+} // namespace code_assistance
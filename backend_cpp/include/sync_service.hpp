@@ -5,8 +5,17 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
+#include <functional>
+#include <mutex>
 #include "code_graph.hpp"
 #include "embedding_service.hpp"
+#include "file_manifest.hpp"
+#include "node_store.hpp"
+#include "PathMatcher.hpp"
+#include "sync_artifacts.hpp"
+#include <string_view>
+
+class ThreadPool;
 
 namespace code_assistance {
 
@@ -16,6 +25,14 @@ struct FilterConfig {
     std::unordered_set<std::string> allowed_extensions;
     std::vector<std::string> blacklist; 
     std::vector<std::string> whitelist; 
+    std::shared_ptr<const PathMatcher> matcher; // Compiled from blacklist + whitelist
+
+    static FilterConfig make(const std::vector<std::string>& allowed_extensions,
+                             const std::vector<std::string>& ignored_paths,
+                             const std::vector<std::string>& included_paths);
+
+    // Extension gate for indexable files ("src/a.CPP" -> "cpp"); dotfiles have no extension
+    bool allows_extension(std::string_view rel_path) const;
 };
 
 struct SyncResult {
@@ -25,10 +42,57 @@ struct SyncResult {
     std::vector<std::string> logs;
 };
 
+// 📡 Snapshot handed to the progress callback (and logged) as the pipeline advances
+struct SyncProgress {
+    std::string stage;            // "scan" | "parse" | "embed" | "done"
+    size_t files_total = 0;
+    size_t files_done = 0;
+    size_t nodes_to_embed = 0;
+    size_t nodes_embedded = 0;
+    size_t batches_in_flight = 0;
+};
+
+struct SyncPipelineOptions {
+    size_t parse_workers = 0;    // 0 = hardware_concurrency
+    size_t embed_in_flight = 0;  // 0 = one per active key, clamped to [2, 8]
+    int batch_size = 50;
+    size_t queue_capacity = 256; // Parsed files buffered ahead of the collector
+};
+
+// ♻️ Nodes from the previous sync, recovered per file instead of by a full scan.
+// Uses the manifest's node id list + the segment's id hash; no per-sync JSON parse.
+class ExistingNodes {
+public:
+    void load(const std::string& storage_path);
+
+    // Appends the previously indexed nodes of `rel_path` (with embeddings) to `out`
+    void recover(const FileManifest& manifest, long entry, const std::string& rel_path,
+                 std::vector<std::shared_ptr<CodeNode>>& out);
+
+private:
+    NodeStore store_;
+    // metadata.json fallback (pre-segment projects)
+    std::unordered_map<std::string, std::vector<std::shared_ptr<CodeNode>>> legacy_by_file_;
+    // Built once, only for manifest entries that carry no id list (migrated manifests)
+    std::unordered_map<std::string_view, std::vector<size_t>> rows_by_file_;
+    bool rows_indexed_ = false;
+};
+
+// Outcome of syncing a set of individually saved files
+struct FileSyncBatch {
+    std::vector<std::string> synced;   // Re-parsed and fully embedded: their nodes replace the old ones
+    std::vector<std::string> removed;  // Gone from disk: drop their nodes
+    std::vector<std::string> failed;   // Embedding failed: keep the previous nodes
+    std::vector<std::shared_ptr<CodeNode>> nodes; // New nodes of `synced`
+};
+
 class SyncService {
 public:
     explicit SyncService(std::shared_ptr<EmbeddingService> embedding_service);
 
+    void set_pipeline_options(const SyncPipelineOptions& options) { options_ = options; }
+    void set_progress_callback(std::function<void(const SyncProgress&)> cb) { progress_cb_ = std::move(cb); }
+
     // Main sync entry point
     SyncResult perform_sync(
         const std::string& project_id,
@@ -39,6 +103,15 @@ public:
         const std::vector<std::string>& included_paths
     );
 
+    // Coalesced file sync: parses every path, then embeds all their nodes together
+    // (one API round trip per batch_size nodes instead of one per file)
+    FileSyncBatch sync_files(
+        const std::string& project_id,
+        const std::string& local_root,
+        const std::string& storage_path,
+        const std::vector<std::string>& relative_paths
+    );
+
     // Atomic file sync
     std::vector<std::shared_ptr<CodeNode>> sync_single_file(
         const std::string& project_id,
@@ -47,27 +120,55 @@ public:
         const std::string& relative_path
     );
 
+    // Files whose size / mtime no longer match the last full sync's manifest, plus manifest
+    // entries that vanished: what a watcher missed while down or after an overflow
+    std::vector<std::string> changed_since_last_sync(
+        const std::string& project_id,
+        const std::string& local_root,
+        const std::string& storage_path,
+        const FilterConfig& cfg
+    );
+
     // Logic Gatekeepers (Only one declaration of each!)
     bool should_index(const fs::path& rel_path, const FilterConfig& cfg);
-    
-    void recursive_scan(
-        const fs::path& current_dir,
-        const fs::path& root_dir,
-        const fs::path& storage_dir,
-        const FilterConfig& cfg,
-        std::vector<fs::path>& results
-    );
+
+    // Directory walks fan out on this pool's Background lane (own threads when unset)
+    void set_thread_pool(ThreadPool* pool) { walk_pool_ = pool; }
 
 private:
     std::shared_ptr<EmbeddingService> embedding_service_;
+    ThreadPool* walk_pool_ = nullptr;
+    SyncPipelineOptions options_;
+    std::function<void(const SyncProgress&)> progress_cb_;
+    std::mutex progress_mutex_;
+
+    void report_progress(const SyncProgress& p);
 
     // Internal Helpers
-    std::string calculate_file_hash(const std::filesystem::path& file_path);
-    std::unordered_map<std::string, std::string> load_manifest(const std::string& project_id);
-    void save_manifest(const std::string& project_id, const std::unordered_map<std::string, std::string>& manifest);
-    void generate_embeddings_batch(std::vector<std::shared_ptr<CodeNode>>& nodes, int batch_size = 50);
-    void generate_tree_file(const fs::path& base_dir, const std::vector<fs::path>& files, const fs::path& output_file);
-    std::unordered_map<std::string, std::shared_ptr<CodeNode>> load_existing_nodes(const std::string& storage_path);
+    struct FileStamp {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        bool ok = false;
+    };
+    FileStamp stat_file(const fs::path& file_path);
+    // Opens data/<id>/manifest.bin, migrating a legacy manifest.json first if needed
+    void load_manifest(const std::string& project_id, FileManifest& manifest);
+    bool save_manifest(const std::string& project_id, FileManifest& current, const FileManifestWriter& updated);
+    // One API round trip; returns how many nodes received an embedding
+    size_t embed_batch(std::vector<std::shared_ptr<CodeNode>>& nodes, int key_slot);
+
+    // tree.txt and the segmented full context, kept across syncs per storage directory
+    struct Artifacts {
+        explicit Artifacts(const fs::path& storage_dir) : context(storage_dir / "full_context") {}
+        std::mutex mutex; // One sync at a time updates them
+        ContextStore context;
+        DirectoryTree tree;
+    };
+    std::mutex artifacts_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Artifacts>> artifacts_;
+    std::shared_ptr<Artifacts> artifacts_for(const fs::path& storage_dir);
+    // Re-renders only dirty directories; nothing is written when the tree is unchanged
+    void write_tree_file(DirectoryTree& tree, const fs::path& base_dir, const fs::path& output_file);
 };
 
 } // namespace code_assistance
\ No newline at end of file
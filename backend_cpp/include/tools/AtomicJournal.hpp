@@ -1,99 +1,151 @@
 #pragma once
+#include <atomic>
+#include <cerrno>
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <spdlog/spdlog.h>
 
 #include "parser_elite.hpp"
+#include "tools/TextPatch.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace code_assistance {
 namespace fs = std::filesystem;
 
 class AtomicJournal {
 public:
-    // 🛡️ Creates a backup of the file before surgery
-    static bool backup(const std::string& filePath) {
-        fs::path p(filePath);
-        fs::path journalPath = p.string() + ".synapse_journal";
+    // 🛡️ Crash-safe replace: the new bytes go to a temp file next to the target, are fsynced,
+    // and atomically renamed over it (then the directory entry is fsynced). A reader or a
+    // crash sees the old file or the new one, never a torn write, so no backup copy is kept.
+    static bool write_atomic(const std::string& filePath, std::string_view content) {
+        fs::path target(filePath);
+        static std::atomic<uint64_t> sequence{0};
+        fs::path temp = target.parent_path() /
+            ("." + target.filename().string() + ".synapse_tmp." + std::to_string(sequence.fetch_add(1)));
         try {
-            if (fs::exists(p)) {
-                fs::copy(p, journalPath, fs::copy_options::overwrite_existing);
-                return true;
+            if (target.has_parent_path()) fs::create_directories(target.parent_path());
+#ifdef _WIN32
+            {
+                std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+                if (!out.write(content.data(), static_cast<std::streamsize>(content.size())) || !out.flush()) {
+                    throw std::runtime_error("write failed");
+                }
             }
-            // If file doesn't exist, it's a new file creation; backup not needed
-            return true; 
-        } catch (const std::exception& e) {
-            spdlog::error("🚨 Journal Backup Failed: {}", e.what());
-            return false;
-        }
-    }
+            fs::rename(temp, target); // MoveFileEx with MOVEFILE_REPLACE_EXISTING
+#else
+            mode_t mode = 0644;
+            struct stat st;
+            if (::stat(filePath.c_str(), &st) == 0) mode = st.st_mode & 07777; // Keep the file's permissions
 
-    // ✅ Confirms the surgery was successful and deletes the backup
-    static void commit(const std::string& filePath) {
-        try {
-            fs::remove(filePath + ".synapse_journal");
-        } catch (...) {}
-    }
+            int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+            if (fd < 0) throw std::runtime_error("cannot create " + temp.string());
+            bool ok = true;
+            for (size_t done = 0; ok && done < content.size();) {
+                ssize_t n = ::write(fd, content.data() + done, content.size() - done);
+                if (n < 0 && errno == EINTR) continue;
+                ok = n > 0;
+                if (ok) done += static_cast<size_t>(n);
+            }
+            ok = ok && ::fchmod(fd, mode) == 0 && ::fsync(fd) == 0;
+            ok = ::close(fd) == 0 && ok;
+            if (!ok || ::rename(temp.c_str(), filePath.c_str()) != 0) throw std::runtime_error("write failed");
 
-    // 🔄 Restores the file to the state before the failed surgery
-    static void rollback(const std::string& filePath) {
-        fs::path journalPath = filePath + ".synapse_journal";
-        if (fs::exists(journalPath)) {
-            try {
-                fs::copy(journalPath, filePath, fs::copy_options::overwrite_existing);
-                fs::remove(journalPath);
-                spdlog::warn("🔄 Rollback triggered for: {}", filePath);
-            } catch (const std::exception& e) {
-                spdlog::critical("💥 ROLLBACK FAILED: {}. Manual repair required!", e.what());
+            // The rename itself must survive a crash too
+            std::string dir = target.has_parent_path() ? target.parent_path().string() : ".";
+            int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dfd >= 0) {
+                ::fsync(dfd);
+                ::close(dfd);
             }
+#endif
+            return true;
+        } catch (const std::exception& e) {
+            std::error_code ec;
+            fs::remove(temp, ec);
+            spdlog::error("🚨 Atomic write failed for {}: {}", filePath, e.what());
+            return false;
         }
     }
 
-    // 🚀 THE FIX: Integrated Surgery Logic
-    static bool apply_surgery_safe(const std::string& path, const std::string& new_code) {
-        fs::path p(path);
-        std::string ext = p.extension().string();
-
+    // 🚀 Whole-file surgery: validated in memory, then committed atomically.
+    // `cache_key` names the file in the AST cache: the project-relative path sync parses it under.
+    static bool apply_surgery_safe(const std::string& path, const std::string& cache_key, const std::string& new_code) {
         // 🛑 STEP 1: MEMORY-ONLY VALIDATION (Zero Disk I/O)
-        // We validate BEFORE we even touch the disk or create a journal.
-        if (!validate_ast_integrity(new_code, ext)) {
+        // We validate BEFORE we even touch the disk.
+        if (!validate_ast_integrity(cache_key, new_code)) {
             return false; // Rejection
         }
+        // ✅ STEP 2: COMMIT
+        return write_atomic(path, new_code);
+    }
 
-        // 🛡️ STEP 2: JOURNAL & WRITE
-        if (!backup(path)) return false;
+    // 🩹 Range surgery: `edits` (offsets into `original`, the file's current bytes) are applied
+    // in memory, the result is validated through the AST cache (an incremental reparse of the
+    // edited span when the file's tree is cached, which a synced file's is) and committed
+    // atomically. On success `patched` holds the new content, already parsed for re-indexing
+    // under `cache_key` (the project-relative path sync and read_file_range look it up by).
+    static bool apply_edits_safe(const std::string& path, const std::string& cache_key, std::string_view original,
+                                 std::vector<TextPatch::Replacement>& edits,
+                                 std::shared_ptr<const std::string>& patched, std::string& error) {
+        auto next = std::make_shared<std::string>();
+        if (!TextPatch::apply(original, edits, *next, error)) return false;
 
-        std::ofstream out(path, std::ios::trunc);
-        if (!out.is_open()) {
-            rollback(path);
+        if (!validate_ast_integrity(cache_key, next)) {
+            error = "the edited file does not parse";
             return false;
         }
-
-        out << new_code;
-        out.close();
-
-        // ✅ STEP 3: COMMIT
-        commit(path);
+        if (!write_atomic(path, *next)) {
+            error = "write failed";
+            return false;
+        }
+        patched = std::move(next);
         return true;
     }
 
-    static bool validate_ast_integrity(const std::string& code, const std::string& ext) {
-        // Instantiate the Elite Parser
-        code_assistance::elite::ASTBooster parser;
-        
-        // 1. Syntax Check
-        if (!parser.validate_syntax(code, ext)) {
+    // `path` is the AST cache key; only its extension picks the grammar
+    static bool validate_ast_integrity(const std::string& path, const std::string& code) {
+        std::string ext = fs::path(path).extension().string();
+
+        // 1. Syntax Check (incremental against the file's last parsed version)
+        if (!code_assistance::elite::ASTBooster().validate_file_syntax(path, code)) {
             spdlog::error("❌ AST REJECTION: Syntax error detected in proposed code.");
             return false;
         }
 
         // 2. Critical Heuristic (Optional): Prevent emptying a file
-        if (code.length() < 10 && ext != ".txt") {
+        return long_enough(ext, code.length());
+    }
+
+    // Same checks; the buffer goes to the AST cache as is, so the re-index finds this tree
+    static bool validate_ast_integrity(const std::string& path, std::shared_ptr<const std::string> code) {
+        std::string ext = fs::path(path).extension().string();
+        size_t length = code->length();
+        if (code_assistance::elite::language_for_extension(ext)) {
+            auto tree = code_assistance::elite::ASTCache::instance().parse(path, std::move(code));
+            if (!tree || tree->has_error()) {
+                spdlog::error("❌ AST REJECTION: Syntax error detected in proposed code.");
+                return false;
+            }
+        }
+        return long_enough(ext, length);
+    }
+
+private:
+    static bool long_enough(const std::string& ext, size_t length) {
+        if (length < 10 && ext != ".txt") {
             spdlog::warn("⚠️ AST WARNING: Proposed code is dangerously short.");
             return false;
         }
-
         return true;
     }
 };
-}
\ No newline at end of file
+}
@@ -2,17 +2,30 @@
 #pragma once
 #include "tools/ToolRegistry.hpp"
 #include "tools/AtomicJournal.hpp"
+#include "tools/TextPatch.hpp"
+#include "SourceFile.hpp"
 #include <fstream>
+#include <functional>
 
 namespace code_assistance {
 
 class FileSurgicalTool : public ITool {
 public:
+    // Told about every committed edit, so the file is re-indexed right away
+    using EditListener = std::function<void(const std::string& project_id, const std::string& relative_path)>;
+
+    explicit FileSurgicalTool(EditListener on_edit = {}) : on_edit_(std::move(on_edit)) {}
+
     ToolMetadata get_metadata() override {
         return {
             "apply_edit",
-            "Overwrites a file with new content. Use ONLY after verifying logic via read_file.",
-            "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\"},\"content\":{\"type\":\"string\"}},\"required\":[\"path\",\"content\"]}"
+            "Edits a file. Prefer small edits: 'edits' is a list of {\"old\",\"new\"} (old must occur exactly once), "
+            "{\"start_line\",\"end_line\",\"content\"} (1-based, inclusive; end_line = start_line - 1 inserts) or "
+            "{\"offset\",\"length\",\"content\"} (bytes); or send a unified 'diff'. 'content' overwrites the whole "
+            "file (new files). Use ONLY after verifying logic via read_file.",
+            "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\"},\"content\":{\"type\":\"string\"},"
+            "\"diff\":{\"type\":\"string\"},\"edits\":{\"type\":\"array\",\"items\":{\"type\":\"object\"}}},"
+            "\"required\":[\"path\"]}"
         };
     }
 
@@ -20,9 +33,8 @@ public:
         try {
             // 1. Parse Payload
             auto j = nlohmann::json::parse(args_json);
-            std::string project_root = j.value("project_id", ""); 
+            std::string project_root = j.value("project_id", "");
             std::string relative_path = j.value("path", "");
-            std::string new_content = j.value("content", "");
 
             // 2. Resolve Flight Path
             if (project_root.empty() || relative_path.empty()) {
@@ -30,22 +42,90 @@ public:
             }
 
             std::filesystem::path full_path = std::filesystem::path(project_root) / relative_path;
+            // The AST cache knows a synced file by its project-relative path
+            std::string cache_key = std::filesystem::path(relative_path).lexically_normal().generic_string();
 
-            // 🚀 THE UPGRADE: Execute Atomic Surgery
-            // This single call handles: Backup -> Write -> Validation -> (Commit OR Rollback)
-            bool success = AtomicJournal::apply_surgery_safe(full_path.string(), new_content);
+            bool success = false;
+            std::string detail;
+            if (j.contains("edits") || j.contains("diff")) {
+                // 🩹 Range surgery: only the edits travel, the file never round-trips through the model
+                SourceFile file;
+                std::vector<TextPatch::Replacement> edits;
+                std::shared_ptr<const std::string> patched;
+                if (!file.open(full_path)) {
+                    detail = "cannot read the file; use 'content' to create it";
+                } else {
+                    success = build_edits(file.view(), j, edits, detail) &&
+                              AtomicJournal::apply_edits_safe(full_path.string(), cache_key, file.view(), edits, patched, detail);
+                }
+                if (success) detail = std::to_string(edits.size()) + " edit(s)";
+            } else if (j.contains("content")) {
+                // Whole-file surgery: validated in memory, committed by atomic rename
+                success = AtomicJournal::apply_surgery_safe(full_path.string(), cache_key, j["content"].get<std::string>());
+                if (!success) detail = "the new content was rejected";
+            } else {
+                return "ERROR: apply_edit needs 'edits', 'diff' or 'content'.";
+            }
 
             if (success) {
-                spdlog::info("🏗️ Surgery Successful: {}", full_path.string());
-                return "SUCCESS: Applied edits to " + relative_path + ". Atomic journal cleared and integrity verified.";
+                spdlog::info("🏗️ Surgery Successful: {} ({})", full_path.string(), detail.empty() ? "rewrite" : detail);
+                if (on_edit_) on_edit_(project_root, relative_path);
+                return "SUCCESS: Applied edits to " + relative_path + ". Committed atomically and integrity verified.";
             } else {
-                spdlog::error("💥 Surgery Failed: {}", full_path.string());
-                return "ERROR: Surgery failed for " + relative_path + ". Rollback performed to preserve codebase integrity.";
+                spdlog::error("💥 Surgery Failed: {}: {}", full_path.string(), detail);
+                return "ERROR: Surgery failed for " + relative_path + " (" + detail + "). The file is unchanged.";
             }
 
         } catch (const std::exception& e) {
             return "ERROR: Surgical Tool Engine Stall: " + std::string(e.what());
         }
     }
+
+private:
+    EditListener on_edit_;
+
+    static bool build_edits(std::string_view original, const nlohmann::json& j,
+                            std::vector<TextPatch::Replacement>& edits, std::string& error) {
+        if (j.contains("diff")) return TextPatch::from_unified_diff(original, j["diff"].get<std::string>(), edits, error);
+
+        const auto& list = j["edits"];
+        if (!list.is_array() || list.empty()) {
+            error = "'edits' must be a non-empty array";
+            return false;
+        }
+        std::vector<size_t> starts; // Line index, built only if a line range needs it
+        for (const auto& e : list) {
+            TextPatch::Replacement r;
+            if (e.contains("old")) {
+                std::string old_text = e["old"].get<std::string>();
+                size_t at = old_text.empty() ? std::string_view::npos : original.find(old_text);
+                if (at == std::string_view::npos) {
+                    error = "'old' text not found (it must match the file exactly)";
+                    return false;
+                }
+                if (original.find(old_text, at + 1) != std::string_view::npos) {
+                    error = "'old' text occurs more than once; include more surrounding lines";
+                    return false;
+                }
+                r.offset = at;
+                r.length = old_text.size();
+                r.text = e.value("new", "");
+            } else if (e.contains("start_line")) {
+                if (starts.empty()) starts = TextPatch::line_starts(original);
+                size_t first = e["start_line"].get<size_t>();
+                size_t last = e.value("end_line", first);
+                if (!TextPatch::line_range(original, starts, first, last, e.value("content", ""), r, error)) return false;
+            } else if (e.contains("offset")) {
+                r.offset = e["offset"].get<size_t>();
+                r.length = e.value("length", size_t(0));
+                r.text = e.value("content", "");
+            } else {
+                error = "each edit needs 'old', 'start_line' or 'offset'";
+                return false;
+            }
+            edits.push_back(std::move(r));
+        }
+        return true;
+    }
 };
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <memory>
+#include "PathMatcher.hpp"
 #include "tools/ToolRegistry.hpp"
 
 namespace code_assistance {
@@ -11,6 +13,7 @@ struct ProjectFilter {
     std::vector<std::string> allowed_extensions;
     std::vector<std::string> ignored_paths;
     std::vector<std::string> included_paths;
+    std::shared_ptr<const PathMatcher> matcher; // Compiled by load_config
 };
 
 class FileSystemTools {
@@ -28,6 +31,12 @@ public:
 
     // 🛡️ Safe Reader
     static std::string read_file_safe(const std::string& root_path, const std::string& relative_path);
+
+    // 📑 Part of a file: lines [start_line, end_line] (1-based, inclusive; 0 = file start / end)
+    // or the definitions named `symbol`, located by their byte ranges in the file as parsed now.
+    // Ranged reads may come from files too large to read whole.
+    static std::string read_file_range(const std::string& root_path, const std::string& relative_path,
+                                       size_t start_line, size_t end_line, const std::string& symbol = "");
 };
 
 // 🔧 Tool Registry Wrappers
@@ -35,7 +44,7 @@ class ListDirTool : public ITool {
 public:
     ToolMetadata get_metadata() override {
         return {"list_dir", "Lists files recursively with filters. Input: {'path': 'string', 'depth': number}", 
-                "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\"},\"depth\":{\"type\":\"number\"}}}"};
+                "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\"},\"depth\":{\"type\":\"number\"}}}", true};
     }
     std::string execute(const std::string& args_json) override;
 };
@@ -43,8 +52,12 @@ public:
 class ReadFileTool : public ITool {
 public:
     ToolMetadata get_metadata() override {
-        return {"read_file", "Reads file content safely. Input: {'path': 'string'}", 
-                "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\"}}}"};
+        return {"read_file",
+                "Reads file content safely. Input: {'path': 'string'}; optional 'start_line'/'end_line' "
+                "(1-based, inclusive) for a range, or 'symbol' for one function/class. Prefer ranges on large files.",
+                "{\"type\":\"object\",\"properties\":{\"path\":{\"type\":\"string\"},"
+                "\"start_line\":{\"type\":\"number\"},\"end_line\":{\"type\":\"number\"},"
+                "\"symbol\":{\"type\":\"string\"}},\"required\":[\"path\"]}", true};
     }
     std::string execute(const std::string& args_json) override;
 };
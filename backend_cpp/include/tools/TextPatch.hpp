@@ -0,0 +1,247 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace code_assistance {
+
+// 🩹 In-memory edits for apply_edit: byte-range replacements, line-range replacements and
+// unified diffs all reduce to a sorted list of non-overlapping Replacements, applied to the
+// original with one sized copy. Hunks are checked against the file: a hunk whose context
+// moved (the model's line numbers are often off) is searched for nearby, and one that
+// matches nowhere fails the whole patch instead of landing in the wrong place.
+class TextPatch {
+public:
+    static constexpr size_t HUNK_SEARCH_LINES = 400; // How far a drifted hunk may be found
+
+    struct Replacement {
+        size_t offset = 0; // Bytes of the original
+        size_t length = 0;
+        std::string text;
+    };
+
+    // Byte offset where each line starts, plus one past the end
+    static std::vector<size_t> line_starts(std::string_view text) {
+        std::vector<size_t> starts{0};
+        for (size_t i = text.find('\n'); i != std::string_view::npos; i = text.find('\n', i + 1)) starts.push_back(i + 1);
+        if (starts.back() != text.size()) starts.push_back(text.size());
+        return starts;
+    }
+
+    static size_t line_count(const std::vector<size_t>& starts) { return starts.size() - 1; }
+
+    // Lines [first, last] (1-based, inclusive) become `text`; last == first - 1 inserts before `first`
+    static bool line_range(std::string_view original, const std::vector<size_t>& starts, size_t first, size_t last,
+                           std::string text, Replacement& out, std::string& error) {
+        const size_t lines = line_count(starts);
+        if (first < 1 || first > lines + 1 || last + 1 < first || last > lines) {
+            error = "line range " + std::to_string(first) + "-" + std::to_string(last) + " is outside the file (" +
+                    std::to_string(lines) + " lines)";
+            return false;
+        }
+        out.offset = starts[first - 1];
+        out.length = starts[last] - out.offset;
+        // Whole lines in, whole lines out: keep the line break the replaced block ended with
+        bool ends_line = out.length > 0 && original[out.offset + out.length - 1] == '\n';
+        if ((ends_line || last < first) && !text.empty() && text.back() != '\n') text += '\n';
+        // Appending after a last line that has no line break
+        if (last < first && out.offset == original.size() && !original.empty() && original.back() != '\n') {
+            text.insert(text.begin(), '\n');
+        }
+        out.text = std::move(text);
+        return true;
+    }
+
+    // Unified diff ("@@ -12,5 +12,6 @@" hunks; ---/+++ headers and "\ No newline" markers allowed)
+    static bool from_unified_diff(std::string_view original, std::string_view diff, std::vector<Replacement>& out,
+                                  std::string& error) {
+        const auto starts = line_starts(original);
+        const size_t lines = line_count(starts);
+        auto line_at = [&](size_t i) { return trim_eol(original.substr(starts[i], starts[i + 1] - starts[i])); };
+
+        size_t hunks = 0;
+        size_t min_line = 0; // Hunks apply in order and may not overlap
+        while (!diff.empty()) {
+            std::string_view line = next_line(diff);
+            if (!line.starts_with("@@")) continue; // File headers and chatter between hunks
+            size_t old_start = 0;
+            if (!parse_hunk_header(line, old_start)) {
+                error = "malformed hunk header: " + std::string(line);
+                return false;
+            }
+
+            // Old side (context + removed) and new side (context + added) of the hunk
+            std::vector<std::string_view> before;
+            std::string after;
+            bool no_newline_after = false;
+            char last_tag = 0;
+            size_t trailing_blank = 0; // Stripped blank lines at the very end of the input
+            while (!diff.empty() && !diff.starts_with("@@")) {
+                std::string_view body = peek_line(diff);
+                if (body.starts_with("diff ") || is_file_header(diff)) break; // Next file's headers
+                next_line(diff);
+                if (body.empty()) { // Blank context line whose leading space got stripped
+                    before.push_back({});
+                    after += '\n';
+                    last_tag = ' ';
+                    trailing_blank++;
+                    continue;
+                }
+                trailing_blank = 0;
+                char tag = body[0];
+                std::string_view rest = body.substr(1);
+                if (tag == ' ') {
+                    before.push_back(rest);
+                    after.append(rest) += '\n';
+                } else if (tag == '-') {
+                    before.push_back(rest);
+                } else if (tag == '+') {
+                    after.append(rest) += '\n';
+                    no_newline_after = false;
+                } else if (tag == '\\') {
+                    // Applies to the line just before it; only the new side's last line matters here
+                    if (last_tag == '+' || last_tag == ' ') no_newline_after = true;
+                    continue;
+                } else {
+                    break; // End of the diff body
+                }
+                last_tag = tag;
+            }
+            if (diff.empty()) { // Blank lines after the last hunk are the message's, not context
+                before.resize(before.size() - trailing_blank);
+                after.resize(after.size() - trailing_blank);
+            }
+            if (no_newline_after && !after.empty()) after.pop_back();
+
+            // Locate the old side: at the stated line first, then outward
+            size_t want = old_start > 0 ? old_start - 1 : 0;
+            if (before.empty()) want = old_start; // Pure insertion after line old_start
+            size_t found = lines + 1;
+            for (size_t d = 0; d <= HUNK_SEARCH_LINES && found > lines; ++d) {
+                for (int sign : {1, -1}) {
+                    if (d == 0 && sign < 0) continue;
+                    if (sign < 0 && d > want) continue;
+                    size_t at = sign > 0 ? want + d : want - d;
+                    if (at < min_line || at + before.size() > lines) continue;
+                    bool match = true;
+                    for (size_t k = 0; k < before.size() && match; ++k) match = same_line(line_at(at + k), before[k]);
+                    if (match) {
+                        found = at;
+                        break;
+                    }
+                }
+            }
+            if (found > lines) {
+                error = "hunk " + std::to_string(hunks + 1) + " (@@ -" + std::to_string(old_start) +
+                        ") does not match the file; read it again and resend the diff";
+                return false;
+            }
+
+            Replacement r;
+            r.offset = starts[found];
+            r.length = starts[found + before.size()] - r.offset;
+            // The file's last line may lack a newline that the diff body always adds
+            if (r.offset + r.length == original.size() && (original.empty() || original.back() != '\n') &&
+                !after.empty() && after.back() == '\n' && !no_newline_after && r.length > 0) {
+                after.pop_back();
+            }
+            r.text = std::move(after);
+            out.push_back(std::move(r));
+            min_line = found + before.size();
+            hunks++;
+        }
+        if (hunks == 0) {
+            error = "no @@ hunks found in the diff";
+            return false;
+        }
+        return true;
+    }
+
+    // Sorts `edits` and writes the patched text to `out`; overlapping edits are an error
+    static bool apply(std::string_view original, std::vector<Replacement>& edits, std::string& out, std::string& error) {
+        std::stable_sort(edits.begin(), edits.end(),
+                         [](const Replacement& a, const Replacement& b) { return a.offset < b.offset; });
+        size_t size = original.size();
+        size_t end = 0;
+        for (const auto& e : edits) {
+            if (e.offset > original.size() || e.length > original.size() - e.offset) {
+                error = "edit at byte " + std::to_string(e.offset) + " runs past the end of the file";
+                return false;
+            }
+            if (e.offset < end) {
+                error = "edits overlap at byte " + std::to_string(e.offset);
+                return false;
+            }
+            end = e.offset + e.length;
+            size = size - e.length + e.text.size();
+        }
+
+        out.clear();
+        out.reserve(size);
+        size_t at = 0;
+        for (const auto& e : edits) {
+            out.append(original.substr(at, e.offset - at)).append(e.text);
+            at = e.offset + e.length;
+        }
+        out.append(original.substr(at));
+        return true;
+    }
+
+    // Smallest span of `original` the edits touch, for the caller's reparse and logging
+    static std::pair<size_t, size_t> touched(const std::vector<Replacement>& edits) {
+        if (edits.empty()) return {0, 0};
+        size_t first = edits.front().offset, last = 0;
+        for (const auto& e : edits) {
+            first = std::min(first, e.offset);
+            last = std::max(last, e.offset + e.length);
+        }
+        return {first, last};
+    }
+
+private:
+    static std::string_view trim_eol(std::string_view s) {
+        if (!s.empty() && s.back() == '\n') s.remove_suffix(1);
+        if (!s.empty() && s.back() == '\r') s.remove_suffix(1);
+        return s;
+    }
+
+    static std::string_view peek_line(std::string_view text) {
+        return trim_eol(text.substr(0, text.find('\n')));
+    }
+
+    static std::string_view next_line(std::string_view& text) {
+        size_t eol = text.find('\n');
+        std::string_view line = trim_eol(text.substr(0, eol));
+        text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+        return line;
+    }
+
+    // "--- a/x" directly followed by "+++ b/x"; a lone "--- " line is a removed "-- " line
+    static bool is_file_header(std::string_view text) {
+        if (!text.starts_with("--- ")) return false;
+        size_t eol = text.find('\n');
+        return eol != std::string_view::npos && text.substr(eol + 1).starts_with("+++ ");
+    }
+
+    // Trailing whitespace is the usual casualty of a model retyping context lines
+    static bool same_line(std::string_view a, std::string_view b) {
+        auto rtrim = [](std::string_view s) {
+            size_t end = s.find_last_not_of(" \t");
+            return end == std::string_view::npos ? std::string_view{} : s.substr(0, end + 1);
+        };
+        return rtrim(a) == rtrim(b);
+    }
+
+    static bool parse_hunk_header(std::string_view line, size_t& old_start) {
+        size_t minus = line.find('-');
+        if (minus == std::string_view::npos) return false;
+        const char* p = line.data() + minus + 1;
+        auto [end, ec] = std::from_chars(p, line.data() + line.size(), old_start);
+        return ec == std::errc() && end != p;
+    }
+};
+
+} // namespace code_assistance
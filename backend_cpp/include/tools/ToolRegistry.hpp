@@ -4,9 +4,16 @@
 #include <map>
 #include <functional>
 #include <memory>
+#include <chrono>
+#include <future>
+#include <atomic>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 #include "LogManager.hpp"
+#include "StageMetrics.hpp"
+#include "RequestArena.hpp"
+#include "ThreadPool.hpp"
 
 namespace code_assistance {
 
@@ -14,6 +21,14 @@ struct ToolMetadata {
     std::string name;
     std::string description;
     std::string parameter_schema; 
+    bool read_only = false;  // No side effects: may run concurrently with other read-only calls
+    int timeout_ms = 30000;  // Read-only calls are abandoned past this
+};
+
+// One call requested by the model in a step
+struct ToolCall {
+    std::string name;
+    nlohmann::json args;
 };
 
 class ITool {
@@ -28,9 +43,9 @@ class GenericTool : public ITool {
     std::function<std::string(const std::string&)> action_;
 public:
     GenericTool(std::string name, std::string desc, std::string schema, 
-                std::function<std::string(const std::string&)> action)
+                std::function<std::string(const std::string&)> action, bool read_only = false)
         : action_(action) {
-        meta_ = {name, desc, schema};
+        meta_ = {name, desc, schema, read_only};
     }
     ToolMetadata get_metadata() override { return meta_; }
     std::string execute(const std::string& args) override { return action_(args); }
@@ -39,7 +54,25 @@ public:
 class ToolRegistry {
 private:
     std::map<std::string, std::unique_ptr<ITool>> tools_;
+    ThreadPool* pool_ = nullptr;
+
+    std::string execute_traced(ITool& tool, const std::string& name, const nlohmann::json& args) {
+        StageSpan span(Stage::Tool);
+        RequestArena arena; // The tool's temporaries (retrieval, context) go back in one shot
+
+        // Convert JSON args to string for the tool's execution
+        std::string res = tool.execute(args.dump());
+
+        double duration = span.stop();
+
+        LogManager::instance().add_trace({"AGENT", "", "TOOL_EXEC", name, duration});
+        return res;
+    }
+
 public:
+    // Read-only calls of a batch fan out on this pool's Interactive lane (sequential when unset)
+    void set_thread_pool(ThreadPool* pool) { pool_ = pool; }
+
     void register_tool(std::unique_ptr<ITool> tool) {
         spdlog::info("🛰️ Payload Integrated: {}", tool->get_metadata().name);
         tools_[tool->get_metadata().name] = std::move(tool);
@@ -75,19 +108,104 @@ public:
 
     // 🚀 FIX: Required by AgentExecutor for executing actions
     std::string dispatch(const std::string& name, const nlohmann::json& args) {
-        if (tools_.count(name)) {
-            auto start = std::chrono::high_resolution_clock::now();
-            
-            // Convert JSON args to string for the tool's execution
-            std::string res = tools_[name]->execute(args.dump());
-            
-            auto end = std::chrono::high_resolution_clock::now();
-            double duration = std::chrono::duration<double, std::milli>(end - start).count();
-
-            LogManager::instance().add_trace({"AGENT", "", "TOOL_EXEC", name, duration});
-            return res;
-        }
+        if (tools_.count(name)) return execute_traced(*tools_[name], name, args);
         return "ERROR: Tool '" + name + "' not found.";
     }
+
+    // 🪭 Runs a step's calls and returns their observations in call order.
+    // Consecutive read-only calls run concurrently, each bounded by its timeout; a call
+    // with side effects is a barrier that runs alone, after everything before it, with
+    // no timeout (a half-applied write cannot be abandoned). `while_waiting` runs once
+    // on the calling thread while the first read-only group is in flight. Once `cancel`
+    // turns true, pending reads are abandoned and no further call is started.
+    std::vector<std::string> dispatch_all(const std::vector<ToolCall>& calls,
+                                          const std::function<void()>& while_waiting = {},
+                                          const std::atomic<bool>* cancel = nullptr) {
+        auto cancelled = [cancel] { return cancel && cancel->load(std::memory_order_relaxed); };
+        std::vector<std::string> results(calls.size());
+        bool waited = false;
+        auto idle = [&] {
+            if (!waited && while_waiting) while_waiting();
+            waited = true;
+        };
+
+        size_t i = 0;
+        while (i < calls.size()) {
+            if (cancelled()) {
+                for (; i < calls.size(); ++i) results[i] = "ERROR: Mission cancelled.";
+                break;
+            }
+            auto it = tools_.find(calls[i].name);
+            if (it == tools_.end()) {
+                results[i] = "ERROR: Tool '" + calls[i].name + "' not found.";
+                ++i;
+                continue;
+            }
+            if (!pool_ || !it->second->get_metadata().read_only) {
+                idle();
+                try {
+                    results[i] = execute_traced(*it->second, calls[i].name, calls[i].args);
+                } catch (const std::exception& e) {
+                    results[i] = "ERROR: Tool '" + calls[i].name + "' failed: " + e.what();
+                }
+                ++i;
+                continue;
+            }
+
+            // Launch the run of read-only calls starting here
+            struct Pending {
+                size_t index;
+                std::future<std::string> result;
+                std::chrono::steady_clock::time_point deadline;
+                int timeout_ms;
+            };
+            std::vector<Pending> group;
+            for (; i < calls.size(); ++i) {
+                auto t = tools_.find(calls[i].name);
+                if (t == tools_.end()) {
+                    results[i] = "ERROR: Tool '" + calls[i].name + "' not found.";
+                    continue;
+                }
+                ToolMetadata meta = t->second->get_metadata();
+                if (!meta.read_only) break;
+
+                // The task owns its inputs: a timed-out call finishes on the pool unobserved
+                auto task = std::make_shared<std::packaged_task<std::string()>>(
+                    [this, tool = t->second.get(), name = calls[i].name, args = calls[i].args] {
+                        return execute_traced(*tool, name, args);
+                    });
+                group.push_back({i, task->get_future(),
+                                 std::chrono::steady_clock::now() + std::chrono::milliseconds(meta.timeout_ms),
+                                 meta.timeout_ms});
+                pool_->post(TaskPriority::Interactive, [task] { (*task)(); });
+            }
+            idle();
+
+            for (auto& p : group) {
+                const std::string& name = calls[p.index].name;
+                // Short slices so a cancelled mission stops waiting promptly
+                auto status = std::future_status::timeout;
+                while (!cancelled() && std::chrono::steady_clock::now() < p.deadline) {
+                    status = p.result.wait_until(std::min(p.deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(50)));
+                    if (status == std::future_status::ready) break;
+                }
+                if (status != std::future_status::ready && cancelled()) {
+                    results[p.index] = "ERROR: Mission cancelled.";
+                    continue;
+                }
+                if (status != std::future_status::ready) {
+                    spdlog::warn("⏱️ Tool '{}' timed out after {} ms", name, p.timeout_ms);
+                    results[p.index] = "ERROR: Tool '" + name + "' timed out after " + std::to_string(p.timeout_ms) + " ms.";
+                    continue;
+                }
+                try {
+                    results[p.index] = p.result.get();
+                } catch (const std::exception& e) {
+                    results[p.index] = "ERROR: Tool '" + name + "' failed: " + e.what();
+                }
+            }
+        }
+        return results;
+    }
 };
 }
\ No newline at end of file
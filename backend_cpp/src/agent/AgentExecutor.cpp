@@ -8,9 +8,14 @@
 #include <sstream>
 #include <filesystem>
 #include <spdlog/spdlog.h>
-#include <stack>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include "parser_elite.hpp"
+#include "agent/PromptBuilder.hpp"
+#include "agent/ToolCallScanner.hpp"
+#include "agent/ReadCache.hpp"
+#include "RequestArena.hpp"
 
 namespace code_assistance {
 
@@ -18,44 +23,15 @@ namespace fs = std::filesystem;
 
 // --- CONSTRUCTOR ---
 AgentExecutor::AgentExecutor(
-    std::shared_ptr<RetrievalEngine> engine,
+    std::shared_ptr<ProjectRetrieval> retrieval,
     std::shared_ptr<EmbeddingService> ai,
     std::shared_ptr<SubAgent> sub_agent,
     std::shared_ptr<ToolRegistry> tool_registry
-) : engine_(engine), ai_service_(ai), sub_agent_(sub_agent), tool_registry_(tool_registry) {
+) : retrieval_(std::move(retrieval)), ai_service_(ai), sub_agent_(sub_agent), tool_registry_(tool_registry) {
     context_mgr_ = std::make_unique<ContextManager>();
 }
 
 // --- HELPERS ---
-nlohmann::json extract_json(const std::string& raw) {
-    try {
-        std::stack<char> braces;
-        size_t start = std::string::npos;
-        size_t end = std::string::npos;
-
-        for (size_t i = 0; i < raw.length(); ++i) {
-            if (raw[i] == '{') {
-                if (braces.empty()) start = i;
-                braces.push('{');
-            } else if (raw[i] == '}') {
-                if (!braces.empty()) {
-                    braces.pop();
-                    if (braces.empty()) {
-                        end = i;
-                        break; 
-                    }
-                }
-            }
-        }
-
-        if (start != std::string::npos && end != std::string::npos) {
-            std::string clean_json = raw.substr(start, end - start + 1);
-            return nlohmann::json::parse(clean_json);
-        }
-    } catch (...) {}
-    return nlohmann::json::object();
-}
-
 std::string AgentExecutor::find_project_root() {
     fs::path p = fs::current_path();
     while (p.has_parent_path()) {
@@ -65,22 +41,30 @@ std::string AgentExecutor::find_project_root() {
     return fs::current_path().string();
 }
 
-void AgentExecutor::notify(::grpc::ServerWriter<::code_assistance::AgentResponse>* w, 
+void AgentExecutor::notify(MissionContext& mission, 
                             const std::string& phase, 
                             const std::string& msg, 
                             double duration_ms) {
-    if (w) {
-        ::code_assistance::AgentResponse res;
-        res.set_phase(phase);
-        res.set_payload(msg);
-        w->Write(res);
-    }
+    if (mission.emit) mission.emit(phase, msg);
     // Also push to trace log
     code_assistance::LogManager::instance().add_trace({"AGENT", "", phase, msg, duration_ms});
 }
 
 // --- CORE ENGINE ---
 std::string AgentExecutor::run_autonomous_loop(const ::code_assistance::UserQuery& req, ::grpc::ServerWriter<::code_assistance::AgentResponse>* writer) {
+    MissionContext mission;
+    if (writer) {
+        mission.emit = [writer](const std::string& phase, const std::string& payload) {
+            ::code_assistance::AgentResponse res;
+            res.set_phase(phase);
+            res.set_payload(payload);
+            writer->Write(res);
+        };
+    }
+    return run_mission(req, mission);
+}
+
+std::string AgentExecutor::run_mission(const ::code_assistance::UserQuery& req, MissionContext& mission) {
     auto mission_start_time = std::chrono::steady_clock::now();
     
     // 🚀 FIX 1: DEFINE CONTEXT HERE (Top Scope)
@@ -90,79 +74,135 @@ std::string AgentExecutor::run_autonomous_loop(const ::code_assistance::UserQuer
     ctx.focal_code = "";
 
     std::string tool_manifest = tool_registry_->get_manifest();
-    std::string internal_monologue = "";
-    std::unordered_set<size_t> action_history;
-    std::hash<std::string> hasher;
+    std::unordered_set<uint64_t> action_history; // ParsedToolCall fingerprints
 
     code_assistance::GenerationResult last_gen; 
     std::string final_output = "Mission Timed Out.";
+    int prompt_tokens = 0;     // Summed over steps
+    int completion_tokens = 0;
+    int cached_tokens = 0;
     
     int max_steps = 10;
+
+    ReadCache reads(req.project_id());
+    determineContextStrategy(req.prompt(), ctx, req.project_id());
+
+    // Manifest, mission and seeded context are fixed for the whole mission: they form the cached prefix
+    PromptBuilder prompt(
+        "### ROLE: Synapse Autonomous Pilot\n"
+        "### TOOLS\n" + tool_manifest + "\n\n"
+        "### MISSION\n" + req.prompt() + "\n\n" +
+        (ctx.architectural_map.empty() ? std::string() : "### PROJECT CONTEXT\n" + ctx.architectural_map + "\n\n") +
+        "### PROTOCOL\n"
+        "1. Format calls as JSON: {\"tool\": \"name\", \"parameters\": {...}}\n"
+        "2. Independent lookups may be batched: {\"tool_calls\": [{\"tool\": \"name\", \"parameters\": {...}}, ...]}\n"
+        "3. If answer found, use FINAL_ANSWER.\n",
+        HISTORY_TOKEN_BUDGET, *context_mgr_);
     
     for (int step = 0; step < max_steps; ++step) {
-        std::string prompt = 
-            "### ROLE: Synapse Autonomous Pilot\n"
-            "### TOOLS\n" + tool_manifest + "\n\n"
-            "### MISSION\n" + req.prompt() + "\n\n"
-            "### PROTOCOL\n"
-            "1. Format calls as JSON: {\"tool\": \"name\", \"parameters\": {...}}\n"
-            "2. If answer found, use FINAL_ANSWER.\n";
-
-        if (!internal_monologue.empty()) {
-            prompt += "\n### HISTORY\n" + internal_monologue;
+        RequestArena arena; // This step's temporaries (pruning, inline tool calls) are released together
+        if (mission.is_cancelled()) {
+            final_output = "CANCELLED";
+            goto mission_complete;
         }
-        prompt += "\nNEXT ACTION:";
-
-        last_gen = ai_service_->generate_text_elite(prompt);
+        // Tokens reach the client as they are generated; generation stops once the action closes
+        ToolCallScanner scanner;
+        last_gen = ai_service_->stream_text_elite(prompt.turns(), [&](std::string_view chunk) {
+            if (mission.emit) mission.emit("TOKEN", std::string(chunk));
+            return !scanner.feed(chunk);
+        }, &mission.cancelled);
         
+        if (mission.is_cancelled()) {
+            final_output = "CANCELLED";
+            goto mission_complete;
+        }
         if (!last_gen.success) {
-            this->notify(writer, "ERROR", "AI Service Unreachable");
+            this->notify(mission, "ERROR", "AI Service Unreachable");
             return "ERROR: AI Service Failure";
         }
+        prompt_tokens += last_gen.prompt_tokens;
+        completion_tokens += last_gen.completion_tokens;
+        cached_tokens += last_gen.cached_tokens;
 
-        std::string thought = last_gen.text;
-        this->notify(writer, "THOUGHT", "Step " + std::to_string(step));
+        AgentStep record;
+        record.action = scanner.closed() ? last_gen.text.substr(0, scanner.end()) : last_gen.text;
+        const std::string& thought = record.action;
+        this->notify(mission, "THOUGHT", "Step " + std::to_string(step));
 
-        nlohmann::json action = extract_json(thought);
-        
-        if (action.contains("tool")) {
-            std::string tool_name = action["tool"];
-            
-            // Loop Detection
-            std::string action_sig = tool_name + action["parameters"].dump();
-            size_t action_hash = hasher(action_sig);
-            
-            if (action_history.count(action_hash)) {
-                 internal_monologue += "\n[SYSTEM: Loop detected. Try different approach.]";
-                 continue; 
+        // The scanner parsed and fingerprinted the calls while they streamed in
+        std::vector<ToolCall> calls;
+        for (const auto& call : scanner.calls()) {
+            if (call.tool == "FINAL_ANSWER") {
+                final_output = call.parameters.value("answer", "Done.");
+                this->notify(mission, "FINAL", final_output);
+                goto mission_complete; 
             }
-            action_history.insert(action_hash);
 
-            if (tool_name == "FINAL_ANSWER") {
-                final_output = action["parameters"].value("answer", "Done.");
-                this->notify(writer, "FINAL", final_output);
-                goto mission_complete; 
+            // Loop Detection (repeat reads are settled by the read cache below)
+            if (ReadCache::loop_checked(call.tool) && !action_history.insert(call.fingerprint).second) {
+                record.notes += "\n[SYSTEM: Loop detected on " + call.tool + ". Try different approach.]";
+                continue;
             }
 
-            nlohmann::json params = action.value("parameters", nlohmann::json::object());
+            nlohmann::json params = call.parameters;
             params["project_id"] = req.project_id();
+            calls.push_back({call.tool, std::move(params)});
+        }
 
-            std::string observation = tool_registry_->dispatch(tool_name, params);
-            
-            if (tool_name == "read_file" && !observation.starts_with("ERROR")) {
-                ctx.focal_code += "\nFile: " + params.value("path", "") + "\n" + observation;
-            }
-
-            internal_monologue += "\n[RESULT: " + tool_name + "]\n" + observation;
-            this->notify(writer, "TOOL_EXEC", "Used " + tool_name);
-            
-        } else {
+        if (scanner.calls().empty()) {
             if (thought.find("FINAL_ANSWER") != std::string::npos) {
                 final_output = thought;
                 goto mission_complete;
             }
-            internal_monologue += "\n[SYSTEM: Invalid JSON. Retry.]";
+            record.notes = "\n[SYSTEM: Invalid JSON. Retry.]";
+        }
+
+        // Repeat reads of unchanged files are answered from the history
+        std::vector<std::string> observations(calls.size());
+        std::vector<std::string> keys(calls.size());
+        std::vector<ToolCall> pending;
+        std::vector<size_t> pending_at;
+        for (size_t i = 0; i < calls.size(); ++i) {
+            if (calls[i].name == "read_file") {
+                keys[i] = reads.key(calls[i].args);
+                const ReadCache::Mark* mark = reads.find(keys[i]);
+                const StepObservation* seen = mark ? prompt.observation(mark->step, mark->index) : nullptr;
+                if (seen && !seen->digested && seen->text.size() == mark->bytes) {
+                    observations[i] = "[read_file] " + ReadCache::path_of(calls[i].args) + " is unchanged since step " +
+                                      std::to_string(mark->step) + "; its content is in that step's result.";
+                    continue;
+                }
+            }
+            pending.push_back(std::move(calls[i]));
+            pending_at.push_back(i);
+        }
+
+        // Read-only tools run on the pool while this thread prunes the history
+        auto results = tool_registry_->dispatch_all(pending, [&] { prompt.prepare(); }, &mission.cancelled);
+        for (size_t k = 0; k < pending.size(); ++k) {
+            observations[pending_at[k]] = std::move(results[k]);
+            calls[pending_at[k]] = std::move(pending[k]);
+        }
+
+        const size_t step_index = prompt.steps();
+        for (size_t i = 0; i < calls.size(); ++i) {
+            const std::string& tool_name = calls[i].name;
+            if (tool_name == "read_file" && !observations[i].starts_with("ERROR") && !observations[i].starts_with("[read_file]")) {
+                // The content lives in the history; the log only names what was read
+                ctx.focal_code += "\nFile: " + ReadCache::path_of(calls[i].args) + " (" +
+                                  std::to_string(observations[i].size()) + " bytes, step " + std::to_string(step_index) + ")";
+                reads.remember(keys[i], {step_index, i, observations[i].size()});
+            }
+            this->notify(mission, "TOOL_EXEC", "Used " + tool_name);
+            record.observations.push_back({tool_name, std::move(observations[i])});
         }
+        prompt.add_step(std::move(record));
+        // A clipped read is not the whole range: the next read of it runs again
+        reads.forget_if([&](const ReadCache::Mark& mark) {
+            const StepObservation* o = prompt.observation(mark.step, mark.index);
+            return mark.step == step_index && (!o || o->text.size() != mark.bytes);
+        });
+        prompt.prepare();
     }
 
 mission_complete:
@@ -177,14 +217,15 @@ mission_complete:
     log.user_query = req.prompt();
     log.ai_response = final_output;
     log.duration_ms = total_ms;
-    log.prompt_tokens = last_gen.prompt_tokens;
-    log.completion_tokens = last_gen.completion_tokens;
-    log.total_tokens = last_gen.total_tokens;
+    log.prompt_tokens = prompt_tokens;
+    spdlog::info("🧮 Mission prompt tokens: {} ({} from prefix cache)", prompt_tokens, cached_tokens);
+    log.completion_tokens = completion_tokens;
+    log.total_tokens = prompt_tokens + completion_tokens;
 
     // 🚀 FIX: Now 'ctx' is visible here
-    log.full_prompt = "### HISTORY:\n" + internal_monologue + "\n### FOCAL CODE:\n" + ctx.focal_code;
+    log.full_prompt = "### HISTORY:\n" + prompt.transcript() + "\n### FOCAL CODE:\n" + ctx.focal_code;
 
-    code_assistance::LogManager::instance().add_log(log);
+    code_assistance::LogManager::instance().add_log(std::move(log));
 
     return final_output;
 }
@@ -196,8 +237,24 @@ std::string AgentExecutor::run_autonomous_loop_internal(const nlohmann::json& bo
     return this->run_autonomous_loop(fake_req, nullptr); 
 }
 
+// Identifier-shaped prompts are answered from the lexical index; the rest embed the prompt
+// once. The hits go in as the sub-agent's topology map: full code for the top nodes,
+// signatures for the next, one line for the rest. A project never synced is skipped.
 void AgentExecutor::determineContextStrategy(const std::string& query, ContextSnapshot& ctx, const std::string& project_id) {
-    // Implementation placeholder
+    if (!retrieval_ || project_id.empty() || query.empty()) return;
+    fs::path storage = fs::path(project_id) / ".study_assistant";
+    if (!FaissVectorStore::exists((storage / "vector_store").string())) return;
+    try {
+        ProjectQuery seed;
+        seed.query = query;
+        seed.max_nodes = SEED_NODES;
+        seed.max_chars = 0; // The sub-agent renders the tiers instead
+        auto answer = retrieval_->retrieve(project_id, project_id, storage.string(), seed);
+        if (!answer.results.empty()) ctx.architectural_map = sub_agent_->generate_topology(answer.results);
+        spdlog::info("🧭 Mission seeded with {} nodes{}", answer.results.size(), answer.lexical ? " (lexical)" : "");
+    } catch (const std::exception& e) {
+        spdlog::warn("⚠️ Mission context retrieval failed: {}", e.what());
+    }
 }
 
 bool AgentExecutor::check_reflection(const std::string& query, const std::string& topo, std::string& reason) {
@@ -1,37 +1,139 @@
-#include "proto/agent.grpc.pb.h" 
-#include "agent/AgentExecutor.hpp"
+#include "agent/AgentService.hpp"
+#include <deque>
+#include <mutex>
+#include <spdlog/spdlog.h>
 
 namespace code_assistance {
 
-class AgentServiceImpl final : public AgentService::Service {
-    
-    std::shared_ptr<AgentExecutor> executor;
+using grpc::ServerWriteReactor;
+using grpc::Status;
 
+namespace {
+
+// 📡 One streamed mission on the callback API. No gRPC thread is held while the mission
+// runs: the mission executes on the scheduler and pushes responses into an outbox that
+// is drained one StartWrite at a time. The reactor lives until OnDone, which gRPC only
+// calls after our Finish, and Finish only happens once the mission has returned and the
+// outbox is empty, so the mission thread never outlives the object it writes to.
+class MissionReactor final : public ServerWriteReactor<AgentResponse> {
 public:
-    // Constructor injection
-    explicit AgentServiceImpl(std::shared_ptr<AgentExecutor> exec) : executor(exec) {}
-
-    grpc::Status ExecuteTask(
-        grpc::ServerContext* context, 
-        const UserQuery* request, 
-        grpc::ServerWriter<AgentResponse>* writer
-    ) override {
-        
+    MissionReactor(std::shared_ptr<AgentExecutor> executor,
+                   MissionScheduler& scheduler,
+                   const UserQuery& request)
+        : executor_(std::move(executor)), request_(request) {
+        spdlog::info("🛰️ Mission Received: [{}] {} ({} running, {} queued)", request_.session_id(), request_.prompt(),
+                     scheduler.running(), scheduler.queued());
+        mission_.emit = [this](const std::string& phase, const std::string& payload) { emit(phase, payload); };
+
+        // 1. Acknowledge
+        emit("STARTUP", "Ignition sequence started...");
+
+        if (!scheduler.submit([this] { run(); })) {
+            spdlog::warn("🚦 Mission refused: {} queued", scheduler.queued());
+            complete(Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Agent is at capacity, retry later"));
+        }
+    }
+
+    void OnCancel() override {
+        spdlog::info("🛑 Mission cancelled by client: [{}]", request_.session_id());
+        mission_.cancelled = true;
+    }
+
+    void OnWriteDone(bool ok) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!ok) {
+            // Stream is gone: stop the mission and drop whatever it still wanted to say
+            mission_.cancelled = true;
+            outbox_.clear();
+        }
+        if (!outbox_.empty()) {
+            current_ = std::move(outbox_.front());
+            outbox_.pop_front();
+            lock.unlock();
+            StartWrite(&current_);
+            return;
+        }
+        writing_ = false;
+        finish_if_idle(lock);
+    }
+
+    void OnDone() override { delete this; }
+
+private:
+    void run() {
+        if (mission_.is_cancelled()) {
+            complete(Status::CANCELLED); // Client left while the mission was queued
+            return;
+        }
+        try {
+            // 2. Execute Autonomous Loop
+            std::string final_answer = executor_->run_mission(request_, mission_);
+
+            // 3. Final Payload
+            emit("FINAL", final_answer);
+            spdlog::info("✅ Mission Complete");
+            complete(mission_.is_cancelled() ? Status::CANCELLED : Status::OK);
+        } catch (const std::exception& e) {
+            spdlog::error("💥 Mission Crash: {}", e.what());
+            emit("ERROR", std::string("Internal Engine Failure: ") + e.what());
+            complete(Status::CANCELLED);
+        }
+    }
+
+    void emit(const std::string& phase, const std::string& payload) {
         AgentResponse res;
-        res.set_phase("STARTUP");
-        res.set_payload("Agent Service Connected.");
-        writer->Write(res);
+        res.set_phase(phase);
+        res.set_payload(payload);
 
-        // 🚀 FIX 2: Correct Argument Count (2 Args)
-        // Pass the request object (dereferenced) and the writer pointer
-        std::string final_answer = executor->run_autonomous_loop(*request, writer);
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (mission_.is_cancelled() || finishing_) return;
+        if (writing_) {
+            outbox_.push_back(std::move(res));
+            return;
+        }
+        writing_ = true;
+        current_ = std::move(res);
+        lock.unlock();
+        StartWrite(&current_);
+    }
 
-        res.set_phase("FINAL");
-        res.set_payload(final_answer);
-        writer->Write(res);
+    void complete(Status status) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_ = true;
+        status_ = std::move(status);
+        finish_if_idle(lock);
+    }
 
-        return grpc::Status::OK;
+    // Caller holds the lock
+    void finish_if_idle(std::unique_lock<std::mutex>& lock) {
+        if (!done_ || writing_ || finishing_) return;
+        finishing_ = true;
+        Status status = status_;
+        lock.unlock();
+        Finish(status);
     }
+
+    std::shared_ptr<AgentExecutor> executor_;
+    UserQuery request_;
+    MissionContext mission_;
+
+    std::mutex mutex_;
+    std::deque<AgentResponse> outbox_;
+    AgentResponse current_; // The one write in flight
+    bool writing_ = false;
+    bool done_ = false;
+    bool finishing_ = false;
+    Status status_;
 };
 
-} // namespace code_assistance
\ No newline at end of file
+} // namespace
+
+AgentServiceImpl::AgentServiceImpl(std::shared_ptr<AgentExecutor> executor, MissionScheduler& scheduler)
+    : executor_(std::move(executor)), scheduler_(scheduler) {}
+
+grpc::ServerWriteReactor<AgentResponse>* AgentServiceImpl::ExecuteTask(grpc::CallbackServerContext* /*context*/,
+                                                                       const UserQuery* request) {
+    return new MissionReactor(executor_, scheduler_, *request);
+}
+
+} // namespace code_assistance
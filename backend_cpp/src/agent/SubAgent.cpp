@@ -1,57 +1,145 @@
 #include "agent/SubAgent.hpp"
-#include <sstream>
-#include <regex>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <string_view>
 
 namespace code_assistance {
 
+namespace {
+
+constexpr size_t IMPLEMENTATION_TIER = 3; // Top 3: full implementation
+constexpr size_t STRUCTURE_TIER = 15;     // Next 12: signatures only
+constexpr size_t TOPOLOGY_LIMIT = 250000; // Hard stop to prevent prompt overflow (SpaceX limit check)
+constexpr size_t PARALLEL_MIN = 64;       // Candidates below this are formatted on the calling thread
+constexpr std::string_view HEADER = "### PROJECT ARCHITECTURAL TOPOLOGY (T-MAP)\n";
+
+// Sinks for render(): one pass sizes every entry, the second writes it in place
+struct Counter {
+    size_t n = 0;
+    void operator()(std::string_view s) { n += s.size(); }
+};
+struct Writer {
+    char* p;
+    void operator()(std::string_view s) {
+        std::memcpy(p, s.data(), s.size());
+        p += s.size();
+    }
+};
+
+template <class Out>
+void render_signatures(std::string_view signatures, Out& out) {
+    if (signatures.empty()) {
+        out("    (Utility/Script Logic)");
+        return;
+    }
+    while (!signatures.empty()) {
+        size_t eol = signatures.find('\n');
+        out("    ");
+        out(signatures.substr(0, eol));
+        out(" ...\n");
+        signatures.remove_prefix(eol == std::string_view::npos ? signatures.size() : eol + 1);
+    }
+}
+
+template <class Out>
+void render(const CodeNode& node, size_t i, std::string_view signatures, Out& out) {
+    // TIER 1: Focal Points - Provide Full implementation context
+    if (i < IMPLEMENTATION_TIER) {
+        out("[TIER: IMPLEMENTATION] FILE: "); out(node.file_path);
+        out(" | NODE: "); out(node.name); out("\n");
+        out(node.text()); out("\n---\n");
+    }
+    // TIER 2: Structural Context - Provide only "The What"
+    else if (i < STRUCTURE_TIER) {
+        out("[TIER: STRUCTURE] FILE: "); out(node.file_path);
+        out(" | NODE: "); out(node.name); out(" (Type: "); out(node.type); out(")\n");
+        out("  AI_SUMMARY: "); out(node.ai_summary); out("\n");
+        out("  SIGNATURES:\n");
+        render_signatures(signatures, out);
+        out("\n");
+    }
+    // TIER 3: Ambient Context (The rest) - Provide only "The Connectivity"
+    else {
+        std::array<char, 24> deps;
+        auto end = std::to_chars(deps.data(), deps.data() + deps.size(), node.dependencies.size()).ptr;
+        out("[TIER: TOPOLOGY] "); out(node.file_path); out(" -> "); out(node.name);
+        out(" (Ref: "); out(std::string_view(deps.data(), end - deps.data())); out(" deps)\n");
+    }
+}
+
+} // namespace
+
 std::string SubAgent::generate_topology(const std::vector<RetrievalResult>& nodes) {
-    std::stringstream topo;
-    topo << "### PROJECT ARCHITECTURAL TOPOLOGY (T-MAP)\n";
-
-    for (size_t i = 0; i < nodes.size(); ++i) {
-        const auto& cand = nodes[i];
-        
-        // TIER 1: Focal Points (Top 3) - Provide Full implementation context
-        if (i < 3) {
-            topo << "[TIER: IMPLEMENTATION] FILE: " << cand.node->file_path 
-                 << " | NODE: " << cand.node->name << "\n"
-                 << cand.node->content << "\n---\n";
-        } 
-        // TIER 2: Structural Context (Next 12) - Provide only "The What"
-        else if (i < 15) {
-            topo << "[TIER: STRUCTURE] FILE: " << cand.node->file_path 
-                 << " | NODE: " << cand.node->name << " (Type: " << cand.node->type << ")\n"
-                 << "  AI_SUMMARY: " << cand.node->ai_summary << "\n"
-                 << "  SIGNATURES:\n" << extract_signatures(cand.node->content) << "\n";
-        }
-        // TIER 3: Ambient Context (The rest) - Provide only "The Connectivity"
-        else {
-            topo << "[TIER: TOPOLOGY] " << cand.node->file_path << " -> " << cand.node->name 
-                 << " (Ref: " << cand.node->dependencies.size() << " deps)\n";
-        }
+    // Signatures come precomputed from the parser; only nodes stored before that are scanned
+    std::vector<std::string> scanned(std::min(nodes.size(), STRUCTURE_TIER));
+    for (size_t i = IMPLEMENTATION_TIER; i < scanned.size(); ++i) {
+        if (nodes[i].node->signatures.empty()) scanned[i] = extract_signatures(nodes[i].node->text());
+    }
+    auto signatures_of = [&](size_t i) -> std::string_view {
+        if (i < scanned.size() && !scanned[i].empty()) return scanned[i];
+        return nodes[i].node->signatures;
+    };
+
+    const long n = static_cast<long>(nodes.size());
+    std::vector<size_t> offsets(nodes.size() + 1, 0);
+#pragma omp parallel for if (n >= static_cast<long>(PARALLEL_MIN)) schedule(static)
+    for (long i = 0; i < n; ++i) {
+        Counter count;
+        render(*nodes[i].node, i, signatures_of(i), count);
+        offsets[i + 1] = count.n;
+    }
 
-        // Hard stop to prevent prompt overflow (SpaceX limit check)
-        if (topo.str().length() > 250000) break; 
+    // Running length: stop after the entry that crosses the limit, as the stream version did
+    size_t kept = 0, length = HEADER.size();
+    while (kept < nodes.size()) {
+        length += offsets[kept + 1];
+        offsets[kept + 1] = length;
+        kept++;
+        if (length > TOPOLOGY_LIMIT) break;
     }
+    offsets[0] = HEADER.size();
 
-    return topo.str();
+    std::string topo(length, '\0');
+    std::memcpy(topo.data(), HEADER.data(), HEADER.size());
+    const long m = static_cast<long>(kept);
+#pragma omp parallel for if (m >= static_cast<long>(PARALLEL_MIN)) schedule(static)
+    for (long i = 0; i < m; ++i) {
+        Writer write{topo.data() + offsets[i]};
+        render(*nodes[i].node, i, signatures_of(i), write);
+    }
+    return topo;
 }
 
-std::string SubAgent::extract_signatures(const std::string& code) {
+std::string SubAgent::extract_signatures(std::string_view code) {
+    // Python/TS/JS/C++ declaration keywords. Reject: Comments and logic. Accept: Headers.
+    static constexpr std::string_view KEYWORDS[] = {"def", "class", "async def", "export", "function",
+                                                    "void", "int", "auto", "struct", "interface"};
     std::string signatures;
-    std::istringstream stream(code);
-    std::string line;
-    
-    // Regex for Python/TS/JS/C++ signatures
-    // Reject: Comments and logic. Accept: Headers.
-    std::regex sig_re(R"(^\s*(def|class|async def|export|function|void|int|auto|struct|interface)\s+([a-zA-Z0-9_]+))");
-
-    while (std::getline(stream, line)) {
-        if (std::regex_search(line, sig_re)) {
-            signatures += "    " + line + " ...\n";
+    while (!code.empty()) {
+        size_t eol = code.find('\n');
+        std::string_view line = code.substr(0, eol);
+        code.remove_prefix(eol == std::string_view::npos ? code.size() : eol + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        size_t indent = line.find_first_not_of(" \t");
+        if (indent == std::string_view::npos) continue;
+        std::string_view rest = line.substr(indent);
+        for (std::string_view kw : KEYWORDS) {
+            if (rest.size() <= kw.size() + 1 || rest.compare(0, kw.size(), kw) != 0) continue;
+            size_t name = rest.find_first_not_of(" \t", kw.size());
+            if (name == kw.size() || name == std::string_view::npos) continue;
+            char c = rest[name];
+            if (std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
+                if (!signatures.empty()) signatures += '\n';
+                signatures.append(line);
+                break;
+            }
         }
     }
-    return signatures.empty() ? "    (Utility/Script Logic)" : signatures;
+    return signatures;
 }
 
-} // namespace code_assistance
\ No newline at end of file
+} // namespace code_assistance
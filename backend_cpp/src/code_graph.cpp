@@ -1,4 +1,6 @@
 #include "code_graph.hpp"
+#include "graph_centrality.hpp"
+#include "Utf8.hpp"
 #include <regex>
 #include <iostream>
 #include <sstream>
@@ -13,26 +15,18 @@ namespace code_assistance {
 namespace fs = std::filesystem; 
 using json = nlohmann::json;
 
-std::string sanitize_utf8(const std::string& str) {
-    std::string safe_str;
-    safe_str.reserve(str.size());
-    for (size_t i = 0; i < str.length(); ++i) {
-        unsigned char c = static_cast<unsigned char>(str[i]);
-        if (c < 0x80) safe_str += c;
-        else if (c >= 0xC0) safe_str += c; 
-        else if (c >= 0x80 && c < 0xC0) safe_str += c;
-        else safe_str += '?';
-    }
-    return safe_str;
-}
+// Single copy when already valid (the common case), U+FFFD for broken sequences:
+// nlohmann::json refuses to dump invalid UTF-8
+std::string sanitize_utf8(std::string_view str) { return Utf8::repair(str); }
 
 json CodeNode::to_json() const {
     try {
         return json{
             {"id", sanitize_utf8(id)},
             {"name", sanitize_utf8(name)},
-            {"content", sanitize_utf8(content)}, 
+            {"content", sanitize_utf8(text())},
             {"docstring", sanitize_utf8(docstring)},
+            {"signatures", sanitize_utf8(signatures)},
             {"file_path", sanitize_utf8(file_path)},
             {"type", type},
             {"dependencies", dependencies},
@@ -51,65 +45,69 @@ CodeNode CodeNode::from_json(const json& j) {
     node.name = safe_get("name");
     node.content = safe_get("content");
     node.docstring = safe_get("docstring");
+    node.signatures = safe_get("signatures");
     node.file_path = safe_get("file_path");
     node.type = safe_get("type");
     if (j.contains("dependencies")) node.dependencies = j["dependencies"].get<std::unordered_set<std::string>>();
     if (j.contains("embedding")) node.embedding = j["embedding"].get<std::vector<float>>();
     if (j.contains("weights")) node.weights = j["weights"].get<std::unordered_map<std::string, double>>();
+    auto structural = node.weights.find("structural");
+    if (structural != node.weights.end()) node.structural_weight = static_cast<float>(structural->second);
     node.ai_summary = safe_get("ai_summary");
     node.ai_quality_score = j.value("ai_quality_score", 0.5);
     return node;
 }
 
 // --- ROBUST HYBRID PARSER ---
+// Walks the buffer line by line as views; blocks are recorded as byte ranges into it.
 class BracketParser {
 public:
-    static std::vector<CodeNode> parse(const std::string& file_path, const std::string& content) {
+    static std::vector<CodeNode> parse(const std::string& file_path, const std::shared_ptr<const std::string>& source) {
         std::vector<CodeNode> nodes;
-        std::istringstream stream(content);
-        std::string line;
-        
-        std::string buffer;
+        const std::string_view content(*source);
+
+        size_t block_start = 0;
         int brace_level = 0;
         bool in_function = false;
         std::string current_signature;
+        std::string_view current_head;
+        std::string file_signatures;
         std::unordered_set<std::string> file_imports;
-        
-        std::regex func_start_re(R"((?:class|struct|interface|function|const|let|var|void|int|auto)\s+([a-zA-Z0-9_:]+))");
 
-        while (std::getline(stream, line)) {
-            if (!line.empty() && line.back() == '\r') line.pop_back();
+        static const std::regex func_start_re(R"((?:class|struct|interface|function|const|let|var|void|int|auto)\s+([a-zA-Z0-9_:]+))");
+
+        for (size_t pos = 0; pos < content.size();) {
+            size_t eol = content.find('\n', pos);
+            size_t next = eol == std::string_view::npos ? content.size() : eol + 1;
+            std::string_view line = content.substr(pos, next - pos);
+            size_t line_start = pos;
+            pos = next;
 
-            std::string clean_line = line; 
+            std::string_view clean_line = line;
+            while (!clean_line.empty() && (clean_line.back() == '\n' || clean_line.back() == '\r')) clean_line.remove_suffix(1);
             // Simple trim
-            clean_line.erase(0, clean_line.find_first_not_of(" \t"));
-            
+            size_t indent = clean_line.find_first_not_of(" \t");
+            clean_line.remove_prefix(indent == std::string_view::npos ? clean_line.size() : indent);
+
             // 1. MANUAL IMPORT SCANNING (Reliable)
             if (clean_line.rfind("import ", 0) == 0) { // Starts with "import "
                 size_t from_pos = clean_line.find("from");
-                if (from_pos != std::string::npos) {
+                if (from_pos != std::string_view::npos) {
                     // Extract substring after 'from'
-                    std::string after_from = clean_line.substr(from_pos + 4);
-                    
+                    std::string_view after_from = clean_line.substr(from_pos + 4);
+
                     // Find quotes
                     size_t first_quote = after_from.find_first_of("'\"");
                     size_t last_quote = after_from.find_last_of("'\"");
-                    
-                    if (first_quote != std::string::npos && last_quote != std::string::npos && last_quote > first_quote) {
-                        std::string path = after_from.substr(first_quote + 1, last_quote - first_quote - 1);
-                        
+
+                    if (first_quote != std::string_view::npos && last_quote != std::string_view::npos && last_quote > first_quote) {
+                        std::string_view path = after_from.substr(first_quote + 1, last_quote - first_quote - 1);
+
                         // Clean Path Logic
                         size_t last_slash = path.find_last_of('/');
-                        if (last_slash != std::string::npos) path = path.substr(last_slash + 1);
-
-                        // size_t dot = path.find_last_of('.');
-                        // if (dot != std::string::npos && dot > 0) path = path.substr(0, dot);
-                        
-                        file_imports.insert(path);
-                        // DEBUG LOG
-                        if(file_path.find("app.ts") != std::string::npos) {
-                             spdlog::info("🔗 Import Detected in {}: {}", file_path, path);
-                        }
+                        if (last_slash != std::string_view::npos) path = path.substr(last_slash + 1);
+
+                        file_imports.emplace(path);
                     }
                 }
             }
@@ -124,30 +122,34 @@ public:
 
             // 3. Function Extraction
             if (!in_function) {
-                std::smatch match;
-                if (open_braces > 0 && std::regex_search(clean_line, match, func_start_re)) {
+                std::cmatch match;
+                if (open_braces > 0 &&
+                    std::regex_search(clean_line.data(), clean_line.data() + clean_line.size(), match, func_start_re)) {
                     in_function = true;
-                    brace_level = 0;
                     current_signature = match[1].str();
-                    buffer = line + "\n";
-                    brace_level += (open_braces - close_braces);
+                    current_head = clean_line;
+                    block_start = line_start;
+                    brace_level = open_braces - close_braces;
                 }
             } else {
-                buffer += line + "\n";
                 brace_level += (open_braces - close_braces);
-                if (brace_level <= 0) {
-                    CodeNode node;
-                    node.name = current_signature;
-                    node.file_path = file_path;
-                    node.id = file_path + "::" + current_signature;
-                    node.content = buffer;
-                    node.type = "code_block";
-                    node.weights = {{"structural", 0.7}};
-                    node.dependencies = file_imports; 
-                    nodes.push_back(node);
-                    in_function = false;
-                    buffer = "";
-                }
+            }
+
+            if (in_function && brace_level <= 0) {
+                CodeNode node;
+                node.name = current_signature;
+                node.file_path = file_path;
+                node.id = file_path + "::" + current_signature;
+                node.set_source(source, block_start, pos - block_start);
+                node.type = "code_block";
+                node.signatures = std::string(current_head);
+                if (!file_signatures.empty()) file_signatures += '\n';
+                file_signatures += node.signatures;
+                node.weights = {{"structural", 0.7}};
+                node.structural_weight = 0.7f;
+                node.dependencies = file_imports;
+                nodes.push_back(std::move(node));
+                in_function = false;
             }
         }
 
@@ -155,27 +157,59 @@ public:
         file_node.name = fs::path(file_path).filename().string();
         file_node.file_path = file_path;
         file_node.id = file_path;
-        file_node.content = content;
+        file_node.set_source(source, 0, content.size());
         file_node.type = "file";
+        file_node.signatures = std::move(file_signatures);
         file_node.weights = {{"structural", 1.0}};
-        file_node.dependencies = file_imports;
-        nodes.push_back(file_node);
+        file_node.structural_weight = 1.0f;
+        file_node.dependencies = std::move(file_imports);
+        nodes.push_back(std::move(file_node));
 
         return nodes;
     }
 };
 
-std::vector<CodeNode> CodeParser::extract_nodes_from_file(const std::string& file_path, const std::string& content) {
-    return BracketParser::parse(file_path, content);
+std::vector<CodeNode> CodeParser::extract_nodes_fallback(const std::string& file_path, const std::shared_ptr<const std::string>& source) {
+    return BracketParser::parse(file_path, source);
 }
 
 void CodeGraph::add_node(std::shared_ptr<CodeNode> node) {
+    priors_.push_back(node->structural_weight);
     all_nodes_.push_back(node);
     name_to_node_map_[node->name] = node;
 }
 
 void CodeGraph::calculate_static_weights() {
-    // Basic weight calculation
+    // Dependencies name node ids (resolved calls) or, failing that, node names (imports)
+    std::unordered_map<std::string_view, uint32_t> by_id;
+    by_id.reserve(all_nodes_.size());
+    for (uint32_t u = 0; u < all_nodes_.size(); ++u) by_id.emplace(all_nodes_[u]->id, u);
+    std::unordered_map<const CodeNode*, uint32_t> dense;
+    dense.reserve(all_nodes_.size());
+    for (uint32_t u = 0; u < all_nodes_.size(); ++u) dense.emplace(all_nodes_[u].get(), u);
+
+    CsrGraph g;
+    g.labels.resize(all_nodes_.size());
+    std::iota(g.labels.begin(), g.labels.end(), 0);
+    g.offsets.reserve(all_nodes_.size() + 1);
+    g.offsets.push_back(0);
+    for (uint32_t u = 0; u < all_nodes_.size(); ++u) {
+        for (const auto& dep : all_nodes_[u]->dependencies) {
+            uint32_t v = CsrGraph::NONE;
+            if (auto it = by_id.find(dep); it != by_id.end()) v = it->second;
+            else if (auto named = name_to_node_map_.find(dep); named != name_to_node_map_.end()) v = dense[named->second.get()];
+            if (v != CsrGraph::NONE && v != u) g.targets.push_back(v);
+        }
+        g.offsets.push_back(static_cast<uint32_t>(g.targets.size()));
+    }
+
+    Centrality c = compute_centrality(g);
+    for (uint32_t u = 0; u < c.score.size(); ++u) {
+        CodeNode& node = *all_nodes_[u];
+        node.structural_weight = blend_structural(priors_[u], c.score[u]);
+        node.weights["structural"] = node.structural_weight;
+        node.weights["centrality"] = c.score[u];
+    }
 }
 
 } // namespace code_assistance
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include "dir_walker.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace code_assistance {
+
+namespace {
+
+struct PendingDir {
+    std::string rel; // "" for the root
+    int depth = 0;
+};
+
+struct WalkState {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<PendingDir> stack; // LIFO: depth-first keeps the frontier small
+    size_t active = 0;             // Workers currently listing a directory
+    size_t helpers = 0;            // Helper threads inside work()
+    size_t queued_helpers = 0;     // Posted to the pool, not started yet
+    size_t helper_limit = 0;
+    bool finished = false;
+    // Set when helpers run on a pool: they leave instead of waiting for work, so a new
+    // one is posted when the frontier grows again
+    std::function<void()> post_helper;
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> dirs{0};
+    std::atomic<size_t> files{0};
+    std::atomic<size_t> errors{0};
+};
+
+// Lists one directory: `emit(name, is_dir)` per entry, except "." and ".."
+#ifdef _WIN32
+
+std::wstring widen(const std::string& s) {
+    if (s.empty()) return {};
+    int n = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), nullptr, 0);
+    std::wstring w(n, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), w.data(), n);
+    return w;
+}
+
+std::string narrow(const wchar_t* w) {
+    int n = WideCharToMultiByte(CP_UTF8, 0, w, -1, nullptr, 0, nullptr, nullptr);
+    std::string s(n > 0 ? n - 1 : 0, '\0');
+    if (n > 1) WideCharToMultiByte(CP_UTF8, 0, w, -1, s.data(), n, nullptr, nullptr);
+    return s;
+}
+
+class DirLister {
+public:
+    DirLister(const fs::path& root, const fs::path& skip) : root_(root.wstring()) {
+        std::error_code ec;
+        fs::path rel = skip.empty() ? fs::path() : fs::relative(skip, root, ec);
+        if (!ec && !rel.empty() && *rel.begin() != "..") skip_rel_ = rel.generic_string();
+    }
+
+    bool is_skip(const std::string& rel) const {
+        return !skip_rel_.empty() && rel.size() == skip_rel_.size() &&
+               std::equal(rel.begin(), rel.end(), skip_rel_.begin(),
+                          [](char a, char b) { return std::tolower((unsigned char)a) == std::tolower((unsigned char)b); });
+    }
+
+    template<typename Emit>
+    bool list(const std::string& rel, Emit&& emit) const {
+        std::wstring pattern = root_;
+        if (!rel.empty()) pattern += L"\\" + widen(rel);
+        pattern += L"\\*";
+
+        WIN32_FIND_DATAW data;
+        HANDLE h = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+                                    nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (h == INVALID_HANDLE_VALUE) return false;
+        do {
+            const wchar_t* name = data.cFileName;
+            if (name[0] == L'.' && (name[1] == 0 || (name[1] == L'.' && name[2] == 0))) continue;
+            bool dir = data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+            // Junctions and directory symlinks are not followed
+            if (dir && (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) continue;
+            if (!emit(narrow(name), dir)) break;
+        } while (FindNextFileW(h, &data));
+        FindClose(h);
+        return true;
+    }
+
+private:
+    std::wstring root_;
+    std::string skip_rel_;
+};
+
+#else
+
+class DirLister {
+public:
+    DirLister(const fs::path& root, const fs::path& skip) {
+        root_fd_ = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct stat st;
+        if (!skip.empty() && ::stat(skip.c_str(), &st) == 0) {
+            skip_dev_ = st.st_dev;
+            skip_ino_ = st.st_ino;
+            has_skip_ = true;
+        }
+    }
+    ~DirLister() { if (root_fd_ >= 0) ::close(root_fd_); }
+    DirLister(const DirLister&) = delete;
+    DirLister& operator=(const DirLister&) = delete;
+
+    bool is_skip(const std::string&) const { return false; } // Decided by inode in list()
+
+    template<typename Emit>
+    bool list(const std::string& rel, Emit&& emit) const {
+        if (root_fd_ < 0) return false;
+        int fd = ::openat(root_fd_, rel.empty() ? "." : rel.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+        if (fd < 0) return false;
+
+        dev_t dev = 0;
+        if (has_skip_) {
+            struct stat st;
+            if (::fstat(fd, &st) == 0) dev = st.st_dev;
+        }
+
+        // Returns false to stop listing
+        auto handle = [&](const char* name, unsigned char type, ino_t ino) {
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) return true;
+            bool dir = type == DT_DIR;
+            if (type == DT_UNKNOWN || type == DT_LNK) {
+                // No type in the listing, or a symlink: one stat (following links to files only)
+                struct stat st;
+                if (::fstatat(fd, name, &st, 0) != 0) return true;
+                if (S_ISDIR(st.st_mode)) {
+                    if (type == DT_LNK) return true; // Symlinked directories are not followed
+                    dir = true;
+                } else if (!S_ISREG(st.st_mode)) {
+                    return true;
+                }
+            } else if (type != DT_DIR && type != DT_REG) {
+                return true; // Sockets, fifos, devices
+            }
+            if (dir && has_skip_ && ino == skip_ino_ && dev == skip_dev_) return true;
+            return emit(std::string(name), dir);
+        };
+
+#ifdef __linux__
+        // getdents64 straight into a large buffer: one syscall per ~1-2k entries
+        struct linux_dirent64 {
+            uint64_t d_ino;
+            int64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[];
+        };
+        thread_local std::vector<char> buffer(64 * 1024);
+        bool keep_going = true;
+        while (keep_going) {
+            long n = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            if (n <= 0) break;
+            for (long pos = 0; pos < n && keep_going;) {
+                auto* e = reinterpret_cast<linux_dirent64*>(buffer.data() + pos);
+                keep_going = handle(e->d_name, e->d_type, static_cast<ino_t>(e->d_ino));
+                pos += e->d_reclen;
+            }
+        }
+        ::close(fd);
+#else
+        DIR* d = ::fdopendir(fd);
+        if (!d) { ::close(fd); return false; }
+        while (struct dirent* e = ::readdir(d)) {
+            if (!handle(e->d_name, e->d_type, e->d_ino)) break;
+        }
+        ::closedir(d); // Closes fd
+#endif
+        return true;
+    }
+
+private:
+    int root_fd_ = -1;
+    bool has_skip_ = false;
+    dev_t skip_dev_ = 0;
+    ino_t skip_ino_ = 0;
+};
+
+#endif
+
+// `wait_for_work`: stay until the walk is over. Pool helpers pass false and return as soon
+// as the frontier is empty, so they never hold a pool slot idle.
+void work(WalkState& state, const DirLister& lister, const DirWalkOptions& options, const WalkSink& sink,
+          bool wait_for_work) {
+    const PathMatcher* matcher = options.matcher.get();
+    std::vector<PendingDir> found;
+
+    for (;;) {
+        PendingDir dir;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            if (wait_for_work) {
+                state.cv.wait(lock, [&] { return !state.stack.empty() || state.active == 0 || state.stop; });
+            }
+            if (state.stop || state.stack.empty()) {
+                if (state.stop || state.active == 0) {
+                    state.finished = true;
+                    state.cv.notify_all();
+                }
+                return;
+            }
+            dir = std::move(state.stack.back());
+            state.stack.pop_back();
+            state.active++;
+        }
+
+        found.clear();
+        bool listed = lister.list(dir.rel, [&](std::string name, bool is_dir) {
+            if (state.stop.load(std::memory_order_relaxed)) return false;
+
+            WalkEntry entry;
+            entry.rel_path = dir.rel.empty() ? std::move(name) : dir.rel + '/' + name;
+            entry.is_dir = is_dir;
+            entry.depth = dir.depth + 1;
+
+            uint8_t flag = matcher ? matcher->check(entry.rel_path, is_dir) : static_cast<uint8_t>(PathFlag::NONE);
+            entry.included = flag & PathFlag::INCLUDE;
+
+            if (is_dir) {
+                if ((flag & PathFlag::IGNORE) && !(flag & PathFlag::BRIDGE)) return true;
+                if (lister.is_skip(entry.rel_path)) return true;
+                if (options.max_depth <= 0 || entry.depth < options.max_depth) {
+                    found.push_back({entry.rel_path, entry.depth});
+                }
+                if (!options.report_dirs) return true;
+            } else {
+                if (flag & PathFlag::IGNORE) return true;
+                state.files.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            try {
+                if (!sink(std::move(entry))) state.stop = true;
+            } catch (const std::exception& e) {
+                spdlog::error("💥 Walk sink failed: {}", e.what());
+                state.stop = true;
+            }
+            return !state.stop.load(std::memory_order_relaxed);
+        });
+        if (listed) state.dirs.fetch_add(1, std::memory_order_relaxed);
+        else state.errors.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            for (auto& f : found) state.stack.push_back(std::move(f));
+            state.active--;
+            // More directories than workers: bring a helper back. Posted under the lock, so
+            // the walk cannot finish (and retire post_helper) meanwhile.
+            if (state.post_helper && !state.finished && state.stack.size() > 1 &&
+                state.helpers + state.queued_helpers < state.helper_limit) {
+                state.queued_helpers++;
+                state.post_helper();
+            }
+        }
+        state.cv.notify_all();
+    }
+}
+
+} // namespace
+
+DirWalkStats DirWalker::walk(const fs::path& root, const DirWalkOptions& options,
+                             const WalkSink& sink, ThreadPool* pool) {
+    DirLister lister(root, options.skip_dir);
+    auto state = std::make_shared<WalkState>();
+    PendingDir start;
+    start.rel = options.start;
+    std::replace(start.rel.begin(), start.rel.end(), '\\', '/');
+    while (!start.rel.empty() && start.rel.back() == '/') start.rel.pop_back();
+    if (start.rel == ".") start.rel.clear();
+    state->stack.push_back(std::move(start));
+
+    size_t helpers = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    if (pool) helpers = std::min(helpers, pool->size());
+
+    // Helpers that start after the walk finished leave without touching the caller's frame
+    const bool on_pool = pool != nullptr;
+    auto helper = [state, &lister, &options, &sink, on_pool] {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (on_pool) state->queued_helpers--;
+            if (state->finished) return;
+            state->helpers++;
+        }
+        work(*state, lister, options, sink, !on_pool);
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->helpers--;
+        }
+        state->cv.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    if (pool) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->helper_limit = helpers;
+        state->post_helper = [pool, helper] { pool->post(TaskPriority::Background, helper); };
+        // The frontier starts as the root alone: one helper, more as directories turn up
+        state->queued_helpers = std::min<size_t>(helpers, 1);
+        if (helpers > 0) state->post_helper();
+    } else {
+        for (size_t i = 0; i < helpers; ++i) threads.emplace_back(helper);
+    }
+
+    work(*state, lister, options, sink, true);
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait(lock, [&] { return state->helpers == 0; });
+        state->post_helper = nullptr; // It holds a helper, which holds the state
+    }
+    for (auto& t : threads) t.join();
+
+    DirWalkStats stats;
+    stats.dirs = state->dirs.load();
+    stats.files = state->files.load();
+    stats.errors = state->errors.load();
+    stats.stopped = state->stop.load();
+    return stats;
+}
+
+} // namespace code_assistance
@@ -0,0 +1,277 @@
+#include "embedding_cache.hpp"
+#include "ContentHash.hpp"
+#include "Float16.hpp"
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace code_assistance {
+
+using namespace embedding_cache_format;
+
+namespace {
+
+constexpr uint32_t MAX_DIM = 1u << 16;
+
+size_t payload_bytes(uint16_t precision, uint32_t dim) {
+    size_t bytes = static_cast<size_t>(dim) * (precision == static_cast<uint16_t>(Precision::F16) ? 2 : 4);
+    return (bytes + 7) & ~size_t(7);
+}
+
+// 🔒 Advisory whole-file lock shared by every process that opens the cache.
+// Writers take it exclusive; readers take it shared while indexing new records,
+// so a checksum failure seen under the lock is a torn tail, never an append in progress.
+class FileLock {
+public:
+    FileLock(std::FILE* f, bool exclusive) : f_(f) {
+#ifdef _WIN32
+        OVERLAPPED ov{};
+        HANDLE h = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(f_)));
+        LockFileEx(h, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, MAXDWORD, MAXDWORD, &ov);
+#else
+        flock(fileno(f_), exclusive ? LOCK_EX : LOCK_SH);
+#endif
+    }
+    ~FileLock() {
+#ifdef _WIN32
+        OVERLAPPED ov{};
+        HANDLE h = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(f_)));
+        UnlockFileEx(h, 0, MAXDWORD, MAXDWORD, &ov);
+#else
+        flock(fileno(f_), LOCK_UN);
+#endif
+    }
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+private:
+    std::FILE* f_;
+};
+
+uint64_t end_offset(std::FILE* f) {
+    std::fseek(f, 0, SEEK_END);
+    long pos = std::ftell(f);
+    return pos < 0 ? 0 : static_cast<uint64_t>(pos);
+}
+
+bool truncate_to(std::FILE* f, uint64_t size) {
+#ifdef _WIN32
+    return _chsize_s(_fileno(f), static_cast<__int64>(size)) == 0;
+#else
+    return ftruncate(fileno(f), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+} // namespace
+
+EmbeddingCache::~EmbeddingCache() {
+    map_.close();
+    if (out_) std::fclose(out_);
+}
+
+bool EmbeddingCache::open(const std::string& path, Precision precision) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    path_ = path;
+    precision_ = precision;
+
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    out_ = std::fopen(path.c_str(), "ab");
+    if (!out_) {
+        spdlog::error("❌ EmbeddingCache: cannot open {}", path);
+        return false;
+    }
+
+    FileLock flock_guard(out_, true);
+
+    if (end_offset(out_) == 0) {
+        FileHeader h{};
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.version = VERSION;
+        std::fwrite(&h, sizeof(h), 1, out_);
+        std::fflush(out_);
+    }
+
+    bool valid = remap() && map_.size() >= sizeof(FileHeader);
+    if (valid) {
+        auto* h = reinterpret_cast<const FileHeader*>(map_.data());
+        valid = std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 && h->version == VERSION;
+    }
+    if (!valid) {
+        spdlog::error("❌ EmbeddingCache: {} has unknown format, cache disabled", path);
+        map_.close();
+        std::fclose(out_);
+        out_ = nullptr;
+        return false;
+    }
+
+    indexed_end_ = sizeof(FileHeader);
+    index_tail();
+
+    // 🩹 A writer died mid-append: drop the torn record so later appends stay reachable
+    if (indexed_end_ < map_.size()) {
+        spdlog::warn("⚠️ EmbeddingCache: dropping {} torn bytes at the tail of {}", map_.size() - indexed_end_, path);
+        map_.close();
+        if (!truncate_to(out_, indexed_end_)) spdlog::warn("⚠️ EmbeddingCache: truncate failed, tail stays unreachable");
+        remap();
+    }
+
+    spdlog::info("🧊 EmbeddingCache: {} embeddings in {}", index_.size(), path);
+    return true;
+}
+
+EmbeddingKey EmbeddingCache::key_for(std::string_view model, std::string_view text) {
+    std::string buf;
+    buf.reserve(model.size() + 1 + text.size());
+    buf.append(model);
+    buf.push_back('\0');
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n') continue;
+        buf.push_back(text[i]);
+    }
+    while (buf.size() > model.size() + 1) {
+        char c = buf.back();
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+        buf.pop_back();
+    }
+    return {xxh64(buf, 0), xxh64(buf, 0x9E3779B97F4A7C15ULL)};
+}
+
+bool EmbeddingCache::remap() {
+    if (!map_.open(path_)) return false;
+    map_.advise_random();
+    return true;
+}
+
+void EmbeddingCache::index_tail() {
+    const char* base = map_.data();
+    const uint64_t size = map_.size();
+    uint64_t off = indexed_end_;
+
+    while (off + sizeof(RecordHeader) <= size) {
+        RecordHeader r;
+        std::memcpy(&r, base + off, sizeof(r));
+        if (r.magic != RECORD_MAGIC || r.precision > static_cast<uint16_t>(Precision::F16) || r.dim > MAX_DIM) break;
+
+        const size_t bytes = payload_bytes(r.precision, r.dim);
+        if (bytes > size - off - sizeof(RecordHeader)) break;
+        if (xxh64(std::string_view(base + off + sizeof(RecordHeader), bytes)) != r.checksum) break;
+
+        index_[r.key_lo] = off;
+        off += sizeof(RecordHeader) + bytes;
+    }
+    indexed_end_ = off;
+}
+
+bool EmbeddingCache::read_record(uint64_t offset, const EmbeddingKey& key, std::vector<float>& out) const {
+    if (offset + sizeof(RecordHeader) > map_.size()) return false;
+    RecordHeader r;
+    std::memcpy(&r, map_.data() + offset, sizeof(r));
+    if (r.key_hi != key.hi) return false; // 64-bit collision on key_lo
+
+    const char* payload = map_.data() + offset + sizeof(RecordHeader);
+    if (payload_bytes(r.precision, r.dim) > map_.size() - offset - sizeof(RecordHeader)) return false;
+
+    out.resize(r.dim);
+    if (r.precision == static_cast<uint16_t>(Precision::F16)) {
+        for (uint32_t i = 0; i < r.dim; ++i) {
+            uint16_t h;
+            std::memcpy(&h, payload + i * 2, 2);
+            out[i] = half_to_float(h);
+        }
+    } else {
+        std::memcpy(out.data(), payload, r.dim * sizeof(float));
+    }
+    return true;
+}
+
+bool EmbeddingCache::get(const EmbeddingKey& key, std::vector<float>& out) {
+    if (!out_) return false;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = index_.find(key.lo);
+        if (it != index_.end()) {
+            if (it->second + sizeof(RecordHeader) <= map_.size()) return read_record(it->second, key, out);
+        } else {
+            // Another process may have appended since our last look
+            std::error_code ec;
+            uint64_t disk = fs::file_size(path_, ec);
+            if (ec || disk <= indexed_end_) return false;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    {
+        FileLock flock_guard(out_, false);
+        if (!remap()) return false;
+        index_tail();
+    }
+    auto it = index_.find(key.lo);
+    return it != index_.end() && read_record(it->second, key, out);
+}
+
+void EmbeddingCache::put(const EmbeddingKey& key, const std::vector<float>& embedding) {
+    if (!out_ || embedding.empty() || embedding.size() > MAX_DIM) return;
+
+    RecordHeader r{};
+    r.magic = RECORD_MAGIC;
+    r.precision = static_cast<uint16_t>(precision_);
+    r.dim = static_cast<uint32_t>(embedding.size());
+    r.key_lo = key.lo;
+    r.key_hi = key.hi;
+
+    std::string payload(payload_bytes(r.precision, r.dim), '\0');
+    if (precision_ == Precision::F16) {
+        for (uint32_t i = 0; i < r.dim; ++i) {
+            uint16_t h = float_to_half(embedding[i]);
+            std::memcpy(payload.data() + i * 2, &h, 2);
+        }
+    } else {
+        std::memcpy(payload.data(), embedding.data(), r.dim * sizeof(float));
+    }
+    r.checksum = xxh64(payload);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (index_.count(key.lo)) return;
+
+    FileLock flock_guard(out_, true);
+    uint64_t end = end_offset(out_);
+    if (end != indexed_end_) {
+        // Other writers appended; catch up so the new record's offset is known
+        if (!remap()) return;
+        index_tail();
+        if (index_.count(key.lo)) return;
+        if (indexed_end_ < end) {
+            map_.close();
+            if (!truncate_to(out_, indexed_end_)) return;
+            remap();
+        }
+        end = indexed_end_;
+    }
+
+    std::fwrite(&r, sizeof(r), 1, out_);
+    std::fwrite(payload.data(), 1, payload.size(), out_);
+    if (std::fflush(out_) != 0) {
+        spdlog::warn("⚠️ EmbeddingCache: append to {} failed", path_);
+        return;
+    }
+    index_[key.lo] = end;
+    indexed_end_ = end + sizeof(RecordHeader) + payload.size();
+}
+
+size_t EmbeddingCache::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return index_.size();
+}
+
+} // namespace code_assistance
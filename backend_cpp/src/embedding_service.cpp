@@ -3,15 +3,96 @@
 #include <cpr/cpr.h>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
+#include <algorithm>
 #include <thread>
 #include <chrono>
 #include <cmath>
 #include "SystemMonitor.hpp" 
+#include "HttpSessionPool.hpp"
+#include "Utf8.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 
 namespace code_assistance {
 
 using json = nlohmann::json;
 
+namespace {
+const std::string EMBEDDING_MODEL = "text-embedding-004";
+const cpr::Header JSON_HEADER{{"Content-Type", "application/json"}};
+
+// ⏳ How long the server asked us to back off: the Retry-After header (seconds), else
+// the RetryInfo detail Gemini embeds in 429 bodies ("retryDelay": "17s"). 0 if neither.
+std::chrono::milliseconds retry_after_of(const cpr::Response& r) {
+    auto it = r.header.find("Retry-After");
+    if (it != r.header.end()) {
+        try { return std::chrono::milliseconds(static_cast<long>(std::stod(it->second) * 1000.0)); } catch (...) {}
+    }
+    size_t pos = r.text.find("\"retryDelay\"");
+    if (pos != std::string::npos) {
+        size_t q = r.text.find('"', r.text.find(':', pos));
+        if (q != std::string::npos) {
+            try { return std::chrono::milliseconds(static_cast<long>(std::stod(r.text.substr(q + 1)) * 1000.0)); } catch (...) {}
+        }
+    }
+    return std::chrono::milliseconds(0);
+}
+
+std::string chat_body(const std::vector<ChatTurn>& turns) {
+    json contents = json::array();
+    for (const auto& turn : turns) contents.push_back({{"role", turn.role}, {"parts", {{{"text", turn.text}}}}});
+    return json{{"contents", std::move(contents)}}.dump();
+}
+
+// 📡 Server-sent events decoder: bytes in, the payload of each event's "data:" lines out.
+// Events may be split anywhere across network chunks. The first bytes are also kept
+// verbatim, because an error status (429 with its RetryInfo body) is plain JSON.
+class SseReader {
+public:
+    static constexpr size_t RAW_LIMIT = 64 * 1024;
+
+    // on_event(payload) returning false stops decoding; feed() then returns false too
+    template<typename F>
+    bool feed(std::string_view bytes, F&& on_event) {
+        if (raw_.size() < RAW_LIMIT) raw_.append(bytes.substr(0, RAW_LIMIT - raw_.size()));
+        pending_.append(bytes);
+        size_t start = 0, nl;
+        while ((nl = pending_.find('\n', start)) != std::string::npos) {
+            std::string_view line(pending_.data() + start, nl - start);
+            start = nl + 1;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (line.empty()) {
+                if (!data_.empty() && !on_event(std::string_view(data_))) { pending_.erase(0, start); return false; }
+                data_.clear();
+            } else if (line.rfind("data:", 0) == 0) {
+                line.remove_prefix(5);
+                if (!line.empty() && line.front() == ' ') line.remove_prefix(1);
+                if (!data_.empty()) data_ += '\n';
+                data_.append(line);
+            } // "event:", "id:", ":" keep-alives and anything else are ignored
+        }
+        pending_.erase(0, start);
+        return true;
+    }
+
+    // An event the stream ended on without its blank line
+    template<typename F>
+    void finish(F&& on_event) {
+        if (!pending_.empty()) feed("\n", on_event);
+        if (!data_.empty()) on_event(std::string_view(data_));
+        data_.clear();
+    }
+
+    std::string& raw() { return raw_; }
+
+private:
+    std::string pending_; // Bytes after the last complete line
+    std::string data_;    // Payload of the event being assembled
+    std::string raw_;
+};
+}
+
 // 🚀 UTILITY: Shutdown-aware sleep
 // Returns false if shutdown requested, true if sleep completed
 bool smart_sleep(int milliseconds) {
@@ -21,59 +102,89 @@ bool smart_sleep(int milliseconds) {
         // if (global_shutdown) return false;
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds % 100));
     return true;
 }
 
-std::string utf8_safe_substr(const std::string& str, size_t length) {
-    if (str.length() <= length) return str;
-    std::string sub = str.substr(0, length);
-    if (sub.empty()) return sub;
-    while (!sub.empty()) {
-        unsigned char c = static_cast<unsigned char>(sub.back());
-        if (c < 0x80) break;
-        if (c >= 0xC0) { sub.pop_back(); break; }
-        sub.pop_back();
-    }
-    return sub;
+std::string utf8_safe_substr(std::string_view str, size_t length) {
+    return Utf8::truncate(str, length);
 }
 
-EmbeddingService::EmbeddingService(std::shared_ptr<KeyManager> key_manager)
-    : key_manager_(key_manager), cache_manager_(std::make_shared<CacheManager>()) {}
+EmbeddingService::EmbeddingService(std::shared_ptr<KeyManager> key_manager, std::shared_ptr<EmbeddingProvider> provider)
+    : key_manager_(key_manager), cache_manager_(std::make_shared<CacheManager>()), provider_(std::move(provider)) {}
 
-std::string EmbeddingService::get_endpoint_url(const std::string& action) {
+// Hedge losers were told to abort when their call returned; they stop at cpr's next progress tick
+EmbeddingService::~EmbeddingService() {
+    std::lock_guard<std::mutex> lock(hedge_workers_mutex_);
+    for (auto& w : hedge_workers_) w.thread.join();
+}
+
+void EmbeddingService::spawn_hedge_attempt(std::function<void()> attempt) {
+    std::lock_guard<std::mutex> lock(hedge_workers_mutex_);
+    std::erase_if(hedge_workers_, [](HedgeWorker& w) {
+        if (!w.done->load(std::memory_order_acquire)) return false;
+        w.thread.join();
+        return true;
+    });
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    hedge_workers_.push_back({std::thread([attempt = std::move(attempt), done] {
+        attempt();
+        done->store(true, std::memory_order_release);
+    }), done});
+}
+
+size_t EmbeddingService::embedding_concurrency() const {
+    return provider_ ? provider_->concurrency() : std::clamp<size_t>(active_key_count(), 2, 8);
+}
+
+const std::string& EmbeddingService::embedding_model() const {
+    return provider_ ? provider_->model() : EMBEDDING_MODEL;
+}
+
+std::string EmbeddingService::get_endpoint_url(const std::string& action, int key_slot) {
     std::string model = (action == "embedContent" || action == "batchEmbedContents") 
-        ? "text-embedding-004" 
+        ? EMBEDDING_MODEL 
         : key_manager_->get_current_model();
+    std::string key = key_slot >= 0 ? key_manager_->get_key_for_slot(key_slot) : key_manager_->get_current_key();
         
-    return base_url_ + model + ":" + action + "?key=" + key_manager_->get_current_key();
+    return get_endpoint_url(model, action, key);
+}
+
+std::string EmbeddingService::get_endpoint_url(const std::string& model, const std::string& action, const std::string& key) const {
+    return base_url_ + model + ":" + action + "?key=" + key;
 }
 
 // 🚀 ELITE: Robust Request Wrapper
+// Each attempt leases the (key, model) with the most budget left; when every bucket is
+// dry the lease says exactly how long until one refills, so we sleep that instead of
+// a blind exponential backoff. Every outcome is fed back to sharpen the budgets.
 template<typename Func>
-cpr::Response perform_request_with_retry(Func request_factory, std::shared_ptr<KeyManager> km) {
+cpr::Response perform_request_with_retry(Func request_factory, std::shared_ptr<KeyManager> km,
+                                         const std::string& model, size_t hint = 0) {
     int max_retries = 5; 
     cpr::Response r; 
     
     for (int i = 0; i < max_retries; ++i) {
-        r = request_factory(); 
+        KeyLease lease = km ? km->acquire_key(model, hint + i) : KeyLease{};
+        if (lease.wait.count() > 0) {
+            spdlog::warn("⏳ All keys dry for {} | Waiting {}ms", model, lease.wait.count());
+            if (!smart_sleep(static_cast<int>(lease.wait.count()))) break; // Exit if system shutting down
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        r = request_factory(lease.key); 
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (km) km->report_result(lease.key_index, model, r.status_code, ms, retry_after_of(r));
         
         if (r.status_code == 200) return r;
 
         bool is_quota = (r.status_code == 429);
         bool is_server_err = (r.status_code >= 500);
 
-        if ((is_quota || is_server_err) && km) {
-            km->report_rate_limit(); // Rotates key internally
-            
-            // 🚀 STRATEGY: If we switched keys, try immediately (minimal jitter). 
-            // Only sleep deep if we looped through all keys.
-            int active_keys = km->get_active_key_count();
-            int backoff_ms = (i > active_keys) ? (1000 * std::pow(2, i - active_keys)) : 50;
-
-            spdlog::warn("⚠️ API {} | Retry {}/{} | Backoff: {}ms", 
-                         r.status_code, i + 1, max_retries, backoff_ms);
-            
-            if (!smart_sleep(backoff_ms)) break; // Exit if system shutting down
+        if (is_quota || is_server_err) {
+            spdlog::warn("⚠️ API {} | Key #{} | Retry {}/{}", 
+                         r.status_code, lease.key_index, i + 1, max_retries);
+            if (is_server_err && !smart_sleep(50 << i)) break;
             continue;
         }
         break; // Fatal error (400, 401, etc)
@@ -82,55 +193,116 @@ cpr::Response perform_request_with_retry(Func request_factory, std::shared_ptr<K
 }
 
 std::vector<float> EmbeddingService::generate_embedding(const std::string& text) {
-    if (auto cached = cache_manager_->get_embedding(text)) return *cached;
+    if (auto cached = cache_manager_->get_embedding(embedding_model(), text)) return *cached;
+
+    std::shared_future<std::vector<float>> result;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(coalesce_mutex_);
+        if (auto it = in_flight_.find(text); it != in_flight_.end()) {
+            result = it->second; // Someone already asked: ride along
+        } else {
+            PendingEmbedding& entry = pending_.emplace_back(PendingEmbedding{text, {}});
+            result = entry.promise.get_future().share();
+            in_flight_.emplace(text, result);
+            leader = pending_.size() == 1;
+            if (pending_.size() >= MAX_EMBED_BATCH) batch_full_.notify_one();
+        }
+    }
 
+    if (leader) {
+        std::vector<PendingEmbedding> batch;
+        {
+            std::unique_lock<std::mutex> lock(coalesce_mutex_);
+            batch_full_.wait_for(lock, COALESCE_WINDOW, [this] { return pending_.size() >= MAX_EMBED_BATCH; });
+            batch.swap(pending_);
+        }
+        flush_embeddings(batch);
+    }
+    return result.get();
+}
+
+void EmbeddingService::flush_embeddings(std::vector<PendingEmbedding>& batch) {
     auto start = std::chrono::high_resolution_clock::now();
 
-    auto r = perform_request_with_retry([&]() {
-        return cpr::Post(cpr::Url{get_endpoint_url("embedContent")},
-                         cpr::Body(json{
-                             {"model", "models/text-embedding-004"},
-                             {"content", {{"parts", {{{"text", text}}}}}}
-                         }.dump()),
-                         cpr::Header{{"Content-Type", "application/json"}});
-    }, key_manager_);
+    // Joiners past the limit while the window was closing go out as further chunks
+    for (size_t begin = 0; begin < batch.size(); begin += MAX_EMBED_BATCH) {
+        size_t end = std::min(batch.size(), begin + MAX_EMBED_BATCH);
+        std::vector<std::string> texts;
+        texts.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) texts.push_back(batch[i].text);
+
+        std::vector<std::vector<float>> embeddings;
+        std::exception_ptr error;
+        try {
+            embeddings = generate_embeddings_batch(texts);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            // Out of in_flight_ first: later askers find the cache (or retry) instead
+            std::lock_guard<std::mutex> lock(coalesce_mutex_);
+            for (size_t i = begin; i < end; ++i) in_flight_.erase(batch[i].text);
+        }
+        for (size_t i = begin; i < end; ++i) {
+            auto& promise = batch[i].promise;
+            if (error) {
+                promise.set_exception(error);
+            } else if (embeddings[i - begin].empty()) {
+                promise.set_exception(std::make_exception_ptr(std::runtime_error("Failed to generate embedding after retries")));
+            } else {
+                promise.set_value(std::move(embeddings[i - begin]));
+            }
+        }
+    }
 
     auto end = std::chrono::high_resolution_clock::now();
     double duration = std::chrono::duration<double, std::milli>(end - start).count();
-    SystemMonitor::global_embedding_latency_ms.store(duration);
+    StageMetrics::record(Stage::Embedding, duration);
+    if (batch.size() > 1) spdlog::debug("🧺 Coalesced {} embedding requests ({:.1f} ms)", batch.size(), duration);
+}
 
-    if (r.status_code != 200) {
-        spdlog::error("❌ Embedding API Fatal Error [{}]: {}", r.status_code, r.text);
-        throw std::runtime_error("Failed to generate embedding after retries");
+std::vector<std::vector<float>> EmbeddingService::generate_embeddings_batch(const std::vector<std::string>& texts, int key_slot) {
+    // 🧊 Only texts the content-addressed cache has never seen go to the API
+    std::vector<std::vector<float>> embeddings(texts.size());
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        if (auto cached = cache_manager_->get_embedding(embedding_model(), texts[i])) embeddings[i] = std::move(*cached);
+        else misses.push_back(i);
     }
-
-    try {
-        auto response_json = json::parse(r.text);
-        std::vector<float> embedding = response_json["embedding"]["values"];
-        cache_manager_->set_embedding(text, embedding);
-        return embedding;
-    } catch (...) {
-        throw std::runtime_error("Malformed JSON from Embedding API");
+    if (misses.empty()) return embeddings;
+
+    if (provider_) {
+        std::vector<std::string> pending;
+        pending.reserve(misses.size());
+        for (size_t i : misses) pending.push_back(texts[i]);
+        auto computed = provider_->embed(pending);
+        for (size_t j = 0; j < misses.size() && j < computed.size(); ++j) {
+            if (computed[j].empty()) continue;
+            size_t i = misses[j];
+            embeddings[i] = std::move(computed[j]);
+            cache_manager_->set_embedding(provider_->model(), texts[i], embeddings[i]);
+        }
+        return embeddings;
     }
-}
 
-std::vector<std::vector<float>> EmbeddingService::generate_embeddings_batch(const std::vector<std::string>& texts) {
     json requests = json::array();
-    for(const auto& raw_text : texts){
+    for (size_t i : misses) {
         requests.push_back({
-            {"model", "models/text-embedding-004"},
-            {"content", { {"parts", {{{"text", raw_text}}}} }}
+            {"model", "models/" + EMBEDDING_MODEL},
+            {"content", { {"parts", {{{"text", texts[i]}}}} }}
         });
     }
     
     // Google Batch API specific structure
     std::string payload_str = json{{"requests", requests}}.dump();
     
-    auto r = perform_request_with_retry([&]() {
-        return cpr::Post(cpr::Url{get_endpoint_url("batchEmbedContents")}, 
-                         cpr::Body{payload_str}, 
-                         cpr::Header{{"Content-Type", "application/json"}});
-    }, key_manager_);
+    auto r = perform_request_with_retry([&](const std::string& key) {
+        return HttpSessionPool::instance().post(get_endpoint_url(EMBEDDING_MODEL, "batchEmbedContents", key), 
+                         payload_str, 
+                         JSON_HEADER);
+    }, key_manager_, EMBEDDING_MODEL, key_slot >= 0 ? static_cast<size_t>(key_slot) : 0);
 
     if (r.status_code != 200) {
         spdlog::error("Batch Embedding API error [{}]: {}", r.status_code, r.text);
@@ -138,15 +310,15 @@ std::vector<std::vector<float>> EmbeddingService::generate_embeddings_batch(cons
     }
     
     auto response_json = json::parse(r.text);
-    std::vector<std::vector<float>> embeddings;
     
     if (response_json.contains("embeddings")) {
-        for(const auto& emb : response_json["embeddings"]){
-            if (emb.contains("values")) {
-                embeddings.push_back(emb["values"].get<std::vector<float>>());
-            } else {
-                embeddings.push_back({}); // Handle failure case gracefully
-            }
+        const auto& embs = response_json["embeddings"];
+        size_t count = std::min(embs.size(), misses.size());
+        for (size_t j = 0; j < count; ++j) {
+            if (!embs[j].contains("values")) continue; // Left empty: handle failure case gracefully
+            size_t i = misses[j];
+            embeddings[i] = embs[j]["values"].get<std::vector<float>>();
+            cache_manager_->set_embedding(EMBEDDING_MODEL, texts[i], embeddings[i]);
         }
     }
     return embeddings;
@@ -158,14 +330,22 @@ std::string EmbeddingService::generate_text(const std::string& prompt) {
 }
 
 GenerationResult EmbeddingService::generate_text_elite(const std::string& prompt) {
+    return generate_text_elite(std::vector<ChatTurn>{{"user", prompt}});
+}
+
+GenerationResult EmbeddingService::generate_text_elite(const std::vector<ChatTurn>& turns, const std::atomic<bool>* cancel) {
+    StageSpan span(Stage::Llm);
     GenerationResult final_result;
-    
-    auto r = perform_request_with_retry([&]() {
-        json payload = {{"contents", {{ {"parts", {{{"text", prompt}}}} }}}};
-        return cpr::Post(cpr::Url{get_endpoint_url("generateContent")},
-                      cpr::Body{payload.dump()},
-                      cpr::Header{{"Content-Type", "application/json"}});
-    }, key_manager_);
+    const std::string body = chat_body(turns); // Serialized once, not per retry
+
+    const std::string model = key_manager_->get_current_model();
+    auto r = perform_request_with_retry([&](const std::string& key) {
+        std::function<bool()> keep_going;
+        if (cancel) keep_going = [cancel] { return !cancel->load(std::memory_order_relaxed); };
+        return HttpSessionPool::instance().post(get_endpoint_url(model, "generateContent", key),
+                      body,
+                      JSON_HEADER, std::chrono::milliseconds(0), std::move(keep_going));
+    }, key_manager_, model);
 
     if (r.status_code == 200) {
         try {
@@ -200,7 +380,8 @@ GenerationResult EmbeddingService::generate_text_elite(const std::string& prompt
                 final_result.prompt_tokens = usage.value("promptTokenCount", 0);
                 final_result.completion_tokens = usage.value("candidatesTokenCount", 0);
                 final_result.total_tokens = usage.value("totalTokenCount", 0);
-                SystemMonitor::global_output_tokens.store(final_result.completion_tokens);
+                final_result.cached_tokens = usage.value("cachedContentTokenCount", 0);
+                SystemMonitor::record_generation(final_result.completion_tokens, span.elapsed_ms());
             }
             
             final_result.success = true;
@@ -215,78 +396,309 @@ GenerationResult EmbeddingService::generate_text_elite(const std::string& prompt
     return final_result;
 }
 
+// 🌊 streamGenerateContent over SSE: every event carries the next slice of the reply and
+// goes to on_chunk as soon as it is decoded, so the caller sees the first token instead
+// of the whole answer. Retries only happen on a status before any event arrives, so a
+// chunk is never delivered twice.
+GenerationResult EmbeddingService::stream_text_elite(const std::vector<ChatTurn>& turns,
+                                                     const std::function<bool(std::string_view)>& on_chunk,
+                                                     const std::atomic<bool>* cancel) {
+    StageSpan span(Stage::Llm);
+    GenerationResult final_result;
+    const std::string body = chat_body(turns);
+    const std::string model = key_manager_->get_current_model();
+
+    bool stopped = false; // on_chunk asked for no more
+    bool blocked = false;
+    auto on_event = [&](std::string_view payload) {
+        try {
+            auto event = json::parse(payload);
+            if (event.contains("usageMetadata")) { // Running totals; the last event has the final ones
+                auto& usage = event["usageMetadata"];
+                final_result.prompt_tokens = usage.value("promptTokenCount", 0);
+                final_result.completion_tokens = usage.value("candidatesTokenCount", 0);
+                final_result.total_tokens = usage.value("totalTokenCount", 0);
+                final_result.cached_tokens = usage.value("cachedContentTokenCount", 0);
+            }
+            if (!event.contains("candidates") || event["candidates"].empty()) return true;
+            auto& candidate = event["candidates"][0];
+            if (candidate.value("finishReason", "") == "SAFETY") { blocked = true; return false; }
+            if (!candidate.contains("content") || !candidate["content"].contains("parts")) return true;
+
+            std::string chunk;
+            for (const auto& part : candidate["content"]["parts"]) {
+                if (part.contains("text")) chunk += part["text"].get<std::string>();
+            }
+            if (chunk.empty()) return true;
+            final_result.text += chunk;
+            if (on_chunk && !on_chunk(chunk)) stopped = true;
+            return !stopped;
+        } catch (const std::exception& e) {
+            spdlog::error("SSE event parse error: {}", e.what());
+            return true; // One bad event does not sink the stream
+        }
+    };
+
+    auto r = perform_request_with_retry([&](const std::string& key) {
+        SseReader sse;
+        std::function<bool()> keep_going;
+        if (cancel) keep_going = [cancel] { return !cancel->load(std::memory_order_relaxed); };
+        auto resp = HttpSessionPool::instance().post_stream(
+            get_endpoint_url(model, "streamGenerateContent", key) + "&alt=sse", body, JSON_HEADER,
+            [&](std::string_view bytes) {
+                if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+                return sse.feed(bytes, on_event);
+            },
+            std::chrono::milliseconds(0), std::move(keep_going));
+        if (resp.status_code == 200) sse.finish(on_event);
+        else resp.text = std::move(sse.raw()); // Error bodies drive the retry / backoff decision
+        return resp;
+    }, key_manager_, model);
+
+    if (r.status_code == 200) {
+        SystemMonitor::record_generation(final_result.completion_tokens, span.elapsed_ms());
+        if (blocked) {
+            final_result.text = "ERROR: Response blocked by safety filters.";
+        } else if (r.error && !stopped) {
+            spdlog::warn("🌊 Stream cut after {} chars: {}", final_result.text.size(), r.error.message);
+            final_result.success = false; // Partial text is kept for the caller to show, not to act on
+        } else if (final_result.text.empty()) {
+            final_result.text = "ERROR: Empty response from AI.";
+        } else {
+            final_result.success = true;
+        }
+        return final_result;
+    }
+
+    final_result.text = "ERROR: API Failure " + std::to_string(r.status_code);
+    final_result.success = false;
+    return final_result;
+}
+
 // ... (Vision and Autocomplete implementations remain similar) ...
-VisionResult EmbeddingService::analyze_vision(const std::string& prompt, const std::string& base64_image) {
+VisionResult EmbeddingService::analyze_vision(const std::string& prompt, const VisionInput& image) {
     VisionResult result;
-    result.success = false;
 
-    json payload = {
-        {"contents", {{
-            {"parts", {
-                {{"text", prompt}},
-                {{"inline_data", {{"mime_type", "image/jpeg"}, {"data", base64_image}}}}
-            }}
-        }}}
-    };
+    uint64_t image_hash = ImagePipeline::content_hash(image);
+    if (auto cached = cache_manager_->get_vision(image_hash, prompt)) {
+        result.analysis = std::move(*cached);
+        result.success = result.cached = true;
+        return result;
+    }
+
+    PreparedImage prepared;
+    std::string error;
+    if (!image_pipeline_.prepare(image, prepared, error)) {
+        spdlog::warn("🖼️ Vision input rejected: {}", error);
+        result.analysis = error;
+        return result;
+    }
 
-    auto r = cpr::Post(cpr::Url{get_endpoint_url("generateContent")},
-                  cpr::Body{payload.dump()},
-                  cpr::Header{{"Content-Type", "application/json"}});
+    // The body is assembled around the base64 in one sized buffer: the image is copied
+    // into it once, never parsed, escaped or re-dumped through a json tree
+    static constexpr std::string_view HEAD = R"({"contents":[{"parts":[{"text":)";
+    static constexpr std::string_view MIME = R"(},{"inline_data":{"mime_type":")";
+    static constexpr std::string_view DATA = R"(","data":")";
+    static constexpr std::string_view TAIL = R"("}}]}]})";
+    std::string prompt_json = json(prompt).dump();
+    std::string body;
+    body.reserve(HEAD.size() + prompt_json.size() + MIME.size() + prepared.mime_type.size() + DATA.size() +
+                 prepared.base64.size() + TAIL.size());
+    body.append(HEAD).append(prompt_json).append(MIME).append(prepared.mime_type).append(DATA);
+    body.append(prepared.base64).append(TAIL);
+    prepared.base64 = std::string(); // Only the body's copy stays alive for the upload
+
+    auto r = HttpSessionPool::instance().post(get_endpoint_url("generateContent"), body, JSON_HEADER);
 
     if (r.status_code == 200) {
         auto j = json::parse(r.text);
         if (j["candidates"][0]["content"]["parts"].size() > 0) {
             result.analysis = j["candidates"][0]["content"]["parts"][0]["text"];
             result.success = true;
+            cache_manager_->set_vision(image_hash, prompt, result.analysis);
         }
     }
     return result;
 }
 
+namespace {
+
+// 🚀 SANITIZATION: returns "" for completions that must be rejected
+std::string sanitize_completion(std::string text) {
+    // Remove Markdown
+    if (text.find("```") != std::string::npos) {
+        size_t start = text.find("```");
+        size_t end = text.rfind("```");
+        if (start != std::string::npos) text = text.substr(text.find('\n', start) + 1);
+        if (end != std::string::npos && end > 0) text = text.substr(0, end);
+    }
+
+    // Remove Repetitive "main()"
+    if (text.find("void main") != std::string::npos) {
+        text = ""; // Reject bad completion
+    }
+    return text;
+}
+
+// Shared by the coordinator and every in-flight attempt; outlives the call if losers are still draining
+struct HedgeState {
+    struct Outcome {
+        size_t attempt;
+        cpr::Response response;
+        double ms;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Outcome> done;
+    std::atomic<bool> finished{false}; // Aborts losers from cpr's progress callback
+};
+
+} // namespace
+
+std::chrono::milliseconds EmbeddingService::hedge_delay(const std::string& model) const {
+    std::lock_guard<std::mutex> lock(latency_mutex_);
+    auto it = autocomplete_latency_.find(model);
+    if (it == autocomplete_latency_.end() || it->second->count() < hedge_options_.min_samples) {
+        return hedge_options_.initial_delay;
+    }
+    auto p = std::chrono::milliseconds(static_cast<long>(it->second->quantile(hedge_options_.quantile)));
+    return std::max(p, hedge_options_.min_delay);
+}
+
+void EmbeddingService::record_autocomplete_latency(const std::string& model, double ms) {
+    std::lock_guard<std::mutex> lock(latency_mutex_);
+    auto& h = autocomplete_latency_[model];
+    if (!h) h = std::make_unique<LatencyHistogram>();
+    h->record(ms);
+}
+
+std::vector<ModelLatency> EmbeddingService::autocomplete_latency() const {
+    std::lock_guard<std::mutex> lock(latency_mutex_);
+    std::vector<ModelLatency> out;
+    for (const auto& [model, h] : autocomplete_latency_) {
+        out.push_back({model, h->count(), h->quantile(0.5), h->quantile(0.95)});
+    }
+    return out;
+}
+
 std::string EmbeddingService::generate_autocomplete(const std::string& prefix) {
     size_t total_keys = key_manager_->get_total_keys();
     size_t total_models = key_manager_->get_total_models();
     size_t max_attempts = total_keys * total_models; // Try ALL combinations
-    
-    // 🚀 LOGIC: Check if prefix ends with open parenthesis or comma to preserve spacing
-    bool needs_space = false;
-    if (!prefix.empty()) {
-        char last = prefix.back();
-        if (last == ',' || last == ')') needs_space = true;
-    }
+    if (max_attempts == 0) return "";
+
+    json payload = {
+        {"contents", {{ 
+            {"parts", {{{"text", 
+                "ROLE: Code Completion Engine.\n"
+                "TASK: Complete the code at the cursor.\n"
+                "RULES:\n"
+                "1. Output ONLY the code to be inserted.\n"
+                "2. Do NOT repeat the input.\n"
+                "3. Do NOT wrap in markdown.\n"
+                "4. If the input is a function signature, complete the parameters or body.\n"
+                "5. DO NOT hallucinate a new 'main()' function.\n\n"
+                "INPUT CONTEXT:\n" + prefix}}}} 
+        }}},
+        {"generationConfig", {
+            {"maxOutputTokens", 64},
+            {"stopSequences", {"\n\n", "```", "void main"}} // 🚀 HARD STOP on hallucinations
+        }}
+    };
+    auto body = std::make_shared<const std::string>(payload.dump());
+
+    // 🏇 HEDGING: the current pair goes first; if it has not answered within the model's
+    // p95 (learned per model), the next key fires in parallel. First usable answer wins,
+    // the rest are aborted. Failures rotate keys/models exactly like the sequential loop did.
+    auto state = std::make_shared<HedgeState>();
+    std::vector<KeyManager::KeyModelPair> attempts;
+    std::vector<char> in_flight_flags;
+    std::vector<std::chrono::steady_clock::time_point> launched;
+    size_t in_flight = 0;
+
+    auto launch = [&](size_t key_offset) -> bool {
+        for (size_t off = key_offset; off < key_offset + total_keys; ++off) {
+            auto pair = key_manager_->get_pair(off, 0);
+            bool busy = false;
+            for (size_t i = 0; i < attempts.size(); ++i) {
+                if (in_flight_flags[i] && attempts[i].key_index == pair.key_index &&
+                    attempts[i].model_index == pair.model_index) busy = true;
+            }
+            if (busy) continue;
+
+            size_t id = attempts.size();
+            attempts.push_back(pair);
+            in_flight_flags.push_back(1);
+            launched.push_back(std::chrono::steady_clock::now());
+            ++in_flight;
+
+            // Construct URL for specific model
+            std::string url = base_url_ + pair.model + ":generateContent?key=" + pair.key;
+            spawn_hedge_attempt([state, body, id, url = std::move(url)] {
+                auto start = std::chrono::steady_clock::now();
+                cpr::Response r = HttpSessionPool::instance().post(
+                    url,
+                    *body,
+                    JSON_HEADER,
+                    std::chrono::milliseconds(3500), // 3.5s timeout per attempt
+                    [state] { return !state->finished.load(); }
+                );
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->done.push_back({id, std::move(r), ms});
+                }
+                state->cv.notify_all();
+            });
+            return true;
+        }
+        return false;
+    };
+
+    auto finish = [&](std::string text) {
+        state->finished = true;
+        // An attempt still running when another won took at least this long. Leaving it out
+        // would teach the histogram only the winners' times, and the hedge delay would shrink
+        // until every request fires twice.
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < attempts.size(); ++i) {
+            if (in_flight_flags[i]) {
+                record_autocomplete_latency(attempts[i].model,
+                                            std::chrono::duration<double, std::milli>(now - launched[i]).count());
+            }
+        }
+        return text;
+    };
+
+    launch(0);
+    while (in_flight > 0) {
+        HedgeState::Outcome outcome;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            bool ready = state->cv.wait_for(lock, hedge_delay(attempts.back().model),
+                                            [&] { return !state->done.empty(); });
+            if (!ready) {
+                lock.unlock();
+                if (in_flight < hedge_options_.max_in_flight && attempts.size() < max_attempts) {
+                    if (launch(1)) spdlog::info("🏇 Ghost hedge: {} slow, firing key #{}",
+                                                attempts.front().model, attempts.back().key_index);
+                }
+                continue;
+            }
+            outcome = std::move(state->done.front());
+            state->done.pop_front();
+        }
+        in_flight_flags[outcome.attempt] = 0;
+        --in_flight;
+
+        const auto& pair = attempts[outcome.attempt];
+        const auto& r = outcome.response;
+        if (r.status_code != 0) {
+            record_autocomplete_latency(pair.model, outcome.ms);
+            key_manager_->report_result(pair.key_index, pair.model, r.status_code, outcome.ms, retry_after_of(r));
+        }
 
-    for(size_t attempt = 0; attempt < max_attempts; ++attempt) {
-        auto pair = key_manager_->get_current_pair();
-        
-        // Construct URL for specific model
-        std::string url = base_url_ + pair.model + ":generateContent?key=" + pair.key;
-        
-        json payload = {
-            {"contents", {{ 
-                {"parts", {{{"text", 
-                    "ROLE: Code Completion Engine.\n"
-                    "TASK: Complete the code at the cursor.\n"
-                    "RULES:\n"
-                    "1. Output ONLY the code to be inserted.\n"
-                    "2. Do NOT repeat the input.\n"
-                    "3. Do NOT wrap in markdown.\n"
-                    "4. If the input is a function signature, complete the parameters or body.\n"
-                    "5. DO NOT hallucinate a new 'main()' function.\n\n"
-                    "INPUT CONTEXT:\n" + prefix}}}} 
-            }}},
-            {"generationConfig", {
-                {"maxOutputTokens", 64},
-                {"stopSequences", {"\n\n", "```", "void main"}} // 🚀 HARD STOP on hallucinations
-            }}
-        };
-
-        auto r = cpr::Post(
-            cpr::Url{url}, 
-            cpr::Body{payload.dump()}, 
-            cpr::Header{{"Content-Type", "application/json"}},
-            cpr::Timeout{3500} // 3.5s timeout per attempt
-        );
-        
         // ✅ SUCCESS
         if (r.status_code == 200) {
             try {
@@ -295,57 +707,35 @@ std::string EmbeddingService::generate_autocomplete(const std::string& prefix) {
                     // Empty candidates often means safety filter block
                     spdlog::warn("⚠️ Blocked/Empty (Model: {} | Key: #{})", pair.model, pair.key_index);
                     key_manager_->rotate_key(); 
-                    continue;
-                }
-                
-                std::string text = j["candidates"][0]["content"]["parts"][0]["text"];
-                
-                // 🚀 SANITIZATION
-                // Remove Markdown
-                if (text.find("```") != std::string::npos) {
-                    size_t start = text.find("```");
-                    size_t end = text.rfind("```");
-                    if (start != std::string::npos) text = text.substr(text.find('\n', start) + 1);
-                    if (end != std::string::npos && end > 0) text = text.substr(0, end);
+                } else {
+                    std::string text = sanitize_completion(j["candidates"][0]["content"]["parts"][0]["text"]);
+                    if (!text.empty()) {
+                        spdlog::info("✅ Ghost: '{}' (Model: {} | Key: #{} | {:.0f}ms)", text, pair.model, pair.key_index, outcome.ms);
+                        return finish(text);
+                    }
+                    key_manager_->rotate_key();
                 }
-                
-                // Remove Repetitive "main()"
-                if (text.find("void main") != std::string::npos) {
-                    text = ""; // Reject bad completion
-                }
-
-                if (text.empty()) {
-                    key_manager_->rotate_key(); continue;
-                }
-
-                spdlog::info("✅ Ghost: '{}' (Model: {} | Key: #{})", text, pair.model, pair.key_index);
-                return text;
-
             } catch(...) { 
-                key_manager_->rotate_key(); continue;
+                key_manager_->rotate_key();
             }
-        }
-
-        // ⚠️ 429: ROTATE KEY
-        if (r.status_code == 429) {
+        } else if (r.status_code == 429) {
+            // ⚠️ 429: ROTATE KEY
             spdlog::warn("⚠️ 429 Rate Limit (Model: {} | Key: #{}) -> Rotating...", pair.model, pair.key_index);
             key_manager_->rotate_key();
-            continue;
-        }
-
-        // ❌ 400/404: BAD MODEL -> ROTATE MODEL
-        if (r.status_code == 400 || r.status_code == 404) {
+        } else if (r.status_code == 400 || r.status_code == 404) {
+            // ❌ 400/404: BAD MODEL -> ROTATE MODEL
             spdlog::error("❌ Bad Model '{}' -> Switching Model...", pair.model);
             key_manager_->rotate_model();
-            continue;
+        } else {
+            // ❌ OTHER: TRY NEXT KEY
+            spdlog::error("❌ API Error {}: {}", r.status_code, r.text.substr(0,50));
+            key_manager_->rotate_key();
         }
 
-        // ❌ OTHER: TRY NEXT KEY
-        spdlog::error("❌ API Error {}: {}", r.status_code, r.text.substr(0,50));
-        key_manager_->rotate_key();
+        if (attempts.size() < max_attempts) launch(0);
     }
 
-    return "";
+    return finish("");
 }
 
 } // namespace code_assistance
\ No newline at end of file
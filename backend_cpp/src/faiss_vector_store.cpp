@@ -1,151 +1,1241 @@
 #include "faiss_vector_store.hpp"
+#include <faiss/IndexFlat.h>
 #include <faiss/IndexHNSW.h>
+#include <faiss/IndexIVFPQ.h>
+#include <faiss/IndexIDMap.h>
 #include <faiss/index_io.h>
 #include <faiss/impl/FaissAssert.h>
 #include <vector>
 #include <numeric>
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 #include <unordered_map>
+#include <chrono>
+#include <cmath>
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
 namespace code_assistance {
 
-struct IndexDeleter {
-    void operator()(faiss::Index* idx) {
-        delete idx;
+// --- CONFIG ---
+
+namespace {
+
+// Vectors needed before config.kind can be trained (FAISS wants ~39 points per IVF centroid)
+size_t train_floor(const IndexConfig& c) {
+    if (c.kind == IndexKind::IVF_PQ) return std::max<size_t>(c.train_min, static_cast<size_t>(c.ivf_nlist) * 39);
+    if (c.kind == IndexKind::HNSW_SQ8) return std::max<size_t>(c.train_min, 1);
+    return 0;
+}
+
+const char* kind_name(IndexKind k) {
+    switch (k) {
+        case IndexKind::Flat: return "flat";
+        case IndexKind::HNSW: return "hnsw";
+        case IndexKind::HNSW_SQ8: return "hnsw_sq8";
+        case IndexKind::IVF_PQ: return "ivf_pq";
+    }
+    return "unknown";
+}
+
+faiss::Index* inner_index(faiss::Index* index) {
+    auto* id_map = dynamic_cast<faiss::IndexIDMap*>(index);
+    return id_map ? id_map->index : index;
+}
+
+IndexKind detect_kind(faiss::Index* index) {
+    faiss::Index* base = inner_index(index);
+    if (dynamic_cast<faiss::IndexIVFPQ*>(base)) return IndexKind::IVF_PQ;
+    if (dynamic_cast<faiss::IndexHNSWSQ*>(base)) return IndexKind::HNSW_SQ8;
+    if (dynamic_cast<faiss::IndexHNSW*>(base)) return IndexKind::HNSW;
+    return IndexKind::Flat;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+IndexConfig IndexConfig::from_json(const json& j) {
+    IndexConfig c;
+    if (!j.contains("vector_index") || !j["vector_index"].is_object()) return c;
+    const auto& v = j["vector_index"];
+
+    std::string type = v.value("type", std::string("hnsw"));
+    if (type == "flat") c.kind = IndexKind::Flat;
+    else if (type == "hnsw") c.kind = IndexKind::HNSW;
+    else if (type == "hnsw_sq8") c.kind = IndexKind::HNSW_SQ8;
+    else if (type == "ivf_pq") c.kind = IndexKind::IVF_PQ;
+    else spdlog::warn("⚠️ Unknown vector_index.type '{}', using hnsw", type);
+
+    c.hnsw_m = v.value("hnsw_m", c.hnsw_m);
+    c.ef_construction = v.value("ef_construction", c.ef_construction);
+    c.ef_search = v.value("ef_search", c.ef_search);
+    c.ivf_nlist = v.value("ivf_nlist", c.ivf_nlist);
+    c.pq_m = v.value("pq_m", c.pq_m);
+    c.pq_nbits = v.value("pq_nbits", c.pq_nbits);
+    c.nprobe = v.value("nprobe", c.nprobe);
+    c.train_min = v.value("train_min", c.train_min);
+    c.rerank_factor = std::max(1, v.value("rerank_factor", c.rerank_factor));
+    std::string precision = v.value("embedding_precision", std::string(precision_name(c.embedding_precision)));
+    if (!parse_precision(precision, c.embedding_precision)) {
+        spdlog::warn("⚠️ Unknown vector_index.embedding_precision '{}', using {}", precision,
+                     precision_name(c.embedding_precision));
     }
-};
+    return c;
+}
+
+IndexConfig IndexConfig::load_for_project(const std::string& root_path) {
+    fs::path config_path = fs::path(root_path) / ".study_assistant" / "config.json";
+    if (!fs::exists(config_path)) config_path = fs::path(root_path) / "config.json";
+    if (!fs::exists(config_path)) return {};
+
+    try {
+        std::ifstream f(config_path);
+        return from_json(json::parse(f));
+    } catch (...) {
+        spdlog::error("❌ Config corrupted at {}", config_path.string());
+        return {};
+    }
+}
+
+// --- LIFECYCLE ---
 
-FaissVectorStore::FaissVectorStore(int dimension) : dimension_(dimension) {
-    // 🚀 THE ACCELERATOR: 32 links per node. efConstruction=128.
-    // This allows the search to 'jump' across the code graph.
-    faiss::IndexHNSWFlat* hnsw_idx = new faiss::IndexHNSWFlat(dimension, 32);
-    hnsw_idx->hnsw.efConstruction = 128; // High precision indexing
-    hnsw_idx->hnsw.efSearch = 64;       // Fast retrieval
-    
-    index_.reset(hnsw_idx); 
-    spdlog::info("🚀 HNSW Accelerator Core Primed. Dimension: {}", dimension);
+FaissVectorStore::FaissVectorStore(int dimension, IndexConfig config)
+    : dimension_(dimension), config_(std::move(config)) {
+    // Segment ids seeded from the clock: a store built beside a loaded one (a full re-sync)
+    // never reuses a file name the other may still believe it has written
+    next_segment_id_.store(std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::system_clock::now().time_since_epoch()).count(),
+                           std::memory_order_relaxed);
+    auto snap = std::make_shared<Snapshot>();
+    snap->overlay = std::make_shared<const OverlayMap>();
+    snap->tombstones = std::make_shared<const LabelSet>();
+    snapshot_.store(std::move(snap), std::memory_order_release);
+    lexical_.store(std::make_shared<LexicalIndex>(), std::memory_order_release);
+    spdlog::info("🚀 HNSW Accelerator Core Primed. Dimension: {} | Backend: {}", dimension, kind_name(config_.kind));
 }
 
 FaissVectorStore::~FaissVectorStore() {
+    if (compaction_thread_.joinable()) compaction_thread_.join();
+}
+
+// The kind make_index() builds from n_train vectors, fallbacks included. needs_rebuild()
+// compares against this too: a configured kind that cannot be built must not look like a
+// pending rebuild, or every merge would rebuild into the fallback again.
+IndexKind FaissVectorStore::target_kind(size_t n_train) const {
+    if (n_train < train_floor(config_)) return IndexKind::HNSW; // Not enough data to train yet
+    if (config_.kind == IndexKind::IVF_PQ && (config_.pq_m <= 0 || dimension_ % config_.pq_m != 0)) {
+        return IndexKind::HNSW_SQ8;
+    }
+    return config_.kind;
+}
+
+std::unique_ptr<faiss::Index> FaissVectorStore::make_index(size_t n_train, IndexKind& kind_out) const {
+    IndexKind kind = target_kind(n_train);
+    if (kind == IndexKind::HNSW_SQ8 && config_.kind == IndexKind::IVF_PQ) {
+        spdlog::warn("⚠️ pq_m={} does not divide dimension {}; using hnsw_sq8", config_.pq_m, dimension_);
+    }
+
+    // Inner product on L2-normalized vectors = cosine, so higher scores are better.
+    faiss::Index* base = nullptr;
+    switch (kind) {
+        case IndexKind::Flat:
+            base = new faiss::IndexFlatIP(dimension_);
+            break;
+        case IndexKind::HNSW: {
+            // 🚀 THE ACCELERATOR: 32 links per node. efConstruction=128.
+            // This allows the search to 'jump' across the code graph.
+            auto* hnsw_idx = new faiss::IndexHNSWFlat(dimension_, config_.hnsw_m, faiss::METRIC_INNER_PRODUCT);
+            hnsw_idx->hnsw.efConstruction = config_.ef_construction;
+            base = hnsw_idx;
+            break;
+        }
+        case IndexKind::HNSW_SQ8: {
+            // 1 byte per dimension instead of 4; graph links unchanged
+            auto* hnsw_idx = new faiss::IndexHNSWSQ(dimension_, faiss::ScalarQuantizer::QT_8bit,
+                                                    config_.hnsw_m, faiss::METRIC_INNER_PRODUCT);
+            hnsw_idx->hnsw.efConstruction = config_.ef_construction;
+            base = hnsw_idx;
+            break;
+        }
+        case IndexKind::IVF_PQ: {
+            // pq_m bytes per vector at 8 bits (64 B vs 3 KB for 768 dims)
+            auto* quantizer = new faiss::IndexFlatIP(dimension_);
+            auto* ivf = new faiss::IndexIVFPQ(quantizer, dimension_, config_.ivf_nlist,
+                                              config_.pq_m, config_.pq_nbits, faiss::METRIC_INNER_PRODUCT);
+            ivf->own_fields = true;
+            ivf->make_direct_map(true); // Lets IDMap2::reconstruct reach PQ codes during compaction
+            base = ivf;
+            break;
+        }
+    }
+    apply_search_params(base);
+
+    // IDMap2 keeps label -> vector so compaction can reconstruct live rows
+    auto* id_map = new faiss::IndexIDMap2(base);
+    id_map->own_fields = true;
+    kind_out = kind;
+    return std::unique_ptr<faiss::Index>(id_map);
+}
+
+void FaissVectorStore::apply_search_params(faiss::Index* index) const {
+    faiss::Index* base = inner_index(index);
+    if (auto* hnsw_idx = dynamic_cast<faiss::IndexHNSW*>(base)) {
+        hnsw_idx->hnsw.efSearch = config_.ef_search; // Fast retrieval
+    } else if (auto* ivf = dynamic_cast<faiss::IndexIVF*>(base)) {
+        ivf->nprobe = config_.nprobe;
+    }
+}
+
+// Small seals stay on HNSW until trained; only the bulk of the index decides. A rebuild
+// trains on the live nodes that have a vector, which is what build_segment will see:
+// live_count also counts nodes stored without one, and a kind chosen from it could
+// never be reached, so the merger would rebuild forever.
+bool FaissVectorStore::needs_rebuild(const Snapshot& snap) const {
+    const Segment* largest = snap.largest();
+    if (!largest) return false;
+    return largest->kind != target_kind(snap.live_vectors);
+}
+
+// Every entry but the current one of each live, indexed label is stale: tombstoned and
+// superseded entries alike, however many live nodes were stored without a vector
+void FaissVectorStore::publish(std::shared_ptr<Snapshot> next) {
+    int64_t total = next->total_vectors();
+    next->stale_vectors = total > static_cast<int64_t>(next->live_vectors) ? total - next->live_vectors : 0;
+    next->version = current()->version + 1;
+    snapshot_.store(std::move(next), std::memory_order_release);
+}
+
+// --- SNAPSHOT LOOKUP ---
+
+std::shared_ptr<CodeNode> FaissVectorStore::Rows::materialize(size_t row) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = cache[row];
+    if (!slot) slot = store->materialize(row);
+    return slot;
+}
+
+int64_t FaissVectorStore::Snapshot::sealed_vectors() const {
+    int64_t n = 0;
+    for (const auto& seg : sealed) n += seg.index->ntotal;
+    return n;
+}
+
+int64_t FaissVectorStore::Snapshot::delta_vectors() const {
+    int64_t n = 0;
+    for (const auto& d : deltas) n += d->ntotal;
+    return n;
+}
+
+bool FaissVectorStore::Snapshot::quantized() const {
+    return std::any_of(sealed.begin(), sealed.end(), [](const Segment& seg) {
+        return seg.kind == IndexKind::HNSW_SQ8 || seg.kind == IndexKind::IVF_PQ;
+    });
+}
+
+const FaissVectorStore::Segment* FaissVectorStore::Snapshot::largest() const {
+    const Segment* best = nullptr;
+    for (const auto& seg : sealed) {
+        if (!best || seg.index->ntotal > best->index->ntotal) best = &seg;
+    }
+    return best;
+}
+
+long FaissVectorStore::Snapshot::segment_row(int64_t label) const {
+    return rows ? rows->store->find_by_hash(static_cast<uint64_t>(label), LABEL_MASK) : -1;
+}
+
+bool FaissVectorStore::Snapshot::is_live(int64_t label) const {
+    if (tombstones->count(label)) return false;
+    if (overlay->count(label)) return true;
+    return segment_row(label) >= 0;
+}
+
+bool FaissVectorStore::Snapshot::indexed(int64_t label) const {
+    auto holds = [label](const faiss::Index* index) {
+        const auto* id_map = dynamic_cast<const faiss::IndexIDMap2*>(index);
+        return id_map && id_map->rev_map.count(label) > 0;
+    };
+    return std::any_of(sealed.begin(), sealed.end(), [&](const Segment& seg) { return holds(seg.index.get()); }) ||
+           std::any_of(deltas.begin(), deltas.end(), [&](const auto& d) { return holds(d.get()); });
+}
+
+std::shared_ptr<CodeNode> FaissVectorStore::Snapshot::lookup(int64_t label) const {
+    if (tombstones->count(label)) return nullptr;
+
+    auto it = overlay->find(label);
+    if (it != overlay->end()) return it->second.arena->materialize(it->second.idx);
+
+    long row = segment_row(label);
+    return row < 0 ? nullptr : rows->materialize(row);
 }
 
-void FaissVectorStore::add_nodes(const std::vector<std::shared_ptr<CodeNode>>& nodes) {
+float FaissVectorStore::Snapshot::centrality_of(int64_t label, long row) const {
+    if (centrality) {
+        auto it = centrality->find(label);
+        if (it != centrality->end()) return it->second;
+    }
+    // Nodes upserted since the last refresh keep the score their previous version had
+    return row >= 0 ? rows->store->centrality(row) : 0.0f;
+}
+
+const float* FaissVectorStore::Snapshot::exact_vector(int64_t label, float* scratch) const {
+    auto it = overlay->find(label);
+    if (it != overlay->end()) return it->second.arena->embedding(it->second.idx);
+    long row = segment_row(label);
+    return row >= 0 ? rows->store->embedding(row, scratch) : nullptr; // f32 straight from the mmap, else decoded
+}
+
+std::shared_ptr<CodeNode> FaissVectorStore::get_node(int64_t label) const {
+    return current()->lookup(label);
+}
+
+size_t FaissVectorStore::exact_vectors(const int64_t* labels, size_t n, std::vector<float>& out) const {
+    auto snap = current();
+    out.assign(n * dimension_, 0.0f);
+    size_t found = 0;
+    for (size_t i = 0; i < n; ++i) {
+        float* row = out.data() + i * dimension_;
+        if (snap->tombstones->count(labels[i])) continue;
+        const float* v = snap->exact_vector(labels[i], row); // Decodes straight into the row
+        if (!v) continue;
+        if (v != row) std::copy_n(v, dimension_, row);
+        found++;
+    }
+    return found;
+}
+
+std::shared_ptr<CodeNode> FaissVectorStore::get_node_by_name(const std::string& name) const {
+    auto node = current()->lookup(stable_id(name));
+    return (node && node->id == name) ? node : nullptr; // Guard against 63-bit hash collisions
+}
+
+size_t FaissVectorStore::size() const {
+    return current()->live_count;
+}
+
+double FaissVectorStore::tombstone_ratio() const {
+    auto snap = current();
+    int64_t total = snap->total_vectors();
+    return total > 0 ? static_cast<double>(snap->stale_vectors) / total : 0.0;
+}
+
+std::vector<std::shared_ptr<CodeNode>> FaissVectorStore::get_all_nodes() const {
+    auto snap = current();
+    std::vector<std::shared_ptr<CodeNode>> all;
+    all.reserve(snap->live_count);
+
+    const NodeStore* store = snap->rows ? snap->rows->store.get() : nullptr;
+    for (size_t row = 0; store && row < store->size(); ++row) {
+        int64_t label = static_cast<int64_t>(store->id_hash(row) & LABEL_MASK);
+        if (snap->tombstones->count(label) || snap->overlay->count(label)) continue;
+        all.push_back(snap->rows->materialize(row));
+    }
+    for (const auto& [label, ref] : *snap->overlay) all.push_back(ref.arena->materialize(ref.idx));
+    return all;
+}
+
+// --- ADJACENCY ---
+
+std::shared_ptr<const CsrGraph> FaissVectorStore::adjacency() const {
+    std::lock_guard<std::mutex> graph_lock(graph_mutex_);
+    auto snap = current();
+    if (graph_ && graph_version_ == snap->version) return graph_;
+
+    auto start = std::chrono::steady_clock::now();
+    auto g = std::make_shared<CsrGraph>();
+    g->labels.reserve(snap->live_count);
+    g->structural.reserve(snap->live_count);
+    g->dense_of.reserve(snap->live_count);
+
+    // Pass 1: dense ids. Segment rows first (in row order), then overlay nodes.
+    const NodeStore* store = snap->rows ? snap->rows->store.get() : nullptr;
+    std::vector<long> rows;
+    rows.reserve(snap->live_count);
+    for (size_t row = 0; store && row < store->size(); ++row) {
+        int64_t label = static_cast<int64_t>(store->id_hash(row) & LABEL_MASK);
+        if (snap->tombstones->count(label) || snap->overlay->count(label)) continue;
+        g->dense_of.emplace(label, static_cast<uint32_t>(g->labels.size()));
+        g->labels.push_back(label);
+        g->structural.push_back(blend_structural(store->structural_weight(row), snap->centrality_of(label, row)));
+        rows.push_back(static_cast<long>(row));
+    }
+    std::vector<const OverlayRef*> overlay_nodes;
+    overlay_nodes.reserve(snap->overlay->size());
+    for (const auto& [label, ref] : *snap->overlay) {
+        g->dense_of.emplace(label, static_cast<uint32_t>(g->labels.size()));
+        g->labels.push_back(label);
+        float centrality = snap->centrality_of(label, snap->segment_row(label));
+        g->structural.push_back(blend_structural(ref.arena->structural_weight(ref.idx), centrality));
+        overlay_nodes.push_back(&ref);
+    }
+
+    // Pass 2: resolve dependency names once, here, instead of per query
+    g->offsets.reserve(g->labels.size() + 1);
+    g->offsets.push_back(0);
+    auto link = [&](uint32_t self, std::string_view dep) {
+        uint32_t v = g->find(stable_id(dep));
+        if (v != CsrGraph::NONE && v != self) g->targets.push_back(v);
+    };
+    for (uint32_t u = 0; u < rows.size(); ++u) {
+        uint32_t n = store->dependency_count(rows[u]);
+        for (uint32_t i = 0; i < n; ++i) link(u, store->dependency(rows[u], i));
+        g->offsets.push_back(static_cast<uint32_t>(g->targets.size()));
+    }
+    for (size_t i = 0; i < overlay_nodes.size(); ++i) {
+        uint32_t u = static_cast<uint32_t>(rows.size() + i);
+        const OverlayRef& ref = *overlay_nodes[i];
+        uint32_t n = ref.arena->dependency_count(ref.idx);
+        for (uint32_t d = 0; d < n; ++d) link(u, ref.arena->dependency(ref.idx, d));
+        g->offsets.push_back(static_cast<uint32_t>(g->targets.size()));
+    }
+
+    spdlog::info("🕸️ Adjacency built: {} nodes, {} edges ({:.1f} ms)", g->size(), g->edge_count(), elapsed_ms(start));
+
+    graph_ = std::move(g);
+    graph_version_ = snap->version;
+    return graph_;
+}
+
+void FaissVectorStore::refresh_centrality(const CentralityOptions& opts) {
+    auto graph = adjacency();
+    if (graph->size() == 0) return;
+    Centrality c = compute_centrality(*graph, opts);
+
+    auto scores = std::make_shared<std::unordered_map<int64_t, float>>();
+    scores->reserve(graph->size());
+    for (size_t u = 0; u < graph->size(); ++u) scores->emplace(graph->labels[u], c.score[u]);
+
+    // Nodes written meanwhile are simply absent from the table and fall back per centrality_of()
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    auto next = std::make_shared<Snapshot>(*current());
+    next->centrality = std::move(scores);
+    publish(std::move(next));
+}
+
+// --- LEXICAL ---
+
+std::shared_ptr<const LexicalIndex> FaissVectorStore::lexical() const {
+    return lexical_.load(std::memory_order_acquire);
+}
+
+std::shared_ptr<LexicalIndex> FaissVectorStore::build_lexical(const Snapshot& snap) const {
+    auto start = std::chrono::steady_clock::now();
+    auto lex = std::make_shared<LexicalIndex>();
+    const NodeStore* store = snap.rows ? snap.rows->store.get() : nullptr;
+    for (size_t row = 0; store && row < store->size(); ++row) {
+        int64_t label = static_cast<int64_t>(store->id_hash(row) & LABEL_MASK);
+        if (snap.tombstones->count(label) || snap.overlay->count(label)) continue;
+        lex->add(label, store->id(row), store->name(row), store->file_path(row), store->content(row));
+    }
+    for (const auto& [label, ref] : *snap.overlay) {
+        const NodeArena& a = *ref.arena;
+        lex->add(label, a.id(ref.idx), a.name(ref.idx), a.file_path(ref.idx), a.content(ref.idx));
+    }
+    spdlog::info("🔤 Lexical index built: {} nodes ({:.1f} ms)", lex->size(), elapsed_ms(start));
+    return lex;
+}
+
+// --- DELTA SEGMENTS ---
+
+// Exact search over a batch's vectors: no training, no graph to maintain
+std::unique_ptr<faiss::Index> FaissVectorStore::make_delta(size_t n, const float* vectors, const int64_t* labels) const {
+    auto* id_map = new faiss::IndexIDMap2(new faiss::IndexFlatIP(dimension_));
+    id_map->own_fields = true;
+    if (n > 0) id_map->add_with_ids(n, vectors, labels);
+    return std::unique_ptr<faiss::Index>(id_map);
+}
+
+// Newest input first, so a label's first hit is its latest vector. Exact vectors come
+// from the node itself when it keeps one (quantized segments only approximate them).
+void FaissVectorStore::gather(const Snapshot& snap, const std::vector<const faiss::Index*>& inputs,
+                              std::vector<int64_t>& labels, std::vector<float>& vectors) const {
+    std::unordered_set<int64_t> seen;
+    std::vector<float> buf(dimension_);
+    std::vector<float> decoded(dimension_);
+    for (auto in = inputs.rbegin(); in != inputs.rend(); ++in) {
+        const auto* id_map = dynamic_cast<const faiss::IndexIDMap2*>(*in);
+        if (!id_map) throw std::logic_error("segment is not label-mapped");
+        const auto* flat = dynamic_cast<const faiss::IndexFlat*>(id_map->index);
+
+        for (int64_t j = (*in)->ntotal - 1; j >= 0; --j) {
+            int64_t label = id_map->id_map[j];
+            if (!snap.is_live(label) || !seen.insert(label).second) continue;
+
+            const float* v = snap.exact_vector(label, decoded.data());
+            if (!v && flat) {
+                v = flat->get_xb() + j * dimension_;
+            } else if (!v) {
+                try {
+                    (*in)->reconstruct(label, buf.data());
+                } catch (...) { continue; }
+                v = buf.data();
+            }
+            labels.push_back(label);
+            vectors.insert(vectors.end(), v, v + dimension_);
+        }
+    }
+    if (!labels.empty()) faiss::fvec_renorm_L2(dimension_, labels.size(), vectors.data());
+}
+
+// One memtable batch holding what `deltas` still contribute; superseded and tombstoned
+// entries are dropped on the way
+std::shared_ptr<const faiss::Index> FaissVectorStore::merge_deltas(
+    const Snapshot& snap, const std::vector<std::shared_ptr<const faiss::Index>>& deltas) const {
+    if (deltas.size() == 1) return deltas.front();
+
+    std::vector<const faiss::Index*> inputs;
+    for (const auto& d : deltas) inputs.push_back(d.get());
+    std::vector<int64_t> labels;
+    std::vector<float> vectors;
+    gather(snap, inputs, labels, vectors);
+    return make_delta(labels.size(), vectors.data(), labels.data());
+}
+
+// --- MUTATION ---
+
+void FaissVectorStore::upsert_nodes(const std::vector<std::shared_ptr<CodeNode>>& nodes) {
     if (nodes.empty()) return;
+    replace_file_nodes({}, nodes);
+}
+
+size_t FaissVectorStore::remove_by_file(const std::string& file_path) {
+    return replace_file_nodes({file_path}, {});
+}
+
+void FaissVectorStore::build_file_index(const Snapshot& snap) {
+    file_index_.clear();
+    const NodeStore* store = snap.rows ? snap.rows->store.get() : nullptr;
+    for (size_t row = 0; store && row < store->size(); ++row) {
+        int64_t label = static_cast<int64_t>(store->id_hash(row) & LABEL_MASK);
+        file_index_[std::string(store->file_path(row))].push_back(label);
+    }
+    for (const auto& [label, ref] : *snap.overlay) file_index_[std::string(ref.arena->file_path(ref.idx))].push_back(label);
+    file_index_ready_ = true;
+}
 
+size_t FaissVectorStore::replace_file_nodes(const std::vector<std::string>& file_paths,
+                                           const std::vector<std::shared_ptr<CodeNode>>& nodes) {
+    // Everything but the publication happens before taking the writer lock
+    auto arena = std::make_shared<NodeArena>(dimension_);
     std::vector<float> vectors_flat;
-    std::vector<const std::shared_ptr<CodeNode>*> node_pointers;
+    std::vector<int64_t> labels;
+    std::vector<NodeArena::Index> records;
+    std::vector<const std::string*> files;
 
     for (const auto& node : nodes) {
-        if (!node->embedding.empty()) {
+        if (node->embedding.size() == static_cast<size_t>(dimension_)) {
             vectors_flat.insert(vectors_flat.end(), node->embedding.begin(), node->embedding.end());
-            node_pointers.push_back(&node);
+            labels.push_back(stable_id(node->id));
+            records.push_back(arena->add(*node));
+            files.push_back(&node->file_path);
         }
     }
 
-    if (vectors_flat.empty()) return;
+    long num_to_add = labels.size();
+    std::shared_ptr<const faiss::Index> delta;
+    if (num_to_add > 0) {
+        faiss::fvec_renorm_L2(dimension_, num_to_add, vectors_flat.data());
+        delta = make_delta(num_to_add, vectors_flat.data(), labels.data());
+    }
+    std::shared_ptr<const NodeArena> batch = std::move(arena);
+
+    size_t removed = 0;
+    {
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        auto cur = current();
+
+        std::vector<int64_t> doomed;
+        if (!file_paths.empty()) {
+            if (!file_index_ready_) build_file_index(*cur);
+            for (const auto& path : file_paths) {
+                auto it = file_index_.find(path);
+                if (it == file_index_.end()) continue;
+                doomed.insert(doomed.end(), it->second.begin(), it->second.end());
+                file_index_.erase(it); // Upserts below re-list the nodes the files still have
+            }
+        }
+        if (doomed.empty() && !delta) return 0;
+
+        auto next = std::make_shared<Snapshot>(*cur);
+        auto overlay = std::make_shared<OverlayMap>(*cur->overlay);
+        next->overlay = overlay;
+        std::shared_ptr<LabelSet> tombstones;
+        if (!doomed.empty() || !cur->tombstones->empty()) {
+            tombstones = std::make_shared<LabelSet>(*cur->tombstones);
+            next->tombstones = tombstones;
+        }
+
+        // Removals first: a node the new version of its file keeps is revived by its upsert
+        for (int64_t label : doomed) {
+            if (!next->is_live(label)) continue;
+            if (overlay->count(label) || next->indexed(label)) next->live_vectors--;
+            tombstones->insert(label);
+            overlay->erase(label);
+            next->live_count--;
+            removed++;
+        }
+        if (removed == 0 && !delta) return 0; // The files' nodes were all gone already
+
+        for (long i = 0; i < num_to_add; ++i) {
+            int64_t label = labels[i];
+
+            // The old vector stays in its segment until a merge; search dedupes by label.
+            // Overlay entries always have one; a loaded row may have been stored without.
+            bool live = next->is_live(label);
+            if (!live) next->live_count++;
+            if (!live || (!overlay->count(label) && !next->indexed(label))) next->live_vectors++;
+
+            if (tombstones) tombstones->erase(label);
+            // The record it replaces goes with the last overlay entry into its batch
+            (*overlay)[label] = OverlayRef{batch, records[i]};
+            if (file_index_ready_) file_index_[*files[i]].push_back(label);
+        }
+
+        if (delta) {
+            next->deltas.push_back(std::move(delta));
+            if (next->deltas.size() > MAX_DELTA_SEGMENTS) {
+                // Batches a running merge has captured (always the oldest) stay as they are,
+                // so it can drop exactly those when it publishes
+                auto tail = next->deltas.begin() + std::min(merging_deltas_.size(), next->deltas.size());
+                if (next->deltas.end() - tail > 1) {
+                    auto merged = merge_deltas(*next, std::vector<std::shared_ptr<const faiss::Index>>(tail, next->deltas.end()));
+                    next->deltas.erase(tail, next->deltas.end());
+                    next->deltas.push_back(std::move(merged));
+                }
+            }
+        }
+
+        // Indexed before the version moves: a result computed at the new version always sees
+        // these nodes, and one computed in between is cached under the old version. New labels
+        // stay filtered by contains() until the publish.
+        auto lex = lexical_.load(std::memory_order_acquire);
+        for (long i = 0; i < num_to_add; ++i) {
+            const NodeArena& a = *batch;
+            lex->add(labels[i], a.id(records[i]), a.name(records[i]), a.file_path(records[i]), a.content(records[i]));
+        }
+        publish(next);
+        if (removed > 0 && file_paths.size() == 1) {
+            spdlog::info("🪦 Tombstoned {} nodes from {}", removed, file_paths.front());
+        } else if (removed > 0) {
+            spdlog::info("🪦 Tombstoned {} nodes from {} files", removed, file_paths.size());
+        }
+        if (num_to_add > 0) {
+            spdlog::info("✅ Upserted {} nodes into FAISS. Live: {} | Stale vectors: {} | Memtable: {} | Sealed segments: {}",
+                         num_to_add, next->live_count, next->stale_vectors, next->delta_vectors(), next->sealed.size());
+        }
+    }
+    maybe_schedule_compaction();
+    return removed;
+}
+
+// --- MERGER ---
+
+void FaissVectorStore::maybe_schedule_compaction() {
+    auto snap = current();
+    int64_t total = snap->total_vectors();
+    double ratio = total > 0 ? static_cast<double>(snap->stale_vectors) / total : 0.0;
+    // Also fires once a quantized backend has enough vectors to train
+    bool due = ratio > compaction_threshold_ || needs_rebuild(*snap) ||
+               snap->delta_vectors() >= static_cast<int64_t>(MEMTABLE_SEAL_VECTORS) ||
+               snap->sealed.size() > MAX_SEALED_SEGMENTS ||
+               lexical_.load(std::memory_order_acquire)->needs_compaction();
+    if (!due) return;
+    if (compacting_.exchange(true)) return; // Already running
+
+    if (compaction_thread_.joinable()) compaction_thread_.join();
+    compaction_thread_ = std::thread([this] {
+        try {
+            std::lock_guard<std::mutex> fold_lock(fold_mutex_);
+            while (merge_step()) {}
+        } catch (const std::exception& e) {
+            spdlog::error("💥 Segment merge failed: {}", e.what());
+        }
+        compacting_ = false;
+    });
+}
 
-    long start_idx = index_->ntotal;
-    long num_to_add = node_pointers.size();
-    
-    faiss::fvec_renorm_L2(dimension_, num_to_add, vectors_flat.data());
-    
-    index_->add(num_to_add, vectors_flat.data());
+bool FaissVectorStore::merge_step() {
+    auto snap = current();
+    int64_t total = snap->total_vectors();
+    double ratio = total > 0 ? static_cast<double>(snap->stale_vectors) / total : 0.0;
 
-    for (long i = 0; i < num_to_add; ++i) {
-        long current_id = start_idx + i;
-        auto node = *node_pointers[i];
-        
-        nodes_list_.push_back(node);
-        id_to_node_map_[current_id] = node;
-        name_to_id_map_[node->id] = current_id;
+    if (ratio > compaction_threshold_ || needs_rebuild(*snap)) {
+        rebuild_index();
+        return true;
+    }
+    if (snap->delta_vectors() >= static_cast<int64_t>(MEMTABLE_SEAL_VECTORS)) {
+        seal_memtable(*capture_memtable());
+        return true;
+    }
+    if (snap->sealed.size() > MAX_SEALED_SEGMENTS) {
+        merge_smallest(*snap);
+        return true;
+    }
+    // Re-saved nodes leave superseded lexical documents behind; drop them off the write path
+    if (auto lex = lexical_.load(std::memory_order_acquire); lex->needs_compaction()) {
+        size_t dropped = lex->superseded();
+        lex->compact();
+        spdlog::debug("🔤 Lexical index compacted: {} superseded documents dropped", dropped);
+        return true;
     }
+    return false;
+}
 
-    spdlog::info("✅ Added {} nodes to FAISS. Total: {}", num_to_add, index_->ntotal);
+void FaissVectorStore::compact() {
+    std::lock_guard<std::mutex> fold_lock(fold_mutex_);
+    rebuild_index();
 }
 
-std::vector<FaissSearchResult> FaissVectorStore::search(const std::vector<float>& query_vector, int k) {
-    if (index_->ntotal == 0) return {};
+FaissVectorStore::Segment FaissVectorStore::build_segment(std::vector<int64_t>& labels, std::vector<float>& vectors) {
+    Segment seg;
+    seg.id = next_segment_id_.fetch_add(1, std::memory_order_relaxed);
+    auto index = make_index(labels.size(), seg.kind);
+    if (!labels.empty()) {
+        if (!index->is_trained) index->train(labels.size(), vectors.data()); // SQ ranges / IVF centroids + PQ codebooks
+        index->add_with_ids(labels.size(), vectors.data(), labels.data());
+    }
+    seg.index = std::move(index);
+    return seg;
+}
 
-    std::vector<float> query_copy = query_vector;
-    faiss::fvec_renorm_L2(dimension_, 1, query_copy.data());
+// Swaps inputs captured from an earlier snapshot for `merged`, keeping everything
+// published since. The merged segment takes the place of its oldest sealed input, or
+// becomes the newest segment when it was built from the memtable alone.
+void FaissVectorStore::replace_segments(const std::vector<uint64_t>& sealed_ids,
+                                        const std::vector<std::shared_ptr<const faiss::Index>>& deltas, Segment merged) {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    auto next = std::make_shared<Snapshot>(*current());
 
-    std::vector<float> scores(k);
-    std::vector<faiss::idx_t> indices(k);
+    auto is_input = [&](const Segment& seg) {
+        return std::find(sealed_ids.begin(), sealed_ids.end(), seg.id) != sealed_ids.end();
+    };
+    auto pos = std::find_if(next->sealed.begin(), next->sealed.end(), is_input) - next->sealed.begin();
+    std::erase_if(next->sealed, is_input);
+    if (merged.index->ntotal > 0) next->sealed.insert(next->sealed.begin() + pos, std::move(merged));
 
-    index_->search(1, query_copy.data(), k, scores.data(), indices.data());
+    std::erase_if(next->deltas, [&](const auto& d) {
+        return std::find(deltas.begin(), deltas.end(), d) != deltas.end();
+    });
+    merging_deltas_.clear();
+    publish(std::move(next));
+}
+
+std::shared_ptr<const FaissVectorStore::Snapshot> FaissVectorStore::capture_memtable() {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    auto snap = current();
+    merging_deltas_ = snap->deltas;
+    return snap;
+}
+
+// 🧹 Every segment into one graph of live vectors only
+void FaissVectorStore::rebuild_index() {
+    auto start = std::chrono::steady_clock::now();
+    auto snap = capture_memtable();
+
+    std::vector<const faiss::Index*> inputs;
+    std::vector<uint64_t> ids;
+    for (const auto& seg : snap->sealed) {
+        inputs.push_back(seg.index.get());
+        ids.push_back(seg.id);
+    }
+    for (const auto& d : snap->deltas) inputs.push_back(d.get());
+
+    std::vector<int64_t> labels;
+    std::vector<float> vectors;
+    labels.reserve(snap->live_count);
+    vectors.reserve(snap->live_count * dimension_);
+    gather(*snap, inputs, labels, vectors);
+
+    Segment seg = build_segment(labels, vectors);
+    IndexKind kind = seg.kind;
+    replace_segments(ids, snap->deltas, std::move(seg));
+    spdlog::info("🧹 Compacted FAISS index into one segment: {} live vectors, backend {} ({:.1f} ms)",
+                 labels.size(), kind_name(kind), elapsed_ms(start));
+}
+
+// The memtable becomes a graph of its own: O(memtable), however big the rest is
+void FaissVectorStore::seal_memtable(const Snapshot& snap) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<const faiss::Index*> inputs;
+    for (const auto& d : snap.deltas) inputs.push_back(d.get());
+
+    std::vector<int64_t> labels;
+    std::vector<float> vectors;
+    gather(snap, inputs, labels, vectors);
+
+    Segment seg = build_segment(labels, vectors);
+    uint64_t id = seg.id;
+    replace_segments({}, snap.deltas, std::move(seg));
+    spdlog::info("🪵 Sealed memtable as segment {}: {} vectors ({:.1f} ms)", id, labels.size(), elapsed_ms(start));
+}
+
+// Size-tiered: the smallest adjacent pair goes first, so segments grow geometrically and
+// each vector is rewritten O(log n) times
+void FaissVectorStore::merge_smallest(const Snapshot& snap) {
+    auto start = std::chrono::steady_clock::now();
+    size_t best = 0;
+    for (size_t i = 1; i + 1 < snap.sealed.size(); ++i) {
+        auto pair_size = [&](size_t j) { return snap.sealed[j].index->ntotal + snap.sealed[j + 1].index->ntotal; };
+        if (pair_size(i) < pair_size(best)) best = i;
+    }
+    const Segment& older = snap.sealed[best];
+    const Segment& newer = snap.sealed[best + 1];
+
+    std::vector<int64_t> labels;
+    std::vector<float> vectors;
+    gather(snap, {older.index.get(), newer.index.get()}, labels, vectors);
+
+    Segment seg = build_segment(labels, vectors);
+    uint64_t id = seg.id;
+    replace_segments({older.id, newer.id}, {}, std::move(seg));
+    spdlog::info("🪵 Merged segments {} + {} into {}: {} vectors ({:.1f} ms)", older.id, newer.id, id, labels.size(),
+                 elapsed_ms(start));
+}
+
+// --- SEARCH ---
+
+std::vector<FaissSearchResult> FaissVectorStore::search(const std::vector<float>& query_vector, int k, const SearchOptions& opts) {
+    if ((int)query_vector.size() != dimension_) return {};
+
+    auto batch = search_batch(query_vector.data(), 1, opts.k > 0 ? opts.k : k, opts);
 
     std::vector<FaissSearchResult> results;
-    for (int i = 0; i < k; ++i) {
-        if (indices[i] == -1) continue;
-        
-        auto it = id_to_node_map_.find(indices[i]);
-        if (it != id_to_node_map_.end()) {
-            results.push_back({it->second, scores[i]});
+    results.reserve(batch.k);
+    auto labels = batch.labels_of(0);
+    auto scores = batch.scores_of(0);
+    for (int i = 0; i < batch.k; ++i) {
+        if (labels[i] == -1) continue;
+        if (auto node = get_node(labels[i])) {
+            results.push_back({node, scores[i]});
         }
     }
     return results;
 }
 
+FaissBatchResult FaissVectorStore::search_batch(const float* queries, size_t nq, int k, const SearchOptions& opts) const {
+    FaissBatchResult out;
+    search_batch_into(queries, nq, k, opts, out);
+    return out;
+}
+
+void FaissVectorStore::search_batch_into(const float* queries, size_t nq, int k, const SearchOptions& opts,
+                                         FaissBatchResult& out) const {
+    out.nq = 0;
+    out.k = 0;
+    out.labels.clear();
+    out.scores.clear();
+    if (nq == 0 || k <= 0) return;
+
+    // Per-thread buffers: steady-state searches reuse capacity instead of allocating
+    thread_local std::vector<float> normalized;
+    normalized.assign(queries, queries + nq * dimension_);
+    faiss::fvec_renorm_L2(dimension_, nq, normalized.data());
+
+    // Held to the end of the search: writers publishing meanwhile cannot affect it
+    auto snap = current();
+    const int64_t total = snap->total_vectors();
+    if (total == 0) return;
+
+    out.nq = nq;
+    out.k = k;
+    out.labels.assign(nq * k, -1);
+    out.scores.assign(nq * k, 0.0f);
+
+    static_assert(sizeof(faiss::idx_t) == sizeof(int64_t), "label layout must match faiss::idx_t");
+
+    // Quantized codes only approximate the score; re-rank a wider pool against exact vectors
+    const int rerank_factor = opts.rerank_factor > 0 ? opts.rerank_factor : config_.rerank_factor;
+    const bool do_rerank = rerank_factor > 1 && snap->quantized();
+    const int64_t pool = do_rerank ? std::min<int64_t>(total, (int64_t)k * rerank_factor) : k;
+
+    // Per-request knobs travel as SearchParameters, so concurrent searches never race on the index
+    faiss::SearchParametersHNSW hnsw_params;
+    faiss::SearchParametersIVF ivf_params;
+    if (opts.ef_search > 0) hnsw_params.efSearch = opts.ef_search;
+    if (opts.nprobe > 0) ivf_params.nprobe = opts.nprobe;
+    auto params_for = [&](IndexKind kind) -> const faiss::SearchParameters* {
+        if ((kind == IndexKind::HNSW || kind == IndexKind::HNSW_SQ8) && opts.ef_search > 0) return &hnsw_params;
+        if (kind == IndexKind::IVF_PQ && opts.nprobe > 0) return &ivf_params;
+        return nullptr;
+    };
+
+    // Fast path: one segment, and every vector in it backs exactly one live node
+    if (snap->sealed.size() == 1 && snap->deltas.empty() && snap->stale_vectors == 0 && !do_rerank) {
+        // FAISS parallelizes across queries internally (OpenMP)
+        const Segment& seg = snap->sealed.front();
+        seg.index->search(nq, normalized.data(), k, out.scores.data(), reinterpret_cast<faiss::idx_t*>(out.labels.data()),
+                          params_for(seg.kind));
+        return;
+    }
+
+    // Over-fetch from every segment to make room for tombstoned and superseded entries
+    struct Probe {
+        const faiss::Index* index;
+        const faiss::SearchParameters* params;
+        int64_t k;      // Fetched from this segment
+        size_t offset;  // Into the raw buffers, nq * k wide
+    };
+    const int64_t want = pool + std::min<int64_t>(snap->stale_vectors, 3 * pool);
+    thread_local std::vector<int64_t> raw_labels;
+    thread_local std::vector<float> raw_scores;
+    thread_local std::vector<Probe> probes;
+    probes.clear();
+    size_t fetched = 0;
+    auto plan = [&](const faiss::Index* index, const faiss::SearchParameters* params) {
+        int64_t kf = std::min<int64_t>(index->ntotal, want);
+        if (kf <= 0) return;
+        probes.push_back({index, params, kf, fetched});
+        fetched += nq * kf;
+    };
+    for (const auto& seg : snap->sealed) plan(seg.index.get(), params_for(seg.kind));
+    for (const auto& d : snap->deltas) plan(d.get(), nullptr);
+
+    raw_labels.resize(fetched);
+    raw_scores.resize(fetched);
+    // 🪵 Fan out: one graph per thread when there are several (each search then runs its
+    // queries serially, as nested OpenMP regions do). Thread-locals are bound here, on the
+    // calling thread.
+    const Probe* probe_list = probes.data();
+    int64_t* label_out = raw_labels.data();
+    float* score_out = raw_scores.data();
+    const float* query_in = normalized.data();
+    const long n_probes = static_cast<long>(probes.size());
+    #pragma omp parallel for schedule(dynamic) if (snap->sealed.size() > 1)
+    for (long p = 0; p < n_probes; ++p) {
+        const Probe& pr = probe_list[p];
+        pr.index->search(nq, query_in, pr.k, score_out + pr.offset, reinterpret_cast<faiss::idx_t*>(label_out + pr.offset),
+                         pr.params);
+    }
+
+    thread_local std::vector<std::pair<float, int64_t>> merged;
+    thread_local std::vector<int64_t> cand_labels;
+    thread_local std::vector<float> cand_scores;
+    cand_labels.resize(pool);
+    cand_scores.resize(pool);
+    for (size_t q = 0; q < nq; ++q) {
+        // Best-first across segments (each is already best-first)
+        merged.clear();
+        for (const Probe& pr : probes) {
+            for (int64_t i = 0; i < pr.k; ++i) {
+                int64_t label = raw_labels[pr.offset + q * pr.k + i];
+                if (label != -1) merged.emplace_back(raw_scores[pr.offset + q * pr.k + i], label);
+            }
+        }
+        if (probes.size() > 1) {
+            std::stable_sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        }
+
+        const float* query = normalized.data() + q * dimension_;
+        int64_t filled = 0;
+        bool rescored = false;
+        for (const auto& [score, label] : merged) {
+            if (filled >= pool) break;
+            if (!snap->is_live(label)) continue;
+            float s = score;
+            if (snap->stale_vectors > 0) {
+                if (std::find(cand_labels.begin(), cand_labels.begin() + filled, label) != cand_labels.begin() + filled) continue;
+                // A label with a superseded vector in an older segment was upserted since load, so
+                // it is in the overlay: score it by the vector it has now, whichever copy was hit
+                auto it = snap->overlay->find(label);
+                if (it != snap->overlay->end()) {
+                    if (const float* exact = it->second.arena->embedding(it->second.idx)) {
+                        float norm_sq = faiss::fvec_norm_L2sqr(exact, dimension_);
+                        if (norm_sq > 0.0f) s = faiss::fvec_inner_product(query, exact, dimension_) / std::sqrt(norm_sq);
+                        rescored = true;
+                    }
+                }
+            }
+            cand_labels[filled] = label;
+            cand_scores[filled] = s;
+            filled++;
+        }
+        if (rescored && !do_rerank) { // rerank() sorts anyway
+            merged.clear();
+            for (int64_t i = 0; i < filled; ++i) merged.emplace_back(cand_scores[i], cand_labels[i]);
+            std::stable_sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+            for (int64_t i = 0; i < filled; ++i) {
+                cand_scores[i] = merged[i].first;
+                cand_labels[i] = merged[i].second;
+            }
+        }
+        if (do_rerank) rerank(*snap, query, filled, cand_labels.data(), cand_scores.data());
+
+        int64_t keep = std::min<int64_t>(filled, k);
+        std::copy_n(cand_labels.begin(), keep, out.labels.begin() + q * k);
+        std::copy_n(cand_scores.begin(), keep, out.scores.begin() + q * k);
+    }
+}
+
+void FaissVectorStore::rerank(const Snapshot& snap, const float* query, int64_t label_count, int64_t* labels, float* scores) const {
+    thread_local std::vector<std::pair<float, int64_t>> scored;
+    thread_local std::vector<float> decoded;
+    scored.clear();
+    decoded.resize(dimension_);
+    for (int64_t i = 0; i < label_count; ++i) {
+        float score = scores[i]; // Keep the approximate score if no exact vector is stored
+        if (const float* exact = snap.exact_vector(labels[i], decoded.data())) {
+            float norm_sq = faiss::fvec_norm_L2sqr(exact, dimension_);
+            if (norm_sq > 0.0f) score = faiss::fvec_inner_product(query, exact, dimension_) / std::sqrt(norm_sq);
+        }
+        scored.emplace_back(score, labels[i]);
+    }
+    std::sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (int64_t i = 0; i < label_count; ++i) {
+        scores[i] = scored[i].first;
+        labels[i] = scored[i].second;
+    }
+}
+
+// --- PERSISTENCE ---
+
+namespace {
+
+std::string segment_file(uint64_t id) { return "seg-" + std::to_string(id) + ".index"; }
+
+} // namespace
+
+bool FaissVectorStore::exists(const std::string& path) {
+    return fs::exists(fs::path(path) / "segments.json") || fs::exists(fs::path(path) / "faiss.index");
+}
+
+// Works from one snapshot, so writers are never blocked by a save. Sealed segments are
+// immutable: each is written once, so a save costs the memtable plus whatever the
+// merger produced since the last one.
 void FaissVectorStore::save(const std::string& path) const {
     fs::path dir(path);
     fs::create_directories(dir);
 
-    // Use .get() to pass raw pointer to FAISS function
-    faiss::write_index(index_.get(), (dir / "faiss.index").string().c_str());
+    std::lock_guard<std::mutex> save_lock(save_mutex_);
+    auto snap = current();
+    if (saved_path_ != path) {
+        saved_segments_.clear();
+        saved_path_ = path;
+    }
+
+    size_t written = 0;
+    json manifest;
+    manifest["next_segment_id"] = next_segment_id_.load(std::memory_order_relaxed);
+    manifest["segments"] = json::array();
+    std::unordered_set<uint64_t> listed;
+    for (const auto& seg : snap->sealed) {
+        if (!saved_segments_.count(seg.id)) {
+            faiss::write_index(seg.index.get(), (dir / segment_file(seg.id)).string().c_str());
+            saved_segments_.insert(seg.id);
+            written++;
+        }
+        manifest["segments"].push_back({{"id", seg.id}, {"vectors", seg.index->ntotal}});
+        listed.insert(seg.id);
+    }
+    // Everything rewritten in place goes through a temp file, so a crash mid-save leaves
+    // the previous version whole: load() throws on a torn file and the project is stuck
+    // until a re-sync
+    if (snap->deltas.empty()) {
+        fs::remove(dir / "delta.index");
+    } else {
+        auto merged = merge_deltas(*snap, snap->deltas);
+        fs::path tmp = dir / "delta.index.tmp";
+        faiss::write_index(merged.get(), tmp.string().c_str());
+        fs::rename(tmp, dir / "delta.index");
+    }
+
+    // 💾 Binary segment of live nodes: untouched mmap rows are copied across without materializing
+    NodeStoreWriter writer(dimension_, true, config_.embedding_precision);
+    std::vector<float> decoded(dimension_);
+    const NodeStore* store = snap->rows ? snap->rows->store.get() : nullptr;
+    for (size_t row = 0; store && row < store->size(); ++row) {
+        int64_t label = static_cast<int64_t>(store->id_hash(row) & LABEL_MASK);
+        if (snap->tombstones->count(label) || snap->overlay->count(label)) continue;
 
-    json metadata = json::array();
-    for(const auto& node : nodes_list_){
-        metadata.push_back(node->to_json());
+        std::shared_ptr<CodeNode> cached;
+        {
+            std::lock_guard<std::mutex> m(snap->rows->mutex);
+            cached = snap->rows->cache[row];
+        }
+        float centrality = snap->centrality_of(label, static_cast<long>(row));
+        if (cached) writer.add(*cached, store->embedding(row, decoded.data()), centrality);
+        else writer.add_row(*store, row, centrality);
+    }
+    for (const auto& [label, ref] : *snap->overlay) {
+        writer.add(*ref.arena->materialize(ref.idx), ref.arena->embedding(ref.idx),
+                   snap->centrality_of(label, snap->segment_row(label)));
     }
 
-    std::ofstream meta_file(dir / "metadata.json");
-    meta_file << metadata.dump(2);
+    if (!writer.write((dir / "nodes.bin").string())) {
+        throw std::runtime_error("Could not write node segment at " + (dir / "nodes.bin").string());
+    }
+    fs::remove(dir / "metadata.json"); // Retire the legacy format once the segment is durable
+
+    // The manifest switches the directory over; only then may merged-away segments go
+    fs::path tmp = dir / "segments.json.tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        f << manifest.dump(2);
+        f.flush();
+        if (!f.good()) {
+            f.close();
+            fs::remove(tmp);
+            throw std::runtime_error("Could not write segment manifest at " + tmp.string());
+        }
+    }
+    fs::rename(tmp, dir / "segments.json");
+    fs::remove(dir / "faiss.index"); // Single-graph layout
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("seg-", 0) != 0 || entry.path().extension() != ".index") continue;
+        uint64_t id = std::strtoull(name.c_str() + 4, nullptr, 10);
+        if (!listed.count(id)) {
+            fs::remove(entry.path());
+            saved_segments_.erase(id);
+        }
+    }
+    spdlog::info("💾 Saved vector store: {} of {} segments written, memtable {} vectors", written, snap->sealed.size(),
+                 snap->delta_vectors());
 }
 
 void FaissVectorStore::load(const std::string& path) {
+    load_segments(path);
+    maybe_schedule_compaction(); // Migrates to the configured backend if the saved one differs
+}
+
+void FaissVectorStore::load_segments(const std::string& path) {
     fs::path dir(path);
-    
-    // reset() deletes the old index and takes ownership of the new one
-    faiss::Index* raw_index = faiss::read_index((dir / "faiss.index").string().c_str());
-    index_.reset(raw_index);
-    
-    std::ifstream meta_file(dir / "metadata.json");
-    json metadata = json::parse(meta_file);
-    
-    nodes_list_.clear();
-    id_to_node_map_.clear();
-    name_to_id_map_.clear();
-    
-    for (const auto& j_node : metadata) {
-        nodes_list_.push_back(std::make_shared<CodeNode>(CodeNode::from_json(j_node)));
+    auto snap = std::make_shared<Snapshot>();
+    std::unordered_set<uint64_t> on_disk;
+    uint64_t next_id = next_segment_id_.load(std::memory_order_relaxed);
+
+    auto add_segment = [&](uint64_t id, faiss::Index* raw, const std::string& file) {
+        std::shared_ptr<faiss::Index> index(raw);
+        if (!dynamic_cast<faiss::IndexIDMap2*>(index.get())) {
+            throw std::runtime_error(file + " at " + path + " is not label-mapped; re-sync required");
+        }
+        if (index->d != dimension_) { // Written by another embedding model
+            throw std::runtime_error(file + " at " + path + " holds " + std::to_string(index->d) + "-dim vectors, not " +
+                                     std::to_string(dimension_) + "; re-sync required");
+        }
+        Segment seg;
+        seg.id = id;
+        seg.kind = detect_kind(index.get());
+        apply_search_params(index.get()); // Config may have changed since the index was written
+        seg.index = std::move(index);
+        snap->sealed.push_back(std::move(seg));
+        next_id = std::max(next_id, id + 1);
+    };
+
+    if (fs::exists(dir / "segments.json")) {
+        std::ifstream f(dir / "segments.json");
+        json manifest = json::parse(f);
+        next_id = std::max(next_id, manifest.value("next_segment_id", next_id));
+        for (const auto& entry : manifest.at("segments")) {
+            uint64_t id = entry.at("id").get<uint64_t>();
+            std::string file = segment_file(id);
+            add_segment(id, faiss::read_index((dir / file).string().c_str()), file);
+            on_disk.insert(id);
+        }
+    } else {
+        std::unique_ptr<faiss::Index> graph(faiss::read_index((dir / "faiss.index").string().c_str()));
+        if (!fs::exists(dir / "nodes.bin")) {
+            load_legacy_json(path, std::move(graph));
+            return;
+        }
+        add_segment(next_id, graph.release(), "faiss.index"); // Rewritten as a segment on the next save
+    }
+    if (fs::exists(dir / "delta.index")) {
+        snap->deltas.emplace_back(faiss::read_index((dir / "delta.index").string().c_str()));
     }
 
-    for (long i = 0; i < nodes_list_.size(); ++i) {
-        id_to_node_map_[i] = nodes_list_[i];
-        name_to_id_map_[nodes_list_[i]->id] = i;
+    auto rows = std::make_shared<Rows>();
+    rows->store = std::make_shared<NodeStore>();
+    if (!rows->store->open((dir / "nodes.bin").string())) {
+        throw std::runtime_error("Corrupt node segment at " + (dir / "nodes.bin").string());
     }
-    spdlog::info("✅ Loaded FAISS index with {} nodes from {}", index_->ntotal, path);
-}
 
-const std::vector<std::shared_ptr<CodeNode>>& FaissVectorStore::get_all_nodes() const {
-    return nodes_list_;
+    // O(1): rows stay in the mapping until someone asks for them
+    rows->cache.resize(rows->store->size());
+    snap->live_count = rows->store->size();
+    snap->rows = std::move(rows);
+    snap->overlay = std::make_shared<const OverlayMap>();
+    snap->tombstones = std::make_shared<const LabelSet>();
+    for (size_t row = 0; row < snap->live_count; ++row) {
+        if (snap->indexed(static_cast<int64_t>(snap->rows->store->id_hash(row) & LABEL_MASK))) snap->live_vectors++;
+    }
+    auto lex = build_lexical(*snap); // Off the writer lock: nobody else sees snap yet
+
+    {
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        file_index_.clear();
+        file_index_ready_ = false;
+        lexical_.store(std::move(lex), std::memory_order_release);
+        next_segment_id_.store(next_id, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> save_lock(save_mutex_);
+            saved_segments_ = std::move(on_disk);
+            saved_path_ = path;
+        }
+        // Entries of nodes tombstoned or replaced before the last save still count as stale
+        publish(snap);
+        spdlog::info("✅ Mapped FAISS index ({} segments, {} memtable vectors) with {} nodes from {}",
+                     snap->sealed.size(), snap->delta_vectors(), snap->live_count, path);
+    }
 }
 
-std::shared_ptr<CodeNode> FaissVectorStore::get_node_by_name(const std::string& name) const {
-    auto it = name_to_id_map_.find(name);
-    if (it != name_to_id_map_.end()) {
-        auto node_it = id_to_node_map_.find(it->second);
-        if (node_it != id_to_node_map_.end()) {
-            return node_it->second;
+void FaissVectorStore::load_legacy_json(const std::string& path, std::unique_ptr<faiss::Index> positional) {
+    std::ifstream meta_file(fs::path(path) / "metadata.json");
+    json metadata = json::parse(meta_file);
+
+    // Legacy indexes are positional (row i == label i); migrate to stable labels.
+    auto arena = std::make_shared<NodeArena>(dimension_);
+    auto overlay = std::make_shared<OverlayMap>();
+    std::vector<float> buf(dimension_);
+    long row = 0;
+    for (const auto& j_node : metadata) {
+        auto node = std::make_shared<CodeNode>(CodeNode::from_json(j_node));
+        if (node->embedding.size() != static_cast<size_t>(dimension_) && row < positional->ntotal) {
+            try {
+                positional->reconstruct(row, buf.data());
+                node->embedding = buf;
+            } catch (...) {}
+        }
+        (*overlay)[stable_id(node->id)] = OverlayRef{arena, arena->add(*node)};
+        row++;
+    }
+
+    // Nothing is indexed yet, so the nodes' own embeddings are all there is
+    std::vector<int64_t> labels;
+    std::vector<float> vectors;
+    for (const auto& [label, ref] : *overlay) {
+        if (const float* v = ref.arena->embedding(ref.idx)) {
+            labels.push_back(label);
+            vectors.insert(vectors.end(), v, v + dimension_);
         }
     }
-    return nullptr;
+    if (!labels.empty()) faiss::fvec_renorm_L2(dimension_, labels.size(), vectors.data());
+
+    // Published without vectors; the synchronous rebuild below indexes them
+    auto snap = std::make_shared<Snapshot>();
+    snap->live_count = overlay->size();
+    snap->live_vectors = labels.size();
+    snap->overlay = std::move(overlay);
+    snap->tombstones = std::make_shared<const LabelSet>();
+    size_t live = snap->live_count;
+    auto lex = build_lexical(*snap);
+    {
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        file_index_.clear();
+        file_index_ready_ = false;
+        lexical_.store(std::move(lex), std::memory_order_release);
+        publish(std::move(snap));
+    }
+
+    std::lock_guard<std::mutex> fold_lock(fold_mutex_);
+    replace_segments({}, {}, build_segment(labels, vectors));
+    spdlog::info("✅ Migrated legacy metadata.json with {} nodes from {}", live, path);
 }
 
-} // namespace code_assistance
\ No newline at end of file
+} // namespace code_assistance
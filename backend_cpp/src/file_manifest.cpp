@@ -0,0 +1,160 @@
+#include "file_manifest.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+namespace code_assistance {
+
+using namespace manifest_format;
+
+namespace {
+
+uint64_t next_pow2(uint64_t v) {
+    uint64_t p = 16;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+bool in_bounds(uint64_t offset, uint64_t bytes, size_t file_size) {
+    return offset <= file_size && bytes <= file_size - offset;
+}
+
+} // namespace
+
+// --- READER ---
+
+bool FileManifest::open(const std::string& path) {
+    header_ = nullptr;
+    if (!file_.open(path)) return false;
+
+    const size_t sz = file_.size();
+    if (sz < sizeof(Header)) {
+        spdlog::error("❌ Manifest: {} is truncated", path);
+        return false;
+    }
+
+    auto* h = reinterpret_cast<const Header*>(file_.data());
+    if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION) {
+        spdlog::error("❌ Manifest: {} has unknown format (version {})", path, h->version);
+        return false;
+    }
+
+    bool ok = in_bounds(h->entries_offset, h->entry_count * sizeof(FileEntry), sz) &&
+              in_bounds(h->ids_offset, h->id_count * sizeof(StrRef), sz) &&
+              in_bounds(h->hash_offset, h->hash_capacity * sizeof(uint32_t), sz) &&
+              in_bounds(h->heap_offset, h->heap_size, sz);
+    if (!ok) {
+        spdlog::error("❌ Manifest: {} has out-of-range sections", path);
+        return false;
+    }
+
+    const char* base = file_.data();
+    entries_ = reinterpret_cast<const FileEntry*>(base + h->entries_offset);
+    ids_ = reinterpret_cast<const StrRef*>(base + h->ids_offset);
+    slots_ = reinterpret_cast<const uint32_t*>(base + h->hash_offset);
+    heap_ = base + h->heap_offset;
+    header_ = h;
+    return true;
+}
+
+std::string_view FileManifest::str(const StrRef& ref) const {
+    if (ref.offset > header_->heap_size || ref.length > header_->heap_size - ref.offset) return {};
+    return {heap_ + ref.offset, ref.length};
+}
+
+std::string_view FileManifest::node_id(size_t i, uint32_t j) const {
+    const FileEntry& e = entries_[i];
+    if (j >= e.id_count || e.id_begin + j >= header_->id_count) return {};
+    return str(ids_[e.id_begin + j]);
+}
+
+long FileManifest::find(std::string_view rel_path) const {
+    if (!header_ || header_->hash_capacity == 0) return -1;
+    const uint64_t mask = header_->hash_capacity - 1;
+    for (uint64_t slot = NodeStore::hash_id(rel_path) & mask;; slot = (slot + 1) & mask) {
+        uint32_t v = slots_[slot];
+        if (v == 0) return -1;
+        if (path(v - 1) == rel_path) return static_cast<long>(v - 1);
+    }
+}
+
+// --- WRITER ---
+
+StrRef FileManifestWriter::intern(std::string_view s) {
+    StrRef ref{heap_.size(), static_cast<uint32_t>(s.size()), 0};
+    heap_.append(s.data(), s.size());
+    return ref;
+}
+
+void FileManifestWriter::add(std::string_view rel_path, uint64_t size, int64_t mtime, uint64_t content_hash,
+                             const std::vector<std::string_view>& node_ids) {
+    FileEntry e{};
+    e.path = intern(rel_path);
+    e.size = size;
+    e.mtime = mtime;
+    e.content_hash = content_hash;
+    e.id_begin = static_cast<uint32_t>(ids_.size());
+    e.id_count = static_cast<uint32_t>(node_ids.size());
+    for (auto id : node_ids) ids_.push_back(intern(id));
+    entries_.push_back(e);
+}
+
+bool FileManifestWriter::write(const std::string& path) const {
+    // 1. Path hash table (linear probing, load factor <= 0.5)
+    const uint64_t capacity = next_pow2(entries_.size() * 2);
+    std::vector<uint32_t> slots(capacity, 0);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        std::string_view p(heap_.data() + entries_[i].path.offset, entries_[i].path.length);
+        uint64_t slot = NodeStore::hash_id(p) & (capacity - 1);
+        while (slots[slot] != 0) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = static_cast<uint32_t>(i + 1);
+    }
+
+    // 2. Lay out sections
+    Header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.entry_count = entries_.size();
+    h.entries_offset = sizeof(Header);
+    h.id_count = ids_.size();
+    h.ids_offset = h.entries_offset + entries_.size() * sizeof(FileEntry);
+    h.hash_capacity = capacity;
+    h.hash_offset = h.ids_offset + ids_.size() * sizeof(StrRef);
+    h.heap_offset = h.hash_offset + capacity * sizeof(uint32_t);
+    h.heap_size = heap_.size();
+
+    // 3. Stream out
+    fs::create_directories(fs::path(path).parent_path());
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            spdlog::error("❌ Manifest: cannot write {}", tmp);
+            return false;
+        }
+        auto put = [&](const void* p, size_t n) { out.write(static_cast<const char*>(p), static_cast<std::streamsize>(n)); };
+
+        put(&h, sizeof(h));
+        put(entries_.data(), entries_.size() * sizeof(FileEntry));
+        put(ids_.data(), ids_.size() * sizeof(StrRef));
+        put(slots.data(), slots.size() * sizeof(uint32_t));
+        put(heap_.data(), heap_.size());
+        if (!out.good()) {
+            spdlog::error("❌ Manifest: short write on {}", tmp);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        spdlog::error("❌ Manifest: rename {} -> {} failed: {}", tmp, path, ec.message());
+        return false;
+    }
+    return true;
+}
+
+} // namespace code_assistance
@@ -0,0 +1,425 @@
+#include "fs_watcher.hpp"
+#include "dir_walker.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+#endif
+
+namespace code_assistance {
+
+struct FileWatcher::Watch {
+    FileWatcher* owner = nullptr;
+    std::string project_id;
+    fs::path root;
+    FilterConfig filter;
+    fs::path skip_dir;
+    std::string skip_rel; // skip_dir relative to root, "" if outside it
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+    Watch(FileWatcher* o, std::string id, fs::path r, FilterConfig f, fs::path skip)
+        : owner(o), project_id(std::move(id)), root(std::move(r)), filter(std::move(f)), skip_dir(std::move(skip)) {
+        std::error_code ec;
+        fs::path rel = skip_dir.empty() ? fs::path() : fs::relative(skip_dir, root, ec);
+        if (!ec && !rel.empty() && *rel.begin() != "..") skip_rel = rel.generic_string();
+    }
+
+    bool in_skip(const std::string& rel) const {
+        return !skip_rel.empty() && rel.compare(0, skip_rel.size(), skip_rel) == 0 &&
+               (rel.size() == skip_rel.size() || rel[skip_rel.size()] == '/');
+    }
+
+    bool accepts_dir(const std::string& rel) const {
+        return !in_skip(rel) && (!filter.matcher || filter.matcher->should_enter(rel));
+    }
+
+    void report(const std::string& rel) {
+        if (in_skip(rel) || !filter.allows_extension(rel)) return;
+        if (filter.matcher && !filter.matcher->should_collect(rel)) return;
+        owner->changes_.fetch_add(1, std::memory_order_relaxed);
+        owner->on_change_(project_id, rel);
+    }
+
+    void overflow() {
+        owner->overflows_.fetch_add(1, std::memory_order_relaxed);
+        spdlog::warn("👁️ [{}] Change notifications overflowed; requesting rescan", project_id);
+        owner->on_overflow_(project_id);
+    }
+
+    // Walks a directory that just appeared: its files were created before anyone watched.
+    // `on_dir` sees every subdirectory that will be entered.
+    template<typename OnDir>
+    void walk_tree(const std::string& rel, bool report_files, OnDir&& on_dir) {
+        DirWalkOptions walk;
+        walk.matcher = filter.matcher;
+        walk.start = rel;
+        walk.skip_dir = skip_dir;
+        walk.report_dirs = true;
+        walk.threads = 2;
+        std::mutex mutex;
+        DirWalker::walk(root, walk, [&](WalkEntry&& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (e.is_dir) on_dir(e.rel_path);
+            else if (report_files) report(e.rel_path);
+            return !stopping.load();
+        });
+    }
+
+#if defined(__linux__)
+    static constexpr uint32_t MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE |
+                                     IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+    int fd = -1;
+    int wake = -1;
+    std::unordered_map<int, std::string> dirs; // Watch thread only
+
+    bool start() {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0 || wake < 0) {
+            spdlog::error("❌ [{}] inotify unavailable: {}", project_id, std::strerror(errno));
+            return false;
+        }
+        thread = std::thread([this] {
+            add_tree("", false);
+            spdlog::info("👁️ [{}] Watching {} directories under {}", project_id, dirs.size(), root.string());
+            loop();
+        });
+        return true;
+    }
+
+    void stop() {
+        stopping = true;
+        if (wake >= 0) {
+            uint64_t one = 1;
+            (void)!::write(wake, &one, sizeof(one));
+        }
+        if (thread.joinable()) thread.join();
+        if (fd >= 0) ::close(fd);
+        if (wake >= 0) ::close(wake);
+    }
+
+    void add_dir(const std::string& rel) {
+        std::string full = rel.empty() ? root.string() : (root / rel).string();
+        int wd = inotify_add_watch(fd, full.c_str(), MASK);
+        if (wd < 0) {
+            static std::atomic<bool> warned{false};
+            if (errno == ENOSPC && !warned.exchange(true)) {
+                spdlog::warn("⚠️ inotify watch limit reached; raise fs.inotify.max_user_watches");
+            }
+            return;
+        }
+        dirs[wd] = rel;
+    }
+
+    void add_tree(const std::string& rel, bool report_files) {
+        add_dir(rel);
+        walk_tree(rel, report_files, [this](const std::string& d) { add_dir(d); });
+    }
+
+    void forget_tree(const std::string& rel) {
+        for (auto it = dirs.begin(); it != dirs.end();) {
+            const std::string& d = it->second;
+            bool inside = d.compare(0, rel.size(), rel) == 0 && (d.size() == rel.size() || d[rel.size()] == '/');
+            if (inside) {
+                inotify_rm_watch(fd, it->first);
+                it = dirs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void handle(const inotify_event& ev) {
+        owner->events_.fetch_add(1, std::memory_order_relaxed);
+        if (ev.mask & IN_Q_OVERFLOW) { overflow(); return; }
+
+        auto it = dirs.find(ev.wd);
+        if (it == dirs.end()) return;
+        if (ev.mask & IN_IGNORED) { dirs.erase(it); return; }
+        if (ev.len == 0) return; // Event on the watched directory itself
+
+        std::string rel = it->second.empty() ? std::string(ev.name) : it->second + "/" + ev.name;
+        if (ev.mask & IN_ISDIR) {
+            if (ev.mask & (IN_CREATE | IN_MOVED_TO)) {
+                if (accepts_dir(rel)) add_tree(rel, true);
+            } else if (ev.mask & IN_MOVED_FROM) {
+                // Its files left without per-file events, and its watches name the old path
+                forget_tree(rel);
+                overflow();
+            }
+            return;
+        }
+        if (ev.mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)) report(rel);
+    }
+
+    void loop() {
+        alignas(inotify_event) char buffer[64 * 1024];
+        pollfd fds[2] = {{fd, POLLIN, 0}, {wake, POLLIN, 0}};
+        while (!stopping) {
+            int r = ::poll(fds, 2, -1);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (fds[1].revents) break;
+            ssize_t n = ::read(fd, buffer, sizeof(buffer));
+            if (n <= 0) continue;
+            for (char* p = buffer; p < buffer + n;) {
+                auto* ev = reinterpret_cast<inotify_event*>(p);
+                handle(*ev);
+                p += sizeof(inotify_event) + ev->len;
+            }
+        }
+    }
+
+#elif defined(_WIN32)
+    HANDLE dir = INVALID_HANDLE_VALUE;
+    HANDLE stop_event = nullptr;
+
+    static std::string narrow(const wchar_t* w, int len) {
+        int n = WideCharToMultiByte(CP_UTF8, 0, w, len, nullptr, 0, nullptr, nullptr);
+        std::string s(n, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, w, len, s.data(), n, nullptr, nullptr);
+        std::replace(s.begin(), s.end(), '\\', '/');
+        return s;
+    }
+
+    bool start() {
+        dir = CreateFileW(root.wstring().c_str(), FILE_LIST_DIRECTORY,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                          FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (dir == INVALID_HANDLE_VALUE || !stop_event) {
+            spdlog::error("❌ [{}] Cannot watch {} (error {})", project_id, root.string(), GetLastError());
+            return false;
+        }
+        thread = std::thread([this] {
+            spdlog::info("👁️ [{}] Watching {}", project_id, root.string());
+            loop();
+        });
+        return true;
+    }
+
+    void stop() {
+        stopping = true;
+        if (stop_event) SetEvent(stop_event);
+        if (thread.joinable()) thread.join();
+        if (dir != INVALID_HANDLE_VALUE) CloseHandle(dir);
+        if (stop_event) CloseHandle(stop_event);
+    }
+
+    void handle(const FILE_NOTIFY_INFORMATION& info) {
+        owner->events_.fetch_add(1, std::memory_order_relaxed);
+        std::string rel = narrow(info.FileName, static_cast<int>(info.FileNameLength / sizeof(WCHAR)));
+        std::error_code ec;
+        switch (info.Action) {
+            case FILE_ACTION_ADDED:
+            case FILE_ACTION_RENAMED_NEW_NAME:
+                if (fs::is_directory(root / fs::u8path(rel), ec)) {
+                    if (accepts_dir(rel)) walk_tree(rel, true, [](const std::string&) {});
+                } else {
+                    report(rel);
+                }
+                break;
+            case FILE_ACTION_MODIFIED:
+                if (!fs::is_directory(root / fs::u8path(rel), ec)) report(rel);
+                break;
+            case FILE_ACTION_REMOVED:
+            case FILE_ACTION_RENAMED_OLD_NAME:
+                report(rel);
+                break;
+        }
+    }
+
+    void loop() {
+        // 64 KiB: the most ReadDirectoryChangesW accepts over SMB
+        std::vector<DWORD> buffer(16 * 1024);
+        OVERLAPPED ov{};
+        ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        const DWORD filter_flags = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                   FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+
+        while (!stopping) {
+            ResetEvent(ov.hEvent);
+            if (!ReadDirectoryChangesW(dir, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(DWORD)),
+                                       TRUE, filter_flags, nullptr, &ov, nullptr)) {
+                spdlog::error("❌ [{}] ReadDirectoryChangesW failed (error {})", project_id, GetLastError());
+                break;
+            }
+            HANDLE handles[2] = {ov.hEvent, stop_event};
+            DWORD which = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+            DWORD bytes = 0;
+            if (which != WAIT_OBJECT_0) {
+                CancelIoEx(dir, &ov);
+                GetOverlappedResult(dir, &ov, &bytes, TRUE);
+                break;
+            }
+            if (!GetOverlappedResult(dir, &ov, &bytes, FALSE)) {
+                if (GetLastError() == ERROR_NOTIFY_ENUM_DIR) overflow();
+                continue;
+            }
+            if (bytes == 0) { overflow(); continue; } // Buffer overflowed: the batch was dropped
+
+            auto* p = reinterpret_cast<const char*>(buffer.data());
+            for (;;) {
+                const auto& info = *reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+                handle(info);
+                if (!info.NextEntryOffset) break;
+                p += info.NextEntryOffset;
+            }
+        }
+        CloseHandle(ov.hEvent);
+    }
+
+#elif defined(__APPLE__)
+    FSEventStreamRef stream = nullptr;
+    dispatch_queue_t queue = nullptr;
+    std::string canonical_root;
+
+    static void on_events(ConstFSEventStreamRef, void* info, size_t count, void* paths,
+                          const FSEventStreamEventFlags flags[], const FSEventStreamEventId[]) {
+        auto* self = static_cast<Watch*>(info);
+        auto** list = static_cast<char**>(paths);
+        const FSEventStreamEventFlags dropped = kFSEventStreamEventFlagMustScanSubDirs |
+                                                kFSEventStreamEventFlagUserDropped |
+                                                kFSEventStreamEventFlagKernelDropped;
+        for (size_t i = 0; i < count && !self->stopping; ++i) {
+            self->owner->events_.fetch_add(1, std::memory_order_relaxed);
+            if (flags[i] & dropped) { self->overflow(); continue; }
+
+            std::string abs = list[i];
+            const std::string& base = self->canonical_root;
+            if (abs.size() <= base.size() + 1 || abs.compare(0, base.size(), base) != 0 || abs[base.size()] != '/') continue;
+            std::string rel = abs.substr(base.size() + 1);
+
+            std::error_code ec;
+            bool exists = fs::exists(abs, ec);
+            if (flags[i] & kFSEventStreamEventFlagItemIsDir) {
+                if (!exists && (flags[i] & kFSEventStreamEventFlagItemRenamed)) self->overflow();
+                else if (exists && (flags[i] & (kFSEventStreamEventFlagItemCreated | kFSEventStreamEventFlagItemRenamed)) &&
+                         self->accepts_dir(rel)) {
+                    self->walk_tree(rel, true, [](const std::string&) {});
+                }
+                continue;
+            }
+            if (flags[i] & kFSEventStreamEventFlagItemIsFile) self->report(rel);
+        }
+    }
+
+    bool start() {
+        std::error_code ec;
+        canonical_root = fs::canonical(root, ec).string(); // FSEvents reports resolved paths (/private/var/...)
+        if (ec) return false;
+
+        CFStringRef path = CFStringCreateWithCString(nullptr, canonical_root.c_str(), kCFStringEncodingUTF8);
+        CFArrayRef paths = CFArrayCreate(nullptr, reinterpret_cast<const void**>(&path), 1, &kCFTypeArrayCallBacks);
+        FSEventStreamContext context{0, this, nullptr, nullptr, nullptr};
+        stream = FSEventStreamCreate(nullptr, &Watch::on_events, &context, paths, kFSEventStreamEventIdSinceNow,
+                                     0.05, kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagNoDefer);
+        CFRelease(paths);
+        CFRelease(path);
+        if (!stream) return false;
+
+        queue = dispatch_queue_create("code_assistance.fs_watcher", DISPATCH_QUEUE_SERIAL);
+        FSEventStreamSetDispatchQueue(stream, queue);
+        if (!FSEventStreamStart(stream)) return false;
+        spdlog::info("👁️ [{}] Watching {}", project_id, canonical_root);
+        return true;
+    }
+
+    void stop() {
+        stopping = true;
+        if (stream) {
+            FSEventStreamStop(stream);
+            FSEventStreamInvalidate(stream);
+            FSEventStreamRelease(stream);
+        }
+        if (queue) {
+            dispatch_sync_f(queue, nullptr, [](void*) {}); // Drain a callback still running
+            dispatch_release(queue);
+        }
+    }
+
+#else
+    bool start() { return false; }
+    void stop() {}
+#endif
+};
+
+FileWatcher::FileWatcher(ChangeFn on_change, OverflowFn on_overflow)
+    : on_change_(std::move(on_change)), on_overflow_(std::move(on_overflow)) {}
+
+FileWatcher::~FileWatcher() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [id, w] : watches_) w->stop();
+    watches_.clear();
+}
+
+bool FileWatcher::supported() {
+#if defined(__linux__) || defined(_WIN32) || defined(__APPLE__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool FileWatcher::watch(const std::string& project_id, const fs::path& root, FilterConfig filter, const fs::path& skip_dir) {
+    auto w = std::make_unique<Watch>(this, project_id, fs::absolute(root), std::move(filter),
+                                     skip_dir.empty() ? fs::path() : fs::absolute(skip_dir));
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = watches_.find(project_id);
+    if (it != watches_.end()) {
+        it->second->stop();
+        watches_.erase(it);
+    }
+    if (!w->start()) {
+        w->stop();
+        return false;
+    }
+    watches_[project_id] = std::move(w);
+    return true;
+}
+
+void FileWatcher::unwatch(const std::string& project_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = watches_.find(project_id);
+    if (it == watches_.end()) return;
+    it->second->stop();
+    watches_.erase(it);
+}
+
+bool FileWatcher::is_watching(const std::string& project_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return watches_.count(project_id) > 0;
+}
+
+FileWatcherStats FileWatcher::stats() const {
+    FileWatcherStats s;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        s.projects = watches_.size();
+    }
+    s.events = events_.load(std::memory_order_relaxed);
+    s.changes = changes_.load(std::memory_order_relaxed);
+    s.overflows = overflows_.load(std::memory_order_relaxed);
+    return s;
+}
+
+} // namespace code_assistance
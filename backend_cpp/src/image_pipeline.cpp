@@ -0,0 +1,301 @@
+#include "image_pipeline.hpp"
+#include "ContentHash.hpp"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+#ifdef CODE_ASSIST_HAVE_STB
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_BMP
+#define STBI_ONLY_GIF
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize2.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#endif
+
+namespace code_assistance {
+
+namespace {
+
+constexpr std::string_view B64_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr size_t HEADER_BYTES = 64 * 1024; // Enough for PNG's IHDR and a JPEG's SOF behind its EXIF
+
+constexpr std::array<int8_t, 256> make_decode_table() {
+    std::array<int8_t, 256> t{};
+    for (auto& v : t) v = -1;
+    for (size_t i = 0; i < B64_ALPHABET.size(); ++i) t[static_cast<unsigned char>(B64_ALPHABET[i])] = static_cast<int8_t>(i);
+    t['-'] = 62; // URL-safe alphabet
+    t['_'] = 63;
+    return t;
+}
+constexpr auto B64_DECODE = make_decode_table();
+
+// "data:image/png;base64,AAAA" -> ("image/png", "AAAA")
+std::string_view strip_data_url(std::string_view data, std::string& mime) {
+    if (!data.starts_with("data:")) return data;
+    size_t comma = data.find(',');
+    if (comma == std::string_view::npos) return data;
+    std::string_view head = data.substr(5, comma - 5);
+    mime = std::string(head.substr(0, head.find(';')));
+    return data.substr(comma + 1);
+}
+
+std::string sniff_mime(std::string_view bytes) {
+    auto starts = [&](std::string_view magic) { return bytes.starts_with(magic); };
+    if (starts("\x89PNG")) return "image/png";
+    if (starts("\xFF\xD8\xFF")) return "image/jpeg";
+    if (starts("GIF8")) return "image/gif";
+    if (starts("BM")) return "image/bmp";
+    if (bytes.size() >= 12 && starts("RIFF") && bytes.substr(8, 4) == "WEBP") return "image/webp";
+    return {};
+}
+
+// A stated type goes into the request verbatim, so only the ones the model takes pass
+bool supported_mime(std::string_view mime) {
+    return mime == "image/png" || mime == "image/jpeg" || mime == "image/gif" || mime == "image/webp" ||
+           mime == "image/bmp";
+}
+
+} // namespace
+
+bool ImagePipeline::codecs_available() {
+#ifdef CODE_ASSIST_HAVE_STB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ImagePipeline::decode_base64(std::string_view in, std::string& out) {
+    out.clear();
+    out.reserve(in.size() / 4 * 3 + 3);
+    uint32_t acc = 0;
+    int bits = 0;
+    for (unsigned char c : in) {
+        if (c == '=') break;
+        if (c == '\n' || c == '\r' || c == ' ' || c == '\t') continue;
+        int8_t v = B64_DECODE[c];
+        if (v < 0) return false;
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((acc >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+void ImagePipeline::encode_base64(std::string_view in, std::string& out) {
+    out.clear();
+    out.resize((in.size() + 2) / 3 * 4);
+    const auto* p = reinterpret_cast<const unsigned char*>(in.data());
+    char* w = out.data();
+    size_t i = 0;
+    for (; i + 3 <= in.size(); i += 3) {
+        uint32_t v = (uint32_t(p[i]) << 16) | (uint32_t(p[i + 1]) << 8) | p[i + 2];
+        *w++ = B64_ALPHABET[v >> 18];
+        *w++ = B64_ALPHABET[(v >> 12) & 63];
+        *w++ = B64_ALPHABET[(v >> 6) & 63];
+        *w++ = B64_ALPHABET[v & 63];
+    }
+    if (size_t rest = in.size() - i) {
+        uint32_t v = uint32_t(p[i]) << 16 | (rest == 2 ? uint32_t(p[i + 1]) << 8 : 0);
+        *w++ = B64_ALPHABET[v >> 18];
+        *w++ = B64_ALPHABET[(v >> 12) & 63];
+        *w++ = rest == 2 ? B64_ALPHABET[(v >> 6) & 63] : '=';
+        *w++ = '=';
+    }
+}
+
+uint64_t ImagePipeline::content_hash(const VisionInput& input) {
+    std::string ignored;
+    uint64_t h = xxh64(input.encoded ? strip_data_url(input.data, ignored) : input.data);
+    if (input.crop) {
+        const CropRect& c = *input.crop;
+        const int32_t rect[4] = {c.x, c.y, c.width, c.height};
+        h = xxh64(std::string_view(reinterpret_cast<const char*>(rect), sizeof(rect)), h);
+    }
+    return h;
+}
+
+bool ImagePipeline::prepare(const VisionInput& input, PreparedImage& out, std::string& error) const {
+    out = PreparedImage{};
+    out.content_hash = content_hash(input);
+
+    std::string stated_mime;
+    std::string_view payload = input.encoded ? strip_data_url(input.data, stated_mime) : input.data;
+    if (payload.empty()) {
+        error = "empty image";
+        return false;
+    }
+    size_t decoded_size = input.encoded ? payload.size() / 4 * 3 : payload.size();
+    if (decoded_size > options_.max_input_bytes) {
+        error = "image too large (" + std::to_string(decoded_size >> 20) + " MB)";
+        return false;
+    }
+
+    // The header decides whether the image needs any work
+    std::string header;
+    std::string_view head_bytes = payload;
+    if (input.encoded) {
+        size_t chars = std::min(payload.size(), HEADER_BYTES / 3 * 4);
+        if (!decode_base64(payload.substr(0, chars - chars % 4), header)) {
+            error = "image_data is not valid base64";
+            return false;
+        }
+        head_bytes = header;
+    }
+    std::string mime = sniff_mime(head_bytes);
+    if (mime.empty() && !stated_mime.empty() && !supported_mime(stated_mime)) {
+        error = "unsupported image type";
+        return false;
+    }
+    if (mime.empty()) mime = stated_mime.empty() ? "image/jpeg" : stated_mime;
+
+    bool needs_work = input.crop.has_value() || decoded_size > options_.passthrough_bytes;
+#ifdef CODE_ASSIST_HAVE_STB
+    int w = 0, h = 0, comp = 0;
+    bool known = stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(head_bytes.data()),
+                                       static_cast<int>(head_bytes.size()), &w, &h, &comp) != 0;
+    if (known && std::max(w, h) > options_.max_edge) needs_work = true;
+    if (!known) needs_work = false; // WebP, or a header we cannot place: sent as is
+#else
+    const bool known = false;
+    needs_work = false;
+#endif
+    // The result is cached under the crop too: sending the whole image instead would be wrong
+    if (input.crop && !known) {
+        error = codecs_available() ? "cannot crop this image format" : "cropping needs the image codecs";
+        return false;
+    }
+
+    if (needs_work) {
+        std::string bytes;
+        std::string_view raw = payload;
+        if (input.encoded) {
+            if (!decode_base64(payload, bytes)) {
+                error = "image_data is not valid base64";
+                return false;
+            }
+            raw = bytes;
+        }
+        out.input_bytes = raw.size();
+        if (transcode(raw, input.crop, out, error)) return true;
+        if (input.crop) return false; // Same reason: no uncropped fallback
+        spdlog::warn("🖼️ Image pipeline: {}; sending the original", error);
+        error.clear();
+    }
+
+    // Passthrough: the original, encoded once at most
+    out.mime_type = std::move(mime);
+    if (input.encoded) {
+        out.input_bytes = decoded_size;
+        out.base64.reserve(payload.size());
+        for (char c : payload) { // Line-wrapped or URL-safe base64 is not accepted inline
+            if (c == '\n' || c == '\r' || c == ' ' || c == '\t') continue;
+            out.base64.push_back(c == '-' ? '+' : c == '_' ? '/' : c);
+        }
+    } else {
+        out.input_bytes = payload.size();
+        encode_base64(payload, out.base64);
+    }
+    return true;
+}
+
+bool ImagePipeline::transcode(std::string_view bytes, const std::optional<CropRect>& crop, PreparedImage& out,
+                              std::string& error) const {
+#ifdef CODE_ASSIST_HAVE_STB
+    int w = 0, h = 0, comp = 0;
+    const auto* src = reinterpret_cast<const stbi_uc*>(bytes.data());
+    if (!stbi_info_from_memory(src, static_cast<int>(bytes.size()), &w, &h, &comp)) {
+        error = std::string("cannot decode image: ") + stbi_failure_reason();
+        return false;
+    }
+    const bool alpha = comp == 2 || comp == 4;
+    std::unique_ptr<stbi_uc, void (*)(void*)> pixels(
+        stbi_load_from_memory(src, static_cast<int>(bytes.size()), &w, &h, &comp, alpha ? 4 : 3), stbi_image_free);
+    if (!pixels) {
+        error = std::string("cannot decode image: ") + stbi_failure_reason();
+        return false;
+    }
+
+    // Crop (clamped to the image), flattening alpha onto white: JPEG has none
+    int x0 = 0, y0 = 0, cw = w, ch = h;
+    if (crop) {
+        x0 = std::clamp(crop->x, 0, w - 1);
+        y0 = std::clamp(crop->y, 0, h - 1);
+        cw = std::clamp(crop->width > 0 ? crop->width : w, 1, w - x0);
+        ch = std::clamp(crop->height > 0 ? crop->height : h, 1, h - y0);
+    }
+    const int in_channels = alpha ? 4 : 3;
+    std::vector<unsigned char> rgb(static_cast<size_t>(cw) * ch * 3);
+    for (int y = 0; y < ch; ++y) {
+        const stbi_uc* row = pixels.get() + (static_cast<size_t>(y0 + y) * w + x0) * in_channels;
+        unsigned char* dst = rgb.data() + static_cast<size_t>(y) * cw * 3;
+        for (int x = 0; x < cw; ++x, row += in_channels, dst += 3) {
+            if (alpha) {
+                unsigned a = row[3];
+                for (int c = 0; c < 3; ++c) dst[c] = static_cast<unsigned char>((row[c] * a + 255 * (255 - a) + 127) / 255);
+            } else {
+                dst[0] = row[0];
+                dst[1] = row[1];
+                dst[2] = row[2];
+            }
+        }
+    }
+    pixels.reset();
+
+    // Downscale to the model's resolution; it would do the same server-side
+    int ow = cw, oh = ch;
+    if (std::max(cw, ch) > options_.max_edge) {
+        double scale = static_cast<double>(options_.max_edge) / std::max(cw, ch);
+        ow = std::max(1, static_cast<int>(cw * scale + 0.5));
+        oh = std::max(1, static_cast<int>(ch * scale + 0.5));
+        std::vector<unsigned char> scaled(static_cast<size_t>(ow) * oh * 3);
+        if (!stbir_resize_uint8_linear(rgb.data(), cw, ch, cw * 3, scaled.data(), ow, oh, ow * 3, STBIR_RGB)) {
+            error = "resize failed";
+            return false;
+        }
+        rgb = std::move(scaled);
+    }
+
+    std::string jpeg;
+    jpeg.reserve(rgb.size() / 8);
+    auto sink = [](void* context, void* data, int size) {
+        static_cast<std::string*>(context)->append(static_cast<const char*>(data), static_cast<size_t>(size));
+    };
+    if (!stbi_write_jpg_to_func(sink, &jpeg, ow, oh, 3, rgb.data(), options_.jpeg_quality)) {
+        error = "JPEG encode failed";
+        return false;
+    }
+    // Not worth it unless it shrank or had to change shape
+    if (jpeg.size() >= bytes.size() && !crop && ow == w && oh == h) {
+        error = "re-encoding would not shrink it";
+        return false;
+    }
+
+    out.mime_type = "image/jpeg";
+    encode_base64(jpeg, out.base64);
+    out.width = ow;
+    out.height = oh;
+    out.transcoded = true;
+    spdlog::info("🖼️ Image pipeline: {}x{} ({} KB) -> {}x{} JPEG ({} KB)", w, h, bytes.size() >> 10, ow, oh,
+                 jpeg.size() >> 10);
+    return true;
+#else
+    (void)bytes;
+    (void)crop;
+    (void)out;
+    error = "built without image codecs";
+    return false;
+#endif
+}
+
+} // namespace code_assistance
@@ -0,0 +1,267 @@
+#include "lexical_index.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <mutex>
+#include <unordered_set>
+
+namespace code_assistance {
+
+namespace {
+
+bool word_char(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+char lower(char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); }
+
+std::string lowered(std::string_view s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), lower);
+    return out;
+}
+
+// Last component of a qualified name: "a::b.c" -> "c"
+std::string_view leaf(std::string_view s) {
+    size_t cut = s.find_last_of(":./\\");
+    return cut == std::string_view::npos ? s : s.substr(cut + 1);
+}
+
+} // namespace
+
+// --- TOKENIZATION ---
+
+void LexicalIndex::tokenize(std::string_view text, std::vector<std::string>& out) {
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && !word_char(text[i])) ++i;
+        size_t start = i;
+        while (i < text.size() && word_char(text[i])) ++i;
+        std::string_view word = text.substr(start, i - start);
+        if (word.size() < 2 || word.size() > 64) continue;
+
+        // Parts split at '_', lower->Upper, UPPER->Upper-lower ("HTTPServer") and digit runs
+        size_t parts_before = out.size();
+        size_t p = 0;
+        for (size_t j = 1; j <= word.size(); ++j) {
+            bool cut = j == word.size() || word[j] == '_';
+            if (!cut) {
+                char a = word[j - 1], b = word[j];
+                bool a_up = std::isupper(static_cast<unsigned char>(a)), b_up = std::isupper(static_cast<unsigned char>(b));
+                bool a_dig = std::isdigit(static_cast<unsigned char>(a)), b_dig = std::isdigit(static_cast<unsigned char>(b));
+                cut = (!a_up && b_up && a != '_') || (a_dig != b_dig) ||
+                      (a_up && b_up && j + 1 < word.size() && std::islower(static_cast<unsigned char>(word[j + 1])));
+            }
+            if (!cut) continue;
+            while (p < j && word[p] == '_') ++p;
+            if (j > p + 1) out.push_back(lowered(word.substr(p, j - p)));
+            p = j;
+        }
+        std::string whole = lowered(word);
+        bool single = out.size() - parts_before == 1 && out.back() == whole;
+        if (!single) out.push_back(std::move(whole)); // Compound: the whole as well
+    }
+}
+
+bool LexicalIndex::identifier_shaped(std::string_view query) {
+    while (!query.empty() && std::isspace(static_cast<unsigned char>(query.front()))) query.remove_prefix(1);
+    while (!query.empty() && std::isspace(static_cast<unsigned char>(query.back()))) query.remove_suffix(1);
+    if (query.size() >= 2 && query.substr(query.size() - 2) == "()") query.remove_suffix(2);
+    if (query.size() < 2 || query.size() > 128) return false;
+    if (!std::isalpha(static_cast<unsigned char>(query.front())) && query.front() != '_') return false;
+    return std::all_of(query.begin(), query.end(), [](char c) { return word_char(c) || c == ':' || c == '.' || c == '~'; });
+}
+
+// --- INDEXING ---
+
+void LexicalIndex::add(int64_t label, std::string_view id, std::string_view name, std::string_view file_path,
+                       std::string_view content) {
+    thread_local std::vector<std::string> name_tokens;
+    thread_local std::vector<std::string> body_tokens;
+    name_tokens.clear();
+    body_tokens.clear();
+    tokenize(name, name_tokens);
+    tokenize(leaf(file_path), body_tokens);
+    tokenize(content, body_tokens);
+
+    // Term frequencies before taking the lock
+    std::unordered_map<std::string, float> tf;
+    for (auto& t : name_tokens) tf[std::move(t)] += NAME_WEIGHT;
+    for (auto& t : body_tokens) tf[std::move(t)] += 1.0f;
+    float length = name_tokens.size() * NAME_WEIGHT + body_tokens.size();
+    std::string name_lower = lowered(name);
+
+    std::unique_lock lock(mutex_);
+    uint32_t doc = static_cast<uint32_t>(docs_.size());
+    auto [slot, fresh] = current_.try_emplace(label, doc);
+    if (!fresh) {
+        Doc& old = docs_[slot->second];
+        total_length_ -= old.length;
+        for (Term* t : old.terms) t->live_df--;
+        old.terms = {};
+        superseded_++;
+        slot->second = doc; // The old doc's postings stay behind and fail current() until compact()
+    }
+    docs_.push_back({label, length, name_lower, {}});
+    total_length_ += length;
+
+    Doc& fresh_doc = docs_.back();
+    fresh_doc.terms.reserve(tf.size());
+    for (auto& [term, f] : tf) {
+        Term& t = postings_[term];
+        t.postings.push_back({doc, f});
+        t.live_df++;
+        fresh_doc.terms.push_back(&t);
+    }
+    for (size_t i = 0; i + 3 <= name_lower.size(); ++i) {
+        auto& list = trigrams_[trigram(name_lower.data() + i)];
+        if (list.empty() || list.back() != doc) list.push_back(doc);
+    }
+    exact_[name_lower].push_back(doc);
+    std::string id_lower = lowered(id);
+    if (id_lower != name_lower) exact_[std::move(id_lower)].push_back(doc);
+}
+
+size_t LexicalIndex::size() const {
+    std::shared_lock lock(mutex_);
+    return current_.size();
+}
+
+size_t LexicalIndex::superseded() const {
+    std::shared_lock lock(mutex_);
+    return superseded_;
+}
+
+bool LexicalIndex::needs_compaction() const {
+    std::shared_lock lock(mutex_);
+    return superseded_ > std::max(COMPACT_MIN, static_cast<size_t>(current_.size() * COMPACT_FRACTION));
+}
+
+// In place: kept documents keep their order, so every list stays ascending, and a kept
+// Term stays where it is, so the documents' pointers to it stay valid
+void LexicalIndex::compact() {
+    std::unique_lock lock(mutex_);
+    if (superseded_ == 0) return;
+
+    constexpr uint32_t DROPPED = ~0u;
+    std::vector<uint32_t> remap(docs_.size(), DROPPED);
+    std::vector<Doc> kept;
+    kept.reserve(current_.size());
+    for (uint32_t doc = 0; doc < docs_.size(); ++doc) {
+        if (!current(doc)) continue;
+        remap[doc] = static_cast<uint32_t>(kept.size());
+        kept.push_back(std::move(docs_[doc]));
+    }
+    docs_ = std::move(kept);
+    for (auto& [label, doc] : current_) doc = remap[doc];
+
+    // Renumbers every list of a map in place, erasing the lists left empty
+    auto renumber_all = [](auto& map, auto&& renumber) {
+        for (auto it = map.begin(); it != map.end();) {
+            it = renumber(it->second) ? map.erase(it) : std::next(it);
+        }
+    };
+    auto renumber = [&](std::vector<uint32_t>& list) {
+        std::erase_if(list, [&](uint32_t doc) { return remap[doc] == DROPPED; });
+        for (uint32_t& doc : list) doc = remap[doc];
+        return list.empty();
+    };
+    renumber_all(postings_, [&](Term& term) {
+        std::erase_if(term.postings, [&](const Posting& p) { return remap[p.doc] == DROPPED; });
+        for (Posting& p : term.postings) p.doc = remap[p.doc];
+        return term.postings.empty();
+    });
+    renumber_all(trigrams_, renumber);
+    renumber_all(exact_, renumber);
+    superseded_ = 0;
+}
+
+bool LexicalIndex::current(uint32_t doc) const {
+    auto it = current_.find(docs_[doc].label);
+    return it != current_.end() && it->second == doc;
+}
+
+// --- SEARCH ---
+
+std::vector<LexicalHit> LexicalIndex::search(std::string_view query, size_t k, const LiveFn& live) const {
+    std::vector<std::string> terms;
+    tokenize(query, terms);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    std::string q = lowered(query);
+    while (!q.empty() && std::isspace(static_cast<unsigned char>(q.back()))) q.pop_back();
+    if (q.size() >= 2 && q.substr(q.size() - 2) == "()") q.resize(q.size() - 2);
+    std::string q_leaf(leaf(q));
+
+    std::shared_lock lock(mutex_);
+    if (docs_.empty() || k == 0) return {};
+
+    std::unordered_map<uint32_t, float> scores;
+    std::unordered_set<uint32_t> exact;
+
+    // BM25 over the current documents: df is the term's live count, never above n_docs
+    const float n_docs = static_cast<float>(current_.size());
+    const float avg_len = current_.empty() ? 1.0f : static_cast<float>(total_length_ / current_.size());
+    for (const auto& term : terms) {
+        auto it = postings_.find(term);
+        if (it == postings_.end()) continue;
+        if (it->second.live_df == 0) continue;
+        float df = static_cast<float>(it->second.live_df);
+        float idf = std::log(1.0f + (n_docs - df + 0.5f) / (df + 0.5f));
+        for (const Posting& p : it->second.postings) {
+            if (!current(p.doc)) continue;
+            float norm = BM25_K1 * (1.0f - BM25_B + BM25_B * docs_[p.doc].length / std::max(avg_len, 1.0f));
+            scores[p.doc] += idf * (p.tf * (BM25_K1 + 1.0f)) / (p.tf + norm);
+        }
+    }
+
+    // Exact name / id, then the leaf of a qualified query ("Store::search" -> search)
+    if (identifier_shaped(q)) {
+        for (const std::string* key : {&q, &q_leaf}) {
+            auto it = exact_.find(*key);
+            if (it == exact_.end()) continue;
+            for (uint32_t doc : it->second) {
+                if (!current(doc) || !exact.insert(doc).second) continue;
+                scores[doc] += EXACT_BONUS;
+            }
+            if (!exact.empty()) break;
+        }
+
+        // Substring of a name: intersect the query's trigram postings, then verify
+        if (q_leaf.size() >= 3) {
+            std::vector<const std::vector<uint32_t>*> lists;
+            for (size_t i = 0; i + 3 <= q_leaf.size(); ++i) {
+                auto it = trigrams_.find(trigram(q_leaf.data() + i));
+                if (it == trigrams_.end()) {
+                    lists.clear();
+                    break;
+                }
+                lists.push_back(&it->second);
+            }
+            if (!lists.empty()) {
+                std::sort(lists.begin(), lists.end(), [](auto* a, auto* b) { return a->size() < b->size(); });
+                for (uint32_t doc : *lists.front()) {
+                    bool in_all = std::all_of(lists.begin() + 1, lists.end(), [doc](auto* l) { return std::binary_search(l->begin(), l->end(), doc); });
+                    if (!in_all || exact.count(doc) || !current(doc)) continue;
+                    if (docs_[doc].name.find(q_leaf) == std::string::npos) continue;
+                    scores[doc] += SUBSTRING_BONUS;
+                }
+            }
+        }
+    }
+
+    std::vector<LexicalHit> hits;
+    hits.reserve(scores.size());
+    for (const auto& [doc, score] : scores) {
+        int64_t label = docs_[doc].label;
+        if (live && !live(label)) continue;
+        hits.push_back({label, score, exact.count(doc) > 0});
+    }
+    auto better = [](const LexicalHit& a, const LexicalHit& b) { return a.score > b.score; };
+    if (hits.size() > k) {
+        std::nth_element(hits.begin(), hits.begin() + k, hits.end(), better);
+        hits.resize(k);
+    }
+    std::sort(hits.begin(), hits.end(), better);
+    return hits;
+}
+
+} // namespace code_assistance
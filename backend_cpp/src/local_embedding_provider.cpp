@@ -0,0 +1,266 @@
+#include "local_embedding_provider.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <spdlog/spdlog.h>
+
+#ifdef CODE_ASSIST_HAVE_ONNXRUNTIME
+#include <onnxruntime_cxx_api.h>
+#endif
+
+namespace code_assistance {
+
+namespace fs = std::filesystem;
+
+#ifdef CODE_ASSIST_HAVE_ONNXRUNTIME
+
+namespace {
+
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+// BERT WordPiece: split on whitespace and ASCII punctuation, then greedy longest-match
+// against the vocabulary with "##" continuations. Non-ASCII bytes stay inside words.
+class WordPiece {
+public:
+    WordPiece(const fs::path& vocab_path, bool lowercase) : lowercase_(lowercase) {
+        std::ifstream in(vocab_path);
+        if (!in) throw std::runtime_error("Cannot open vocabulary " + vocab_path.string());
+        std::string line;
+        for (int64_t id = 0; std::getline(in, line); ++id) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            vocab_.emplace(line, id);
+        }
+        cls_ = special("[CLS]");
+        sep_ = special("[SEP]");
+        unk_ = special("[UNK]");
+        pad_ = special("[PAD]");
+    }
+
+    int64_t pad() const { return pad_; }
+
+    // [CLS] pieces... [SEP], at most max_tokens ids
+    void encode(std::string_view text, size_t max_tokens, std::vector<int64_t>& out) const {
+        out.clear();
+        out.push_back(cls_);
+        const size_t limit = std::max<size_t>(max_tokens, 2) - 1; // Room for [SEP]
+        std::string word;
+        auto flush = [&] {
+            if (!word.empty() && out.size() < limit) pieces(word, limit, out);
+            word.clear();
+        };
+        for (char c : text) {
+            if (out.size() >= limit) break;
+            unsigned char u = static_cast<unsigned char>(c);
+            if (std::isspace(u)) {
+                flush();
+            } else if (u < 0x80 && std::ispunct(u)) {
+                flush();
+                word.push_back(c);
+                flush();
+            } else {
+                word.push_back(lowercase_ && u < 0x80 ? static_cast<char>(std::tolower(u)) : c);
+            }
+        }
+        flush();
+        out.push_back(sep_);
+    }
+
+private:
+    static constexpr size_t MAX_WORD_BYTES = 100;
+
+    int64_t special(std::string_view token) const {
+        auto it = vocab_.find(token);
+        if (it == vocab_.end()) throw std::runtime_error("Vocabulary has no " + std::string(token));
+        return it->second;
+    }
+
+    void pieces(const std::string& word, size_t limit, std::vector<int64_t>& out) const {
+        if (word.size() > MAX_WORD_BYTES) {
+            out.push_back(unk_);
+            return;
+        }
+        size_t mark = out.size();
+        std::string piece;
+        for (size_t start = 0; start < word.size();) {
+            int64_t id = -1;
+            size_t end = word.size();
+            for (; end > start; --end) {
+                piece.assign(start > 0 ? "##" : "");
+                piece.append(word, start, end - start);
+                if (auto it = vocab_.find(piece); it != vocab_.end()) {
+                    id = it->second;
+                    break;
+                }
+            }
+            if (id < 0) { // Not spellable from the vocabulary: the whole word is unknown
+                out.resize(mark);
+                out.push_back(unk_);
+                return;
+            }
+            if (out.size() < limit) out.push_back(id);
+            start = end;
+        }
+    }
+
+    std::unordered_map<std::string, int64_t, StringHash, std::equal_to<>> vocab_;
+    int64_t cls_ = 0, sep_ = 0, unk_ = 0, pad_ = 0;
+    bool lowercase_;
+};
+
+enum class InputRole { Ids, Mask, Types };
+
+} // namespace
+
+struct LocalEmbeddingProvider::Runtime {
+    WordPiece tokenizer;
+    Ort::Env env{ORT_LOGGING_LEVEL_WARNING, "local-embeddings"};
+    Ort::Session session{nullptr};
+    Ort::MemoryInfo memory = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    std::vector<std::string> input_names;
+    std::vector<InputRole> input_roles;
+    std::string output_name;
+
+    Runtime(const fs::path& dir, const LocalEmbeddingOptions& options)
+        : tokenizer(dir / "vocab.txt", options.lowercase) {
+        Ort::SessionOptions session_options;
+        if (options.threads > 0) session_options.SetIntraOpNumThreads(options.threads);
+        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        fs::path model_path = dir / "model.onnx";
+        session = Ort::Session(env, model_path.c_str(), session_options);
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        for (size_t i = 0; i < session.GetInputCount(); ++i) {
+            std::string name = session.GetInputNameAllocated(i, allocator).get();
+            if (name == "input_ids") input_roles.push_back(InputRole::Ids);
+            else if (name == "attention_mask") input_roles.push_back(InputRole::Mask);
+            else if (name == "token_type_ids") input_roles.push_back(InputRole::Types);
+            else throw std::runtime_error("Unsupported model input: " + name);
+            input_names.push_back(std::move(name));
+        }
+
+        // A pooled sentence embedding if the export has one, else the token states
+        std::vector<std::string> outputs;
+        for (size_t i = 0; i < session.GetOutputCount(); ++i) outputs.push_back(session.GetOutputNameAllocated(i, allocator).get());
+        auto named = std::find(outputs.begin(), outputs.end(), "sentence_embedding");
+        if (named == outputs.end()) named = std::find(outputs.begin(), outputs.end(), "last_hidden_state");
+        if (named == outputs.end()) named = outputs.begin();
+        if (named == outputs.end()) throw std::runtime_error("Model has no outputs");
+        output_name = *named;
+    }
+};
+
+LocalEmbeddingProvider::LocalEmbeddingProvider(LocalEmbeddingOptions options) : options_(std::move(options)) {
+    fs::path dir(options_.model_dir);
+    runtime_ = std::make_unique<Runtime>(dir, options_);
+    model_ = "local/" + dir.filename().string();
+    if (model_ == "local/") model_ += dir.parent_path().filename().string(); // Trailing separator
+
+    dimension_ = static_cast<int>(embed({"dimension probe"}).front().size());
+    if (dimension_ <= 0) throw std::runtime_error("Model produced no embedding");
+    spdlog::info("🖥️ Local embedding model {} loaded: {} dims", model_, dimension_);
+}
+
+LocalEmbeddingProvider::~LocalEmbeddingProvider() = default;
+
+// Each run already spreads over `threads` cores (all of them by default)
+size_t LocalEmbeddingProvider::concurrency() const {
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    return options_.threads > 0 ? std::max<size_t>(1, cores / options_.threads) : 2;
+}
+
+std::vector<std::vector<float>> LocalEmbeddingProvider::embed(const std::vector<std::string>& texts) {
+    Runtime& rt = *runtime_;
+    std::vector<std::vector<int64_t>> tokens(texts.size());
+    for (size_t i = 0; i < texts.size(); ++i) rt.tokenizer.encode(texts[i], options_.max_tokens, tokens[i]);
+
+    // Similar lengths share a batch, so little of it is padding
+    std::vector<size_t> order(texts.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return tokens[a].size() < tokens[b].size(); });
+
+    std::vector<const char*> input_names;
+    for (const auto& name : rt.input_names) input_names.push_back(name.c_str());
+    const char* output_name = rt.output_name.c_str();
+
+    thread_local std::vector<int64_t> ids, mask, types;
+    std::vector<std::vector<float>> result(texts.size());
+    const size_t batch = std::max<size_t>(options_.batch_size, 1);
+    for (size_t begin = 0; begin < order.size(); begin += batch) {
+        const size_t end = std::min(order.size(), begin + batch);
+        const size_t rows = end - begin;
+        const size_t seq = tokens[order[end - 1]].size(); // Longest of the batch
+        ids.assign(rows * seq, rt.tokenizer.pad());
+        mask.assign(rows * seq, 0);
+        types.assign(rows * seq, 0);
+        for (size_t r = 0; r < rows; ++r) {
+            const auto& t = tokens[order[begin + r]];
+            std::copy(t.begin(), t.end(), ids.begin() + r * seq);
+            std::fill_n(mask.begin() + r * seq, t.size(), 1);
+        }
+
+        const int64_t shape[2] = {static_cast<int64_t>(rows), static_cast<int64_t>(seq)};
+        std::vector<Ort::Value> inputs;
+        for (InputRole role : rt.input_roles) {
+            auto& data = role == InputRole::Ids ? ids : role == InputRole::Mask ? mask : types;
+            inputs.push_back(Ort::Value::CreateTensor<int64_t>(rt.memory, data.data(), data.size(), shape, 2));
+        }
+        auto outputs = rt.session.Run(Ort::RunOptions{nullptr}, input_names.data(), inputs.data(), inputs.size(),
+                                      &output_name, 1);
+
+        const float* out = outputs.front().GetTensorData<float>();
+        auto out_shape = outputs.front().GetTensorTypeAndShapeInfo().GetShape();
+        const bool pooled = out_shape.size() == 2;
+        const size_t dim = static_cast<size_t>(out_shape.back());
+        for (size_t r = 0; r < rows; ++r) {
+            std::vector<float> v(dim, 0.0f);
+            if (pooled) {
+                std::copy_n(out + r * dim, dim, v.begin());
+            } else {
+                // Mean over the real tokens; the inner loop is contiguous and vectorizes
+                const size_t len = tokens[order[begin + r]].size();
+                for (size_t t = 0; t < len; ++t) {
+                    const float* h = out + (r * seq + t) * dim;
+                    for (size_t d = 0; d < dim; ++d) v[d] += h[d];
+                }
+            }
+            float norm = 0.0f;
+            for (float x : v) norm += x * x;
+            if (norm > 0.0f) {
+                float inv = 1.0f / std::sqrt(norm);
+                for (float& x : v) x *= inv;
+            }
+            result[order[begin + r]] = std::move(v);
+        }
+    }
+    return result;
+}
+
+#else // Built without ONNX Runtime
+
+struct LocalEmbeddingProvider::Runtime {};
+
+LocalEmbeddingProvider::LocalEmbeddingProvider(LocalEmbeddingOptions options) : options_(std::move(options)) {
+    throw std::runtime_error("Local embeddings need a build with CODE_ASSIST_LOCAL_EMBEDDINGS=ON (ONNX Runtime)");
+}
+
+LocalEmbeddingProvider::~LocalEmbeddingProvider() = default;
+
+size_t LocalEmbeddingProvider::concurrency() const { return 1; }
+
+std::vector<std::vector<float>> LocalEmbeddingProvider::embed(const std::vector<std::string>&) {
+    throw std::runtime_error("Local embeddings are not available in this build");
+}
+
+#endif
+
+} // namespace code_assistance
@@ -6,18 +6,27 @@
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <optional>
+#include <fstream>
 
 #include "KeyManager.hpp"
 #include "LogManager.hpp"
 #include "ThreadPool.hpp"
+#include "TokenCounter.hpp"
+#include "CompletionCache.hpp"
 #include "embedding_service.hpp"
 #include "sync_service.hpp"
+#include "sync_queue.hpp"
+#include "fs_watcher.hpp"
 #include "SystemMonitor.hpp"
-#include "agent/AgentExecutor.hpp"
-#include "agent/SubAgent.hpp"
-#include "tools/ToolRegistry.hpp"
-#include "tools/FileSurgicalTool.hpp"
+#include "parser_elite.hpp"
+#include "service_hub.hpp"
+#include "agent/AgentService.hpp"
+#include "agent/MissionScheduler.hpp"
 #include "tools/FileSystemTools.hpp"
+#include <grpcpp/grpcpp.h>
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
@@ -29,27 +38,40 @@ namespace code_assistance {
 
 class CodeAssistanceServer {
 public:
-    CodeAssistanceServer(int port = 5002)
-        : port_(port), thread_pool_(4) 
+    // The hub's keys, caches, pool and stores are shared with an in-process agent service
+    CodeAssistanceServer(std::shared_ptr<code_assistance::ServiceHub> hub, int port = 5002, bool watch = false,
+                         code_assistance::SystemMonitorOptions monitor_options = {})
+        : port_(port), hub_(std::move(hub)), thread_pool_(hub_->thread_pool()), ai_service_(hub_->ai_service()),
+          system_monitor_(monitor_options)
     {
-        key_manager_ = std::make_shared<code_assistance::KeyManager>();
-        ai_service_ = std::make_shared<code_assistance::EmbeddingService>(key_manager_);
-        
-        // Initialize other components for full functionality
-        sub_agent_ = std::make_shared<code_assistance::SubAgent>();
-        tool_registry_ = std::make_shared<code_assistance::ToolRegistry>();
-        
-        // Register Tools (Mirroring Agent Service for consistency)
-        tool_registry_->register_tool(std::make_unique<code_assistance::ReadFileTool>());
-        tool_registry_->register_tool(std::make_unique<code_assistance::ListDirTool>());
-        
-        executor_ = std::make_shared<code_assistance::AgentExecutor>(
-            nullptr, ai_service_, sub_agent_, tool_registry_
+        system_monitor_.watch_pool(&thread_pool_);
+
+        // Saves from the IDE are debounced, coalesced and embedded off the HTTP threads
+        sync_service_ = std::make_shared<code_assistance::SyncService>(ai_service_);
+        sync_service_->set_thread_pool(&thread_pool_);
+        sync_queue_ = std::make_unique<code_assistance::SyncQueue>(
+            sync_service_, thread_pool_,
+            [this](const std::string& project_id, const code_assistance::SyncProject& project,
+                   code_assistance::FileSyncBatch& batch) { apply_file_sync(project_id, project, batch); }
         );
 
+        // ✍️ Agent edits (combined mode) are re-indexed at once, like an IDE save
+        hub_->set_file_edit_listener([this](const std::string& project_id, const std::string& rel_path) {
+            on_agent_edit(project_id, rel_path);
+        });
+
+        if (watch) start_file_watcher();
         setup_routes();
     }
 
+    ~CodeAssistanceServer() {
+        hub_->set_file_edit_listener({}); // Waits out a notification in flight
+        // Background tasks still queued on the pool now return at once; wait out the ones running
+        std::unique_lock<std::mutex> lock(background_mutex_);
+        stopping_ = true;
+        background_idle_.wait(lock, [this] { return background_in_flight_ == 0; });
+    }
+
     void run() {
         spdlog::info("🚀 REST Server (Ghost Text & Sync) listening on port {}", port_);
         server_.listen("0.0.0.0", port_);
@@ -58,20 +80,34 @@ public:
 private:
     int port_;
     httplib::Server server_;
-    ThreadPool thread_pool_;
     std::mutex store_mutex;
     
     // Core Services
-    std::shared_ptr<code_assistance::KeyManager> key_manager_;
+    std::shared_ptr<code_assistance::ServiceHub> hub_;
+    ThreadPool& thread_pool_;
     std::shared_ptr<code_assistance::EmbeddingService> ai_service_;
-    std::shared_ptr<code_assistance::SubAgent> sub_agent_;
-    std::shared_ptr<code_assistance::ToolRegistry> tool_registry_;
-    std::shared_ptr<code_assistance::AgentExecutor> executor_;
     
     // Data Stores
-    std::unordered_map<std::string, std::shared_ptr<code_assistance::FaissVectorStore>> project_stores_;
+    std::unordered_map<std::string, code_assistance::SyncProject> sync_projects_; // Guarded by store_mutex
+    code_assistance::CompletionCache completion_cache_;
     code_assistance::SystemMonitor system_monitor_;
 
+    // Background lane tasks (rescans, centrality) use the members below; the destructor waits them out
+    std::mutex background_mutex_;
+    std::condition_variable background_idle_;
+    size_t background_in_flight_ = 0; // Guarded by background_mutex_
+    bool stopping_ = false;           // Guarded by background_mutex_
+    struct CentralityRun {
+        bool running = false;
+        bool again = false; // Another batch landed while it ran
+    };
+    std::unordered_map<std::string, CentralityRun> centrality_runs_; // Guarded by background_mutex_
+
+    // Declared last: destroyed first, while the pool and stores its batches use still exist
+    std::shared_ptr<code_assistance::SyncService> sync_service_;
+    std::unique_ptr<code_assistance::SyncQueue> sync_queue_;
+    std::unique_ptr<code_assistance::FileWatcher> watcher_; // After the queue: its thread submits into it
+
     void setup_routes() {
         // CORS Headers
         server_.set_pre_routing_handler([](const httplib::Request&, httplib::Response& res) {
@@ -100,31 +136,19 @@ private:
                 
                 if (prefix.empty()) { res.status = 400; return; }
 
-                // 🚀 FIX: Explicitly use this-> to access member
-                auto vector_preview = this->ai_service_->generate_embedding(prefix.substr(0, 100));
-                std::string completion = this->ai_service_->generate_autocomplete(prefix);
+                // ⚡ Prefix reuse: the user typed along with the last suggestion
+                std::string session = body.value("session_id", req.remote_addr);
+                auto reused = this->completion_cache_.lookup(session, prefix);
+
+                std::string completion = reused ? *reused : this->ai_service_->generate_autocomplete(prefix);
+                if (!reused && !completion.empty()) this->completion_cache_.store(session, prefix, completion);
 
                 auto end = std::chrono::high_resolution_clock::now();
                 double ms = std::chrono::duration<double, std::milli>(end - start).count();
-                code_assistance::SystemMonitor::global_llm_generation_ms.store(ms);
-
-                // LOGGING
-                code_assistance::InteractionLog log;
-                log.timestamp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                log.project_id = "IDE_EXTENSION";
-                log.request_type = "GHOST";
-                log.user_query = "Cursor Context"; 
-                log.full_prompt = prefix;
-                log.ai_response = completion;
-                log.duration_ms = ms;
-                log.total_tokens = (prefix.length() + completion.length()) / 4; 
-                
-                if(vector_preview.size() > 8) {
-                    log.vector_snapshot = std::vector<float>(vector_preview.begin(), vector_preview.begin() + 8);
-                }
+                if (!reused) code_assistance::StageMetrics::record(code_assistance::Stage::Autocomplete, ms);
 
-                code_assistance::LogManager::instance().add_log(log);
-                spdlog::info("👻 Ghost: [{}] ({}ms)", completion, ms);
+                spdlog::info("👻 Ghost{}: [{}] ({}ms)", reused ? " (reused)" : "", completion, ms);
+                this->log_ghost_async(prefix, completion, ms, reused.has_value());
 
                 res.set_content(json{{"completion", completion}}.dump(), "application/json");
             } catch (...) {
@@ -147,18 +171,71 @@ private:
                     return;
                 }
 
-                // In a real implementation we'd use this->thread_pool_.enqueue(...)
-                // For now, logging to confirm receipt
-                spdlog::info("🔄 Sync Queued: {}", rel_path);
+                auto project = this->resolve_sync_project(project_id, body);
+                if (!project) {
+                    res.status = 404;
+                    res.set_content(json{{"error", "Unknown project root; send local_path once"}}.dump(), "application/json");
+                    return;
+                }
+
+                // ⏳ Returns immediately; parsing + embedding happen on the pool's background lane
+                bool fresh = this->sync_queue_->submit(project_id, *project, rel_path);
+                spdlog::info("🔄 Sync {}: {}", fresh ? "Queued" : "Coalesced", rel_path);
 
-                res.set_content(json{{"status", "queued"}}.dump(), "application/json");
+                res.set_content(json{{"status", fresh ? "queued" : "coalesced"}}.dump(), "application/json");
             } catch (...) { res.status = 400; }
         });
 
+        // 🧭 CONTEXT RETRIEVAL: identifier lookups are answered lexically, without an embedding call
+        server_.Post("/retrieve/:project_id", [this](const httplib::Request& req, httplib::Response& res) {
+            json body;
+            try { body = json::parse(req.body); } catch (...) { res.status = 400; return; }
+            code_assistance::ProjectQuery query;
+            query.query = body.value("query", "");
+            if (query.query.empty()) { res.status = 400; return; }
+            query.max_nodes = body.value("max_nodes", query.max_nodes);
+            query.use_graph = body.value("use_graph", query.use_graph);
+            query.max_chars = body.value("max_chars", query.max_chars);
+
+            try {
+                std::string project_id = req.path_params.at("project_id");
+                auto project = this->resolve_sync_project(project_id, body);
+                if (!project) {
+                    res.status = 404;
+                    res.set_content(json{{"error", "Unknown project root; send local_path once"}}.dump(), "application/json");
+                    return;
+                }
+
+                auto answer = hub_->retrieval().retrieve(project_id, project->local_root, project->storage_path, query);
+                json nodes = json::array();
+                for (const auto& r : answer.results) {
+                    nodes.push_back({{"id", r.node->id}, {"file_path", r.node->file_path}, {"score", r.final_score}});
+                }
+                res.set_content(json{{"context", answer.context}, {"nodes", nodes}, {"lexical", answer.lexical}}.dump(),
+                                "application/json");
+            } catch (const std::exception& e) {
+                spdlog::error("❌ Retrieval failed: {}", e.what());
+                res.status = 500;
+            }
+        });
+
         // 3. 📊 TELEMETRY DASHBOARD API
-        server_.Get("/api/admin/telemetry", [this](const httplib::Request&, httplib::Response& res) {
+        // ?since=<log_cursor> returns only the interaction logs added after that poll
+        server_.Get("/api/admin/telemetry", [this](const httplib::Request& req, httplib::Response& res) {
             auto metrics = system_monitor_.get_latest_snapshot();
-            auto logs = code_assistance::LogManager::instance().get_logs_json();
+            uint64_t since = 0;
+            if (req.has_param("since")) since = std::strtoull(req.get_param_value("since").c_str(), nullptr, 10);
+            uint64_t log_cursor = 0;
+            std::string logs = code_assistance::LogManager::instance().logs_json_since(since, log_cursor);
+            auto cache = ai_service_->cache_manager();
+            auto cache_json = [](const code_assistance::CacheStats& s) {
+                uint64_t lookups = s.hits + s.misses;
+                return json{
+                    {"hits", s.hits}, {"misses", s.misses}, {"evictions", s.evictions},
+                    {"hit_rate", lookups ? static_cast<double>(s.hits) / lookups : 0.0},
+                    {"entries", s.entries}, {"bytes", s.bytes}, {"budget_bytes", s.budget_bytes}
+                };
+            };
 
             json response = {
                 {"metrics", {
@@ -168,9 +245,101 @@ private:
                     {"tps", metrics.tokens_per_second},
                     {"llm_latency", metrics.llm_generation_ms}
                 }},
-                {"logs", logs}
+                {"process", [&metrics] {
+                    json threads = json::array();
+                    for (const auto& t : metrics.threads) {
+                        threads.push_back({{"tid", t.tid}, {"name", t.name}, {"cpu", t.cpu_percent}});
+                    }
+                    return json{
+                        {"cpu", metrics.process_cpu}, {"rss_bytes", metrics.rss_bytes}, {"pss_bytes", metrics.pss_bytes},
+                        {"heap_in_use_bytes", metrics.heap_in_use_bytes}, {"heap_free_bytes", metrics.heap_free_bytes},
+                        {"heap_mapped_bytes", metrics.heap_mapped_bytes}, {"thread_count", metrics.thread_count},
+                        {"threads", std::move(threads)},
+                        {"pool", {{"pending", metrics.pool_pending}, {"active", metrics.pool_active}, {"size", metrics.pool_size}}},
+                        {"sample_cost_us", metrics.sample_cost_us}
+                    };
+                }()},
+                {"cache", {
+                    {"embedding", cache_json(cache->embedding_stats())},
+                    {"result", cache_json(cache->result_stats())},
+                    {"ghost_reuse", {{"hits", completion_cache_.hits()}, {"misses", completion_cache_.misses()}}},
+                    {"ast", [&] {
+                        auto ast = code_assistance::elite::ASTCache::instance().stats();
+                        json j = cache_json(ast.cache);
+                        j["full_parses"] = ast.full_parses;
+                        j["incremental_parses"] = ast.incremental_parses;
+                        return j;
+                    }()}
+                }},
+                {"stages", [] {
+                    json stages = json::object();
+                    for (size_t i = 0; i < code_assistance::StageMetrics::STAGES; ++i) {
+                        auto stage = static_cast<code_assistance::Stage>(i);
+                        auto h = code_assistance::StageMetrics::histogram(stage).snapshot();
+                        stages[code_assistance::StageMetrics::name(stage)] = {
+                            {"count", h.count}, {"mean_ms", h.mean_ms()}, {"p50_ms", h.percentile_ms(0.5)},
+                            {"p95_ms", h.percentile_ms(0.95)}, {"p99_ms", h.percentile_ms(0.99)}, {"max_ms", h.max_us / 1000.0}
+                        };
+                    }
+                    return stages;
+                }()},
+                {"ghost_models", [this] {
+                    json models = json::array();
+                    for (const auto& m : ai_service_->autocomplete_latency()) {
+                        models.push_back({{"model", m.model}, {"samples", m.samples}, {"p50_ms", m.p50_ms}, {"p95_ms", m.p95_ms}});
+                    }
+                    return models;
+                }()},
+                {"sync_queue", [this] {
+                    auto q = sync_queue_->stats();
+                    return json{{"submitted", q.submitted}, {"coalesced", q.coalesced}, {"batches", q.batches},
+                                {"files_synced", q.files_synced}, {"pending", q.pending}};
+                }()},
+                {"stores", [this] {
+                    auto st = hub_->stores().stats();
+                    return json{{"projects", st.projects}, {"loaded", st.loaded}, {"resident_bytes", st.resident_bytes},
+                                {"budget_bytes", st.budget_bytes}, {"loads", st.loads}, {"evictions", st.evictions},
+                                {"swaps", st.swaps}};
+                }()},
+                {"watcher", [this] {
+                    if (!watcher_) return json{{"enabled", false}};
+                    auto w = watcher_->stats();
+                    return json{{"enabled", true}, {"projects", w.projects}, {"events", w.events},
+                                {"changes", w.changes}, {"overflows", w.overflows}};
+                }()},
+                {"log_cursor", log_cursor}
             };
-            res.set_content(response.dump(), "application/json");
+            // The logs are already rendered: spliced in as the last member, not re-parsed
+            std::string body = response.dump();
+            body.pop_back();
+            body.reserve(body.size() + logs.size() + 10);
+            body += ",\"logs\":";
+            body += logs;
+            body += '}';
+            res.set_content(body, "application/json");
+        });
+
+        // 📈 Prometheus scrape target: stage latency histograms plus the system gauges
+        server_.Get("/metrics", [this](const httplib::Request&, httplib::Response& res) {
+            auto metrics = system_monitor_.get_latest_snapshot();
+            std::string body = code_assistance::StageMetrics::prometheus();
+            body += fmt::format(
+                "# TYPE code_assistance_cpu_percent gauge\ncode_assistance_cpu_percent {:.2f}\n"
+                "# TYPE code_assistance_process_cpu_percent gauge\ncode_assistance_process_cpu_percent {:.2f}\n"
+                "# TYPE code_assistance_resident_bytes gauge\ncode_assistance_resident_bytes {}\n"
+                "# TYPE code_assistance_proportional_bytes gauge\ncode_assistance_proportional_bytes {}\n"
+                "# TYPE code_assistance_heap_in_use_bytes gauge\ncode_assistance_heap_in_use_bytes {}\n"
+                "# TYPE code_assistance_heap_free_bytes gauge\ncode_assistance_heap_free_bytes {}\n"
+                "# TYPE code_assistance_threads gauge\ncode_assistance_threads {}\n"
+                "# TYPE code_assistance_pool_pending_tasks gauge\ncode_assistance_pool_pending_tasks {}\n"
+                "# TYPE code_assistance_pool_active_workers gauge\ncode_assistance_pool_active_workers {}\n"
+                "# TYPE code_assistance_tokens_per_second gauge\ncode_assistance_tokens_per_second {:.2f}\n"
+                "# TYPE code_assistance_output_tokens_total counter\ncode_assistance_output_tokens_total {}\n",
+                metrics.cpu_usage, metrics.process_cpu, metrics.rss_bytes, metrics.pss_bytes,
+                metrics.heap_in_use_bytes, metrics.heap_free_bytes, metrics.thread_count,
+                metrics.pool_pending, metrics.pool_active, metrics.tokens_per_second,
+                code_assistance::SystemMonitor::global_output_tokens.load(std::memory_order_relaxed));
+            res.set_content(body, "text/plain; version=0.0.4");
         });
 
         // 4. 🧠 AGENT TRACE API
@@ -190,7 +359,243 @@ private:
         // You can paste back the other handler methods here if needed, but ensure they use 'this->'
     }
     
-    // ... (Helper methods like load_project_config, load_vector_store would go here) ...
+    // 📝 Telemetry enrichment (vector snapshot) runs on the pool, never on the request path
+    void log_ghost_async(std::string prefix, std::string completion, double ms, bool reused) {
+        auto ai = ai_service_;
+        thread_pool_.post(TaskPriority::Background, [ai, prefix = std::move(prefix), completion = std::move(completion), ms, reused] {
+            code_assistance::InteractionLog log;
+            log.timestamp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            log.project_id = "IDE_EXTENSION";
+            log.request_type = reused ? "GHOST_REUSE" : "GHOST";
+            log.user_query = "Cursor Context";
+            log.full_prompt = prefix;
+            log.ai_response = completion;
+            log.duration_ms = ms;
+            log.total_tokens = static_cast<int>(code_assistance::TokenCounter::count(prefix) + code_assistance::TokenCounter::count(completion));
+
+            try {
+                auto vector_preview = ai->generate_embedding(code_assistance::utf8_safe_substr(prefix, 100));
+                if (vector_preview.size() > 8) {
+                    log.vector_snapshot = std::vector<float>(vector_preview.begin(), vector_preview.begin() + 8);
+                }
+            } catch (const std::exception& e) {
+                spdlog::warn("⚠️ Ghost telemetry: no vector snapshot ({})", e.what());
+            }
+
+            code_assistance::LogManager::instance().add_log(std::move(log));
+        });
+    }
+
+    // Project roots for /sync/file: taken from the request when present (and remembered in
+    // data/<id>/project.json), otherwise from that file
+    std::optional<code_assistance::SyncProject> resolve_sync_project(const std::string& project_id, const json& body) {
+        bool learned = false;
+        auto project = lookup_sync_project(project_id, body, learned);
+        // Outside store_mutex: replacing a watch joins a thread that may be waiting on it
+        if (project && learned && watcher_) start_watching(project_id, *project);
+        return project;
+    }
+
+    std::optional<code_assistance::SyncProject> lookup_sync_project(const std::string& project_id, const json& body, bool& learned) {
+        std::lock_guard<std::mutex> lock(store_mutex);
+        fs::path project_file = fs::path("data") / project_id / "project.json";
+
+        std::string local_root = body.value("local_path", "");
+        if (!local_root.empty()) {
+            code_assistance::SyncProject project;
+            project.local_root = local_root;
+            project.storage_path = body.value("storage_path", (fs::path(local_root) / ".study_assistant").string());
+
+            auto& known = sync_projects_[project_id];
+            if (known.local_root != project.local_root || known.storage_path != project.storage_path) {
+                fs::create_directories(project_file.parent_path());
+                std::ofstream(project_file) << json{{"local_path", project.local_root}, {"storage_path", project.storage_path}}.dump(2);
+                known = project;
+                learned = true;
+            }
+            return project;
+        }
+
+        auto it = sync_projects_.find(project_id);
+        if (it != sync_projects_.end()) return it->second;
+
+        if (!fs::exists(project_file)) return std::nullopt;
+        try {
+            std::ifstream f(project_file);
+            auto j = json::parse(f);
+            code_assistance::SyncProject project{j.at("local_path").get<std::string>(), j.at("storage_path").get<std::string>()};
+            sync_projects_[project_id] = project;
+            learned = true;
+            return project;
+        } catch (...) {
+            spdlog::error("❌ Corrupt project file: {}", project_file.string());
+            return std::nullopt;
+        }
+    }
+
+    // 👁️ WATCH MODE: saves made outside the IDE (git checkout, codegen, other editors) reach the
+    // sync queue without a /sync/file call. Every project with a data/<id>/project.json is watched.
+    void start_file_watcher() {
+        if (!code_assistance::FileWatcher::supported()) {
+            spdlog::warn("⚠️ --watch: no change notifications on this platform");
+            return;
+        }
+        watcher_ = std::make_unique<code_assistance::FileWatcher>(
+            [this](const std::string& project_id, const std::string& rel_path) {
+                auto project = known_sync_project(project_id);
+                if (project) sync_queue_->submit(project_id, *project, rel_path);
+            },
+            [this](const std::string& project_id) {
+                auto project = known_sync_project(project_id);
+                if (project) rescan_project(project_id, *project);
+            }
+        );
+
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator("data", ec)) {
+            if (!entry.is_directory() || !fs::exists(entry.path() / "project.json")) continue;
+            std::string project_id = entry.path().filename().string();
+            bool learned = false;
+            auto project = lookup_sync_project(project_id, json::object(), learned);
+            if (project) start_watching(project_id, *project);
+        }
+    }
+
+    // The agent names a project by id or by its root path; the file path is relative to that
+    void on_agent_edit(const std::string& project_id, const std::string& rel_path) {
+        std::error_code ec;
+        fs::path full = fs::weakly_canonical(fs::path(project_id) / rel_path, ec);
+        std::optional<std::pair<std::string, code_assistance::SyncProject>> target;
+        std::string relative = rel_path;
+        {
+            std::lock_guard<std::mutex> lock(store_mutex);
+            auto it = sync_projects_.find(project_id);
+            if (it != sync_projects_.end()) {
+                target.emplace(it->first, it->second);
+            } else if (!ec) {
+                for (const auto& [id, project] : sync_projects_) {
+                    std::error_code root_ec;
+                    fs::path rel = full.lexically_relative(fs::weakly_canonical(project.local_root, root_ec));
+                    if (root_ec || rel.empty() || *rel.begin() == "..") continue;
+                    target.emplace(id, project);
+                    relative = rel.generic_string();
+                    break;
+                }
+            }
+        }
+        if (!target) return; // Not a synced project: nothing indexed to refresh
+        bool fresh = sync_queue_->submit(target->first, target->second, relative);
+        spdlog::info("✍️ Agent edit {}: {}", fresh ? "queued for re-index" : "coalesced", relative);
+    }
+
+    std::optional<code_assistance::SyncProject> known_sync_project(const std::string& project_id) {
+        std::lock_guard<std::mutex> lock(store_mutex);
+        auto it = sync_projects_.find(project_id);
+        if (it == sync_projects_.end()) return std::nullopt;
+        return it->second;
+    }
+
+    static code_assistance::FilterConfig watch_filter(const code_assistance::SyncProject& project) {
+        auto rules = code_assistance::FileSystemTools::load_config(project.local_root);
+        return code_assistance::FilterConfig::make(rules.allowed_extensions, rules.ignored_paths, rules.included_paths);
+    }
+
+    void start_watching(const std::string& project_id, const code_assistance::SyncProject& project) {
+        if (!fs::is_directory(project.local_root)) return;
+        if (watcher_->watch(project_id, project.local_root, watch_filter(project), project.storage_path)) {
+            rescan_project(project_id, project); // Catch up on edits made while nobody was watching
+        }
+    }
+
+    // Background lane work that uses this server: skipped once the destructor has started,
+    // and waited out by it when already running
+    bool post_background(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(background_mutex_);
+            if (stopping_) return false;
+            background_in_flight_++;
+        }
+        thread_pool_.post(TaskPriority::Background, [this, task = std::move(task)] {
+            struct Done {
+                CodeAssistanceServer* server;
+                ~Done() {
+                    std::lock_guard<std::mutex> lock(server->background_mutex_);
+                    if (--server->background_in_flight_ == 0) server->background_idle_.notify_all();
+                }
+            } done{this};
+            {
+                std::lock_guard<std::mutex> lock(background_mutex_);
+                if (stopping_) return;
+            }
+            task();
+        });
+        return true;
+    }
+
+    // Background lane: stat-compare against the last full sync and queue whatever moved
+    void rescan_project(const std::string& project_id, const code_assistance::SyncProject& project) {
+        post_background([this, project_id, project] {
+            auto changed = sync_service_->changed_since_last_sync(
+                project_id, project.local_root, project.storage_path, watch_filter(project));
+            for (const auto& rel : changed) sync_queue_->submit(project_id, project, rel);
+            if (!changed.empty()) spdlog::info("👁️ [{}] Rescan queued {} changed files", project_id, changed.size());
+        });
+    }
+
+    // Runs on a pool worker: swap the files' nodes in the project's index and persist it
+    void apply_file_sync(const std::string& project_id, const code_assistance::SyncProject& project,
+                         code_assistance::FileSyncBatch& batch) {
+        fs::path store_dir = fs::path(project.storage_path) / "vector_store";
+        auto store = hub_->stores().acquire(project_id, project.local_root, project.storage_path);
+
+        std::vector<std::string> replaced = batch.removed;
+        replaced.insert(replaced.end(), batch.synced.begin(), batch.synced.end());
+        store->replace_file_nodes(replaced, batch.nodes);
+        store->save(store_dir.string());
+        hub_->stores().saved(project_id);
+        schedule_centrality(project_id, project);
+    }
+
+    // 📈 Centrality walks the whole graph: one run per project at a time, on the Background
+    // lane, and a burst of syncs meanwhile folds into a single follow-up run. Nodes synced
+    // since the last run fall back to their stored weight until it lands. The scores are
+    // persisted by the next sync's save: saving here would rewrite nodes.bin a second time
+    // for every batch.
+    void schedule_centrality(const std::string& project_id, const code_assistance::SyncProject& project) {
+        {
+            std::lock_guard<std::mutex> lock(background_mutex_);
+            auto& run = centrality_runs_[project_id];
+            if (run.running) {
+                run.again = true;
+                return;
+            }
+            run.running = true;
+        }
+        bool posted = post_background([this, project_id, project] {
+            for (;;) {
+                bool ok = true;
+                try {
+                    auto store = hub_->stores().acquire(project_id, project.local_root, project.storage_path);
+                    store->refresh_centrality(); // Hub scores go out with the nodes, so queries never walk the graph for them
+                } catch (const std::exception& e) {
+                    spdlog::error("❌ [{}] Centrality refresh failed: {}", project_id, e.what());
+                    ok = false; // The next sync schedules another
+                }
+
+                std::lock_guard<std::mutex> lock(background_mutex_);
+                auto& run = centrality_runs_[project_id];
+                if (!ok || !run.again || stopping_) {
+                    run = {};
+                    return;
+                }
+                run.again = false;
+            }
+        });
+        if (!posted) {
+            std::lock_guard<std::mutex> lock(background_mutex_);
+            centrality_runs_[project_id] = {};
+        }
+    }
 };
 
 void pre_flight_check() {
@@ -198,11 +603,66 @@ void pre_flight_check() {
     if (!fs::exists("www/index.html")) spdlog::warn("⚠️ www/index.html not found in CWD!");
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     spdlog::set_pattern("[%H:%M:%S] [%^%l%$] %v");
     pre_flight_check();
-    
-    CodeAssistanceServer server;
+
+    bool watch = false;
+    int port = 5002;
+    bool agent = false; // Combined mode: also host the gRPC agent on this process's services
+    std::string agent_address = "0.0.0.0:50051";
+    code_assistance::MissionSchedulerOptions mission_options;
+    code_assistance::ServiceHubOptions hub_options;
+    code_assistance::SystemMonitorOptions monitor_options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--watch") watch = true;
+        else if (arg == "--agent") agent = true;
+        else if (arg == "--port" && has_value) port = std::stoi(argv[++i]);
+        else if (arg == "--agent-address" && has_value) agent_address = argv[++i];
+        else if (arg == "--max-missions" && has_value) mission_options.max_concurrent = std::stoul(argv[++i]);
+        else if (arg == "--max-queued" && has_value) mission_options.max_queued = std::stoul(argv[++i]);
+        else if (arg == "--monitor-interval-ms" && has_value) monitor_options.interval = std::chrono::milliseconds(std::stoul(argv[++i]));
+        else if (arg == "--llm-base-url" && has_value) hub_options.llm_base_url = argv[++i];
+        else if (arg == "--store-budget-mb" && has_value) hub_options.stores.memory_budget_bytes = std::stoull(argv[++i]) << 20;
+        else if (arg == "--local-embeddings" && has_value) {
+            if (!hub_options.local_embeddings) hub_options.local_embeddings.emplace();
+            hub_options.local_embeddings->model_dir = argv[++i];
+        } else if (arg == "--embedding-threads" && has_value) {
+            if (!hub_options.local_embeddings) hub_options.local_embeddings.emplace();
+            hub_options.local_embeddings->threads = std::stoi(argv[++i]);
+        }
+    }
+    if (hub_options.local_embeddings && hub_options.local_embeddings->model_dir.empty()) {
+        spdlog::warn("⚠️ --embedding-threads without --local-embeddings: using the embedding API");
+        hub_options.local_embeddings.reset();
+    }
+
+    auto hub = std::make_shared<code_assistance::ServiceHub>(hub_options);
+
+    // 🛰️ The agent runs on gRPC's own threads and the mission scheduler; REST keeps this one
+    std::unique_ptr<code_assistance::MissionScheduler> scheduler;
+    std::unique_ptr<code_assistance::AgentServiceImpl> agent_service;
+    std::unique_ptr<grpc::Server> agent_server;
+    if (agent) {
+        hub->enable_editing_tools();
+        scheduler = std::make_unique<code_assistance::MissionScheduler>(mission_options);
+        agent_service = std::make_unique<code_assistance::AgentServiceImpl>(hub->executor(), *scheduler);
+        grpc::ServerBuilder builder;
+        builder.AddListeningPort(agent_address, grpc::InsecureServerCredentials());
+        builder.RegisterService(agent_service.get());
+        agent_server = builder.BuildAndStart();
+        if (!agent_server) {
+            spdlog::error("❌ Agent gRPC Service failed to bind {}", agent_address);
+            return 1;
+        }
+        spdlog::info("🚀 Agent gRPC Service ignited on {} (shared services, {} concurrent missions)",
+                     agent_address, mission_options.max_concurrent);
+    }
+
+    CodeAssistanceServer server(hub, port, watch, monitor_options);
     server.run();
+    if (agent_server) agent_server->Shutdown();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "node_arena.hpp"
+#include <algorithm>
+
+namespace code_assistance {
+
+NodeArena::Index NodeArena::add(const CodeNode& node) {
+    CompactNode r;
+    r.id = symbols_.intern(node.id);
+    r.name = symbols_.intern(node.name);
+    r.file_path = symbols_.intern(node.file_path);
+    r.type = symbols_.intern(node.type);
+    r.structural_weight = node.structural_weight;
+    r.ai_quality_score = static_cast<float>(node.ai_quality_score);
+
+    r.dep_begin = static_cast<uint32_t>(deps_.size());
+    r.dep_count = static_cast<uint32_t>(node.dependencies.size());
+    for (const auto& d : node.dependencies) deps_.push_back(symbols_.intern(d));
+
+    r.weight_begin = static_cast<uint32_t>(weights_.size());
+    for (const auto& [key, value] : node.weights) {
+        if (key == "structural") continue; // Kept in structural_weight
+        weights_.push_back({symbols_.intern(key), value});
+    }
+    r.weight_count = static_cast<uint32_t>(weights_.size() - r.weight_begin);
+
+    if (node.source) {
+        r.buffer = acquire_buffer(node.source);
+        r.content_offset = node.source_offset;
+        r.content_length = node.source_length;
+    } else if (!node.content.empty()) {
+        r.buffer = acquire_buffer(std::make_shared<const std::string>(node.content));
+        r.content_length = static_cast<uint32_t>(node.content.size());
+    }
+
+    if (!node.docstring.empty() || !node.ai_summary.empty() || !node.signatures.empty()) {
+        if (free_texts_.empty()) {
+            r.text = static_cast<uint32_t>(texts_.size());
+            texts_.emplace_back();
+        } else {
+            r.text = free_texts_.back();
+            free_texts_.pop_back();
+        }
+        texts_[r.text] = {node.docstring, node.ai_summary, node.signatures};
+    }
+
+    if (node.embedding.size() == static_cast<size_t>(dimension_)) {
+        if (free_embeddings_.empty()) {
+            r.embedding = static_cast<uint32_t>(embeddings_.size() / dimension_);
+            embeddings_.insert(embeddings_.end(), node.embedding.begin(), node.embedding.end());
+        } else {
+            r.embedding = free_embeddings_.back();
+            free_embeddings_.pop_back();
+            std::copy(node.embedding.begin(), node.embedding.end(), embeddings_.begin() + static_cast<size_t>(r.embedding) * dimension_);
+        }
+    }
+
+    Index idx;
+    if (free_records_.empty()) {
+        idx = static_cast<Index>(records_.size());
+        records_.push_back(r);
+        alive_.push_back(1);
+    } else {
+        idx = free_records_.back();
+        free_records_.pop_back();
+        records_[idx] = r;
+        alive_[idx] = 1;
+    }
+    live_++;
+    return idx;
+}
+
+void NodeArena::erase(Index idx) {
+    if (!contains(idx)) return;
+    CompactNode& r = records_[idx];
+    if (r.buffer != CompactNode::NONE) release_buffer(r.buffer);
+    if (r.text != CompactNode::NONE) {
+        texts_[r.text] = {};
+        free_texts_.push_back(r.text);
+    }
+    if (r.embedding != CompactNode::NONE) free_embeddings_.push_back(r.embedding);
+    dead_pool_entries_ += r.dep_count + r.weight_count;
+    r = CompactNode{};
+    alive_[idx] = 0;
+    free_records_.push_back(idx);
+    live_--;
+
+    // Replaced files leave their ranges behind; reclaim once they outweigh the live ones
+    if (dead_pool_entries_ > 4096 && dead_pool_entries_ * 2 > deps_.size() + weights_.size()) compact_pools();
+}
+
+void NodeArena::clear() {
+    records_.clear();
+    alive_.clear();
+    free_records_.clear();
+    live_ = 0;
+    deps_.clear();
+    weights_.clear();
+    dead_pool_entries_ = 0;
+    buffers_.clear();
+    free_buffers_.clear();
+    buffer_slot_.clear();
+    texts_.clear();
+    free_texts_.clear();
+    embeddings_.clear();
+    free_embeddings_.clear();
+}
+
+std::string_view NodeArena::content(Index idx) const {
+    const CompactNode& r = records_[idx];
+    if (r.buffer == CompactNode::NONE) return {};
+    return std::string_view(*buffers_[r.buffer].bytes).substr(r.content_offset, r.content_length);
+}
+
+const float* NodeArena::embedding(Index idx) const {
+    const CompactNode& r = records_[idx];
+    return r.embedding == CompactNode::NONE ? nullptr : embeddings_.data() + static_cast<size_t>(r.embedding) * dimension_;
+}
+
+std::shared_ptr<CodeNode> NodeArena::materialize(Index idx, bool with_embedding) const {
+    const CompactNode& r = records_[idx];
+    auto node = std::make_shared<CodeNode>();
+    node->id = symbols_.str(r.id);
+    node->name = symbols_.str(r.name);
+    node->file_path = symbols_.str(r.file_path);
+    node->type = symbols_.str(r.type);
+    node->structural_weight = r.structural_weight;
+    node->ai_quality_score = r.ai_quality_score;
+
+    node->dependencies.reserve(r.dep_count);
+    for (uint32_t i = 0; i < r.dep_count; ++i) node->dependencies.emplace(symbols_.str(deps_[r.dep_begin + i]));
+    node->weights.emplace("structural", r.structural_weight);
+    for (uint32_t i = 0; i < r.weight_count; ++i) {
+        const Weight& w = weights_[r.weight_begin + i];
+        node->weights.emplace(symbols_.str(w.key), w.value);
+    }
+
+    if (r.buffer != CompactNode::NONE) node->set_source(buffers_[r.buffer].bytes, r.content_offset, r.content_length);
+    if (r.text != CompactNode::NONE) {
+        node->docstring = texts_[r.text].docstring;
+        node->ai_summary = texts_[r.text].ai_summary;
+        node->signatures = texts_[r.text].signatures;
+    }
+    if (with_embedding && r.embedding != CompactNode::NONE) {
+        const float* e = embedding(idx);
+        node->embedding.assign(e, e + dimension_);
+    }
+    return node;
+}
+
+size_t NodeArena::memory_bytes() const {
+    size_t text_bytes = 0;
+    for (const auto& t : texts_) text_bytes += sizeof(Text) + t.docstring.capacity() + t.ai_summary.capacity() + t.signatures.capacity();
+    size_t buffer_bytes = 0;
+    for (const auto& b : buffers_) buffer_bytes += sizeof(Buffer) + (b.bytes ? b.bytes->capacity() : 0);
+    return records_.capacity() * (sizeof(CompactNode) + 1) + deps_.capacity() * sizeof(uint32_t) +
+           weights_.capacity() * sizeof(Weight) + embeddings_.capacity() * sizeof(float) + text_bytes + buffer_bytes;
+}
+
+uint32_t NodeArena::acquire_buffer(const std::shared_ptr<const std::string>& bytes) {
+    auto [it, fresh] = buffer_slot_.try_emplace(bytes.get(), 0);
+    if (!fresh) {
+        buffers_[it->second].refs++;
+        return it->second;
+    }
+    uint32_t slot;
+    if (free_buffers_.empty()) {
+        slot = static_cast<uint32_t>(buffers_.size());
+        buffers_.emplace_back();
+    } else {
+        slot = free_buffers_.back();
+        free_buffers_.pop_back();
+    }
+    buffers_[slot] = {bytes, 1};
+    it->second = slot;
+    return slot;
+}
+
+void NodeArena::release_buffer(uint32_t slot) {
+    Buffer& b = buffers_[slot];
+    if (--b.refs > 0) return;
+    buffer_slot_.erase(b.bytes.get());
+    b.bytes.reset();
+    free_buffers_.push_back(slot);
+}
+
+void NodeArena::compact_pools() {
+    std::vector<uint32_t> deps;
+    std::vector<Weight> weights;
+    deps.reserve(deps_.size() - std::min(deps_.size(), dead_pool_entries_));
+    for (size_t i = 0; i < records_.size(); ++i) {
+        if (!alive_[i]) continue;
+        CompactNode& r = records_[i];
+        uint32_t begin = static_cast<uint32_t>(deps.size());
+        deps.insert(deps.end(), deps_.begin() + r.dep_begin, deps_.begin() + r.dep_begin + r.dep_count);
+        r.dep_begin = begin;
+        begin = static_cast<uint32_t>(weights.size());
+        weights.insert(weights.end(), weights_.begin() + r.weight_begin, weights_.begin() + r.weight_begin + r.weight_count);
+        r.weight_begin = begin;
+    }
+    deps_ = std::move(deps);
+    weights_ = std::move(weights);
+    dead_pool_entries_ = 0;
+}
+
+} // namespace code_assistance
@@ -0,0 +1,353 @@
+#include "node_store.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+namespace code_assistance {
+
+using namespace node_store_format;
+
+namespace {
+
+uint64_t align_up(uint64_t v, uint64_t a) { return (v + a - 1) & ~(a - 1); }
+
+uint64_t next_pow2(uint64_t v) {
+    uint64_t p = 16;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+bool in_bounds(uint64_t offset, uint64_t bytes, size_t file_size) {
+    return offset <= file_size && bytes <= file_size - offset;
+}
+
+} // namespace
+
+uint64_t NodeStore::hash_id(std::string_view s) {
+    // FNV-1a: stable across platforms and builds (std::hash is not)
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// --- READER ---
+
+bool NodeStore::open(const std::string& path) {
+    header_ = nullptr;
+    if (!file_.open(path)) return false;
+
+    const size_t sz = file_.size();
+    if (sz < sizeof(Header)) {
+        spdlog::error("❌ NodeStore: {} is truncated", path);
+        return false;
+    }
+
+    auto* h = reinterpret_cast<const Header*>(file_.data());
+    if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version < MIN_VERSION || h->version > VERSION) {
+        spdlog::error("❌ NodeStore: {} has unknown format (version {})", path, h->version);
+        return false;
+    }
+    precision_ = VectorPrecision::F32;
+    if (h->version >= 4) {
+        if (h->embedding_precision > static_cast<uint32_t>(VectorPrecision::Int8)) {
+            spdlog::error("❌ NodeStore: {} has unknown embedding precision {}", path, h->embedding_precision);
+            return false;
+        }
+        precision_ = static_cast<VectorPrecision>(h->embedding_precision);
+    }
+    row_bytes_ = vector_row_bytes(precision_, h->dimension);
+    if (h->version >= 4 && h->embeddings_offset != 0 && h->embedding_row_bytes != row_bytes_) {
+        spdlog::error("❌ NodeStore: {} has inconsistent embedding rows", path);
+        return false;
+    }
+
+    const uint64_t signatures_offset = h->version >= 6 ? h->signatures_offset : 0;
+    bool ok = in_bounds(h->records_offset, h->node_count * sizeof(NodeRecord), sz) &&
+              in_bounds(h->weights_offset, h->weight_count * sizeof(WeightEntry), sz) &&
+              in_bounds(h->deps_offset, h->dep_count * sizeof(StrRef), sz) &&
+              (signatures_offset == 0 || in_bounds(signatures_offset, h->node_count * sizeof(StrRef), sz)) &&
+              in_bounds(h->hash_offset, h->hash_capacity * sizeof(uint32_t), sz) &&
+              in_bounds(h->heap_offset, h->heap_size, sz) &&
+              (h->embeddings_offset == 0 ||
+               in_bounds(h->embeddings_offset, h->node_count * row_bytes_, sz));
+    if (!ok) {
+        spdlog::error("❌ NodeStore: {} has out-of-range sections", path);
+        return false;
+    }
+
+    const char* base = file_.data();
+    records_ = reinterpret_cast<const NodeRecord*>(base + h->records_offset);
+    weights_ = reinterpret_cast<const WeightEntry*>(base + h->weights_offset);
+    deps_ = reinterpret_cast<const StrRef*>(base + h->deps_offset);
+    signatures_ = signatures_offset ? reinterpret_cast<const StrRef*>(base + signatures_offset) : nullptr;
+    slots_ = reinterpret_cast<const uint32_t*>(base + h->hash_offset);
+    heap_ = base + h->heap_offset;
+    embeddings_ = h->embeddings_offset ? reinterpret_cast<const uint8_t*>(base + h->embeddings_offset) : nullptr;
+    header_ = h;
+
+    file_.advise_random();
+    return true;
+}
+
+std::string_view NodeStore::str(const StrRef& ref) const {
+    if (ref.offset > header_->heap_size || ref.length > header_->heap_size - ref.offset) return {};
+    return {heap_ + ref.offset, ref.length};
+}
+
+std::string_view NodeStore::id(size_t row) const { return str(records_[row].id); }
+std::string_view NodeStore::name(size_t row) const { return str(records_[row].name); }
+std::string_view NodeStore::file_path(size_t row) const { return str(records_[row].file_path); }
+std::string_view NodeStore::type(size_t row) const { return str(records_[row].type); }
+std::string_view NodeStore::content(size_t row) const { return str(records_[row].content); }
+std::string_view NodeStore::signatures(size_t row) const { return signatures_ ? str(signatures_[row]) : std::string_view(); }
+
+std::string_view NodeStore::dependency(size_t row, uint32_t i) const {
+    const NodeRecord& r = records_[row];
+    if (i >= r.dep_count || r.dep_begin + i >= header_->dep_count) return {};
+    return str(deps_[r.dep_begin + i]);
+}
+
+const uint8_t* NodeStore::embedding_row(size_t row) const {
+    return embeddings_ ? embeddings_ + row * row_bytes_ : nullptr;
+}
+
+const float* NodeStore::embedding(size_t row, float* scratch) const {
+    const uint8_t* bytes = embedding_row(row);
+    if (!bytes) return nullptr;
+    if (precision_ == VectorPrecision::F32) return reinterpret_cast<const float*>(bytes);
+    decode_vector(precision_, bytes, header_->dimension, scratch);
+    return scratch;
+}
+
+long NodeStore::find(std::string_view node_id) const {
+    if (!header_ || header_->hash_capacity == 0) return -1;
+    const uint64_t mask = header_->hash_capacity - 1;
+    for (uint64_t slot = hash_id(node_id) & mask;; slot = (slot + 1) & mask) {
+        uint32_t v = slots_[slot];
+        if (v == 0) return -1;
+        if (id(v - 1) == node_id) return static_cast<long>(v - 1);
+    }
+}
+
+long NodeStore::find_by_hash(uint64_t hash, uint64_t mask) const {
+    if (!header_ || header_->hash_capacity == 0) return -1;
+    const uint64_t slot_mask = header_->hash_capacity - 1;
+    // Slots are placed by the full hash; callers masking high bits must still probe from it
+    for (uint64_t slot = hash & slot_mask;; slot = (slot + 1) & slot_mask) {
+        uint32_t v = slots_[slot];
+        if (v == 0) return -1;
+        if ((records_[v - 1].id_hash & mask) == (hash & mask)) return static_cast<long>(v - 1);
+    }
+}
+
+std::shared_ptr<CodeNode> NodeStore::materialize(size_t row, bool with_embedding) const {
+    const NodeRecord& r = records_[row];
+    auto node = std::make_shared<CodeNode>();
+    node->id = str(r.id);
+    node->name = str(r.name);
+    node->content = str(r.content);
+    node->docstring = str(r.docstring);
+    node->file_path = str(r.file_path);
+    node->type = str(r.type);
+    node->ai_summary = str(r.ai_summary);
+    node->signatures = signatures(row);
+    node->ai_quality_score = r.ai_quality_score;
+    node->structural_weight = r.structural_weight;
+
+    node->dependencies.reserve(r.dep_count);
+    for (uint32_t i = 0; i < r.dep_count && r.dep_begin + i < header_->dep_count; ++i) {
+        node->dependencies.emplace(str(deps_[r.dep_begin + i]));
+    }
+    for (uint32_t i = 0; i < r.weight_count && r.weight_begin + i < header_->weight_count; ++i) {
+        const WeightEntry& w = weights_[r.weight_begin + i];
+        node->weights.emplace(std::string(str(w.key)), w.value);
+    }
+
+    if (with_embedding && embeddings_) {
+        node->embedding.resize(header_->dimension);
+        decode_vector(precision_, embedding_row(row), header_->dimension, node->embedding.data());
+    }
+    return node;
+}
+
+// --- WRITER ---
+
+StrRef NodeStoreWriter::intern(std::string_view s) {
+    StrRef ref{heap_.size(), static_cast<uint32_t>(s.size()), 0};
+    heap_.append(s.data(), s.size());
+    return ref;
+}
+
+StrRef NodeStoreWriter::intern_slice(std::string_view blob, size_t offset, size_t length) {
+    auto [it, fresh] = blobs_.try_emplace(blob.data(), 0);
+    if (fresh) it->second = intern(blob).offset;
+    return StrRef{it->second + offset, static_cast<uint32_t>(length), 0};
+}
+
+void NodeStoreWriter::push_embedding(const float* embedding) {
+    if (!with_embeddings_) return;
+    size_t at = embeddings_.size();
+    embeddings_.resize(at + row_bytes_, 0);
+    if (embedding) encode_vector(precision_, embedding, dimension_, embeddings_.data() + at);
+}
+
+void NodeStoreWriter::add(const CodeNode& node, const float* embedding, float centrality) {
+    NodeRecord r{};
+    r.id = intern(node.id);
+    r.name = intern(node.name);
+    r.content = node.source ? intern_slice(*node.source, node.source_offset, node.source_length)
+                            : intern(node.content);
+    r.docstring = intern(node.docstring);
+    r.file_path = intern(node.file_path);
+    r.type = intern(node.type);
+    r.ai_summary = intern(node.ai_summary);
+    r.ai_quality_score = node.ai_quality_score;
+
+    r.dep_begin = static_cast<uint32_t>(deps_.size());
+    r.dep_count = static_cast<uint32_t>(node.dependencies.size());
+    for (const auto& d : node.dependencies) deps_.push_back(intern(d));
+
+    r.weight_begin = static_cast<uint32_t>(weights_.size());
+    r.weight_count = static_cast<uint32_t>(node.weights.size());
+    for (const auto& [k, v] : node.weights) weights_.push_back({intern(k), v});
+
+    r.id_hash = NodeStore::hash_id(node.id);
+    r.structural_weight = node.structural_weight;
+    r.centrality = centrality;
+    records_.push_back(r);
+    signatures_.push_back(intern(node.signatures));
+
+    if (!embedding && node.embedding.size() == static_cast<size_t>(dimension_)) {
+        embedding = node.embedding.data();
+    }
+    push_embedding(embedding);
+}
+
+void NodeStoreWriter::add_row(const NodeStore& source, size_t row, float centrality) {
+    add_row(source, row);
+    records_.back().centrality = centrality;
+}
+
+void NodeStoreWriter::add_row(const NodeStore& source, size_t row) {
+    const NodeRecord& src = source.records_[row];
+    NodeRecord r{};
+    r.id = intern(source.str(src.id));
+    r.name = intern(source.str(src.name));
+    std::string_view content = source.str(src.content);
+    long file_row = source.find(source.str(src.file_path));
+    std::string_view file = file_row >= 0 ? source.content(static_cast<size_t>(file_row)) : std::string_view();
+    // Rows cut from the file row's bytes keep pointing into one copy of them
+    if (!file.empty() && content.data() >= file.data() && content.data() + content.size() <= file.data() + file.size()) {
+        r.content = intern_slice(file, static_cast<size_t>(content.data() - file.data()), content.size());
+    } else {
+        r.content = intern(content);
+    }
+    r.docstring = intern(source.str(src.docstring));
+    r.file_path = intern(source.str(src.file_path));
+    r.type = intern(source.str(src.type));
+    r.ai_summary = intern(source.str(src.ai_summary));
+    r.ai_quality_score = src.ai_quality_score;
+
+    r.dep_begin = static_cast<uint32_t>(deps_.size());
+    r.dep_count = src.dep_count;
+    for (uint32_t i = 0; i < src.dep_count; ++i) deps_.push_back(intern(source.str(source.deps_[src.dep_begin + i])));
+
+    r.weight_begin = static_cast<uint32_t>(weights_.size());
+    r.weight_count = src.weight_count;
+    for (uint32_t i = 0; i < src.weight_count; ++i) {
+        const WeightEntry& w = source.weights_[src.weight_begin + i];
+        weights_.push_back({intern(source.str(w.key)), w.value});
+    }
+
+    r.id_hash = src.id_hash;
+    r.structural_weight = src.structural_weight;
+    r.centrality = src.centrality;
+    records_.push_back(r);
+    signatures_.push_back(intern(source.signatures(row)));
+    if (!with_embeddings_) return;
+    if (source.dimension() != dimension_ || !source.has_embeddings()) {
+        push_embedding(nullptr);
+    } else if (source.embedding_precision() == precision_) {
+        const uint8_t* bytes = source.embedding_row(row); // Same encoding: copied, never re-quantized
+        embeddings_.insert(embeddings_.end(), bytes, bytes + row_bytes_);
+    } else {
+        thread_local std::vector<float> scratch;
+        scratch.resize(dimension_);
+        push_embedding(source.embedding(row, scratch.data()));
+    }
+}
+
+bool NodeStoreWriter::write(const std::string& path) const {
+    // 1. Build the id hash table (linear probing, load factor <= 0.5)
+    const uint64_t capacity = next_pow2(records_.size() * 2);
+    std::vector<uint32_t> slots(capacity, 0);
+    for (size_t row = 0; row < records_.size(); ++row) {
+        uint64_t slot = records_[row].id_hash & (capacity - 1);
+        while (slots[slot] != 0) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = static_cast<uint32_t>(row + 1);
+    }
+
+    // 2. Lay out sections
+    Header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.dimension = static_cast<uint32_t>(dimension_);
+    h.node_count = records_.size();
+    h.records_offset = sizeof(Header);
+    h.weights_offset = h.records_offset + records_.size() * sizeof(NodeRecord);
+    h.weight_count = weights_.size();
+    h.deps_offset = h.weights_offset + weights_.size() * sizeof(WeightEntry);
+    h.dep_count = deps_.size();
+    h.signatures_offset = h.deps_offset + deps_.size() * sizeof(StrRef);
+    h.hash_offset = h.signatures_offset + signatures_.size() * sizeof(StrRef);
+    h.hash_capacity = capacity;
+    h.heap_offset = h.hash_offset + capacity * sizeof(uint32_t);
+    h.heap_size = heap_.size();
+    h.embeddings_offset = with_embeddings_ ? align_up(h.heap_offset + h.heap_size, 64) : 0;
+    h.embedding_precision = static_cast<uint32_t>(precision_);
+    h.embedding_row_bytes = static_cast<uint32_t>(row_bytes_);
+
+    // 3. Stream out
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            spdlog::error("❌ NodeStore: cannot write {}", tmp);
+            return false;
+        }
+        auto put = [&](const void* p, size_t n) { out.write(static_cast<const char*>(p), static_cast<std::streamsize>(n)); };
+
+        put(&h, sizeof(h));
+        put(records_.data(), records_.size() * sizeof(NodeRecord));
+        put(weights_.data(), weights_.size() * sizeof(WeightEntry));
+        put(deps_.data(), deps_.size() * sizeof(StrRef));
+        put(signatures_.data(), signatures_.size() * sizeof(StrRef));
+        put(slots.data(), slots.size() * sizeof(uint32_t));
+        put(heap_.data(), heap_.size());
+        if (with_embeddings_) {
+            static const char zeros[64] = {};
+            put(zeros, h.embeddings_offset - (h.heap_offset + h.heap_size));
+            put(embeddings_.data(), embeddings_.size());
+        }
+        if (!out.good()) {
+            spdlog::error("❌ NodeStore: short write on {}", tmp);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        spdlog::error("❌ NodeStore: rename {} -> {} failed: {}", tmp, path, ec.message());
+        return false;
+    }
+    return true;
+}
+
+} // namespace code_assistance
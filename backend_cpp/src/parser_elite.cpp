@@ -1,9 +1,15 @@
 #include "parser_elite.hpp"
+#include "Utf8.hpp"
 #include <tree_sitter/api.h>
 #include <spdlog/spdlog.h>
 #include <filesystem>
 #include <fstream>
-#include <stack>
+#include <cctype>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
 
 // 🚀 LINK THE EMBEDDED GRAMMARS (Must be global scope)
 extern "C" {
@@ -14,28 +20,128 @@ extern "C" {
 
 namespace code_assistance::elite {
 
-ASTBooster::ASTBooster() {
-    parser_ = ts_parser_new();
-}
-
-ASTBooster::~ASTBooster() {
-    if (parser_) ts_parser_delete(parser_);
-}
-
-const TSLanguage* ASTBooster::get_lang(const std::string& ext) {
+const TSLanguage* language_for_extension(const std::string& ext) {
     if (ext == ".cpp" || ext == ".hpp" || ext == ".h") return tree_sitter_cpp();
     if (ext == ".py") return tree_sitter_python();
     if (ext == ".ts" || ext == ".js") return tree_sitter_typescript();
     return nullptr;
 }
 
+TSParser* thread_parser(const TSLanguage* lang) {
+    struct ParserDeleter { void operator()(TSParser* p) const { ts_parser_delete(p); } };
+    thread_local std::unordered_map<const TSLanguage*, std::unique_ptr<TSParser, ParserDeleter>> parsers;
+
+    auto& slot = parsers[lang];
+    if (!slot) {
+        slot.reset(ts_parser_new());
+        ts_parser_set_language(slot.get(), lang);
+    }
+    return slot.get();
+}
+
+namespace {
+
+TSPoint point_at(std::string_view text, uint32_t byte) {
+    TSPoint p{0, 0};
+    size_t line_start = 0;
+    for (size_t i = 0; i < byte; ++i) {
+        if (text[i] == '\n') { p.row++; line_start = i + 1; }
+    }
+    p.column = static_cast<uint32_t>(byte - line_start);
+    return p;
+}
+
+// ✂️ Smallest single edit turning `before` into `after`: common prefix + common suffix
+TSInputEdit diff_edit(std::string_view before, std::string_view after) {
+    size_t limit = std::min(before.size(), after.size());
+    size_t prefix = 0;
+    while (prefix < limit && before[prefix] == after[prefix]) prefix++;
+    size_t suffix = 0;
+    while (suffix < limit - prefix &&
+           before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) suffix++;
+
+    TSInputEdit edit;
+    edit.start_byte = static_cast<uint32_t>(prefix);
+    edit.old_end_byte = static_cast<uint32_t>(before.size() - suffix);
+    edit.new_end_byte = static_cast<uint32_t>(after.size() - suffix);
+    edit.start_point = point_at(before, edit.start_byte);
+    edit.old_end_point = point_at(before, edit.old_end_byte);
+    edit.new_end_point = point_at(after, edit.new_end_byte);
+    return edit;
+}
+
+} // namespace
+
+ASTCache& ASTCache::instance() {
+    static ASTCache cache;
+    return cache;
+}
+
+ASTCache::ASTCache(size_t budget_bytes)
+    : trees_(budget_bytes, std::chrono::hours(24), EvictionPolicy::Clock) {}
+
+std::shared_ptr<const SyntaxTree> ASTCache::parse(const std::string& path, std::string_view source) {
+    return parse(path, source, nullptr);
+}
+
+std::shared_ptr<const SyntaxTree> ASTCache::parse(const std::string& path, std::shared_ptr<const std::string> buffer) {
+    if (!buffer) return nullptr;
+    std::string_view source(*buffer);
+    return parse(path, source, std::move(buffer));
+}
+
+// `buffer` holds `source` when the caller already owns a shared copy; otherwise one is made,
+// but only once the cached tree turns out to be stale
+std::shared_ptr<const SyntaxTree> ASTCache::parse(const std::string& path, std::string_view source,
+                                                  std::shared_ptr<const std::string> buffer) {
+    const TSLanguage* lang = language_for_extension(std::filesystem::path(path).extension().string());
+    if (!lang) return nullptr;
+
+    std::shared_ptr<const SyntaxTree> previous;
+    if (auto cached = trees_.get(path)) previous = std::move(*cached);
+    if (previous && previous->language() == lang && previous->source() == source) return previous;
+
+    TSParser* parser = thread_parser(lang);
+    TSTree* old_tree = nullptr;
+    if (previous && previous->language() == lang) {
+        // The cached tree is shared with readers; edit a private copy
+        old_tree = ts_tree_copy(previous->tree());
+        TSInputEdit edit = diff_edit(previous->source(), source);
+        ts_tree_edit(old_tree, &edit);
+    }
+
+    TSTree* tree = ts_parser_parse_string(parser, old_tree, source.data(), static_cast<uint32_t>(source.size()));
+    if (old_tree) {
+        ts_tree_delete(old_tree);
+        incremental_parses_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        full_parses_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!tree) return nullptr;
+
+    if (!buffer) buffer = std::make_shared<const std::string>(source);
+    auto parsed = std::make_shared<const SyntaxTree>(std::move(buffer), tree, lang);
+    trees_.set(path, parsed);
+    return parsed;
+}
+
+void ASTCache::invalidate(const std::string& path) {
+    trees_.erase(path);
+}
+
+ASTCacheStats ASTCache::stats() const {
+    return {trees_.stats(),
+            full_parses_.load(std::memory_order_relaxed),
+            incremental_parses_.load(std::memory_order_relaxed)};
+}
+
 bool ASTBooster::validate_syntax(const std::string& content, const std::string& extension) {
-    const TSLanguage* lang = get_lang(extension);
+    const TSLanguage* lang = language_for_extension(extension);
     if (!lang) return true;
 
-    ts_parser_set_language(parser_, lang);
-    TSTree* tree = ts_parser_parse_string(parser_, nullptr, content.c_str(), (uint32_t)content.length());
-    
+    TSTree* tree = ts_parser_parse_string(thread_parser(lang), nullptr, content.c_str(), (uint32_t)content.length());
+    if (!tree) return false;
+
     TSNode root = ts_tree_root_node(tree);
     bool has_error = ts_node_has_error(root);
     
@@ -43,59 +149,413 @@ bool ASTBooster::validate_syntax(const std::string& content, const std::string&
     return !has_error;
 }
 
+bool ASTBooster::validate_file_syntax(const std::string& path, const std::string& content) {
+    if (!language_for_extension(std::filesystem::path(path).extension().string())) return true;
+    auto tree = ASTCache::instance().parse(path, content);
+    return tree && !tree->has_error();
+}
+
+// --- SYMBOL EXTRACTION ---
+
+namespace {
+
+// 🔎 One query per grammar. Captures: @definition.function / @definition.class mark a
+// definition and @name its identifier; @import is a module path, @call a callee name.
+constexpr const char* CPP_QUERY = R"scm(
+(function_definition declarator: (function_declarator declarator: (_) @name)) @definition.function
+(function_definition declarator: (pointer_declarator declarator: (function_declarator declarator: (_) @name))) @definition.function
+(function_definition declarator: (reference_declarator (function_declarator declarator: (_) @name))) @definition.function
+(class_specifier name: (_) @name body: (field_declaration_list)) @definition.class
+(struct_specifier name: (_) @name body: (field_declaration_list)) @definition.class
+(preproc_include path: (_) @import)
+(call_expression function: (identifier) @call)
+(call_expression function: (field_expression field: (field_identifier) @call))
+(call_expression function: (qualified_identifier name: (identifier) @call))
+)scm";
+
+constexpr const char* PYTHON_QUERY = R"scm(
+(function_definition name: (identifier) @name) @definition.function
+(class_definition name: (identifier) @name) @definition.class
+(import_statement name: (dotted_name) @import)
+(import_statement name: (aliased_import name: (dotted_name) @import))
+(import_from_statement module_name: (_) @import)
+(call function: (identifier) @call)
+(call function: (attribute attribute: (identifier) @call))
+)scm";
+
+constexpr const char* TYPESCRIPT_QUERY = R"scm(
+(function_declaration name: (identifier) @name) @definition.function
+(method_definition name: (property_identifier) @name) @definition.function
+(class_declaration name: (type_identifier) @name) @definition.class
+(abstract_class_declaration name: (type_identifier) @name) @definition.class
+(interface_declaration name: (type_identifier) @name) @definition.class
+(lexical_declaration (variable_declarator name: (identifier) @name value: (arrow_function))) @definition.function
+(import_statement source: (string) @import)
+(call_expression function: (identifier) @call)
+(call_expression function: (member_expression property: (property_identifier) @call))
+)scm";
+
+enum class Capture : uint8_t { Other, Name, Function, Class, Import, Call };
+
+struct SymbolQuery {
+    TSQuery* query = nullptr;
+    std::vector<Capture> captures; // By capture id
+    bool python = false;
+    bool cpp = false;
+};
+
+// Compiled on first use per grammar and shared: a TSQuery is immutable once built.
+// A pattern naming a node type this grammar version lacks is dropped (and logged) rather
+// than sinking the whole query; nullptr only when no pattern survives.
+const SymbolQuery* symbol_query(const TSLanguage* lang) {
+    static std::mutex mutex;
+    static std::unordered_map<const TSLanguage*, std::unique_ptr<SymbolQuery>> compiled;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = compiled.find(lang);
+    if (it != compiled.end()) return it->second ? it->second.get() : nullptr;
+
+    auto q = std::make_unique<SymbolQuery>();
+    const char* source = nullptr;
+    if (lang == tree_sitter_cpp()) { source = CPP_QUERY; q->cpp = true; }
+    else if (lang == tree_sitter_python()) { source = PYTHON_QUERY; q->python = true; }
+    else if (lang == tree_sitter_typescript()) source = TYPESCRIPT_QUERY;
+
+    std::string patterns = source ? source : "";
+    while (!q->query && patterns.find('(') != std::string::npos) {
+        uint32_t error_offset = 0;
+        TSQueryError error = TSQueryErrorNone;
+        q->query = ts_query_new(lang, patterns.data(), static_cast<uint32_t>(patterns.size()), &error_offset, &error);
+        if (q->query) break;
+
+        // One pattern per line: cut the line holding the error and retry
+        size_t line_start = patterns.rfind('\n', std::min<size_t>(error_offset, patterns.size() - 1));
+        line_start = line_start == std::string::npos ? 0 : line_start + 1;
+        size_t line_end = patterns.find('\n', line_start);
+        if (line_end == std::string::npos) line_end = patterns.size();
+        if (line_end <= line_start) break;
+        spdlog::warn("⚠️ Symbol query pattern dropped (error {}): {}", (int)error,
+                     patterns.substr(line_start, line_end - line_start));
+        patterns.erase(line_start, line_end - line_start);
+    }
+    if (!q->query) {
+        if (source) spdlog::error("❌ No symbol query for this grammar; using the bracket scanner");
+        compiled.emplace(lang, nullptr);
+        return nullptr;
+    }
+
+    uint32_t capture_count = ts_query_capture_count(q->query);
+    for (uint32_t id = 0; id < capture_count; ++id) {
+        uint32_t length = 0;
+        const char* name = ts_query_capture_name_for_id(q->query, id, &length);
+        std::string_view n(name, length);
+        q->captures.push_back(n == "name" ? Capture::Name
+                            : n == "definition.function" ? Capture::Function
+                            : n == "definition.class" ? Capture::Class
+                            : n == "import" ? Capture::Import
+                            : n == "call" ? Capture::Call : Capture::Other);
+    }
+    return (compiled[lang] = std::move(q)).get();
+}
+
+TSQueryCursor* thread_cursor() {
+    struct CursorDeleter { void operator()(TSQueryCursor* c) const { ts_query_cursor_delete(c); } };
+    thread_local std::unique_ptr<TSQueryCursor, CursorDeleter> cursor(ts_query_cursor_new());
+    return cursor.get();
+}
+
+std::string_view text_of(TSNode node, std::string_view src) {
+    return src.substr(ts_node_start_byte(node), ts_node_end_byte(node) - ts_node_start_byte(node));
+}
+
+// Template, export and decorator wrappers belong to the definition they wrap
+TSNode outer_of(TSNode node) {
+    for (;;) {
+        TSNode parent = ts_node_parent(node);
+        if (ts_node_is_null(parent)) return node;
+        std::string_view type = ts_node_type(parent);
+        if (type != "template_declaration" && type != "export_statement" && type != "decorated_definition") return node;
+        node = parent;
+    }
+}
+
+// Python: the body's leading string. Elsewhere: the comments directly above the definition.
+std::string docstring_of(TSNode def, TSNode outer, std::string_view src, bool python) {
+    if (python) {
+        TSNode body = ts_node_child_by_field_name(def, "body", 4);
+        if (ts_node_is_null(body) || ts_node_named_child_count(body) == 0) return {};
+        TSNode first = ts_node_named_child(body, 0);
+        if (std::string_view(ts_node_type(first)) != "expression_statement" || ts_node_named_child_count(first) == 0) return {};
+        TSNode str = ts_node_named_child(first, 0);
+        if (std::string_view(ts_node_type(str)) != "string") return {};
+        std::string_view text = text_of(str, src);
+        size_t quote = text.find_first_of("\"'");
+        if (quote == std::string_view::npos) return {};
+        size_t width = text.compare(quote, 3, std::string(3, text[quote])) == 0 ? 3 : 1;
+        if (text.size() < quote + 2 * width) return {};
+        return std::string(text.substr(quote + width, text.size() - quote - 2 * width));
+    }
+
+    uint32_t start = ts_node_start_byte(outer);
+    uint32_t first = start;
+    for (TSNode prev = ts_node_prev_named_sibling(outer); !ts_node_is_null(prev); prev = ts_node_prev_named_sibling(prev)) {
+        if (std::string_view(ts_node_type(prev)) != "comment") break;
+        std::string_view gap = src.substr(ts_node_end_byte(prev), first - ts_node_end_byte(prev));
+        if (std::count(gap.begin(), gap.end(), '\n') > 1 ||
+            gap.find_first_not_of(" \t\r\n") != std::string_view::npos) break; // A blank line detaches it
+        first = ts_node_start_byte(prev);
+    }
+    if (first == start) return {};
+    std::string_view block = src.substr(first, start - first);
+    while (!block.empty() && std::isspace(static_cast<unsigned char>(block.back()))) block.remove_suffix(1);
+    return std::string(block);
+}
+
+// Declaration line of a definition: everything before its body, whitespace collapsed
+std::string signature_of(TSNode def, std::string_view src) {
+    constexpr size_t MAX_SIGNATURE = 240;
+    uint32_t start = ts_node_start_byte(def);
+    TSNode body = ts_node_child_by_field_name(def, "body", 4);
+    std::string_view head = src.substr(start, (ts_node_is_null(body) ? ts_node_end_byte(def) : ts_node_start_byte(body)) - start);
+    if (ts_node_is_null(body)) head = head.substr(0, head.find('\n'));
+
+    std::string sig;
+    sig.reserve(std::min(head.size(), MAX_SIGNATURE));
+    for (char c : head) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            if (!sig.empty() && sig.back() != ' ') sig += ' ';
+        } else {
+            sig += c;
+        }
+        if (sig.size() >= MAX_SIGNATURE) break;
+    }
+    sig.resize(Utf8::floor_boundary(sig, MAX_SIGNATURE)); // The cap may split a code point
+    while (!sig.empty() && sig.back() == ' ') sig.pop_back();
+    return sig;
+}
+
+void add_path(std::unordered_set<std::string>& out, const std::filesystem::path& p) {
+    std::string s = p.lexically_normal().generic_string();
+    if (!s.empty() && s.rfind("..", 0) != 0 && s[0] != '/') out.insert(std::move(s));
+}
+
+// 🔗 Project-relative paths an import may name: the graph keeps whichever is a real file node
+void resolve_import(std::string_view raw, const std::filesystem::path& dir, bool cpp, bool python,
+                    std::unordered_set<std::string>& out) {
+    namespace fs = std::filesystem;
+    auto trim = [&](std::string_view chars) {
+        while (!raw.empty() && chars.find(raw.front()) != std::string_view::npos) raw.remove_prefix(1);
+        while (!raw.empty() && chars.find(raw.back()) != std::string_view::npos) raw.remove_suffix(1);
+    };
+
+    if (cpp) {
+        trim("\"<> ");
+        if (raw.empty()) return;
+        fs::path p{std::string(raw)};
+        add_path(out, dir / p);
+        add_path(out, p);
+        add_path(out, fs::path("include") / p);
+        return;
+    }
+
+    if (python) {
+        size_t dots = 0;
+        while (dots < raw.size() && raw[dots] == '.') dots++;
+        std::string module(raw.substr(dots));
+        std::replace(module.begin(), module.end(), '.', '/');
+        fs::path base;
+        if (dots > 0) {
+            base = dir;
+            for (size_t i = 1; i < dots; ++i) base = base.parent_path();
+        }
+        if (!module.empty()) base /= module;
+        if (base.empty()) return;
+        add_path(out, fs::path(base.string() + ".py"));
+        add_path(out, base / "__init__.py");
+        return;
+    }
+
+    trim("\"'` ");
+    if (raw.empty() || raw[0] != '.') return; // Packages live outside the project
+    fs::path base = dir / std::string(raw);
+    for (const char* suffix : {"", ".ts", ".tsx", ".js", ".jsx"}) add_path(out, fs::path(base.string() + suffix));
+    add_path(out, base / "index.ts");
+    add_path(out, base / "index.js");
+}
+
+std::string_view simple_name(std::string_view name) {
+    size_t cut = name.find_last_of(":.");
+    return cut == std::string_view::npos ? name : name.substr(cut + 1);
+}
+
+} // namespace
+
 std::vector<CodeNode> ASTBooster::extract_symbols(const std::string& path, const std::string& content) {
-    std::vector<CodeNode> nodes;
-    std::string ext = std::filesystem::path(path).extension().string();
-    const TSLanguage* lang = get_lang(ext);
-    if (!lang) return {};
+    if (!language_for_extension(std::filesystem::path(path).extension().string())) return {};
+    return extract_symbols(path, std::make_shared<const std::string>(content));
+}
 
-    ts_parser_set_language(parser_, lang);
-    TSTree* tree = ts_parser_parse_string(parser_, nullptr, content.c_str(), (uint32_t)content.length());
-    TSNode root = ts_tree_root_node(tree);
+std::vector<CodeNode> ASTBooster::extract_symbols(const std::string& path, std::shared_ptr<const std::string> source) {
+    auto tree = ASTCache::instance().parse(path, std::move(source));
+    if (!tree) return {};
+    const SymbolQuery* query = symbol_query(tree->language());
+    if (!query) return {};
+    // An unchanged file hands back the cached tree: its buffer is the one nodes share
+    const auto& buffer = tree->source_buffer();
+    std::string_view src = *buffer;
 
-    // 🚀 THE ELITE FIX: Recursive Stack Walker
-    std::stack<TSNode> traversal_stack;
-    traversal_stack.push(root);
-
-    while (!traversal_stack.empty()) {
-        TSNode node = traversal_stack.top();
-        traversal_stack.pop();
-
-        std::string type = ts_node_type(node);
-        
-        // Target: Functions, Classes, and Methods (Nested)
-        if (type == "function_definition" || type == "class_specifier" || 
-            type == "method_definition" || type == "function_item" || type == "struct_specifier") {
-            
-            CodeNode info;
-            info.name = "unnamed_symbol";
-            info.type = type;
-            info.file_path = path;
-
-            // Extract the identifier (name) of the node
-            uint32_t child_count = ts_node_child_count(node);
-            for (uint32_t i = 0; i < child_count; i++) {
-                TSNode child = ts_node_child(node, i);
-                std::string c_type = ts_node_type(child);
-                if (c_type == "identifier" || c_type == "field_identifier" || c_type == "type_identifier") {
-                    uint32_t start = ts_node_start_byte(child);
-                    uint32_t end = ts_node_end_byte(child);
-                    info.name = content.substr(start, end - start);
+    struct Definition {
+        TSNode node;
+        TSNode outer;
+        std::string_view name;
+        bool is_class = false;
+        int parent = -1;
+        std::string qualified;
+    };
+    std::vector<Definition> defs;
+    std::vector<std::pair<uint32_t, std::string_view>> calls; // (byte, callee)
+    std::unordered_set<std::string> imports;
+    const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+
+    TSQueryCursor* cursor = thread_cursor();
+    ts_query_cursor_exec(cursor, query->query, tree->root());
+    TSQueryMatch match;
+    while (ts_query_cursor_next_match(cursor, &match)) {
+        Definition def{};
+        bool has_def = false, has_name = false;
+        for (uint16_t i = 0; i < match.capture_count; ++i) {
+            const TSQueryCapture& c = match.captures[i];
+            Capture kind = c.index < query->captures.size() ? query->captures[c.index] : Capture::Other;
+            switch (kind) {
+                case Capture::Function:
+                case Capture::Class:
+                    def.node = c.node;
+                    def.is_class = kind == Capture::Class;
+                    has_def = true;
+                    break;
+                case Capture::Name:
+                    def.name = text_of(c.node, src);
+                    has_name = true;
+                    break;
+                case Capture::Import:
+                    resolve_import(text_of(c.node, src), dir, query->cpp, query->python, imports);
+                    break;
+                case Capture::Call:
+                    calls.emplace_back(ts_node_start_byte(c.node), text_of(c.node, src));
+                    break;
+                default:
                     break;
-                }
             }
-            nodes.push_back(info);
         }
+        if (has_def && has_name && !def.name.empty()) {
+            def.outer = outer_of(def.node);
+            defs.push_back(std::move(def));
+        }
+    }
+
+    // Document order, enclosing definitions first; parents come from a stack of open ranges
+    std::sort(defs.begin(), defs.end(), [](const Definition& a, const Definition& b) {
+        uint32_t sa = ts_node_start_byte(a.node), sb = ts_node_start_byte(b.node);
+        return sa != sb ? sa < sb : ts_node_end_byte(a.node) > ts_node_end_byte(b.node);
+    });
+    const char* sep = query->cpp ? "::" : ".";
+    std::vector<int> open;
+    std::unordered_map<std::string, int> id_uses;
+    std::unordered_map<std::string_view, std::vector<size_t>> by_name;
+    std::vector<CodeNode> nodes;
+    nodes.reserve(defs.size() + 1);
+    std::vector<std::string> heads;
+    heads.reserve(defs.size());
+
+    for (size_t i = 0; i < defs.size(); ++i) {
+        Definition& d = defs[i];
+        uint32_t start = ts_node_start_byte(d.node);
+        while (!open.empty() && ts_node_end_byte(defs[open.back()].node) <= start) open.pop_back();
+        d.parent = open.empty() ? -1 : open.back();
+        open.push_back(static_cast<int>(i));
+
+        // Out-of-line C++ members already carry their scope
+        bool scoped = d.name.find("::") != std::string_view::npos;
+        d.qualified = (d.parent < 0 || scoped) ? std::string(d.name) : defs[d.parent].qualified + sep + std::string(d.name);
+
+        CodeNode node;
+        node.name = d.qualified;
+        node.id = path + "::" + d.qualified;
+        int uses = ++id_uses[node.id];
+        if (uses > 1) node.id += "~" + std::to_string(uses); // Overloads
+        node.file_path = path;
+        node.type = d.is_class ? "class" : "function";
+        node.set_source(buffer, ts_node_start_byte(d.outer), ts_node_end_byte(d.outer) - ts_node_start_byte(d.outer));
+        node.docstring = docstring_of(d.node, d.outer, src, query->python);
+        heads.push_back(signature_of(d.node, src));
+        node.signatures = heads.back();
+        double weight = d.is_class ? 0.8 : 0.7;
+        node.weights = {{"structural", weight}};
+        node.structural_weight = static_cast<float>(weight);
+        node.dependencies = imports;
+        by_name[simple_name(d.name)].push_back(i);
+        nodes.push_back(std::move(node));
+    }
+
+    // Calls resolve to definitions in this file, attributed to the innermost enclosing one
+    for (const auto& [byte, callee] : calls) {
+        auto named = by_name.find(callee);
+        if (named == by_name.end()) continue;
+        auto after = std::upper_bound(defs.begin(), defs.end(), byte, [](uint32_t b, const Definition& d) {
+            return b < ts_node_start_byte(d.node);
+        });
+        int owner = static_cast<int>(after - defs.begin()) - 1;
+        while (owner >= 0 && ts_node_end_byte(defs[owner].node) <= byte) owner = defs[owner].parent;
+        if (owner < 0) continue;
+        for (size_t target : named->second) {
+            if (static_cast<int>(target) != owner) nodes[owner].dependencies.insert(nodes[target].id);
+        }
+    }
 
-        // Add children to stack
-        uint32_t count = ts_node_child_count(node);
-        for (uint32_t i = 0; i < count; i++) {
-            traversal_stack.push(ts_node_child(node, i));
+    // 🧾 Each definition lists the declarations nested in it, the file node all of them
+    constexpr size_t MAX_SIGNATURE_LINES = 64;
+    std::vector<size_t> lines(defs.size(), 1);
+    std::string file_signatures;
+    for (size_t i = 0; i < defs.size(); ++i) {
+        for (int a = defs[i].parent; a >= 0; a = defs[a].parent) {
+            if (lines[a] >= MAX_SIGNATURE_LINES) continue;
+            nodes[a].signatures += '\n';
+            nodes[a].signatures += heads[i];
+            lines[a]++;
+        }
+        if (i < MAX_SIGNATURE_LINES) {
+            if (!file_signatures.empty()) file_signatures += '\n';
+            file_signatures += heads[i];
         }
     }
-    
-    ts_tree_delete(tree);
+
+    CodeNode file_node;
+    file_node.name = std::filesystem::path(path).filename().string();
+    file_node.file_path = path;
+    file_node.id = path;
+    file_node.set_source(buffer, 0, src.size());
+    file_node.type = "file";
+    file_node.signatures = std::move(file_signatures);
+    file_node.weights = {{"structural", 1.0}};
+    file_node.structural_weight = 1.0f;
+    file_node.dependencies = std::move(imports);
+    nodes.push_back(std::move(file_node));
     return nodes;
 }
 
-} // namespace code_assistance::elite
\ No newline at end of file
+} // namespace code_assistance::elite
+
+namespace code_assistance {
+
+std::vector<CodeNode> CodeParser::extract_nodes_from_file(const std::string& file_path, std::shared_ptr<const std::string> source) {
+    if (!source) return {};
+    auto nodes = elite::ASTBooster().extract_symbols(file_path, source);
+    if (!nodes.empty()) return nodes;
+    return extract_nodes_fallback(file_path, source);
+}
+
+std::vector<CodeNode> CodeParser::extract_nodes_from_file(const std::string& file_path, const std::string& content) {
+    return extract_nodes_from_file(file_path, std::make_shared<const std::string>(content));
+}
+
+} // namespace code_assistance
@@ -0,0 +1,42 @@
+#include "project_retrieval.hpp"
+#include <spdlog/spdlog.h>
+
+namespace code_assistance {
+
+ProjectRetrieval::ProjectRetrieval(ProjectStores& stores, std::shared_ptr<EmbeddingService> ai, RetrievalCacheOptions cache)
+    : stores_(stores), ai_(std::move(ai)), cache_options_(cache) {}
+
+std::shared_ptr<RetrievalEngine> ProjectRetrieval::engine_for(const std::string& project_id,
+                                                              const ProjectStores::Handle& store) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = engines_[project_id];
+    if (!entry.engine || entry.store.lock() != store) {
+        // Non-owning: the caller's handle keeps the store alive for every use of the engine
+        std::shared_ptr<FaissVectorStore> unowned(std::shared_ptr<FaissVectorStore>(), store.get());
+        entry.store = store;
+        entry.engine = std::make_shared<RetrievalEngine>(std::move(unowned), cache_options_);
+    }
+    return entry.engine;
+}
+
+ProjectAnswer ProjectRetrieval::retrieve(const std::string& project_id, const std::string& local_root,
+                                         const std::string& storage_path, const ProjectQuery& query) {
+    ProjectAnswer answer;
+    answer.store = stores_.acquire(project_id, local_root, storage_path);
+    auto engine = engine_for(project_id, answer.store);
+
+    if (auto hits = engine->retrieve_lexical(query.query, query.max_nodes, query.use_graph, query.opts)) {
+        answer.results = std::move(*hits);
+        answer.lexical = true;
+    } else {
+        std::vector<float> embedding = ai_->generate_embedding(query.query);
+        answer.results = engine->retrieve(query.query, embedding, query.max_nodes, query.use_graph, query.opts);
+    }
+    spdlog::debug("🧭 [{}] {} nodes for \"{}\"{}", project_id, answer.results.size(), query.query,
+                  answer.lexical ? " (lexical)" : "");
+
+    if (query.max_chars > 0) answer.context = engine->build_hierarchical_context(answer.results, query.max_chars);
+    return answer;
+}
+
+} // namespace code_assistance
@@ -0,0 +1,187 @@
+#include "project_stores.hpp"
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+namespace code_assistance {
+
+namespace fs = std::filesystem;
+
+ProjectStores::ProjectStores(ProjectStoresOptions options)
+    : slots_(std::make_shared<const SlotMap>()), budget_(options.memory_budget_bytes), dimension_(options.dimension) {}
+
+std::shared_ptr<ProjectStores::Slot> ProjectStores::find_slot(const std::string& project_id) const {
+    auto map = slots_.load(std::memory_order_acquire);
+    auto it = map->find(project_id);
+    return it == map->end() ? nullptr : it->second;
+}
+
+std::shared_ptr<ProjectStores::Slot> ProjectStores::slot_for(const std::string& project_id, const std::string& local_root,
+                                                             const std::string& storage_path) {
+    if (auto slot = find_slot(project_id)) return slot;
+
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    auto current = slots_.load(std::memory_order_acquire);
+    auto it = current->find(project_id);
+    if (it != current->end()) return it->second; // Raced with another first lookup
+
+    auto slot = std::make_shared<Slot>();
+    slot->local_root = local_root;
+    slot->storage_path = storage_path;
+    auto next = std::make_shared<SlotMap>(*current);
+    next->emplace(project_id, slot);
+    slots_.store(std::move(next), std::memory_order_release);
+    return slot;
+}
+
+ProjectStores::Handle ProjectStores::open(const std::string& local_root, const std::string& storage_path) const {
+    fs::path store_dir = fs::path(storage_path) / "vector_store";
+    auto store = std::make_shared<FaissVectorStore>(dimension_, IndexConfig::load_for_project(local_root));
+    if (FaissVectorStore::exists(store_dir.string())) store->load(store_dir.string());
+    return store;
+}
+
+// The segments are read into memory; nodes.bin is mmap'd but its pages count once touched
+uint64_t ProjectStores::footprint(const std::string& storage_path) {
+    fs::path store_dir = fs::path(storage_path) / "vector_store";
+    uint64_t total = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(store_dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != ".index" && it->path().filename() != "nodes.bin") continue;
+        std::error_code size_ec;
+        auto size = it->file_size(size_ec);
+        if (!size_ec) total += size;
+    }
+    return total;
+}
+
+// Caller holds slot.load_mutex
+void ProjectStores::install(Slot& slot, Handle store) {
+    slot.bytes.store(footprint(slot.storage_path), std::memory_order_relaxed);
+    Handle previous = slot.store.exchange(std::move(store), std::memory_order_acq_rel);
+    if (previous) swaps_.fetch_add(1, std::memory_order_relaxed);
+}
+
+ProjectStores::Handle ProjectStores::acquire(const std::string& project_id, const std::string& local_root,
+                                             const std::string& storage_path) {
+    auto slot = slot_for(project_id, local_root, storage_path);
+    if (auto store = slot->store.load(std::memory_order_acquire)) {
+        touch(*slot);
+        return store;
+    }
+
+    Handle store;
+    {
+        std::lock_guard<std::mutex> lock(slot->load_mutex);
+        store = slot->store.load(std::memory_order_acquire);
+        if (!store) {
+            slot->local_root = local_root;
+            slot->storage_path = storage_path;
+            store = open(local_root, storage_path);
+            install(*slot, store);
+            loads_.fetch_add(1, std::memory_order_relaxed);
+            spdlog::info("🗂️ [{}] Vector store loaded ({} nodes)", project_id, store->size());
+        }
+    }
+    touch(*slot);
+    enforce_budget(slot.get());
+    return store;
+}
+
+ProjectStores::Handle ProjectStores::find(const std::string& project_id) const {
+    auto slot = find_slot(project_id);
+    if (!slot) return nullptr;
+    auto store = slot->store.load(std::memory_order_acquire);
+    if (store) touch(*slot);
+    return store;
+}
+
+bool ProjectStores::reload(const std::string& project_id, const std::string& local_root, const std::string& storage_path) {
+    if (!FaissVectorStore::exists((fs::path(storage_path) / "vector_store").string())) return false;
+    Handle fresh = open(local_root, storage_path); // Readers keep using the live version meanwhile
+    publish(project_id, local_root, storage_path, std::move(fresh));
+    return true;
+}
+
+void ProjectStores::publish(const std::string& project_id, const std::string& local_root, const std::string& storage_path,
+                            Handle store) {
+    auto slot = slot_for(project_id, local_root, storage_path);
+    {
+        std::lock_guard<std::mutex> lock(slot->load_mutex);
+        slot->local_root = local_root;
+        slot->storage_path = storage_path;
+        install(*slot, std::move(store));
+    }
+    touch(*slot);
+    spdlog::info("🗂️ [{}] Vector store version published", project_id);
+    enforce_budget(slot.get());
+}
+
+void ProjectStores::saved(const std::string& project_id) {
+    auto slot = find_slot(project_id);
+    if (!slot) return;
+    {
+        std::lock_guard<std::mutex> lock(slot->load_mutex);
+        slot->bytes.store(footprint(slot->storage_path), std::memory_order_relaxed);
+    }
+    enforce_budget(slot.get());
+}
+
+void ProjectStores::set_memory_budget(uint64_t bytes) {
+    budget_.store(bytes, std::memory_order_relaxed);
+    enforce_budget(nullptr);
+}
+
+// Drops the coldest stores until the resident total fits. A store someone still holds
+// is skipped: a writer mid-batch must not have its changes reloaded from under it.
+void ProjectStores::enforce_budget(const Slot* keep) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    auto map = slots_.load(std::memory_order_acquire);
+    const uint64_t budget = budget_.load(std::memory_order_relaxed);
+
+    uint64_t resident = 0;
+    for (const auto& [id, slot] : *map) {
+        if (slot->store.load(std::memory_order_acquire)) resident += slot->bytes.load(std::memory_order_relaxed);
+    }
+
+    while (resident > budget) {
+        const std::string* victim_id = nullptr;
+        Slot* victim = nullptr;
+        Handle victim_store;
+        for (const auto& [id, slot] : *map) {
+            if (slot.get() == keep) continue;
+            Handle store = slot->store.load(std::memory_order_acquire);
+            if (!store || store.use_count() > 2) continue; // Unloaded, or held beyond the slot and us
+            if (!victim || slot->last_used.load(std::memory_order_relaxed) < victim->last_used.load(std::memory_order_relaxed)) {
+                victim_id = &id;
+                victim = slot.get();
+                victim_store = std::move(store);
+            }
+        }
+        if (!victim) break; // Everything left is in use
+
+        if (!victim->store.compare_exchange_strong(victim_store, nullptr, std::memory_order_acq_rel)) continue;
+        uint64_t bytes = victim->bytes.load(std::memory_order_relaxed);
+        resident -= bytes < resident ? bytes : resident;
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+        spdlog::info("🗂️ [{}] Vector store unloaded ({} MB over budget)", *victim_id,
+                     (resident + bytes - budget) >> 20);
+    }
+}
+
+ProjectStoresStats ProjectStores::stats() const {
+    ProjectStoresStats s;
+    auto map = slots_.load(std::memory_order_acquire);
+    s.projects = map->size();
+    for (const auto& [id, slot] : *map) {
+        if (!slot->store.load(std::memory_order_acquire)) continue;
+        s.loaded++;
+        s.resident_bytes += slot->bytes.load(std::memory_order_relaxed);
+    }
+    s.budget_bytes = budget_.load(std::memory_order_relaxed);
+    s.loads = loads_.load(std::memory_order_relaxed);
+    s.evictions = evictions_.load(std::memory_order_relaxed);
+    s.swaps = swaps_.load(std::memory_order_relaxed);
+    return s;
+}
+
+} // namespace code_assistance
@@ -1,11 +1,18 @@
 #include "retrieval_engine.hpp"
-#include <deque>
+#include <string_view>
 #include <cmath>
 #include <algorithm>
+#include <numeric>
 #include <unordered_set>
+#include <unordered_map>
 #include <spdlog/spdlog.h>
 #include <chrono> 
+#include <limits>
+#include <optional>
+#include <memory_resource>
 #include "SystemMonitor.hpp" // Required for telemetry
+#include "RequestArena.hpp"
+#include "VectorKernels.hpp"
 
 namespace code_assistance {
 
@@ -13,129 +20,506 @@ std::vector<RetrievalResult> RetrievalEngine::retrieve(
     const std::string& query,
     const std::vector<float>& query_embedding,
     int max_nodes,
-    bool use_graph)
+    bool use_graph,
+    const SearchOptions& opts)
 {
-    // --- TELEMETRY START ---
-    auto start = std::chrono::high_resolution_clock::now();
+    size_t nq = (int)query_embedding.size() == vector_store_->dimension() ? 1 : 0;
+    RetrievalKey key = cache_key(query, query_embedding.data(), nq, max_nodes, use_graph, opts);
+    if (auto hit = cached(key, query_embedding.data(), nq)) return std::move(*hit);
 
-    // 1. Search (Get seeds)
-    auto seeds = vector_store_->search(query_embedding, 200); 
-    
-    // 2. Expand
-    auto expanded = exponential_graph_expansion(seeds, 200, 3, 0.5);
-    
-    // 3. Score
-    multi_dimensional_scoring(expanded);
-    
-    // 4. Sort and filter
-    std::sort(expanded.begin(), expanded.end(), [](const auto& a, const auto& b) {
-        return a.final_score > b.final_score;
-    });
+    auto results = retrieve_batched(query_embedding.data(), nq, lexical_hits(query, opts), max_nodes, opts);
+    remember(key, query_embedding.data(), nq, results);
+    return results;
+}
 
-    if (expanded.size() > max_nodes) {
-        expanded.resize(max_nodes);
+std::vector<RetrievalResult> RetrievalEngine::retrieve_multi(
+    const std::string& query,
+    const std::vector<std::vector<float>>& query_embeddings,
+    int max_nodes,
+    bool use_graph,
+    const SearchOptions& opts)
+{
+    const size_t dim = vector_store_->dimension();
+    std::pmr::vector<float> flat(RequestArena::resource());
+    flat.reserve(query_embeddings.size() * dim);
+    for (const auto& q : query_embeddings) {
+        if (q.size() == dim) flat.insert(flat.end(), q.begin(), q.end());
     }
+    const size_t nq = flat.size() / dim;
+    RetrievalKey key = cache_key(query, flat.data(), nq, max_nodes, use_graph, opts);
+    if (auto hit = cached(key, flat.data(), nq)) return std::move(*hit);
 
-    // --- TELEMETRY END ---
-    auto end = std::chrono::high_resolution_clock::now();
-    double duration = std::chrono::duration<double, std::milli>(end - start).count();
-    
-    // Update global atomic metric
-    SystemMonitor::global_vector_latency_ms.store(duration);
-    
-    spdlog::info("⏱️ Retrieval Pipeline Time: {:.2f} ms", duration);
-
-    return expanded;
+    auto results = retrieve_batched(flat.data(), nq, lexical_hits(query, opts), max_nodes, opts);
+    remember(key, flat.data(), nq, results);
+    return results;
 }
 
-std::string RetrievalEngine::build_hierarchical_context(
-    const std::vector<RetrievalResult>& candidates,
-    size_t max_chars)
+std::optional<std::vector<RetrievalResult>> RetrievalEngine::retrieve_lexical(
+    const std::string& query,
+    int max_nodes,
+    bool use_graph,
+    const SearchOptions& opts)
 {
-    std::string context;
-    std::unordered_set<std::string> included_files; 
+    if (!LexicalIndex::identifier_shaped(query)) return std::nullopt;
 
-    for (const auto& cand : candidates) {
+    // Only ever stored below, and only for an exact hit: a cached entry answers for the index
+    RetrievalKey key = cache_key(query, nullptr, 0, max_nodes, use_graph, opts);
+    key.embedding_hash = LEXICAL_ONLY;
+    if (auto hit = cached(key, nullptr, 0)) return hit;
 
-        if (included_files.count(cand.node->file_path)) {
-            continue; 
+    auto hits = lexical_hits(query, opts);
+    if (hits.empty() || !hits.front().exact) return std::nullopt;
+    auto results = retrieve_batched(nullptr, 0, hits, max_nodes, opts);
+    remember(key, nullptr, 0, results);
+    return results;
+}
+
+// --- RESULT CACHE ---
+
+RetrievalKey RetrievalEngine::cache_key(std::string_view query, const float* embeddings, size_t nq, int max_nodes,
+                                        bool use_graph, const SearchOptions& opts) const {
+    RetrievalKey key{};
+    key.version = vector_store_->version();
+    key.query_hash = NodeStore::hash_id(query);
+    key.max_nodes = max_nodes;
+    key.use_graph = use_graph;
+    key.opts = opts;
+
+    // FNV-1a over each embedding's int8 codes at unit scale
+    const size_t dim = static_cast<size_t>(vector_store_->dimension());
+    uint64_t h = 1469598103934665603ULL ^ nq;
+    for (size_t q = 0; q < nq; ++q) {
+        const float* v = embeddings + q * dim;
+        float norm = std::sqrt(dot_product(v, v, dim));
+        float scale = norm > 0.0f ? 127.0f / norm : 0.0f;
+        for (size_t d = 0; d < dim; ++d) {
+            h ^= static_cast<uint8_t>(static_cast<int8_t>(std::lround(v[d] * scale)));
+            h *= 1099511628211ULL;
         }
+    }
+    key.embedding_hash = h;
+    return key;
+}
 
-        if (cand.node->type == "file") {
-            included_files.insert(cand.node->file_path);
+std::optional<std::vector<RetrievalResult>> RetrievalEngine::cached(const RetrievalKey& key, const float* embeddings,
+                                                                    size_t nq) {
+    if (!cache_options_.enabled) return std::nullopt;
+    if (auto hits = cache_.get(key)) return resolve(*hits);
+    if (cache_options_.near_duplicate_cosine <= 0.0f || nq != 1) return std::nullopt;
+
+    // 🪞 A close paraphrase of a recent query: same parameters, nearly the same embedding
+    const size_t dim = static_cast<size_t>(vector_store_->dimension());
+    std::pmr::vector<float> unit(embeddings, embeddings + dim, RequestArena::resource());
+    normalize_rows(unit.data(), 1, dim);
+    std::optional<RetrievalKey> twin;
+    {
+        std::lock_guard<std::mutex> lock(recent_mutex_);
+        float best = cache_options_.near_duplicate_cosine;
+        for (const auto& r : recent_) {
+            if (!r.key.same_parameters(key)) continue;
+            float cosine = dot_product(unit.data(), r.unit.data(), dim);
+            if (cosine >= best) {
+                best = cosine;
+                twin = r.key;
+            }
         }
+    }
+    if (!twin) return std::nullopt;
+    if (auto hits = cache_.get(*twin)) {
+        spdlog::debug("🪞 Retrieval served from a near-duplicate query");
+        return resolve(*hits);
+    }
+    return std::nullopt;
+}
 
-        std::string entry = "\n\n# FILE: " + cand.node->file_path + 
-                            " | NODE: " + cand.node->name + 
-                            " (Type: " + cand.node->type + ")\n" +
-                            std::string(50, '-') + "\n" +
-                            cand.node->content + "\n" +
-                            std::string(50, '-') + "\n";
-        
-        if (context.length() + entry.length() > max_chars) {
-            break;
+void RetrievalEngine::remember(const RetrievalKey& key, const float* embeddings, size_t nq,
+                               const std::vector<RetrievalResult>& results) {
+    if (!cache_options_.enabled) return;
+    std::vector<CachedHit> hits;
+    hits.reserve(results.size());
+    for (const auto& r : results) {
+        hits.push_back({FaissVectorStore::stable_id(r.node->id), static_cast<float>(r.graph_score),
+                        static_cast<float>(r.final_score), r.distance});
+    }
+    cache_.set(key, hits);
+
+    if (cache_options_.near_duplicate_cosine <= 0.0f || nq != 1) return;
+    const size_t dim = static_cast<size_t>(vector_store_->dimension());
+    RecentQuery recent{key, std::vector<float>(embeddings, embeddings + dim)};
+    normalize_rows(recent.unit.data(), 1, dim);
+    std::lock_guard<std::mutex> lock(recent_mutex_);
+    // Entries of older versions can never match again
+    std::erase_if(recent_, [&](const RecentQuery& r) { return r.key.version != key.version; });
+    recent_.push_back(std::move(recent));
+    if (recent_.size() > RECENT_QUERIES) recent_.pop_front();
+}
+
+// Same version, so every label still resolves; nodes are materialized afresh
+std::vector<RetrievalResult> RetrievalEngine::resolve(const std::vector<CachedHit>& hits) const {
+    std::vector<RetrievalResult> results;
+    results.reserve(hits.size());
+    for (const auto& h : hits) {
+        if (auto node = vector_store_->get_node(h.label)) {
+            results.push_back({std::move(node), h.graph_score, h.final_score, h.distance});
         }
-        context += entry;
     }
-    return context;
+    return results;
 }
 
-std::vector<RetrievalResult> RetrievalEngine::exponential_graph_expansion(
-    const std::vector<FaissSearchResult>& seed_nodes,
-    int max_nodes,
-    int max_hops,
-    double alpha)
-{
-    spdlog::info("Starting graph expansion with {} seed nodes", seed_nodes.size());
+std::vector<LexicalHit> RetrievalEngine::lexical_hits(std::string_view query, const SearchOptions& opts) const {
+    if (query.empty()) return {};
+    auto lex = vector_store_->lexical();
+    return lex->search(query, opts.k > 0 ? opts.k : DEFAULT_SEED_K,
+                       [this](int64_t label) { return vector_store_->contains(label); });
+}
+
+namespace {
+
+struct Candidate {
+    int64_t label;
+    std::shared_ptr<CodeNode> node; // Orphans are materialized early, for their structural weight
+    float graph_score;
+    float structural;
+    int dist;
+    float final_score;
+};
 
-    std::unordered_map<std::string, RetrievalResult> visited;
-    std::deque<std::tuple<std::shared_ptr<CodeNode>, int, double>> queue;
+// Per-thread retrieval scratch, indexed by CsrGraph dense id (stamp/dist/score)
+// or by BFS order (queue/final/order). Epoch stamps make "clear visited" O(1),
+// so after warmup a query touches no allocator here.
+struct RetrievalScratch {
+    std::vector<uint32_t> stamp;
+    uint32_t epoch = 0;
+    std::vector<uint8_t> dist;
+    std::vector<float> score;
 
-    for (const auto& seed : seed_nodes) {
-        if (visited.find(seed.node->id) == visited.end()) {
-            visited[seed.node->id] = {seed.node, seed.faiss_score, 0.0, 0};
-            queue.emplace_back(seed.node, 0, seed.faiss_score);
+    std::vector<uint32_t> queue;
+    std::vector<float> final_score;
+    std::vector<uint32_t> order;
+    std::vector<std::pair<int64_t, float>> orphans; // Seeds newer than the graph snapshot
+    std::vector<std::pair<float, uint32_t>> ranked; // Vector seeds by score, for rank fusion
+
+    // Re-rank / MMR stage, indexed by pool position
+    std::vector<Candidate> pool;
+    std::vector<int64_t> pool_labels;
+    std::vector<float> vectors;   // pool x dim, unit rows (zero if the node has none)
+    std::vector<float> unit_queries;
+    std::vector<float> gram;      // pool x pool cosine similarities
+    std::vector<float> redundancy; // Max similarity to anything picked so far
+    std::vector<uint8_t> taken;
+    std::vector<uint32_t> picked;
+    FaissBatchResult batch;
+
+    void begin(size_t n) {
+        if (stamp.size() < n) {
+            stamp.assign(n, 0);
+            dist.resize(n);
+            score.resize(n);
+            epoch = 0;
+        }
+        if (++epoch == 0) { // Wrapped: stale stamps could alias
+            std::fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+        queue.clear();
+        orphans.clear();
+    }
+    bool visit(uint32_t u) {
+        if (stamp[u] == epoch) return false;
+        stamp[u] = epoch;
+        return true;
+    }
+};
+
+// Reciprocal rank fusion of the vector seeds already in s.queue/s.orphans with the
+// lexical hits: each list adds 1 / (K + rank). Exact name hits also count as a top
+// vector hit. Scores are rescaled so the best seed is 1, like a cosine match.
+void fuse_lexical(const CsrGraph& graph, RetrievalScratch& s, const std::vector<LexicalHit>& lexical, float k) {
+    s.ranked.clear();
+    for (size_t i = 0; i < s.queue.size(); ++i) s.ranked.emplace_back(s.score[s.queue[i]], static_cast<uint32_t>(i));
+    for (size_t j = 0; j < s.orphans.size(); ++j) s.ranked.emplace_back(s.orphans[j].second, static_cast<uint32_t>(s.queue.size() + j));
+    std::sort(s.ranked.begin(), s.ranked.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    const size_t queued = s.queue.size();
+    auto fused = [&](uint32_t slot) -> float& {
+        return slot < queued ? s.score[s.queue[slot]] : s.orphans[slot - queued].second;
+    };
+    for (size_t r = 0; r < s.ranked.size(); ++r) fused(s.ranked[r].second) = 1.0f / (k + r + 1);
+
+    for (size_t r = 0; r < lexical.size(); ++r) {
+        const LexicalHit& hit = lexical[r];
+        float add = 1.0f / (k + r + 1) + (hit.exact ? 1.0f / (k + 1) : 0.0f);
+        uint32_t u = graph.find(hit.label);
+        if (u == CsrGraph::NONE) {
+            auto it = std::find_if(s.orphans.begin(), s.orphans.end(), [&](const auto& o) { return o.first == hit.label; });
+            if (it != s.orphans.end()) it->second += add;
+            else s.orphans.emplace_back(hit.label, add);
+        } else if (s.visit(u)) {
+            s.dist[u] = 0;
+            s.score[u] = add;
+            s.queue.push_back(u);
+        } else {
+            s.score[u] += add; // Before expansion, visited means it is a vector seed
         }
     }
 
-    int scanned_count = visited.size(); 
+    float best = 0.0f;
+    for (uint32_t u : s.queue) best = std::max(best, s.score[u]);
+    for (const auto& o : s.orphans) best = std::max(best, o.second);
+    if (best <= 0.0f) return;
+    for (uint32_t u : s.queue) s.score[u] /= best;
+    for (auto& o : s.orphans) o.second /= best;
+}
+
+// Exact re-rank: a candidate scores at least its exact cosine to the nearest query, which
+// lifts graph neighbours that match the query better than their decayed score says.
+// Then Maximal Marginal Relevance over the pool: repeatedly pick the candidate with the
+// best lambda * relevance - (1 - lambda) * (max similarity to what is already picked), so
+// near-duplicates of a chosen chunk sink below distinct code. Fills s.picked (best first).
+void rerank_and_diversify(const FaissVectorStore& store, RetrievalScratch& s, const float* queries, size_t nq,
+                          size_t keep, float lambda) {
+    const size_t p = s.pool.size();
+    const size_t dim = static_cast<size_t>(store.dimension());
+    s.pool_labels.clear();
+    for (const auto& c : s.pool) s.pool_labels.push_back(c.label);
+    size_t with_vectors = store.exact_vectors(s.pool_labels.data(), p, s.vectors);
+    normalize_rows(s.vectors.data(), p, dim);
 
-    while (!queue.empty() && visited.size() < max_nodes) {
-        auto [curr, dist, base_score] = queue.front();
-        queue.pop_front();
+    if (nq > 0 && with_vectors > 0) {
+        s.unit_queries.assign(queries, queries + nq * dim);
+        normalize_rows(s.unit_queries.data(), nq, dim);
+        for (size_t i = 0; i < p; ++i) {
+            const float* v = s.vectors.data() + i * dim;
+            float best = s.pool[i].graph_score;
+            for (size_t q = 0; q < nq; ++q) best = std::max(best, dot_product(s.unit_queries.data() + q * dim, v, dim));
+            s.pool[i].graph_score = best;
+        }
+    }
+    float top = 0.0f;
+    for (auto& c : s.pool) {
+        c.final_score = c.graph_score * (0.8f + c.structural * 0.2f);
+        top = std::max(top, c.final_score);
+    }
 
+    const size_t count = std::min(keep, p);
+    s.picked.clear();
+    if (with_vectors < 2 || top <= 0.0f) { // Nothing to compare: plain score order
+        s.picked.resize(p);
+        std::iota(s.picked.begin(), s.picked.end(), 0u);
+        auto better = [&](uint32_t a, uint32_t b) { return s.pool[a].final_score > s.pool[b].final_score; };
+        std::partial_sort(s.picked.begin(), s.picked.begin() + count, s.picked.end(), better);
+        s.picked.resize(count);
+        return;
+    }
+
+    s.gram.resize(p * p);
+    gram_matrix(s.vectors.data(), p, dim, s.gram.data());
+    s.redundancy.assign(p, 0.0f);
+    s.taken.assign(p, 0);
+    const float inv_top = 1.0f / top;
+    while (s.picked.size() < count) {
+        size_t best = p;
+        float best_mmr = -std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < p; ++i) {
+            if (s.taken[i]) continue;
+            float mmr = lambda * s.pool[i].final_score * inv_top - (1.0f - lambda) * s.redundancy[i];
+            if (mmr > best_mmr) {
+                best_mmr = mmr;
+                best = i;
+            }
+        }
+        s.taken[best] = 1;
+        s.picked.push_back(static_cast<uint32_t>(best));
+        const float* sims = s.gram.data() + best * p;
+        for (size_t i = 0; i < p; ++i) s.redundancy[i] = std::max(s.redundancy[i], sims[i]);
+    }
+}
+
+// BFS over integer ids; scores decay by exp(-alpha * hops). Fills s.queue in visit order.
+int exponential_graph_expansion(const CsrGraph& graph, RetrievalScratch& s, size_t seed_count,
+                                int max_nodes, int max_hops, double alpha) {
+    size_t visited_count = seed_count + s.orphans.size();
+    int scanned_count = static_cast<int>(visited_count);
+    for (size_t head = 0; head < s.queue.size() && visited_count < (size_t)max_nodes; ++head) {
+        uint32_t curr = s.queue[head];
+        int dist = s.dist[curr];
         if (dist >= max_hops) continue;
 
-        for (const auto& dep_name : curr->dependencies) {
-            auto candidate_node = vector_store_->get_node_by_name(dep_name);
+        int new_dist = dist + 1;
+        float new_score = static_cast<float>(s.score[curr] * std::exp(-alpha * new_dist));
+        for (uint32_t v : graph.neighbors(curr)) {
+            scanned_count++;
+            if (!s.visit(v)) continue;
+            s.dist[v] = static_cast<uint8_t>(new_dist);
+            s.score[v] = new_score;
+            s.queue.push_back(v);
+            visited_count++;
+        }
+    }
+    return scanned_count;
+}
 
-            scanned_count++; 
+// SoA pass: final = graph_score * (0.8 + 0.2 * structural)
+void multi_dimensional_scoring(const CsrGraph& graph, RetrievalScratch& s) {
+    s.final_score.resize(s.queue.size());
+    for (size_t i = 0; i < s.queue.size(); ++i) {
+        uint32_t u = s.queue[i];
+        s.final_score[i] = s.score[u] * (0.8f + graph.structural[u] * 0.2f);
+    }
+}
+
+} // namespace
+
+std::vector<RetrievalResult> RetrievalEngine::retrieve_batched(const float* queries, size_t nq,
+                                                               const std::vector<LexicalHit>& lexical, int max_nodes,
+                                                               const SearchOptions& opts) {
+    // --- TELEMETRY START ---
+    StageSpan total(Stage::Retrieval);
+    thread_local RetrievalScratch s;
 
-            if (candidate_node && visited.find(candidate_node->id) == visited.end()) {
-                int new_dist = dist + 1;
-                double new_score = base_score * std::exp(-alpha * new_dist);
-                
-                visited[candidate_node->id] = {candidate_node, new_score, 0.0, new_dist};
-                queue.emplace_back(candidate_node, new_dist, new_score);
+    // 1. Search (Get seeds) - single FAISS call for all queries
+    std::optional<StageSpan> stage(std::in_place, Stage::RetrievalSearch);
+    vector_store_->search_batch_into(queries, nq, opts.k > 0 ? opts.k : DEFAULT_SEED_K, opts, s.batch);
+    stage.emplace(Stage::RetrievalExpand);
+
+    auto graph = vector_store_->adjacency();
+    s.begin(graph->size());
+
+    // Fuse per-query hits: a node seen by several queries keeps its best score
+    for (size_t q = 0; q < s.batch.nq; ++q) {
+        auto labels = s.batch.labels_of(q);
+        auto scores = s.batch.scores_of(q);
+        for (int i = 0; i < s.batch.k; ++i) {
+            if (labels[i] == -1) continue;
+            uint32_t u = graph->find(labels[i]);
+            if (u == CsrGraph::NONE) {
+                s.orphans.emplace_back(labels[i], scores[i]);
+            } else if (s.visit(u)) {
+                s.dist[u] = 0;
+                s.score[u] = scores[i];
+                s.queue.push_back(u);
+            } else {
+                s.score[u] = std::max(s.score[u], scores[i]);
             }
         }
     }
+    if (!lexical.empty()) fuse_lexical(*graph, s, lexical, RRF_K);
+    spdlog::info("Starting graph expansion with {} seed nodes ({} lexical hits)", s.queue.size() + s.orphans.size(),
+                 lexical.size());
+
+    // 2. Expand
+    int scanned = exponential_graph_expansion(*graph, s, s.queue.size(), 200, 3, 0.5);
+    SystemMonitor::global_graph_nodes_scanned.store(scanned);
+
+    // 3. Score
+    stage.emplace(Stage::RetrievalScore);
+    multi_dimensional_scoring(*graph, s);
+
+    // 4. Candidate pool: the best MMR_POOL by score (partial order only), plus orphan seeds
+    const size_t n = s.queue.size();
+    const size_t keep = static_cast<size_t>(std::max(0, max_nodes));
+    const size_t pooled = std::min(n, std::max(keep, MMR_POOL));
+    s.order.resize(n);
+    std::iota(s.order.begin(), s.order.end(), 0u);
+    auto by_score = [&](uint32_t a, uint32_t b) { return s.final_score[a] > s.final_score[b]; };
+    if (pooled < n) std::nth_element(s.order.begin(), s.order.begin() + pooled, s.order.end(), by_score);
+    s.pool.clear();
+    for (size_t i = 0; i < pooled; ++i) {
+        uint32_t u = s.queue[s.order[i]];
+        s.pool.push_back({graph->labels[u], nullptr, s.score[u], graph->structural[u], s.dist[u], 0.0f});
+    }
+    for (const auto& [label, score] : s.orphans) {
+        auto node = vector_store_->get_node(label);
+        if (!node) continue;
+        float structural = static_cast<float>(node->structural_weight);
+        s.pool.push_back({label, std::move(node), score, structural, 0, 0.0f});
+    }
 
-    SystemMonitor::global_graph_nodes_scanned.store(scanned_count);
-    
+    // 5. Exact re-rank, then MMR picks the order
+    rerank_and_diversify(*vector_store_, s, queries, nq, keep, MMR_LAMBDA);
+
+    // 6. Materialize only what is returned
     std::vector<RetrievalResult> results;
-    for(auto const& [key, val] : visited) {
-        results.push_back(val);
+    results.reserve(s.picked.size());
+    for (uint32_t i : s.picked) {
+        Candidate& c = s.pool[i];
+        auto node = c.node ? std::move(c.node) : vector_store_->get_node(c.label);
+        if (node) results.push_back({std::move(node), c.graph_score, c.final_score, c.dist});
     }
+    s.pool.clear(); // Drops the orphans' nodes; capacity stays
+    stage.reset();
     spdlog::info("✅ Graph expansion complete. {} nodes selected.", results.size());
+
+    // --- TELEMETRY END ---
+    double duration = total.stop();
+    spdlog::info("⏱️ Retrieval Pipeline Time: {:.2f} ms", duration);
+
     return results;
 }
 
-void RetrievalEngine::multi_dimensional_scoring(std::vector<RetrievalResult>& candidates) {
-    for (auto& c : candidates) {
-        double s_weight = c.node->weights.count("structural") ? c.node->weights["structural"] : 0.5;
-        c.final_score = c.graph_score * (0.8 + (s_weight * 0.2));
+std::string RetrievalEngine::build_hierarchical_context(
+    const std::vector<RetrievalResult>& candidates,
+    size_t max_chars)
+{
+    std::string context;
+    build_hierarchical_context_into(candidates, context, max_chars);
+    return context;
+}
+
+size_t RetrievalEngine::build_hierarchical_context_into(
+    const std::vector<RetrievalResult>& candidates,
+    std::string& out,
+    size_t max_chars)
+{
+    out.clear();
+    out.reserve(max_chars); // No-op once a reused buffer has grown
+    return stream_hierarchical_context(candidates, [&out](std::string_view chunk) {
+        out.append(chunk);
+        return true;
+    }, max_chars);
+}
+
+size_t RetrievalEngine::stream_hierarchical_context(
+    const std::vector<RetrievalResult>& candidates,
+    const ContextSink& sink,
+    size_t max_chars)
+{
+    static constexpr std::string_view RULE = "--------------------------------------------------\n"; // 50 dashes
+    StageSpan span(Stage::ContextBuild);
+
+    size_t written = 0;
+    // Views into the candidates' nodes, which outlive this call
+    std::pmr::unordered_set<std::string_view> included_files(RequestArena::resource());
+    included_files.reserve(candidates.size());
+
+    for (const auto& cand : candidates) {
+        const CodeNode& node = *cand.node;
+
+        if (included_files.count(node.file_path)) {
+            continue; 
+        }
+
+        if (node.type == "file") {
+            included_files.insert(node.file_path);
+        }
+
+        // Gather list for one entry; sized up front so the budget check needs no temporary
+        const std::string_view parts[] = {
+            "\n\n# FILE: ", node.file_path, " | NODE: ", node.name, " (Type: ", node.type, ")\n",
+            RULE, node.text(), "\n", RULE
+        };
+        size_t entry_len = 0;
+        for (auto p : parts) entry_len += p.size();
+
+        if (written + entry_len > max_chars) {
+            break;
+        }
+        for (auto p : parts) {
+            if (!sink(p)) return written; // Consumer went away (client disconnect, cancelled request)
+            written += p.size();
+        }
     }
+    return written;
 }
 
 } // namespace code_assistance
\ No newline at end of file
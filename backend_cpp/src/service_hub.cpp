@@ -0,0 +1,59 @@
+#include "service_hub.hpp"
+#include <algorithm>
+#include <thread>
+#include <spdlog/spdlog.h>
+#include "tools/FileSystemTools.hpp"
+#include "tools/FileSurgicalTool.hpp"
+
+namespace code_assistance {
+
+namespace {
+
+std::shared_ptr<EmbeddingProvider> make_provider(const ServiceHubOptions& options) {
+    if (!options.local_embeddings) return nullptr;
+    return std::make_shared<LocalEmbeddingProvider>(*options.local_embeddings);
+}
+
+ProjectStoresOptions sized_for(ProjectStoresOptions stores, const EmbeddingService& ai) {
+    stores.dimension = ai.embedding_dimension();
+    return stores;
+}
+
+} // namespace
+
+ServiceHub::ServiceHub(ServiceHubOptions options)
+    : thread_pool_(options.worker_threads ? options.worker_threads : std::max(4u, std::thread::hardware_concurrency())),
+      key_manager_(std::make_shared<KeyManager>()),
+      ai_service_(std::make_shared<EmbeddingService>(key_manager_, make_provider(options))),
+      stores_(sized_for(options.stores, *ai_service_)),
+      retrieval_(std::make_shared<ProjectRetrieval>(stores_, ai_service_)) {
+    if (!options.llm_base_url.empty()) ai_service_->set_base_url(options.llm_base_url);
+    if (!options.embedding_cache_path.empty()) ai_service_->cache_manager()->open_embedding_store(options.embedding_cache_path);
+
+    sub_agent_ = std::make_shared<SubAgent>();
+    tools_ = std::make_shared<ToolRegistry>();
+    tools_->set_thread_pool(&thread_pool_); // Read-only calls of one step run side by side
+    tools_->register_tool(std::make_unique<ReadFileTool>());
+    tools_->register_tool(std::make_unique<ListDirTool>());
+
+    executor_ = std::make_shared<AgentExecutor>(retrieval_, ai_service_, sub_agent_, tools_);
+}
+
+void ServiceHub::enable_editing_tools() {
+    std::call_once(editing_, [this] {
+        tools_->register_tool(std::make_unique<FileSurgicalTool>(
+            [this](const std::string& project_id, const std::string& rel_path) { notify_file_edited(project_id, rel_path); }));
+    });
+}
+
+void ServiceHub::set_file_edit_listener(FileEditListener listener) {
+    std::lock_guard<std::mutex> lock(edit_mutex_);
+    edit_listener_ = std::move(listener);
+}
+
+void ServiceHub::notify_file_edited(const std::string& project_id, const std::string& rel_path) {
+    std::lock_guard<std::mutex> lock(edit_mutex_); // Held across the call: clearing waits for it
+    if (edit_listener_) edit_listener_(project_id, rel_path);
+}
+
+} // namespace code_assistance
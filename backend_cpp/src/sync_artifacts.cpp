@@ -0,0 +1,463 @@
+#include "sync_artifacts.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace code_assistance {
+
+namespace {
+
+// index.bin: [IndexHeader][per file: u32 path length, path bytes, IndexEntry]
+constexpr char INDEX_MAGIC[8] = {'C', 'T', 'X', 'I', 'N', 'D', 'E', 'X'};
+constexpr uint32_t INDEX_VERSION = 1;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+struct IndexEntry {
+    uint32_t segment;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t hash;
+};
+
+constexpr std::string_view BLOCK_OPEN = "\n\n--- FILE: ";
+constexpr std::string_view BLOCK_CLOSE = " ---\n";
+
+bool parse_segment_name(const std::string& name, uint32_t& id) {
+    if (name.size() != 14 || name.compare(0, 4, "seg-") != 0 || name.compare(10, 4, ".txt") != 0) return false;
+    id = 0;
+    for (size_t i = 4; i < 10; ++i) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        id = id * 10 + static_cast<uint32_t>(name[i] - '0');
+    }
+    return true;
+}
+
+} // namespace
+
+// --- CONTEXT STORE ---
+
+ContextStore::~ContextStore() {
+    if (out_.is_open()) out_.close();
+}
+
+uint64_t ContextStore::block_size(std::string_view rel_path, uint64_t length) {
+    return BLOCK_OPEN.size() + rel_path.size() + BLOCK_CLOSE.size() + length + 1;
+}
+
+fs::path ContextStore::segment_path(uint32_t id) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg-%06u.txt", id);
+    return dir_ / name;
+}
+
+bool ContextStore::load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.clear();
+    segments_.clear();
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+
+    for (const auto& e : fs::directory_iterator(dir_, ec)) {
+        uint32_t id;
+        if (!parse_segment_name(e.path().filename().string(), id)) continue;
+        segments_[id].size = e.file_size(ec);
+    }
+
+    std::ifstream in(dir_ / "index.bin", std::ios::binary);
+    bool ok = true;
+    if (in) {
+        IndexHeader h{};
+        in.read(reinterpret_cast<char*>(&h), sizeof(h));
+        ok = in.good() && std::memcmp(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 && h.version == INDEX_VERSION;
+        std::string path;
+        for (uint64_t i = 0; ok && i < h.count; ++i) {
+            uint32_t len = 0;
+            IndexEntry entry{};
+            in.read(reinterpret_cast<char*>(&len), sizeof(len));
+            path.resize(len);
+            in.read(path.data(), len);
+            in.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+            auto seg = segments_.find(entry.segment);
+            ok = in.good() && seg != segments_.end() && entry.offset + entry.length < seg->second.size;
+            if (!ok) break;
+            seg->second.live += block_size(path, entry.length);
+            index_[path] = {entry.segment, entry.offset, entry.length, entry.hash};
+        }
+        if (!ok) {
+            // Every file then misses its hash and is appended again; old segments go at commit
+            spdlog::warn("⚠️ Context store: index in {} is damaged, rebuilding", dir_.string());
+            index_.clear();
+            for (auto& [id, seg] : segments_) seg.live = 0;
+        }
+    }
+
+    // Keep filling the newest segment while it has room
+    active_ = segments_.empty() ? 0 : segments_.rbegin()->first;
+    if (!segments_.empty() && segments_.rbegin()->second.size >= SEGMENT_LIMIT) active_++;
+    dirty_ = !ok;
+    written_ = 0;
+    return ok;
+}
+
+bool ContextStore::contains(std::string_view rel_path, uint64_t hash) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(std::string(rel_path));
+    return it != index_.end() && it->second.hash == hash;
+}
+
+bool ContextStore::put(const std::string& rel_path, uint64_t hash, std::string_view content) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(rel_path);
+    if (it != index_.end()) {
+        if (it->second.hash == hash) return true;
+        drop(it->second, rel_path);
+        index_.erase(it);
+    }
+    return append(rel_path, hash, content);
+}
+
+void ContextStore::remove(const std::string& rel_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(rel_path);
+    if (it == index_.end()) return;
+    drop(it->second, rel_path);
+    index_.erase(it);
+    dirty_ = true;
+}
+
+size_t ContextStore::retain(const std::unordered_set<std::string>& live) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t removed = 0;
+    for (auto it = index_.begin(); it != index_.end();) {
+        if (live.count(it->first)) {
+            ++it;
+            continue;
+        }
+        drop(it->second, it->first);
+        it = index_.erase(it);
+        removed++;
+    }
+    if (removed) dirty_ = true;
+    return removed;
+}
+
+std::optional<std::string> ContextStore::read(const std::string& rel_path) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(rel_path);
+    if (it == index_.end()) return std::nullopt;
+    const Location& loc = it->second;
+    if (loc.segment == active_) flush_active();
+
+    std::ifstream in(segment_path(loc.segment), std::ios::binary);
+    std::string content(loc.length, '\0');
+    in.seekg(static_cast<std::streamoff>(loc.offset));
+    in.read(content.data(), static_cast<std::streamsize>(loc.length));
+    if (!in.good()) return std::nullopt;
+    return content;
+}
+
+bool ContextStore::append(const std::string& rel_path, uint64_t hash, std::string_view content) {
+    const uint64_t bytes = block_size(rel_path, content.size());
+    if (!ensure_active(bytes)) return false;
+
+    Segment& seg = segments_[active_];
+    out_ << BLOCK_OPEN << rel_path << BLOCK_CLOSE;
+    out_.write(content.data(), static_cast<std::streamsize>(content.size()));
+    out_ << '\n';
+    if (!out_.good()) {
+        spdlog::error("❌ Context store: write to {} failed", segment_path(active_).string());
+        out_.close();
+        return false;
+    }
+
+    index_[rel_path] = {active_, seg.size + BLOCK_OPEN.size() + rel_path.size() + BLOCK_CLOSE.size(), content.size(), hash};
+    seg.size += bytes;
+    seg.live += bytes;
+    written_ += bytes;
+    dirty_ = true;
+    return true;
+}
+
+void ContextStore::drop(const Location& loc, std::string_view rel_path) {
+    auto seg = segments_.find(loc.segment);
+    if (seg == segments_.end()) return;
+    seg->second.live -= std::min(seg->second.live, block_size(rel_path, loc.length));
+}
+
+bool ContextStore::ensure_active(uint64_t incoming) {
+    Segment& seg = segments_[active_];
+    if (seg.size > 0 && seg.size + incoming > SEGMENT_LIMIT) {
+        out_.close();
+        active_ = segments_.rbegin()->first + 1;
+        segments_[active_];
+    }
+    if (out_.is_open()) return true;
+
+    out_.open(segment_path(active_), std::ios::binary | std::ios::app);
+    if (!out_.is_open()) {
+        spdlog::error("❌ Context store: cannot open {}", segment_path(active_).string());
+        return false;
+    }
+    return true;
+}
+
+void ContextStore::flush_active() const {
+    if (out_.is_open()) out_.flush();
+}
+
+bool ContextStore::compact(uint32_t id) {
+    std::vector<std::pair<std::string, Location>> moving;
+    for (const auto& [path, loc] : index_) {
+        if (loc.segment == id) moving.emplace_back(path, loc);
+    }
+
+    std::ifstream in(segment_path(id), std::ios::binary);
+    std::string content;
+    for (auto& [path, loc] : moving) {
+        content.resize(loc.length);
+        in.seekg(static_cast<std::streamoff>(loc.offset));
+        in.read(content.data(), static_cast<std::streamsize>(loc.length));
+        if (!in.good()) {
+            spdlog::error("❌ Context store: cannot read {} from {}", path, segment_path(id).string());
+            return false;
+        }
+        drop(loc, path);
+        if (!append(path, loc.hash, content)) return false;
+    }
+    return true;
+}
+
+bool ContextStore::commit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 1. Segments that are mostly superseded blocks move their live ones to the tail
+    std::vector<uint32_t> sparse;
+    for (const auto& [id, seg] : segments_) {
+        if (id != active_ && seg.live > 0 && seg.live * 2 < seg.size) sparse.push_back(id);
+    }
+    for (uint32_t id : sparse) {
+        if (!compact(id)) {
+            dirty_ = true;
+            break;
+        }
+    }
+
+    // 2. Publish: the index only ever points at flushed bytes
+    if (dirty_) {
+        flush_active();
+        if (!write_index()) return false;
+        dirty_ = false;
+    }
+
+    // 3. Nothing references these any more
+    for (auto it = segments_.begin(); it != segments_.end();) {
+        if (it->first == active_ || it->second.live > 0) {
+            ++it;
+            continue;
+        }
+        std::error_code ec;
+        fs::remove(segment_path(it->first), ec);
+        it = segments_.erase(it);
+    }
+    return true;
+}
+
+bool ContextStore::write_index() {
+    fs::path path = dir_ / "index.bin";
+    fs::path tmp = dir_ / "index.bin.tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            spdlog::error("❌ Context store: cannot write {}", tmp.string());
+            return false;
+        }
+        IndexHeader h{};
+        std::memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        h.version = INDEX_VERSION;
+        h.count = index_.size();
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        for (const auto& [p, loc] : index_) {
+            uint32_t len = static_cast<uint32_t>(p.size());
+            IndexEntry entry{loc.segment, 0, loc.offset, loc.length, loc.hash};
+            out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            out.write(p.data(), len);
+            out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        }
+        if (!out.good()) {
+            spdlog::error("❌ Context store: short write on {}", tmp.string());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        spdlog::error("❌ Context store: rename {} -> {} failed: {}", tmp.string(), path.string(), ec.message());
+        return false;
+    }
+    return true;
+}
+
+ContextStore::Stats ContextStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s;
+    s.files = index_.size();
+    s.segments = segments_.size();
+    for (const auto& [id, seg] : segments_) {
+        s.live_bytes += seg.live;
+        s.dead_bytes += seg.size - std::min(seg.size, seg.live);
+    }
+    s.written_bytes = written_;
+    return s;
+}
+
+// --- DIRECTORY TREE ---
+
+DirectoryTree::Entry* DirectoryTree::find(Dir& dir, std::string_view name) {
+    auto it = std::lower_bound(dir.entries.begin(), dir.entries.end(), name,
+                               [](const Entry& e, std::string_view n) { return e.name < n; });
+    return it != dir.entries.end() && it->name == name ? &*it : nullptr;
+}
+
+bool DirectoryTree::insert(std::string_view rel_path, uint32_t epoch) {
+    std::vector<Dir*> chain{&root_};
+    bool changed = false;
+    size_t start = 0;
+    while (start < rel_path.size()) {
+        size_t slash = rel_path.find('/', start);
+        const bool leaf = slash == std::string_view::npos;
+        std::string_view part = rel_path.substr(start, leaf ? std::string_view::npos : slash - start);
+        start = leaf ? rel_path.size() : slash + 1;
+        if (part.empty()) continue;
+
+        Dir& dir = *chain.back();
+        auto it = std::lower_bound(dir.entries.begin(), dir.entries.end(), part,
+                                   [](const Entry& e, std::string_view n) { return e.name < n; });
+        if (it == dir.entries.end() || it->name != part) {
+            it = dir.entries.insert(it, Entry{std::string(part), nullptr, epoch});
+            changed = true;
+        }
+        it->epoch = epoch;
+        // A path can switch between file and directory across syncs
+        if (leaf && it->dir) {
+            it->dir.reset();
+            changed = true;
+        } else if (!leaf && !it->dir) {
+            it->dir = std::make_unique<Dir>();
+            changed = true;
+        }
+        if (!leaf) chain.push_back(it->dir.get());
+    }
+    if (changed) {
+        for (Dir* d : chain) d->dirty = true;
+    }
+    return changed;
+}
+
+bool DirectoryTree::sweep(Dir& dir, uint32_t epoch) {
+    bool changed = false;
+    for (auto it = dir.entries.begin(); it != dir.entries.end();) {
+        bool gone = it->epoch != epoch;
+        if (!gone && it->dir) {
+            changed |= sweep(*it->dir, epoch);
+            gone = it->dir->entries.empty();
+        }
+        if (gone) {
+            it = dir.entries.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+    if (changed) dir.dirty = true;
+    return changed;
+}
+
+void DirectoryTree::assign(const std::vector<std::string>& files) {
+    const uint32_t epoch = ++epoch_;
+    for (const auto& f : files) insert(f, epoch);
+    sweep(root_, epoch);
+    populated_ = true;
+}
+
+bool DirectoryTree::add(std::string_view rel_path) {
+    return insert(rel_path, epoch_);
+}
+
+bool DirectoryTree::remove(std::string_view rel_path) {
+    std::vector<std::pair<Dir*, std::string_view>> chain; // Directory, name of the entry taken in it
+    Dir* dir = &root_;
+    size_t start = 0;
+    while (dir && start < rel_path.size()) {
+        size_t slash = rel_path.find('/', start);
+        std::string_view part = rel_path.substr(start, slash == std::string_view::npos ? std::string_view::npos : slash - start);
+        start = slash == std::string_view::npos ? rel_path.size() : slash + 1;
+        if (part.empty()) continue;
+        Entry* e = find(*dir, part);
+        if (!e) return false;
+        chain.emplace_back(dir, part);
+        dir = e->dir.get();
+    }
+    if (chain.empty() || dir) return false; // Not a file
+
+    // Erase the file, then every directory it leaves empty
+    for (auto& [d, name] : chain) d->dirty = true;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        Dir& parent = *it->first;
+        Entry* e = find(parent, it->second);
+        if (it != chain.rbegin() && !e->dir->entries.empty()) break;
+        parent.entries.erase(parent.entries.begin() + (e - parent.entries.data()));
+    }
+    return true;
+}
+
+const std::string& DirectoryTree::render_dir(Dir& dir) {
+    if (!dir.dirty) return dir.block;
+    rendered_dirs_++;
+    dir.block.clear();
+    for (size_t i = 0; i < dir.entries.size(); ++i) {
+        Entry& e = dir.entries[i];
+        const bool last = i + 1 == dir.entries.size();
+        dir.block += last ? "└── " : "├── ";
+        dir.block += e.name;
+        if (!e.dir) {
+            dir.block += '\n';
+            continue;
+        }
+        dir.block += "/\n";
+
+        // The child's lines are relative to it; this level adds one column
+        const std::string& sub = render_dir(*e.dir);
+        std::string_view column = last ? "    " : "│   ";
+        for (size_t pos = 0; pos < sub.size();) {
+            size_t eol = sub.find('\n', pos);
+            size_t end = eol == std::string::npos ? sub.size() : eol + 1;
+            dir.block += column;
+            dir.block.append(sub, pos, end - pos);
+            pos = end;
+        }
+    }
+    dir.dirty = false;
+    return dir.block;
+}
+
+std::string DirectoryTree::render(std::string_view root_name) {
+    rendered_dirs_ = 0;
+    const std::string& body = render_dir(root_);
+    std::string out;
+    out.reserve(root_name.size() + 2 + body.size());
+    out.append(root_name);
+    out += "/\n";
+    out += body;
+    return out;
+}
+
+} // namespace code_assistance
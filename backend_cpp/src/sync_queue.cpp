@@ -0,0 +1,114 @@
+#include "sync_queue.hpp"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace code_assistance {
+
+SyncQueue::SyncQueue(std::shared_ptr<SyncService> service, ThreadPool& pool, ApplyFn apply, SyncQueueOptions options)
+    : service_(std::move(service)), pool_(pool), apply_(std::move(apply)), options_(options) {
+    dispatcher_ = std::thread(&SyncQueue::dispatch_loop, this);
+}
+
+SyncQueue::~SyncQueue() {
+    size_t dropped = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+        for (const auto& [id, pq] : projects_) dropped += pq.pending.size();
+    }
+    cv_.notify_all();
+    if (dispatcher_.joinable()) dispatcher_.join();
+
+    // Batches already on the pool reference this queue
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return batches_in_flight_ == 0; });
+    if (dropped > 0) spdlog::warn("⚠️ SyncQueue: {} pending file syncs dropped at shutdown", dropped);
+}
+
+bool SyncQueue::submit(const std::string& project_id, const SyncProject& project, const std::string& rel_path) {
+    const auto now = Clock::now();
+    bool fresh;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& pq = projects_[project_id];
+        pq.project = project;
+
+        auto [it, inserted] = pq.pending.try_emplace(rel_path, Pending{now + options_.debounce, now});
+        if (!inserted) {
+            it->second.due = std::min(now + options_.debounce, it->second.first_seen + options_.max_delay);
+            ++stats_.coalesced;
+        }
+        ++stats_.submitted;
+        fresh = inserted;
+    }
+    cv_.notify_all();
+    return fresh;
+}
+
+SyncQueueStats SyncQueue::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SyncQueueStats s = stats_;
+    for (const auto& [id, pq] : projects_) s.pending += pq.pending.size();
+    return s;
+}
+
+void SyncQueue::dispatch_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        const auto now = Clock::now();
+        auto next_wake = Clock::time_point::max();
+
+        for (auto& [id, pq] : projects_) {
+            if (pq.in_flight || pq.pending.empty()) continue; // Woken again when the batch lands
+
+            std::vector<std::string> due;
+            for (auto it = pq.pending.begin(); it != pq.pending.end();) {
+                if (it->second.due <= now && due.size() < options_.max_batch_files) {
+                    due.push_back(it->first);
+                    it = pq.pending.erase(it);
+                } else {
+                    next_wake = std::min(next_wake, it->second.due);
+                    ++it;
+                }
+            }
+            if (due.empty()) continue;
+
+            pq.in_flight = true;
+            ++batches_in_flight_;
+            try {
+                pool_.post(TaskPriority::Background,
+                           [this, id = id, project = pq.project, paths = std::move(due)] { run_batch(id, project, paths); });
+            } catch (const std::exception& e) {
+                spdlog::error("❌ SyncQueue: cannot schedule batch for {}: {}", id, e.what());
+                pq.in_flight = false;
+                --batches_in_flight_;
+            }
+        }
+
+        if (next_wake == Clock::time_point::max()) cv_.wait(lock);
+        else cv_.wait_until(lock, next_wake);
+    }
+}
+
+void SyncQueue::run_batch(const std::string& project_id, const SyncProject& project, const std::vector<std::string>& paths) {
+    size_t synced = 0;
+    try {
+        FileSyncBatch batch = service_->sync_files(project_id, project.local_root, project.storage_path, paths);
+        synced = batch.synced.size();
+        if (apply_) apply_(project_id, project, batch);
+    } catch (const std::exception& e) {
+        spdlog::error("❌ SyncQueue: batch of {} files for {} failed: {}", paths.size(), project_id, e.what());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = projects_.find(project_id);
+        if (it != projects_.end()) it->second.in_flight = false;
+        ++stats_.batches;
+        stats_.files_synced += synced;
+        --batches_in_flight_;
+    }
+    cv_.notify_all();
+}
+
+} // namespace code_assistance
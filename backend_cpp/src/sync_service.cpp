@@ -9,12 +9,17 @@
 #include <cctype>
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
-#include <map>
-#include <sstream> 
+#include <thread>
+#include <atomic>
+#include <functional>
 
-#include "PrefixTrie.hpp"
+#include "BoundedQueue.hpp"
+#include "ContentHash.hpp"
+#include "node_store.hpp"
 #include "code_graph.hpp"
 #include "sync_service.hpp"
+#include "dir_walker.hpp"
+#include "SourceFile.hpp"
 #include "embedding_service.hpp"
 
 namespace code_assistance {
@@ -22,10 +27,6 @@ namespace code_assistance {
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
-struct VisualNode {
-    std::map<std::string, VisualNode> children;
-};
-
 // --- UTILITIES ---
 
 // Case-insensitive, separator-agnostic path comparison
@@ -46,40 +47,32 @@ bool paths_are_equal(const fs::path& p1, const fs::path& p2) {
     return s1 == s2;
 }
 
-// Check if child is inside parent (or equal)
-bool is_inside(const fs::path& child, const fs::path& parent) {
-    if (parent.empty()) return false;
-    
-    // Normalize both paths to remove dots and redundant slashes
-    auto c = child.lexically_normal();
-    auto p = parent.lexically_normal();
-
-    auto it_c = c.begin();
-    auto it_p = p.begin();
-
-    while (it_p != p.end()) {
-        // If parent has a trailing slash, lexically_normal might leave a "." segment. 
-        // We skip it.
-        if (it_p->string() == "." || it_p->string().empty()) {
-            ++it_p;
-            continue;
-        }
+// --- FILTERS ---
 
-        if (it_c == c.end()) return false;
-        
-        std::string s_c = it_c->string();
-        std::string s_p = it_p->string();
-        
-        // Windows Case-Insensitivity
-        std::transform(s_c.begin(), s_c.end(), s_c.begin(), ::tolower);
-        std::transform(s_p.begin(), s_p.end(), s_p.begin(), ::tolower);
-        
-        if (s_c != s_p) return false;
-        
-        ++it_c;
-        ++it_p;
+FilterConfig FilterConfig::make(const std::vector<std::string>& allowed_extensions,
+                                const std::vector<std::string>& ignored_paths,
+                                const std::vector<std::string>& included_paths) {
+    FilterConfig cfg;
+    cfg.blacklist = ignored_paths;
+    cfg.whitelist = included_paths;
+    cfg.matcher = std::make_shared<const PathMatcher>(ignored_paths, included_paths);
+    for (auto ext : allowed_extensions) {
+        if (!ext.empty() && ext[0] == '.') ext = ext.substr(1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        cfg.allowed_extensions.insert(ext);
+    }
+    return cfg;
+}
+
+bool FilterConfig::allows_extension(std::string_view rel_path) const {
+    size_t slash = rel_path.find_last_of("/\\");
+    size_t dot = rel_path.rfind('.');
+    std::string ext;
+    if (dot != std::string_view::npos && (slash == std::string_view::npos ? dot > 0 : dot > slash + 1)) {
+        ext = rel_path.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
     }
-    return true;
+    return allowed_extensions.count(ext) > 0;
 }
 
 // --- SYNC SERVICE IMPLEMENTATION ---
@@ -89,13 +82,10 @@ SyncService::SyncService(std::shared_ptr<EmbeddingService> embedding_service)
 
 bool SyncService::should_index(const fs::path& rel_path, const FilterConfig& cfg) {
     std::string p_str = rel_path.generic_string();
-
-    for (const auto& white : cfg.whitelist) {
-        if (p_str == white) return true; 
-    }
-
-    for (const auto& black : cfg.blacklist) {
-        if (p_str.find(black) == 0) return false; 
+    if (cfg.matcher) {
+        uint8_t flag = cfg.matcher->check(p_str, false);
+        if (flag & PathFlag::INCLUDE) return true;
+        if (flag & PathFlag::IGNORE) return false;
     }
 
     std::string ext = rel_path.extension().string();
@@ -103,234 +93,158 @@ bool SyncService::should_index(const fs::path& rel_path, const FilterConfig& cfg
     return cfg.allowed_extensions.count(ext) > 0;
 }
 
-std::unordered_map<std::string, std::shared_ptr<CodeNode>> 
-SyncService::load_existing_nodes(const std::string& storage_path) {
-    std::unordered_map<std::string, std::shared_ptr<CodeNode>> map;
-    fs::path meta_path = fs::path(storage_path) / "vector_store" / "metadata.json";
+// --- EXISTING NODE RECOVERY ---
+
+void ExistingNodes::load(const std::string& storage_path) {
+    fs::path store_dir = fs::path(storage_path) / "vector_store";
+
+    // 💾 Binary segment first: O(1) open, rows are only touched when recovered
+    if (store_.open((store_dir / "nodes.bin").string())) return;
+
+    fs::path meta_path = store_dir / "metadata.json";
     if (fs::exists(meta_path)) {
         try {
             std::ifstream f(meta_path);
             json j = json::parse(f);
             for (const auto& j_node : j) {
                 auto node = std::make_shared<CodeNode>(CodeNode::from_json(j_node));
-                map[node->id] = node;
+                legacy_by_file_[node->file_path].push_back(node);
             }
         } catch (...) {}
     }
-    return map;
 }
 
-void SyncService::generate_tree_file(
-    const fs::path& base_dir, 
-    const std::vector<fs::path>& files, 
-    const fs::path& output_file
-) {
-    VisualNode root;
-
-    // 1. Build the Trie structure from flat paths
-    for (const auto& file_path : files) {
-        std::string rel = fs::relative(file_path, base_dir).string();
-        std::replace(rel.begin(), rel.end(), '\\', '/');
-        
-        std::stringstream ss(rel);
-        std::string part;
-        VisualNode* current = &root;
-        
-        while (std::getline(ss, part, '/')) {
-            if (part.empty()) continue;
-            current = &(current->children[part]);
-        }
+void ExistingNodes::recover(const FileManifest& manifest, long entry, const std::string& rel_path,
+                            std::vector<std::shared_ptr<CodeNode>>& out) {
+    if (!store_.is_open()) {
+        auto it = legacy_by_file_.find(rel_path);
+        if (it != legacy_by_file_.end()) out.insert(out.end(), it->second.begin(), it->second.end());
+        return;
     }
 
-    // 2. Recursive Lambda to print with standard box-drawing characters
-    std::ofstream out(output_file);
-    out << base_dir.filename().string() << "/\n";
-
-    // Helper function for recursive drawing
-    std::function<void(VisualNode&, std::string)> draw_node;
-    draw_node = [&](VisualNode& node, std::string prefix) {
-        auto it = node.children.begin();
-        while (it != node.children.end()) {
-            bool is_last = (std::next(it) == node.children.end());
-            
-            // Standard ASCII Tree Characters
-            std::string connector = is_last ? "└── " : "├── ";
-            
-            // Render folder trailing slash if it has children
-            std::string name = it->first;
-            if (!it->second.children.empty()) {
-                name += "/";
-            }
-
-            out << prefix << connector << name << "\n";
-
-            // Prepare prefix for children
-            std::string new_prefix = prefix + (is_last ? "    " : "│   ");
-            draw_node(it->second, new_prefix);
-            
-            ++it;
+    // Fast path: the manifest lists this file's node ids
+    uint32_t count = entry >= 0 ? manifest.node_count(entry) : 0;
+    if (count > 0) {
+        for (uint32_t j = 0; j < count; ++j) {
+            long row = store_.find(manifest.node_id(entry, j));
+            if (row >= 0) out.push_back(store_.materialize(row, true));
         }
-    };
-
-    draw_node(root, "");
-    out.close();
-}
+        return;
+    }
 
-std::string SyncService::calculate_file_hash(const fs::path& file_path) {
-    try {
-        auto size = fs::file_size(file_path);
-        auto time = fs::last_write_time(file_path).time_since_epoch().count();
-        return std::to_string(size) + "-" + std::to_string(time);
-    } catch (...) { return "err"; }
+    if (!rows_indexed_) {
+        for (size_t row = 0; row < store_.size(); ++row) rows_by_file_[store_.file_path(row)].push_back(row);
+        rows_indexed_ = true;
+    }
+    auto it = rows_by_file_.find(rel_path);
+    if (it == rows_by_file_.end()) return;
+    for (size_t row : it->second) out.push_back(store_.materialize(row, true));
 }
 
-// backend_cpp/src/sync_service.cpp
-
-void scan_directory_recursive(
-    const fs::path& current_dir,
-    const fs::path& root_dir,
-    const fs::path& storage_dir,
-    const std::unordered_set<std::string>& ext_set,
-    const std::vector<std::string>& ignored_paths,
-    const std::vector<std::string>& included_paths,
-    std::vector<fs::path>& results
-) {
-    try {
-        for (const auto& entry : fs::directory_iterator(current_dir)) {
-            const auto& path = entry.path();
-            if (fs::equivalent(path, storage_dir)) continue;
-
-            fs::path rel_fs = fs::relative(path, root_dir);
-            std::string rel_str = rel_fs.generic_string(); // Always uses '/'
-
-            // Check if explicitly ignored
-            bool explicitly_ignored = false;
-            for (const auto& ign : ignored_paths) {
-                if (is_inside(rel_fs, fs::path(ign))) {
-                    explicitly_ignored = true;
-                    break;
-                }
-            }
+std::shared_ptr<SyncService::Artifacts> SyncService::artifacts_for(const fs::path& storage_dir) {
+    std::lock_guard<std::mutex> lock(artifacts_mutex_);
+    auto& slot = artifacts_[storage_dir.lexically_normal().string()];
+    if (slot) return slot;
 
-            // Check exceptions
-            bool is_explicit_exception = false;
-            bool is_bridge_to_exception = false;
-            for (const auto& inc : included_paths) {
-                fs::path inc_path(inc);
-                if (is_inside(rel_fs, inc_path)) { is_explicit_exception = true; break; }
-                if (is_inside(inc_path, rel_fs)) { is_bridge_to_exception = true; }
-            }
+    slot = std::make_shared<Artifacts>(storage_dir);
+    slot->context.load();
 
-            if (entry.is_directory()) {
-                bool enter = !explicitly_ignored || is_bridge_to_exception || is_explicit_exception;
-                spdlog::info("DIR  | {} | Ignored: {} | Bridge: {} | Action: {}", 
-                    rel_str, explicitly_ignored ? "YES" : "NO ", is_bridge_to_exception ? "YES" : "NO ", enter ? "ENTER" : "SKIP");
-                
-                if (enter) {
-                    scan_directory_recursive(path, root_dir, storage_dir, ext_set, ignored_paths, included_paths, results);
-                }
-            } else {
-                bool collect = !explicitly_ignored || is_explicit_exception;
-                
-                std::string ext = path.extension().string();
-                if (!ext.empty() && ext[0] == '.') ext = ext.substr(1);
-                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                
-                bool ext_match = ext_set.empty() || ext_set.count(ext);
-
-                if (collect && ext_match) {
-                    spdlog::info("FILE | {} | Action: COLLECT", rel_str);
-                    results.push_back(path);
-                } else {
-                    spdlog::info("FILE | {} | Action: SKIP (Ignored: {}, ExtMatch: {})", 
-                        rel_str, explicitly_ignored ? "YES" : "NO ", ext_match ? "YES" : "NO ");
-                }
-            }
-        }
-    } catch (const std::exception& e) {
-        spdlog::error("Scanner error at {}: {}", current_dir.string(), e.what());
+    // The monolithic file is superseded by full_context/ and would only go stale
+    std::error_code ec;
+    if (fs::remove(storage_dir / "_full_context.txt", ec)) {
+        spdlog::info("🧹 Replaced legacy _full_context.txt with segmented store in {}", (storage_dir / "full_context").string());
     }
+    return slot;
 }
 
-void SyncService::generate_embeddings_batch(std::vector<std::shared_ptr<CodeNode>>& nodes, int batch_size) {
-    spdlog::info("Generating embeddings for {} nodes...", nodes.size());
-    for (size_t i = 0; i < nodes.size(); i += batch_size) {
-        std::vector<std::string> texts;
-        size_t end = std::min(i + batch_size, nodes.size());
-        for (size_t j = i; j < end; ++j) {
-            std::string safe = utf8_safe_substr(nodes[j]->content, 800);
-            texts.push_back("Name: " + nodes[j]->name + " Code: " + safe);
+void SyncService::write_tree_file(DirectoryTree& tree, const fs::path& base_dir, const fs::path& output_file) {
+    std::error_code ec;
+    if (!tree.dirty() && fs::exists(output_file, ec)) return;
+
+    std::string text = tree.render(base_dir.filename().string());
+    std::string tmp = output_file.string() + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if (!out.good()) {
+            spdlog::error("❌ Tree: cannot write {}", tmp);
+            return;
         }
-        try {
-            auto embs = embedding_service_->generate_embeddings_batch(texts);
-            for (size_t j = 0; j < embs.size(); ++j) nodes[i + j]->embedding = embs[j];
-        } catch(...) {}
-        spdlog::info("  - Embedded batch {}/{}", (i/batch_size)+1, (nodes.size()/batch_size)+1);
     }
+    fs::rename(tmp, output_file, ec);
+    if (ec) spdlog::error("❌ Tree: rename {} failed: {}", tmp, ec.message());
+    else spdlog::info("🌳 tree.txt updated ({} directories re-rendered)", tree.rendered_dirs());
 }
 
-std::unordered_map<std::string, std::string> SyncService::load_manifest(const std::string& project_id) {
-    fs::path p = fs::path("data") / project_id / "manifest.json";
-    if (!fs::exists(p)) return {};
-    try { std::ifstream f(p); json j; f >> j; return j; } catch(...) { return {}; }
+SyncService::FileStamp SyncService::stat_file(const fs::path& file_path) {
+    std::error_code ec_size, ec_time;
+    FileStamp stamp;
+    stamp.size = fs::file_size(file_path, ec_size);
+    stamp.mtime = static_cast<int64_t>(fs::last_write_time(file_path, ec_time).time_since_epoch().count());
+    stamp.ok = !ec_size && !ec_time;
+    return stamp;
+}
+
+size_t SyncService::embed_batch(std::vector<std::shared_ptr<CodeNode>>& nodes, int key_slot) {
+    std::vector<std::string> texts;
+    texts.reserve(nodes.size());
+    for (const auto& n : nodes) {
+        std::string safe = utf8_safe_substr(n->text(), 800);
+        texts.push_back("Name: " + n->name + " Code: " + safe);
+    }
+    try {
+        auto embs = embedding_service_->generate_embeddings_batch(texts, key_slot);
+        size_t count = 0;
+        for (size_t j = 0; j < std::min(embs.size(), nodes.size()); ++j) {
+            if (embs[j].empty()) continue;
+            nodes[j]->embedding = std::move(embs[j]);
+            ++count;
+        }
+        return count;
+    } catch (const std::exception& e) {
+        spdlog::error("❌ Embedding batch of {} failed: {}", nodes.size(), e.what());
+        return 0;
+    }
 }
 
-void SyncService::save_manifest(const std::string& project_id, const std::unordered_map<std::string, std::string>& m) {
-    fs::path p = fs::path("data") / project_id / "manifest.json";
-    fs::create_directories(p.parent_path());
-    std::ofstream f(p); json j = m; f << j.dump(2);
+void SyncService::report_progress(const SyncProgress& p) {
+    std::lock_guard<std::mutex> lock(progress_mutex_);
+    if (progress_cb_) progress_cb_(p);
 }
 
-void SyncService::recursive_scan(
-    const fs::path& current_dir,
-    const fs::path& root_dir,
-    const fs::path& storage_dir,
-    const FilterConfig& cfg, // You might need to refactor FilterConfig to hold the Trie
-    std::vector<fs::path>& results
-) {
-    // 1. Build Trie locally (In production, build this ONCE in the class constructor/update)
-    // For this snippet, we assume 'trie_' is a member of SyncService populated from cfg.
-    PrefixTrie trie;
-    for(const auto& p : cfg.blacklist) trie.insert(p, PathFlag::IGNORE);
-    for(const auto& p : cfg.whitelist) trie.insert(p, PathFlag::INCLUDE);
+void SyncService::load_manifest(const std::string& project_id, FileManifest& manifest) {
+    fs::path dir = fs::path("data") / project_id;
+    fs::path bin_path = dir / "manifest.bin";
+    fs::path json_path = dir / "manifest.json";
 
-    try {
-        for (const auto& entry : fs::directory_iterator(current_dir)) {
-            const auto& path = entry.path();
-            if (fs::equivalent(path, storage_dir)) continue;
-
-            fs::path rel_path = fs::relative(path, root_dir);
-            
-            // 🚀 ELITE O(1) LOOKUP
-            uint8_t flag = trie.check(rel_path);
-            
-            bool is_ignored = (flag & PathFlag::IGNORE);
-            bool is_included = (flag & PathFlag::INCLUDE);
-
-            if (entry.is_directory()) {
-                // Logic: Enter if NOT ignored, OR if explicit exception exists
-                // Note: The Trie check returns the status of the *current* path.
-                // We need to know if there's a deep exception.
-                // For simplicity in Phase 2.1: We scan if not ignored OR if included.
-                
-                if (!is_ignored || is_included) {
-                    recursive_scan(path, root_dir, storage_dir, cfg, results);
-                }
-            } 
-            else if (entry.is_regular_file()) {
-                // File Logic
-                if (is_ignored && !is_included) continue;
-
-                // Extension Check
-                std::string ext = path.extension().string();
-                if (!ext.empty() && ext[0] == '.') ext = ext.substr(1);
-                
-                if (cfg.allowed_extensions.count(ext)) {
-                    results.push_back(path);
-                }
+    if (!fs::exists(bin_path) && fs::exists(json_path)) {
+        // Legacy values are "size-mtime". Carry them over with an unknown content hash,
+        // so untouched files are trusted once and hashed on their first real change.
+        try {
+            std::ifstream f(json_path);
+            auto legacy = json::parse(f).get<std::unordered_map<std::string, std::string>>();
+            FileManifestWriter writer;
+            for (const auto& [rel_path, stamp] : legacy) {
+                size_t dash = stamp.find('-');
+                if (dash == std::string::npos) continue;
+                writer.add(rel_path, std::stoull(stamp.substr(0, dash)), std::stoll(stamp.substr(dash + 1)), 0, {});
+            }
+            if (writer.write(bin_path.string())) {
+                fs::remove(json_path);
+                spdlog::info("🧾 Migrated manifest.json ({} files) to manifest.bin", writer.size());
             }
+        } catch (const std::exception& e) {
+            spdlog::warn("⚠️ Legacy manifest unreadable, full re-index: {}", e.what());
         }
-    } catch (...) {}
+    }
+
+    if (fs::exists(bin_path)) manifest.open(bin_path.string());
+}
+
+bool SyncService::save_manifest(const std::string& project_id, FileManifest& current, const FileManifestWriter& updated) {
+    fs::path dir = fs::path("data") / project_id;
+    current.close(); // Windows refuses to replace a mapped file
+    return updated.write((dir / "manifest.bin").string());
 }
 
 SyncResult SyncService::perform_sync(
@@ -347,112 +261,368 @@ SyncResult SyncService::perform_sync(
     fs::create_directories(converted_files_dir);
 
     SyncResult result;
-    auto manifest = load_manifest(project_id);
-    auto existing_nodes_map = load_existing_nodes(storage_path_str);
+    FileManifest manifest;
+    load_manifest(project_id, manifest);
+    ExistingNodes existing_nodes;
+    existing_nodes.load(storage_path_str);
+    auto artifacts = artifacts_for(storage_dir);
+    std::lock_guard<std::mutex> artifacts_lock(artifacts->mutex);
+    const uint64_t context_written = artifacts->context.stats().written_bytes;
 
     // 🚀 PHASE 1: PRE-FLIGHT SANITATION
-    FilterConfig cfg;
-    cfg.blacklist = ignored_paths;
-    cfg.whitelist = included_paths;
-    for (auto ext : allowed_extensions) {
-        if (!ext.empty() && ext[0] == '.') ext = ext.substr(1);
-        std::string clean_ext = ext;
-        std::transform(clean_ext.begin(), clean_ext.end(), clean_ext.begin(), ::tolower);
-        cfg.allowed_extensions.insert(clean_ext);
-    }
+    FilterConfig cfg = FilterConfig::make(allowed_extensions, ignored_paths, included_paths);
 
     spdlog::info("🔍 Mission Start: {} | Filters: [E:{} I:{} W:{}]", 
                  project_id, cfg.allowed_extensions.size(), cfg.blacklist.size(), cfg.whitelist.size());
 
-    // 🚀 PHASE 2: PRUNING RECURSIVE SCAN
-    std::vector<fs::path> files_to_process;
-    // We call the specialized recursive scan that uses should_index internally
-    this->recursive_scan(source_dir, source_dir, storage_dir, cfg, files_to_process);
-
-    // 🚀 PHASE 3: DIFFERENTIAL PROCESSING
-    std::unordered_map<std::string, std::string> new_manifest;
-    std::vector<std::shared_ptr<CodeNode>> nodes_to_embed;
-    std::ofstream full_context_file(storage_dir / "_full_context.txt");
-
-    for (const auto& file_path : files_to_process) {
-        std::string rel_path_str = fs::relative(file_path, source_dir).generic_string();
-        std::string current_hash = calculate_file_hash(file_path);
-        std::string old_hash = manifest.count(rel_path_str) ? manifest.at(rel_path_str) : "";
-        
-        bool is_changed = (current_hash != old_hash);
-        new_manifest[rel_path_str] = current_hash;
-
-        // 1. Context Reassembly (Always update full context for the agent)
-        std::ifstream file_in(file_path);
-        std::string content((std::istreambuf_iterator<char>(file_in)), std::istreambuf_iterator<char>());
-        full_context_file << "\n\n--- FILE: " << rel_path_str << " ---\n" << content << "\n";
+    // 🚀 PHASE 2 + 3: STREAMING SCAN INTO PIPELINED DIFFERENTIAL PROCESSING
+    // [walker -> tree.txt] -> scanned queue -> [parse workers] -> parsed queue -> [collector: manifest, context, recovery]
+    //   -> batch queue -> [embedders]
+    // Files start parsing as soon as the walker finds them; the total grows until the walk ends.
+    const size_t parse_workers = std::max<size_t>(1, options_.parse_workers ? options_.parse_workers
+                                                                             : std::thread::hardware_concurrency());
+    const size_t embed_workers = options_.embed_in_flight
+        ? options_.embed_in_flight
+        : embedding_service_->embedding_concurrency();
+    const size_t batch_size = std::max(1, options_.batch_size);
+
+    struct ParsedFile {
+        std::string rel_path;
+        FileStamp stamp;
+        long entry = -1;
+        uint64_t hash = 0;
+        SourceFile source; // Mapped or read once; heap-copied only if the file is parsed
+        bool ok = false;
+        bool changed = false;
+        std::vector<CodeNode> nodes;
+    };
+    using Batch = std::vector<std::shared_ptr<CodeNode>>;
+
+    BoundedQueue<std::string> scanned(options_.queue_capacity);
+    BoundedQueue<ParsedFile> parsed(options_.queue_capacity);
+    BoundedQueue<Batch> batches(embed_workers * 2); // Bounds memory held by unembedded nodes
+
+    std::atomic<size_t> files_found{0};
+    std::atomic<bool> scan_done{false};
+    std::atomic<size_t> parsers_left{parse_workers};
+    std::atomic<size_t> nodes_to_embed{0};
+    std::atomic<size_t> nodes_embedded{0};
+    std::atomic<size_t> in_flight{0};
+    std::atomic<size_t> files_done{0};
+
+    auto snapshot = [&](const char* stage) {
+        SyncProgress p;
+        p.stage = stage;
+        p.files_total = files_found.load();
+        p.files_done = files_done.load();
+        p.nodes_to_embed = nodes_to_embed.load();
+        p.nodes_embedded = nodes_embedded.load();
+        p.batches_in_flight = in_flight.load();
+        return p;
+    };
+
+    // Stage 0: parallel pruning walk, streaming relative paths. The walker then refreshes
+    // tree.txt while the rest of the pipeline is still parsing and embedding.
+    std::mutex files_mutex;
+    std::vector<std::string> walked_files;
+
+    // Declared after everything the stages capture, so they are joined first. If the
+    // collector below throws, the queues close before the joins: no stage is left blocked
+    // on a push or pop, and no joinable thread is destroyed.
+    std::jthread walker;
+    std::vector<std::jthread> parsers;
+    std::vector<std::jthread> embedders;
+    struct CloseOnExit {
+        std::function<void()> close;
+        ~CloseOnExit() { close(); }
+    } close_on_exit{[&] {
+        scanned.close();
+        parsed.close();
+        batches.close();
+    }};
+
+    walker = std::jthread([&] {
+        DirWalkOptions walk;
+        walk.matcher = cfg.matcher;
+        walk.skip_dir = storage_dir;
+        auto stats = DirWalker::walk(source_dir, walk, [&](WalkEntry&& e) {
+            if (e.is_dir || !cfg.allows_extension(e.rel_path)) return true;
+
+            files_found++;
+            {
+                std::lock_guard<std::mutex> lock(files_mutex);
+                walked_files.push_back(e.rel_path);
+            }
+            return scanned.push(std::move(e.rel_path));
+        }, walk_pool_);
+        scanned.close();
+        scan_done = true;
+
+        spdlog::info("🗂️ Scan complete: {} files in {} dirs ({} unreadable)", files_found.load(), stats.dirs, stats.errors);
+        auto p = snapshot("scan");
+        report_progress(p);
+
+        artifacts->tree.assign(walked_files);
+        write_tree_file(artifacts->tree, source_dir, storage_dir / "tree.txt");
+    });
+
+    // Stage 1: read + hash + parse, sized to the cores
+    for (size_t w = 0; w < parse_workers; ++w) {
+        parsers.emplace_back([&] {
+            while (auto rel = scanned.pop()) {
+                const fs::path file_path = source_dir / *rel;
+                ParsedFile pf;
+                pf.rel_path = std::move(*rel);
+                try {
+                    pf.stamp = stat_file(file_path);
+                    pf.entry = manifest.find(pf.rel_path);
+                    long entry = pf.entry;
+                    bool stamp_match = entry >= 0 && pf.stamp.ok &&
+                                       manifest.file_size(entry) == pf.stamp.size &&
+                                       manifest.mtime(entry) == pf.stamp.mtime;
+                    uint64_t stored = entry >= 0 ? manifest.content_hash(entry) : 0;
+                    const bool trusted = stamp_match && stored != 0;
+
+                    // An untouched file whose context block is current is never read
+                    if (!(trusted && artifacts->context.contains(pf.rel_path, stored)) && !pf.source.open(file_path)) {
+                        throw std::runtime_error("unreadable");
+                    }
+
+                    // Hash only when the cheap probe fails; a touch or checkout that
+                    // leaves bytes identical is then caught by the content hash.
+                    if (trusted) {
+                        pf.hash = stored;
+                        pf.changed = false;
+                    } else {
+                        pf.hash = xxh64(pf.source.view());
+                        pf.changed = !(stored == pf.hash || (stored == 0 && stamp_match));
+                    }
+                    if (pf.changed) {
+                        // Nodes slice this one buffer; the mapping is no longer needed
+                        pf.nodes = CodeParser::extract_nodes_from_file(pf.rel_path, pf.source.buffer());
+                        pf.source.release_mapping();
+                    }
+                    pf.ok = true;
+                } catch (const std::exception& e) {
+                    spdlog::error("❌ Parse failed for {}: {}", pf.rel_path, e.what());
+                }
+                if (!parsed.push(std::move(pf))) break;
+            }
+            if (--parsers_left == 0) parsed.close();
+        });
+    }
+
+    // Stage 3: N batch requests in flight, each pinned to a different key slot
+    for (size_t w = 0; w < embed_workers; ++w) {
+        embedders.emplace_back([&, w] {
+            while (auto batch = batches.pop()) {
+                in_flight++;
+                nodes_embedded += embed_batch(*batch, static_cast<int>(w));
+                in_flight--;
+                auto p = snapshot("embed");
+                spdlog::info("  - Embedded {}/{} nodes ({} batches in flight)",
+                             p.nodes_embedded, p.nodes_to_embed, p.batches_in_flight);
+                report_progress(p);
+            }
+        });
+    }
+
+    // Stage 2 (this thread): ordered side effects stay single-threaded
+    FileManifestWriter new_manifest;
+    std::vector<std::string_view> file_node_ids;
+    std::unordered_set<std::string> context_live; // Everything still on disk keeps its block
+    Batch pending;
+    const size_t report_every = 64;
+
+    while (auto pf = parsed.pop()) {
+        size_t done = ++files_done;
+        if (done % report_every == 0 || (scan_done && done == files_found.load())) {
+            auto p = snapshot("parse");
+            spdlog::info("📄 Parsed {}/{} files | {} nodes queued for embedding", p.files_done, p.files_total, p.nodes_to_embed);
+            report_progress(p);
+        }
+        context_live.insert(pf->rel_path);
+        if (!pf->ok) continue; // Left out of the manifest so the next sync retries it
+
+        file_node_ids.clear();
+        size_t first_node = result.nodes.size();
+
+        // 1. Full context: only files that were read can have a stale block
+        if (pf->source.is_open()) artifacts->context.put(pf->rel_path, pf->hash, pf->source.view());
+        pf->source.close(); // Unchanged files were never copied; changed ones live on in their nodes
 
         // 2. Node Generation
-        if (is_changed) {
-            spdlog::info("🔼 UPDATE: {}", rel_path_str);
-            result.logs.push_back("UPDATE: " + rel_path_str);
-            auto new_nodes = CodeParser::extract_nodes_from_file(rel_path_str, content);
-            for (auto& n : new_nodes) {
-                auto ptr = std::make_shared<CodeNode>(n);
+        if (pf->changed) {
+            spdlog::info("🔼 UPDATE: {}", pf->rel_path);
+            result.logs.push_back("UPDATE: " + pf->rel_path);
+            for (auto& n : pf->nodes) {
+                auto ptr = std::make_shared<CodeNode>(std::move(n));
                 result.nodes.push_back(ptr);
-                nodes_to_embed.push_back(ptr);
+                pending.push_back(std::move(ptr));
+                nodes_to_embed++;
+                if (pending.size() >= batch_size) {
+                    batches.push(std::move(pending));
+                    pending.clear();
+                }
             }
             result.updated_count++;
         } else {
-            // Recover from existing map to avoid re-embedding
-            for (const auto& [id, node] : existing_nodes_map) {
-                if (node->file_path == rel_path_str) result.nodes.push_back(node);
-            }
+            // Recover from the previous index to avoid re-embedding: one lookup per file
+            existing_nodes.recover(manifest, pf->entry, pf->rel_path, result.nodes);
         }
+
+        // Nodes stay alive in result.nodes, so the views remain valid until the manifest is written
+        for (size_t i = first_node; i < result.nodes.size(); ++i) file_node_ids.push_back(result.nodes[i]->id);
+        new_manifest.add(pf->rel_path, pf->stamp.size, pf->stamp.mtime, pf->hash, file_node_ids);
     }
+    if (!pending.empty()) batches.push(std::move(pending));
+    batches.close();
+
+    walker.join();
+    for (auto& t : parsers) t.join();
+    for (auto& t : embedders) t.join();
 
     // 🚀 PHASE 4: VECTOR & METADATA FINALIZATION
-    if (!nodes_to_embed.empty()) {
-        generate_embeddings_batch(nodes_to_embed, 50);
-    }
-    
-    generate_tree_file(source_dir, files_to_process, storage_dir / "tree.txt");
-    save_manifest(project_id, new_manifest);
+    size_t context_dropped = artifacts->context.retain(context_live);
+    artifacts->context.commit();
+    save_manifest(project_id, manifest, new_manifest);
 
+    auto ctx = artifacts->context.stats();
+    spdlog::info("📚 Full context: {} files in {} segments | {} KiB written, {} dropped, {} KiB dead",
+                 ctx.files, ctx.segments, (ctx.written_bytes - context_written) / 1024, context_dropped, ctx.dead_bytes / 1024);
+
+    report_progress(snapshot("done"));
     spdlog::info("✅ Mission Success: {} nodes indexed.", result.nodes.size());
     return result;
 }
 
-std::vector<std::shared_ptr<CodeNode>> SyncService::sync_single_file(
+std::vector<std::string> SyncService::changed_since_last_sync(
     const std::string& project_id,
     const std::string& local_root,
     const std::string& storage_path,
-    const std::string& relative_path
+    const FilterConfig& cfg
 ) {
-    fs::path full_path = fs::path(local_root) / relative_path;
-    if (!fs::exists(full_path)) throw std::runtime_error("File not found locally");
+    fs::path root = fs::absolute(local_root);
+    FileManifest manifest;
+    load_manifest(project_id, manifest);
+
+    std::mutex mutex;
+    std::vector<std::string> changed;
+    std::vector<uint8_t> seen(manifest.size(), 0);
+
+    DirWalkOptions walk;
+    walk.matcher = cfg.matcher;
+    walk.skip_dir = fs::absolute(storage_path);
+    DirWalker::walk(root, walk, [&](WalkEntry&& e) {
+        if (e.is_dir || !cfg.allows_extension(e.rel_path)) return true;
+        long entry = manifest.find(e.rel_path);
+        FileStamp stamp = stat_file(root / e.rel_path);
+        bool same = entry >= 0 && stamp.ok &&
+                    manifest.file_size(entry) == stamp.size && manifest.mtime(entry) == stamp.mtime;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entry >= 0) seen[entry] = 1;
+        if (!same) changed.push_back(std::move(e.rel_path));
+        return true;
+    }, walk_pool_);
+
+    for (size_t i = 0; i < seen.size(); ++i) {
+        std::error_code ec;
+        if (!seen[i] && !fs::exists(root / manifest.path(i), ec)) changed.emplace_back(manifest.path(i)); // Deleted since
+    }
+    return changed;
+}
 
-    // 1. Read Content
-    std::ifstream file(full_path);
-    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+FileSyncBatch SyncService::sync_files(
+    const std::string& project_id,
+    const std::string& local_root,
+    const std::string& storage_path,
+    const std::vector<std::string>& relative_paths
+) {
+    FileSyncBatch batch;
+    struct FileNodes { std::string rel_path; size_t begin; size_t end; std::shared_ptr<const std::string> content; };
+    std::vector<FileNodes> files;
+    std::vector<std::shared_ptr<CodeNode>> pending;
+    auto artifacts = artifacts_for(fs::absolute(storage_path));
+    std::unique_lock<std::mutex> artifacts_lock(artifacts->mutex);
+    bool tree_changed = false;
+
+    // 1. Read + parse (cheap next to the embedding round trip)
+    for (const auto& relative_path : relative_paths) {
+        fs::path full_path = fs::path(local_root) / relative_path;
+        if (!fs::exists(full_path)) {
+            batch.removed.push_back(relative_path);
+            artifacts->context.remove(relative_path);
+            tree_changed |= artifacts->tree.remove(relative_path);
+            continue;
+        }
 
-    // 2. Parse into Nodes
-    auto raw_nodes = CodeParser::extract_nodes_from_file(relative_path, content);
-    std::vector<std::shared_ptr<CodeNode>> nodes;
-    
-    // 3. Generate Embeddings (Atomic Batch)
-    std::vector<std::string> texts_to_embed;
-    for (auto& n : raw_nodes) {
-        auto ptr = std::make_shared<CodeNode>(n);
-        nodes.push_back(ptr);
-        texts_to_embed.push_back("Name: " + ptr->name + " Code: " + utf8_safe_substr(ptr->content, 800));
+        SourceFile source;
+        if (!source.open(full_path)) {
+            batch.failed.push_back(relative_path);
+            continue;
+        }
+        const auto& content = source.buffer();
+        artifacts->context.put(relative_path, xxh64(*content), *content);
+        tree_changed |= artifacts->tree.add(relative_path);
+
+        size_t begin = pending.size();
+        for (auto& n : CodeParser::extract_nodes_from_file(relative_path, content)) {
+            pending.push_back(std::make_shared<CodeNode>(std::move(n)));
+        }
+        files.push_back({relative_path, begin, pending.size(), content});
     }
 
-    auto embs = embedding_service_->generate_embeddings_batch(texts_to_embed);
-    for (size_t i = 0; i < embs.size(); ++i) nodes[i]->embedding = embs[i];
+    // Before the round trip: the artifacts only track what is on disk
+    artifacts->context.commit();
+    // Without a full walk this process has no tree to patch; the next full sync writes it
+    if (tree_changed && artifacts->tree.populated()) {
+        write_tree_file(artifacts->tree, fs::absolute(local_root), fs::path(storage_path) / "tree.txt");
+    }
+    artifacts_lock.unlock();
+
+    // 2. Embed the whole coalesced set together
+    const size_t batch_size = std::max<size_t>(1, options_.batch_size);
+    for (size_t i = 0; i < pending.size(); i += batch_size) {
+        std::vector<std::shared_ptr<CodeNode>> chunk(pending.begin() + i,
+                                                     pending.begin() + std::min(pending.size(), i + batch_size));
+        embed_batch(chunk, -1);
+    }
 
-    // 4. Update the storage .txt (for full context chat)
-    fs::path target_txt = fs::path(storage_path) / "converted_files" / (relative_path + ".txt");
-    fs::create_directories(target_txt.parent_path());
-    std::ofstream out(target_txt);
-    out << content;
+    // 3. A file only replaces its old nodes if every new node got a vector
+    for (const auto& f : files) {
+        bool complete = std::all_of(pending.begin() + f.begin, pending.begin() + f.end,
+                                    [](const auto& n) { return !n->embedding.empty(); });
+        if (!complete) {
+            batch.failed.push_back(f.rel_path);
+            continue;
+        }
+        batch.synced.push_back(f.rel_path);
+        batch.nodes.insert(batch.nodes.end(), pending.begin() + f.begin, pending.begin() + f.end);
+
+        // The storage .txt (for full context chat) moves with the index: a failed file keeps
+        // the copy that matches its nodes, and its retry writes this one
+        fs::path target_txt = fs::path(storage_path) / "converted_files" / (f.rel_path + ".txt");
+        fs::create_directories(target_txt.parent_path());
+        std::ofstream out(target_txt, std::ios::binary);
+        out.write(f.content->data(), static_cast<std::streamsize>(f.content->size()));
+    }
+
+    spdlog::info("🔄 [{}] File sync: {} synced ({} nodes), {} removed, {} failed",
+                 project_id, batch.synced.size(), batch.nodes.size(), batch.removed.size(), batch.failed.size());
+    return batch;
+}
+
+std::vector<std::shared_ptr<CodeNode>> SyncService::sync_single_file(
+    const std::string& project_id,
+    const std::string& local_root,
+    const std::string& storage_path,
+    const std::string& relative_path
+) {
+    fs::path full_path = fs::path(local_root) / relative_path;
+    if (!fs::exists(full_path)) throw std::runtime_error("File not found locally");
 
-    return nodes;
+    return sync_files(project_id, local_root, storage_path, {relative_path}).nodes;
 }
 
-} // namespace code_assistance
\ No newline at end of file
+} // namespace code_assistance
@@ -3,25 +3,16 @@
 #include <fstream>
 #include <sstream>
 #include <spdlog/spdlog.h>
-#include <omp.h>
+#include <algorithm>
+#include <mutex>
+#include "dir_walker.hpp"
+#include "SourceFile.hpp"
+#include "code_graph.hpp"
 
 namespace code_assistance {
 
 namespace fs = std::filesystem;
 
-// 🚀 THE ELITE HELPER: Segment-based path comparison (Mirroring Sync Logic)
-bool is_inside_path(const fs::path& child, const fs::path& parent) {
-    if (parent.empty()) return false;
-    auto c = child.lexically_normal();
-    auto p = parent.lexically_normal();
-    auto it_c = c.begin();
-    for (auto it_p = p.begin(); it_p != p.end(); ++it_p) {
-        if (it_c == c.end() || *it_c != *it_p) return false;
-        ++it_c;
-    }
-    return true;
-}
-
 ProjectFilter FileSystemTools::load_config(const std::string& root) {
     ProjectFilter filter;
     // 🚀 THE FIX: Look inside the .study_assistant folder for the config
@@ -43,6 +34,7 @@ ProjectFilter FileSystemTools::load_config(const std::string& root) {
                          filter.ignored_paths.size(), filter.included_paths.size());
         } catch (...) { spdlog::error("❌ Config corrupted at {}", config_path.string()); }
     }
+    filter.matcher = std::make_shared<const PathMatcher>(filter.ignored_paths, filter.included_paths);
     return filter;
 }
 
@@ -54,92 +46,82 @@ std::string FileSystemTools::list_dir_deep(const std::string& root, const std::s
     if (base_root.relative_path().empty()) return "ERROR: Security - Root scan blocked.";
     if (!fs::exists(target_path)) return "ERROR: Path not found.";
 
-    // --- PHASE 1: SERIAL DISCOVERY (Fast I/O) ---
-    std::vector<fs::directory_entry> all_entries;
-    try {
-        auto iter_options = fs::directory_options::skip_permission_denied;
-        for (const auto& entry : fs::recursive_directory_iterator(target_path, iter_options)) {
-            all_entries.push_back(entry);
-            // 🛡️ EMERGENCY BRAKE: Limit discovery to prevent RAM overflow
-            if (all_entries.size() > 5000) break; 
-        }
-    } catch (...) {}
-
-    // --- PHASE 2: PARALLEL VALIDATION (Heavy Logic) ---
-    // We use a vector of strings to hold results to avoid thread-shuffling
-    std::vector<std::string> results(all_entries.size(), "");
-    int found_count = 0;
-
-    #pragma omp parallel
-    {
-        #pragma omp for reduction(+:found_count)
-        for (int i = 0; i < (int)all_entries.size(); ++i) {
-            const auto& entry = all_entries[i];
-            fs::path current = entry.path();
-            std::error_code ec;
-            
-            // Calculate depth relative to target
-            auto depth_rel = fs::relative(current, target_path, ec);
-            if (ec) continue;
-            int depth = 0;
-            for (auto it = depth_rel.begin(); it != depth_rel.end(); ++it) depth++;
-            
-            if (depth > max_depth) continue;
-
-            // Mirror Logic: Ignore vs Exception
-            auto rel_path = fs::relative(current, base_root, ec);
-            if (ec) continue;
-
-            bool is_ignored = false;
-            for (const auto& p : filter.ignored_paths) {
-                if (is_inside_path(rel_path, fs::path(p))) { is_ignored = true; break; }
-            }
-
-            bool is_exception = false;
-            for (const auto& p : filter.included_paths) {
-                if (is_inside_path(rel_path, fs::path(p))) { is_exception = true; break; }
-            }
-
-            bool is_bridge = false;
-            for (const auto& p : filter.included_paths) {
-                if (is_inside_path(fs::path(p), rel_path)) { is_bridge = true; break; }
-            }
-
-            if (entry.is_directory()) {
-                if (is_ignored && !is_bridge && !is_exception) continue; 
-            } else {
-                if (is_ignored && !is_exception) continue;
-                
-                std::string ext = current.extension().string();
-                if (!ext.empty()) ext = ext.substr(1);
-                bool ext_match = filter.allowed_extensions.empty();
-                for (const auto& a : filter.allowed_extensions) if (ext == a) { ext_match = true; break; }
-                
-                if (!ext_match && !is_exception) continue;
-            }
-
-            // SUCCESS: Build thread-local visual string
-            std::string line = "";
-            for (int d = 0; d < depth - 1; ++d) line += "  ";
-            line += (entry.is_directory() ? "📁 " : "📄 ") + rel_path.generic_string() + "\n";
-            
-            results[i] = line;
-            found_count++;
+    std::shared_ptr<const PathMatcher> matcher = filter.matcher;
+    if (!matcher) matcher = std::make_shared<const PathMatcher>(filter.ignored_paths, filter.included_paths);
+
+    // --- PHASE 1: PARALLEL PRUNING WALK ---
+    // Ignored directories without an exception beneath, and directories at the depth
+    // limit, are never opened; files are filtered as they stream in
+    std::mutex results_mutex;
+    std::vector<WalkEntry> results;
+    DirWalkOptions walk;
+    walk.matcher = matcher;
+    walk.start = fs::relative(target_path, base_root).generic_string();
+    walk.max_depth = max_depth;
+    walk.report_dirs = true;
+    walk.threads = 4;
+    DirWalker::walk(base_root, walk, [&](WalkEntry&& e) {
+        if (!e.is_dir && !e.included && !filter.allowed_extensions.empty()) {
+            std::string ext = fs::path(e.rel_path).extension().string();
+            if (!ext.empty()) ext = ext.substr(1);
+            bool ext_match = false;
+            for (const auto& a : filter.allowed_extensions) if (ext == a) { ext_match = true; break; }
+            if (!ext_match) return true;
         }
-    }
+        std::lock_guard<std::mutex> lock(results_mutex);
+        results.push_back(std::move(e));
+        // 🛡️ EMERGENCY BRAKE: Limit output to prevent RAM overflow
+        return results.size() < 5000;
+    });
+
+    // --- PHASE 2: AGGREGATION (Tree order: '/' sorts before any other character) ---
+    std::sort(results.begin(), results.end(), [](const WalkEntry& a, const WalkEntry& b) {
+        return std::lexicographical_compare(a.rel_path.begin(), a.rel_path.end(), b.rel_path.begin(), b.rel_path.end(),
+            [](char x, char y) { return (x == '/' ? '\0' : x) < (y == '/' ? '\0' : y); });
+    });
 
-    // --- PHASE 3: AGGREGATION (Merging the Stream) ---
     std::stringstream ss;
     ss << "🛰️ PARALLEL SCAN COMPLETE | WORKSPACE: " << base_root.generic_string() << "\n";
-    for (const auto& s : results) {
-        if (!s.empty()) ss << s;
+    for (const auto& e : results) {
+        for (int d = 0; d < e.depth - 1; ++d) ss << "  ";
+        ss << (e.is_dir ? "📁 " : "📄 ") << e.rel_path << "\n";
     }
+    size_t found_count = results.size();
 
     if (found_count == 0) ss << "(No visible files matching filters)\n";
 
     return ss.str();
 }
 
+namespace {
+
+constexpr size_t MAX_READ_BYTES = 1024 * 512;
+
+size_t count_lines(std::string_view text) {
+    size_t n = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+    return n + (!text.empty() && text.back() != '\n');
+}
+
+// Byte offset where 1-based `line` starts, scanning forward from (`offset`, `at_line`)
+size_t line_offset(std::string_view text, size_t line, size_t offset = 0, size_t at_line = 1) {
+    while (at_line < line && offset < text.size()) {
+        size_t nl = text.find('\n', offset);
+        if (nl == std::string_view::npos) return text.size();
+        offset = nl + 1;
+        at_line++;
+    }
+    return offset;
+}
+
+bool names_symbol(const std::string& name, std::string_view symbol) {
+    if (name == symbol) return true;
+    if (name.size() <= symbol.size() || !std::string_view(name).ends_with(symbol)) return false;
+    char sep = name[name.size() - symbol.size() - 1];
+    return sep == ':' || sep == '.'; // Foo::bar, Foo.bar
+}
+
+} // namespace
+
 std::string FileSystemTools::read_file_safe(const std::string& root, const std::string& rel) {
     fs::path target = (fs::path(root) / rel).lexically_normal();
     spdlog::info("🔍 [I/O Probe] Attempting to read: {}", target.string());
@@ -149,12 +131,74 @@ std::string FileSystemTools::read_file_safe(const std::string& root, const std::
         return "ERROR: File not found at " + rel;
     }
     
-    if (fs::file_size(target) > 1024 * 512) return "ERROR: File too large for direct read (>512KB).";
+    if (fs::file_size(target) > MAX_READ_BYTES) {
+        return "ERROR: File too large for direct read (>512KB). Read it by 'start_line'/'end_line' or 'symbol'.";
+    }
 
-    std::ifstream f(target, std::ios::in | std::ios::binary);
-    std::stringstream buffer;
-    buffer << f.rdbuf();
-    return buffer.str();
+    // Mapped (or read in one call): one copy, into the observation
+    SourceFile source;
+    if (!source.open(target)) return "ERROR: Cannot read " + rel;
+    return std::string(source.view());
+}
+
+std::string FileSystemTools::read_file_range(const std::string& root, const std::string& rel,
+                                             size_t start_line, size_t end_line, const std::string& symbol) {
+    fs::path target = (fs::path(root) / rel).lexically_normal();
+    SourceFile source;
+    if (!fs::exists(target) || !source.open(target)) return "ERROR: File not found at " + rel;
+    std::string_view text = source.view();
+
+    if (!symbol.empty()) {
+        // Byte ranges from the parser (the AST cache makes this free for a file that was synced)
+        auto nodes = CodeParser::extract_nodes_from_file(rel, source.buffer());
+        text = *source.buffer();
+        std::string out;
+        size_t matches = 0;
+        for (const auto& node : nodes) {
+            if (node.type == "file" || !names_symbol(node.name, symbol)) continue;
+            if (++matches > 5) break;
+            std::string_view body = node.text();
+            size_t offset = node.source ? node.source_offset : text.find(body);
+            if (offset == std::string_view::npos) offset = 0;
+            size_t first = count_lines(text.substr(0, offset)) + (offset == 0 || text[offset - 1] == '\n');
+            size_t last = first + static_cast<size_t>(std::count(body.begin(), body.end(), '\n')) -
+                          (!body.empty() && body.back() == '\n');
+            if (out.size() + body.size() > MAX_READ_BYTES) {
+                out += "[... further matches omitted: output limit]\n";
+                break;
+            }
+            out += "[" + rel + " lines " + std::to_string(first) + "-" + std::to_string(last) + ": " + node.type +
+                   " " + node.name + "]\n";
+            out.append(body);
+            out += "\n";
+        }
+        if (matches > 0) return out;
+
+        std::string known;
+        size_t listed = 0;
+        for (const auto& node : nodes) {
+            if (node.type == "file" || listed++ >= 40) continue;
+            if (!known.empty()) known += ", ";
+            known += node.name;
+        }
+        return "ERROR: No symbol '" + symbol + "' in " + rel + (known.empty() ? "." : ". Symbols: " + known);
+    }
+
+    const size_t total = count_lines(text);
+    const size_t first = std::max<size_t>(1, start_line);
+    const size_t last = end_line == 0 ? total : std::min(end_line, total);
+    if (first > total || last < first) {
+        return "ERROR: Lines " + std::to_string(first) + "-" + std::to_string(end_line) + " are outside " + rel +
+               " (" + std::to_string(total) + " lines).";
+    }
+    size_t begin = line_offset(text, first);
+    size_t end = line_offset(text, last + 1, begin, first);
+    if (end - begin > MAX_READ_BYTES) return "ERROR: Range too large (>512KB). Read fewer lines.";
+
+    std::string out = "[" + rel + " lines " + std::to_string(first) + "-" + std::to_string(last) + " of " +
+                      std::to_string(total) + "]\n";
+    out.append(text.substr(begin, end - begin));
+    return out;
 }
 
 // 🔧 Tool Wrapper Implementations
@@ -170,7 +214,13 @@ std::string ListDirTool::execute(const std::string& args_json) {
 std::string ReadFileTool::execute(const std::string& args_json) {
     try {
         auto j = nlohmann::json::parse(args_json);
-        return FileSystemTools::read_file_safe(j.value("project_id", ""), j.value("path", ""));
+        std::string root = j.value("project_id", ""), path = j.value("path", "");
+        size_t start_line = j.value("start_line", size_t(0)), end_line = j.value("end_line", size_t(0));
+        std::string symbol = j.value("symbol", "");
+        if (start_line || end_line || !symbol.empty()) {
+            return FileSystemTools::read_file_range(root, path, start_line, end_line, symbol);
+        }
+        return FileSystemTools::read_file_safe(root, path);
     } catch (...) { return "ERROR: Invalid JSON parameters."; }
 }
 
@@ -1,8 +1,12 @@
 #include "tools/ToolRegistry.hpp"
 #include "embedding_service.hpp"
+#include "SourceFile.hpp"
+#include <filesystem>
 
 namespace code_assistance {
 
+namespace fs = std::filesystem;
+
 class VisionTool : public ITool {
     std::shared_ptr<EmbeddingService> ai_;
 public:
@@ -11,21 +15,39 @@ public:
     ToolMetadata get_metadata() override {
         return {
             "analyze_vision",
-            "Analyzes a screenshot (terminal errors, UI bugs). Input: {'prompt': 'string', 'image_data': 'base64_string'}",
-            "{\"type\":\"object\",\"properties\":{\"prompt\":{\"type\":\"string\"},\"image_data\":{\"type\":\"string\"}}}"
+            "Analyzes a screenshot (terminal errors, UI bugs). Input: {'prompt': 'string', 'image_path': 'file in the "
+            "project'} or {'prompt': 'string', 'image_data': 'base64_string'}; optional 'crop': {'x','y','width','height'} "
+            "in image pixels. Images are downscaled to the model's resolution; prefer image_path.",
+            "{\"type\":\"object\",\"properties\":{\"prompt\":{\"type\":\"string\"},\"image_path\":{\"type\":\"string\"},"
+            "\"image_data\":{\"type\":\"string\"},\"crop\":{\"type\":\"object\"}}}"
         };
     }
 
     std::string execute(const std::string& args_json) override {
         auto j = nlohmann::json::parse(args_json);
         std::string prompt = j.value("prompt", "What is wrong with this image?");
-        std::string base64 = j.value("image_data", "");
 
-        if (base64.empty()) return "ERROR: No image data received.";
+        VisionInput input;
+        SourceFile file; // image_path: the bytes are mapped, never base64-decoded
+        if (j.contains("image_path")) {
+            fs::path target = (fs::path(j.value("project_id", "")) / j["image_path"].get<std::string>()).lexically_normal();
+            if (!file.open(target)) return "ERROR: Cannot read image " + j["image_path"].get<std::string>();
+            input.data = file.view();
+            input.encoded = false;
+        } else if (j.contains("image_data") && j["image_data"].is_string()) {
+            input.data = j["image_data"].get_ref<const std::string&>(); // Viewed in place, not copied
+        }
+        if (input.data.empty()) return "ERROR: No image data received.";
+
+        if (j.contains("crop") && j["crop"].is_object()) {
+            const auto& c = j["crop"];
+            input.crop = CropRect{c.value("x", 0), c.value("y", 0), c.value("width", 0), c.value("height", 0)};
+        }
 
         // 🛰️ Call the Vision Booster
-        auto res = ai_->analyze_vision(prompt, base64);
-        return res.success ? res.analysis : "ERROR: Vision Engine Stall.";
+        auto res = ai_->analyze_vision(prompt, input);
+        if (res.success) return res.analysis;
+        return res.analysis.empty() ? "ERROR: Vision Engine Stall." : "ERROR: " + res.analysis;
     }
 };
 }
\ No newline at end of file
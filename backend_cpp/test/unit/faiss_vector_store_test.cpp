@@ -0,0 +1,224 @@
+#include "faiss_vector_store.hpp"
+#include "node_store.hpp"
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/index_io.h>
+#include <faiss/utils/distances.h>
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using namespace code_assistance;
+
+namespace {
+
+constexpr int DIM = 8;
+
+std::vector<float> random_unit(std::mt19937& rng) {
+    std::normal_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> v(DIM);
+    for (float& x : v) x = unit(rng);
+    faiss::fvec_renorm_L2(DIM, 1, v.data());
+    return v;
+}
+
+// A saved store of `nodes` nodes where only the first `with_vector` are in the index:
+// the others were stored without an embedding
+fs::path write_store(const std::string& name, int nodes, int with_vector, std::vector<float>& first_vector) {
+    fs::path dir = fs::temp_directory_path() / ("code_assist_test_" + name);
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::mt19937 rng(7);
+    NodeStoreWriter writer(DIM, false);
+    faiss::IndexIDMap2 segment(new faiss::IndexFlatIP(DIM));
+    segment.own_fields = true;
+    for (int i = 0; i < nodes; ++i) {
+        CodeNode node;
+        node.id = "src/module.py::fn_" + std::to_string(i);
+        node.name = "fn_" + std::to_string(i);
+        node.file_path = "src/module.py";
+        node.type = "function";
+        node.content = "def fn_" + std::to_string(i) + "(): pass";
+        writer.add(node);
+        if (i < with_vector) {
+            auto v = random_unit(rng);
+            int64_t label = FaissVectorStore::stable_id(node.id);
+            segment.add_with_ids(1, v.data(), &label);
+            if (i == 0) first_vector = v;
+        }
+    }
+    EXPECT_TRUE(writer.write((dir / "nodes.bin").string()));
+    faiss::write_index(&segment, (dir / "seg-1.index").string().c_str());
+    std::ofstream(dir / "segments.json")
+        << json{{"next_segment_id", 2}, {"segments", {{{"id", 1}, {"vectors", with_vector}}}}}.dump();
+    return dir;
+}
+
+} // namespace
+
+// The configured IVF-PQ needs more vectors than the store has, though it holds enough nodes:
+// the merger must settle on HNSW rather than rebuild, find HNSW again, and repeat
+TEST(FaissVectorStore, RebuildSettlesWhenNodesLackVectors) {
+    std::vector<float> query;
+    fs::path dir = write_store("vectorless", 60, 5, query);
+
+    IndexConfig config;
+    config.kind = IndexKind::IVF_PQ;
+    config.ivf_nlist = 1;
+    config.pq_m = 4;
+    config.train_min = 40; // <= 60 nodes, > 5 vectors
+    FaissVectorStore store(DIM, config);
+    store.load(dir.string());
+
+    // compact() waits on the merger; a merger that never stops never lets it in
+    auto compacted = std::async(std::launch::async, [&] { store.compact(); });
+    ASSERT_EQ(compacted.wait_for(std::chrono::seconds(20)), std::future_status::ready) << "merger did not settle";
+    compacted.get();
+
+    EXPECT_EQ(store.size(), 60u);
+    auto hits = store.search(query, 3);
+    ASSERT_FALSE(hits.empty());
+    EXPECT_EQ(hits.front().node->id, "src/module.py::fn_0");
+    fs::remove_all(dir);
+}
+
+// pq_m = 3 does not divide 8 dimensions, so IVF-PQ falls back to HNSW-SQ8: the merger must
+// take that as done, not as a rebuild still due after every upsert
+TEST(FaissVectorStore, PqFallbackIsNotAPendingRebuild) {
+    std::vector<float> query;
+    fs::path dir = write_store("pq_fallback", 60, 60, query);
+
+    IndexConfig config;
+    config.kind = IndexKind::IVF_PQ;
+    config.ivf_nlist = 1;
+    config.pq_m = 3;
+    config.train_min = 40;
+    FaissVectorStore store(DIM, config);
+    store.load(dir.string());
+
+    std::mt19937 rng(11);
+    for (int round = 0; round < 3; ++round) {
+        auto node = std::make_shared<CodeNode>();
+        node->id = "src/extra.py::fn_" + std::to_string(round);
+        node->name = "fn_extra_" + std::to_string(round);
+        node->file_path = "src/extra.py";
+        node->embedding = random_unit(rng);
+        store.upsert_nodes({node});
+
+        auto compacted = std::async(std::launch::async, [&] { store.compact(); });
+        ASSERT_EQ(compacted.wait_for(std::chrono::seconds(20)), std::future_status::ready) << "merger did not settle";
+        compacted.get();
+    }
+
+    EXPECT_EQ(store.size(), 63u);
+    auto hits = store.search(query, 3);
+    ASSERT_FALSE(hits.empty());
+    EXPECT_EQ(hits.front().node->id, "src/module.py::fn_0");
+    fs::remove_all(dir);
+}
+
+// The old vector of a re-upserted node stays in its segment until a merge; search must
+// rank the node by the vector it has now
+TEST(FaissVectorStore, SupersededVectorDoesNotRankNode) {
+    auto node = [](const std::string& id, std::vector<float> v) {
+        auto n = std::make_shared<CodeNode>();
+        n->id = id;
+        n->name = id;
+        n->file_path = "src/module.py";
+        n->embedding = std::move(v);
+        return n;
+    };
+    std::vector<float> old_vec(DIM, 0.0f), new_vec(DIM, 0.0f), other(DIM, 0.0f);
+    old_vec[0] = 1.0f;
+    new_vec[1] = 1.0f;
+    other[0] = 0.6f;
+    other[2] = 0.8f;
+
+    FaissVectorStore store(DIM);
+    store.upsert_nodes({node("moved", old_vec), node("other", other)});
+    store.upsert_nodes({node("moved", new_vec)});
+
+    auto hits = store.search(old_vec, 2);
+    ASSERT_EQ(hits.size(), 2u);
+    EXPECT_EQ(hits[0].node->id, "other");
+    EXPECT_NEAR(hits[0].faiss_score, 0.6f, 1e-4);
+    EXPECT_EQ(hits[1].node->id, "moved");
+    EXPECT_NEAR(hits[1].faiss_score, 0.0f, 1e-4);
+}
+
+// Identifier lookups must find a loaded node without anyone building the index first
+TEST(FaissVectorStore, LexicalIndexReadyAfterLoad) {
+    std::vector<float> unused;
+    fs::path dir = write_store("lexical", 10, 10, unused);
+    FaissVectorStore store(DIM);
+    store.load(dir.string());
+
+    auto live = [&](int64_t label) { return store.contains(label); };
+    auto hits = store.lexical()->search("fn_3", 5, live);
+    ASSERT_FALSE(hits.empty());
+    EXPECT_TRUE(hits.front().exact);
+    EXPECT_EQ(hits.front().label, FaissVectorStore::stable_id("src/module.py::fn_3"));
+    fs::remove_all(dir);
+}
+
+// Most nodes were stored without a vector, so live nodes outnumber index entries: a
+// tombstoned entry must still count as stale, or the single-segment fast path returns it
+TEST(FaissVectorStore, TombstonedVectorStaysStaleAmongVectorlessNodes) {
+    std::vector<float> query;
+    fs::path dir = write_store("tombstone_mix", 60, 5, query);
+    FaissVectorStore store(DIM);
+    store.load(dir.string());
+
+    auto doomed = std::make_shared<CodeNode>();
+    doomed->id = "src/doomed.py::fn";
+    doomed->name = "fn";
+    doomed->file_path = "src/doomed.py";
+    doomed->embedding = query;
+    store.upsert_nodes({doomed});
+    store.compact(); // One segment of 6 entries again
+    ASSERT_EQ(store.remove_by_file("src/doomed.py"), 1u);
+
+    EXPECT_EQ(store.size(), 60u);
+    EXPECT_NEAR(store.tombstone_ratio(), 1.0 / 6.0, 1e-9);
+    auto batch = store.search_batch(query.data(), 1, 3);
+    auto labels = batch.labels_of(0);
+    int64_t doomed_label = FaissVectorStore::stable_id(doomed->id);
+    for (int i = 0; i < batch.k; ++i) EXPECT_NE(labels[i], doomed_label);
+    EXPECT_EQ(labels[0], FaissVectorStore::stable_id("src/module.py::fn_0"));
+    fs::remove_all(dir);
+}
+
+// A file re-sync is one publish: no version in between where the file has no nodes
+TEST(FaissVectorStore, ReplaceFileNodesPublishesOnce) {
+    auto node = [](const std::string& id, const std::string& file, std::vector<float> v) {
+        auto n = std::make_shared<CodeNode>();
+        n->id = id;
+        n->name = id;
+        n->file_path = file;
+        n->embedding = std::move(v);
+        return n;
+    };
+    std::mt19937 rng(5);
+    auto v = random_unit(rng);
+
+    FaissVectorStore store(DIM);
+    store.upsert_nodes({node("src/a.py::old", "src/a.py", random_unit(rng)), node("src/b.py::keep", "src/b.py", random_unit(rng))});
+    uint64_t before = store.version();
+
+    EXPECT_EQ(store.replace_file_nodes({"src/a.py", "src/gone.py"}, {node("src/a.py::new", "src/a.py", v)}), 1u);
+    EXPECT_EQ(store.version(), before + 1);
+    EXPECT_EQ(store.size(), 2u);
+    EXPECT_EQ(store.get_node_by_name("src/a.py::old"), nullptr);
+    auto hits = store.search(v, 1);
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].node->id, "src/a.py::new");
+}
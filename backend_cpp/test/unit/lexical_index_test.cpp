@@ -0,0 +1,62 @@
+#include "lexical_index.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace code_assistance;
+
+namespace {
+
+bool always_live(int64_t) { return true; }
+
+} // namespace
+
+// Re-saving one node many times must not push the term's idf below zero
+TEST(LexicalIndex, SupersededDocsDoNotCountTowardsDf) {
+    LexicalIndex index;
+    index.add(2, "src/a.py::render", "render", "src/a.py", "def render(): draw()");
+    index.add(3, "src/b.py::flush", "flush", "src/b.py", "def flush(): sync()");
+    for (int i = 0; i < 50; ++i) {
+        index.add(1, "src/c.py::parse", "parse", "src/c.py", "def parse(): tokenize() # v" + std::to_string(i));
+    }
+    ASSERT_EQ(index.size(), 3u);
+    EXPECT_EQ(index.superseded(), 49u);
+
+    auto hits = index.search("tokenize", 5, always_live);
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].label, 1);
+    EXPECT_GT(hits[0].score, 0.0f);
+}
+
+TEST(LexicalIndex, CompactDropsSupersededDocs) {
+    LexicalIndex index;
+    index.add(7, "src/d.py::other", "other", "src/d.py", "def other(): pass");
+    index.add(1, "src/c.py::parse", "parse", "src/c.py", "def parse(): legacy_reader()");
+    for (int i = 0; i < 400; ++i) {
+        index.add(1, "src/c.py::parse", "parse", "src/c.py", "def parse(): step" + std::to_string(i) + "()");
+    }
+    ASSERT_TRUE(index.needs_compaction());
+    auto before = index.search("parse", 5, always_live);
+
+    index.compact();
+    EXPECT_FALSE(index.needs_compaction());
+    EXPECT_EQ(index.superseded(), 0u);
+    EXPECT_EQ(index.size(), 2u);
+
+    // Only the newest content survives, and ranking is unchanged
+    EXPECT_TRUE(index.search("legacy_reader", 5, always_live).empty());
+    auto latest = index.search("step399", 5, always_live);
+    ASSERT_EQ(latest.size(), 1u);
+    EXPECT_EQ(latest[0].label, 1);
+    auto after = index.search("parse", 5, always_live);
+    ASSERT_EQ(after.size(), before.size());
+    for (size_t i = 0; i < after.size(); ++i) {
+        EXPECT_EQ(after[i].label, before[i].label);
+        EXPECT_FLOAT_EQ(after[i].score, before[i].score);
+    }
+
+    // Adds after a compaction land on the renumbered ids
+    index.add(7, "src/d.py::other", "other", "src/d.py", "def other(): parse()");
+    auto readded = index.search("other", 5, always_live);
+    ASSERT_FALSE(readded.empty());
+    EXPECT_EQ(readded[0].label, 7);
+}
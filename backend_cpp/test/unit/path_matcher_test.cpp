@@ -0,0 +1,17 @@
+#include "PathMatcher.hpp"
+#include <gtest/gtest.h>
+
+using namespace code_assistance;
+
+// The '/' of a trailing "/**" anchors the pattern like any inner '/'
+TEST(PathMatcher, TrailingGlobstarIsAnchored) {
+    PathMatcher matcher({"src/**", "**/cache/**"}, {});
+    EXPECT_EQ(matcher.check("src/x", false), PathFlag::IGNORE);
+    EXPECT_EQ(matcher.check("src", true), PathFlag::IGNORE);
+    EXPECT_EQ(matcher.check("a/src/x", false), PathFlag::NONE);
+    EXPECT_EQ(matcher.check("a/src", true), PathFlag::NONE);
+
+    // A leading "**/" still means any depth
+    EXPECT_EQ(matcher.check("cache/x", false), PathFlag::IGNORE);
+    EXPECT_EQ(matcher.check("a/b/cache/x", false), PathFlag::IGNORE);
+}
@@ -0,0 +1,62 @@
+#include "agent/ReadCache.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+using namespace code_assistance;
+
+// A repeat read of an unchanged file is answered from the history; after apply_edit the
+// same call is a new read, and loop detection must not reject it first
+TEST(ReadCache, RepeatReadHitsUntilTheFileChanges) {
+    fs::path root = fs::temp_directory_path() / "code_assist_test_read_cache";
+    fs::remove_all(root);
+    fs::create_directories(root / "src");
+    std::ofstream(root / "src" / "a.py") << "def a(): pass\n";
+
+    ReadCache reads(root.string());
+    nlohmann::json args = {{"path", "src/a.py"}};
+    EXPECT_FALSE(ReadCache::loop_checked("read_file"));
+    EXPECT_TRUE(ReadCache::loop_checked("list_dir"));
+
+    std::string first = reads.key(args);
+    ASSERT_FALSE(first.empty());
+    EXPECT_EQ(reads.find(first), nullptr);
+    reads.remember(first, {1, 0, 14});
+
+    const ReadCache::Mark* repeat = reads.find(reads.key(args));
+    ASSERT_NE(repeat, nullptr);
+    EXPECT_EQ(repeat->step, 1u);
+
+    std::ofstream(root / "src" / "a.py", std::ios::app) << "def b(): pass\n"; // The edit
+    std::string edited = reads.key(args);
+    EXPECT_NE(edited, first);
+    EXPECT_EQ(reads.find(edited), nullptr);
+
+    // Another range of the same file is another read
+    nlohmann::json range = {{"path", "src/a.py"}, {"start_line", 2}, {"end_line", 2}};
+    EXPECT_NE(reads.key(range), edited);
+
+    EXPECT_TRUE(reads.key({{"path", "src/missing.py"}}).empty());
+    fs::remove_all(root);
+}
+
+// Arguments come from the model: a mistyped one is a cache miss, not an exception
+TEST(ReadCache, MistypedArgumentsMiss) {
+    fs::path root = fs::temp_directory_path() / "code_assist_test_read_cache_types";
+    fs::remove_all(root);
+    fs::create_directories(root);
+    std::ofstream(root / "a.py") << "def a(): pass\n";
+
+    ReadCache reads(root.string());
+    EXPECT_FALSE(reads.key({{"path", "a.py"}, {"start_line", 1}}).empty());
+    EXPECT_TRUE(reads.key({{"path", "a.py"}, {"start_line", "10"}}).empty());
+    EXPECT_TRUE(reads.key({{"path", "a.py"}, {"end_line", -1}}).empty());
+    EXPECT_TRUE(reads.key({{"path", 3}}).empty());
+    EXPECT_TRUE(reads.key(nlohmann::json::array()).empty());
+
+    EXPECT_EQ(ReadCache::path_of({{"path", "a.py"}}), "a.py");
+    EXPECT_EQ(ReadCache::path_of({{"path", 3}}), "");
+    EXPECT_EQ(ReadCache::path_of("a.py"), "");
+    fs::remove_all(root);
+}
@@ -32,18 +32,26 @@ UI.navItems.forEach(item => {
 // --- DATA POLLING ---
 async function pollTelemetry() {
     try {
-        const res = await fetch('/api/admin/telemetry');
+        const res = await fetch(`/api/admin/telemetry?since=${logCursor}`);
         const data = await res.json();
         
         // Update KPIs
         UI.kpiLatency.innerText = data.metrics.llm_latency.toFixed(0) + 'ms';
         UI.kpiTps.innerText = data.metrics.tps.toFixed(1);
 
-        renderLogs(data.logs);
+        // Only entries after logCursor come back (newest first); a restarted server starts over
+        if (data.log_cursor < logCursor) logs = [];
+        logCursor = data.log_cursor;
+        if (data.logs.length) {
+            logs = data.logs.concat(logs).slice(0, MAX_LOGS);
+            renderLogs(logs);
+        }
     } catch(e) { console.error(e); }
 }
 
-let lastLogCount = 0;
+const MAX_LOGS = 128;
+let logs = [];
+let logCursor = 0;
 
 async function pollTraceData() {
     try {
@@ -73,9 +81,6 @@ function updateOverview(metrics) {
 }
 
 function renderLogs(logs) {
-    if (logs.length === lastLogCount) return;
-    lastLogCount = logs.length;
-
     UI.logList.innerHTML = logs.slice().reverse().map((log, index) => {
         const time = new Date(log.timestamp * 1000).toLocaleTimeString();
         const typeClass = log.type === 'GHOST' ? 'type-GHOST' : 'type-AGENT';